@@ -1,7 +1,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2011, Hammersmith Imanet Ltd
-    Copyright (C) 2013, University College London
+    Copyright (C) 2013, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -578,15 +578,20 @@ read_interfile_PDFS_SPECT(istream& input,
        return 0;
      }
 
-   return new ProjDataFromStream(hdr.get_exam_info_sptr(), 
-				 hdr.data_info_sptr,
-				 data_in,
-				 hdr.data_offset_each_dataset[0],
-				 segment_sequence,
-				 hdr.storage_order,
-				 hdr.type_of_numbers,
-				 hdr.file_byte_order,
-				 static_cast<float>(hdr.image_scaling_factors[0][0]));
+   ProjDataFromStream * const proj_data_ptr =
+     new ProjDataFromStream(hdr.get_exam_info_sptr(), 
+			    hdr.data_info_sptr,
+			    data_in,
+			    hdr.data_offset_each_dataset[0],
+			    segment_sequence,
+			    hdr.storage_order,
+			    hdr.type_of_numbers,
+			    hdr.file_byte_order,
+			    static_cast<float>(hdr.image_scaling_factors[0][0]));
+   // allow reading by multiple threads when the data cannot be modified
+   if (!(open_mode & ios::out))
+     proj_data_ptr->set_up_concurrent_read(full_data_file_name);
+   return proj_data_ptr;
 
 
 }
@@ -648,15 +653,20 @@ read_interfile_PDFS(istream& input,
        return 0;
      }
 
-   return new ProjDataFromStream(hdr.get_exam_info_sptr(),
-				 hdr.data_info_ptr->create_shared_clone(),
-				 data_in,
-				 hdr.data_offset_each_dataset[0],
-				 hdr.segment_sequence,
-				 hdr.storage_order,
-				 hdr.type_of_numbers,
-				 hdr.file_byte_order,
-				 static_cast<float>(hdr.image_scaling_factors[0][0]));
+   ProjDataFromStream * const proj_data_ptr =
+     new ProjDataFromStream(hdr.get_exam_info_sptr(),
+			    hdr.data_info_ptr->create_shared_clone(),
+			    data_in,
+			    hdr.data_offset_each_dataset[0],
+			    hdr.segment_sequence,
+			    hdr.storage_order,
+			    hdr.type_of_numbers,
+			    hdr.file_byte_order,
+			    static_cast<float>(hdr.image_scaling_factors[0][0]));
+   // allow reading by multiple threads when the data cannot be modified
+   if (!(open_mode & ios::out))
+     proj_data_ptr->set_up_concurrent_read(full_data_file_name);
+   return proj_data_ptr;
 
 
 }
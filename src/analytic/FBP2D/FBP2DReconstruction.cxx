@@ -1,7 +1,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2012-01-09, Hammersmith Imanet Ltd
-    Copyright (C) 2013 University College London
+    Copyright (C) 2013, 2016 University College London
 
     This file is part of STIR.
 
@@ -30,10 +30,13 @@
 #include "stir/analytic/FBP2D/FBP2DReconstruction.h"
 #include "stir/VoxelsOnCartesianGrid.h"
 #include "stir/RelatedViewgrams.h"
+#include "stir/HighResWallClockTimer.h"
 #include "stir/recon_buildblock/BackProjectorByBinUsingInterpolation.h"
+#include "stir/recon_buildblock/ThreadLocalImages.h"
 #include "stir/ProjDataInfoCylindricalArcCorr.h"
 #include "stir/ArcCorrection.h"
 #include "stir/analytic/FBP2D/RampFilter.h"
+#include "stir/numerics/fourier.h"
 #include "stir/SSRB.h"
 #include "stir/ProjDataInMemory.h"
 // #include "stir/ProjDataInterfile.h"
@@ -284,7 +287,6 @@ actual_reconstruct(shared_ptr<DiscretisedDensity<3,float> > const & density_ptr)
       tangential_sampling =
 	arc_correction.get_arc_corrected_proj_data_info().get_tangential_sampling();  
     }
-  //ProjDataInterfile ramp_filtered_proj_data(arc_corrected_proj_data_info_sptr,"ramp_filtered");
 
   VoxelsOnCartesianGrid<float>& image =
     dynamic_cast<VoxelsOnCartesianGrid<float>&>(*density_ptr);
@@ -296,26 +298,38 @@ actual_reconstruct(shared_ptr<DiscretisedDensity<3,float> > const & density_ptr)
 
 
   // set ramp filter with appropriate sizes
+#ifdef NRFFT
   const int fft_size = 
     round(pow(2., ceil(log((double)(pad_in_s + 1)* arc_corrected_proj_data_info_sptr->get_num_tangential_poss()) / log(2.))));
+#else
+  // no need to pad to a power of 2
+  const int fft_size =
+    get_efficient_fourier_length((pad_in_s + 1)* arc_corrected_proj_data_info_sptr->get_num_tangential_poss());
+#endif
   
   RampFilter filter(tangential_sampling,
 			 fft_size, 
 			 float(alpha_ramp), float(fc_ramp));   
 
 
+  set_num_threads();
+
   density_ptr->fill(0);
   
   shared_ptr<DataSymmetriesForViewSegmentNumbers> 
     symmetries_sptr(back_projector_sptr->get_symmetries_used()->clone());
     
-  set_num_threads();
+  // every thread back projects into its own image, these are added at the end
+  ThreadLocalImages local_density_images(*density_ptr);
+
+  /* Every set of related viewgrams is read and ramp filtered in one batch
+     (such that the filter uses the same plan and scratch space for all its rows),
+     and then back projected. The time spent in both stages is summed over the threads.
+  */
+  double filter_time = 0.;
+  double back_projection_time = 0.;
 #ifdef STIR_OPENMP
-  shared_ptr<DiscretisedDensity<3,float> > empty_density_ptr(density_ptr->clone());
-#endif
-
-#ifdef STIR_OPENMP
-#pragma omp parallel for shared(empty_density_ptr) schedule(dynamic)
+#pragma omp parallel for shared(local_density_images) schedule(dynamic) reduction(+:filter_time,back_projection_time)
 #endif
   for (int view_num=proj_data_ptr->get_min_view_num(); view_num <= proj_data_ptr->get_max_view_num(); ++view_num) 
   {         
@@ -330,8 +344,15 @@ actual_reconstruct(shared_ptr<DiscretisedDensity<3,float> > const & density_ptr)
     if (!symmetries_sptr->is_basic(vs_num))
       continue;
 
+    HighResWallClockTimer timer;
+    timer.start();
     RelatedViewgrams<float> viewgrams;
 #ifdef STIR_OPENMP
+    // only lock when the projection data cannot be read by several threads at once
+    if (proj_data_ptr->supports_concurrent_read())
+      viewgrams =
+	proj_data_ptr->get_related_viewgrams(vs_num, symmetries_sptr);
+    else
 #pragma omp critical(FBP2D_get_viewgrams)
 #endif
     {
@@ -344,46 +365,35 @@ actual_reconstruct(shared_ptr<DiscretisedDensity<3,float> > const & density_ptr)
 	arc_correction.do_arc_correction(viewgrams);
 
     // now filter
+#ifdef NRFFT
     for (RelatedViewgrams<float>::iterator viewgram_iter = viewgrams.begin();
          viewgram_iter != viewgrams.end();
          ++viewgram_iter)
-    {
-#ifdef NRFFT
       filter.apply(*viewgram_iter);
 #else
-      std::for_each(viewgram_iter->begin(), viewgram_iter->end(), 
-		    filter);
+    filter.apply_to_rows(viewgrams);
 #endif
-    }
-    // ramp_filtered_proj_data.set_related_viewgrams(viewgrams);
-
-  if(display_level>1) 
-    display( viewgrams,viewgrams.find_max(),"Ramp filter");
-
-#ifdef STIR_OPENMP 
-  //clone density_ptr and backproject    
-  shared_ptr<DiscretisedDensity<3,float> > omp_density_ptr(empty_density_ptr->clone());
-           
-    back_projector_sptr->back_project(*omp_density_ptr, viewgrams);
-#pragma omp critical(FBP2D_REDUCTION)
-    {	//reduction
-      
-      DiscretisedDensity<3,float>::full_iterator density_iter = density_ptr->begin_all();
-      DiscretisedDensity<3,float>::full_iterator density_end = density_ptr->end_all();
-      DiscretisedDensity<3,float>::full_iterator omp_density_iter = omp_density_ptr->begin_all();
-      
-      while (density_iter!= density_end)
-	{
-	  *density_iter += (*omp_density_iter);
-	  ++density_iter;
-	  ++omp_density_iter;
-	}
-    }
-#else
-    //  and backproject
-    back_projector_sptr->back_project(*density_ptr, viewgrams);
+    timer.stop();
+    filter_time += timer.value();
+
+    if(display_level>1) 
+      {
+#ifdef STIR_OPENMP
+#pragma omp critical(FBP2D_display)
 #endif
+        display(viewgrams, viewgrams.find_max(), "Ramp filter");
+      }
+
+    timer.reset();
+    timer.start();
+    back_projector_sptr->back_project(local_density_images.get_local_image(), viewgrams);
+    timer.stop();
+    back_projection_time += timer.value();
   } 
+  local_density_images.reduce();
+  info(boost::format("FBP2D: reading and ramp filtering took %1% s, back projection %2% s "
+                     "(wall-clock time summed over threads)")
+       % filter_time % back_projection_time);
  
   // Normalise the image
   const ProjDataInfoCylindrical& proj_data_info_cyl =
@@ -16,6 +16,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
 
     This file is part of STIR.
 
@@ -33,6 +34,7 @@
 */
 
 #include "stir/analytic/FBP2D/RampFilter.h"
+#include "stir/RelatedViewgrams.h"
 #include <math.h>
 #include <iostream>
 #ifdef BOOST_NO_STRINGSTREAM
@@ -41,6 +43,13 @@
 #include <sstream>
 #endif
 #include <algorithm>
+#ifndef NRFFT
+#include "stir/numerics/FFTPlan.h"
+#include "stir/modulo.h"
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+#endif
 
 /* Note: #ifdef NRFFT, then the Numerical Recipes version is used (if you have it...) */
 
@@ -199,4 +208,92 @@ std::string RampFilter:: parameter_info() const
 
 
 
+#ifndef NRFFT
+void
+RampFilter::apply_to_rows(Array<2,float>& data) const
+{
+  std::vector<Array<1,float> *> rows;
+  rows.reserve(data.get_length());
+  for (int r=data.get_min_index(); r<=data.get_max_index(); ++r)
+    rows.push_back(&data[r]);
+  filter_rows(rows);
+}
+
+void
+RampFilter::apply_to_rows(Array<3,float>& data) const
+{
+  std::vector<Array<1,float> *> rows;
+  for (int p=data.get_min_index(); p<=data.get_max_index(); ++p)
+    for (int r=data[p].get_min_index(); r<=data[p].get_max_index(); ++r)
+      rows.push_back(&data[p][r]);
+  filter_rows(rows);
+}
+
+void
+RampFilter::apply_to_rows(RelatedViewgrams<float>& viewgrams) const
+{
+  std::vector<Array<1,float> *> rows;
+  for (RelatedViewgrams<float>::iterator viewgram_iter = viewgrams.begin();
+       viewgram_iter != viewgrams.end();
+       ++viewgram_iter)
+    for (int r=viewgram_iter->get_min_index(); r<=viewgram_iter->get_max_index(); ++r)
+      rows.push_back(&(*viewgram_iter)[r]);
+  filter_rows(rows);
+}
+
+void
+RampFilter::filter_rows(const std::vector<Array<1,float> *>& rows) const
+{
+  const int num_rows = static_cast<int>(rows.size());
+  if (num_rows==0 || is_trivial())
+    return;
+
+  // this is what do_it() does for every row, but using the same plan and
+  // scratch space for all rows
+  const int length = (kernel_in_frequency_space.get_length()-1)*2;
+  const shared_ptr<const RealFFTPlan<float> > plan_sptr =
+    RealFFTPlan<float>::get_plan(length, 1);
+
+#ifdef STIR_OPENMP
+#pragma omp parallel if (num_rows>1 && !omp_in_parallel())
+#endif
+  {
+    // every thread uses its own scratch space, allocated only once
+    Array<1,float> padded_row(length);
+    Array<1,std::complex<float> > frequencies(length/2+1);
+    Array<1,std::complex<float> > scratch(length/2);
+    float * const padded_ptr = padded_row.get_full_data_ptr();
+    std::complex<float> * const frequencies_ptr = frequencies.get_full_data_ptr();
+    std::complex<float> * const scratch_ptr = scratch.get_full_data_ptr();
+    const std::complex<float> * const kernel_ptr = kernel_in_frequency_space.get_const_full_data_ptr();
+
+#ifdef STIR_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int row_num=0; row_num<num_rows; ++row_num)
+      {
+        Array<1,float>& row = *rows[row_num];
+        if (row.get_length() > length)
+          {
+            // wrap-around would add elements, let do_it() handle that
+            (*this)(row);
+            continue;
+          }
+        // zero-pad using wrap-around
+        std::fill(padded_ptr, padded_ptr+length, 0.F);
+        for (int i=row.get_min_index(); i<=row.get_max_index(); ++i)
+          padded_ptr[modulo(i, length)] = row[i];
+
+        plan_sptr->transform(frequencies_ptr, padded_ptr, scratch_ptr);
+        for (int k=0; k<=length/2; ++k)
+          frequencies_ptr[k] *= kernel_ptr[k];
+        plan_sptr->inverse_transform(padded_ptr, frequencies_ptr, scratch_ptr);
+
+        for (int i=row.get_min_index(); i<=row.get_max_index(); ++i)
+          row[i] = padded_ptr[modulo(i, length)];
+      }
+  }
+}
+#endif
+
 END_NAMESPACE_STIR
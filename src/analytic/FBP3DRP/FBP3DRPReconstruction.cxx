@@ -9,6 +9,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2012, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
 
     This file is part of STIR.
 
@@ -87,6 +88,7 @@
 #include "stir/Succeeded.h"
 
 #include "stir/analytic/FBP3DRP/ColsherFilter.h" 
+#include "stir/numerics/fourier.h"
 #include "stir/display.h"
 //#include "stir/recon_buildblock/distributable.h"
 //#include "stir/FBP3DRP/process_viewgrams.h"
@@ -98,19 +100,28 @@
 #include "stir/recon_buildblock/BackProjectorByBinUsingInterpolation.h"
 #include "stir/recon_buildblock/ForwardProjectorByBinUsingRayTracing.h"
 #include "stir/IO/read_from_file.h"
+#include "stir/recon_buildblock/ThreadLocalImages.h"
+#include "stir/num_threads.h"
 //#include "stir/mash_views.h"
+#include <boost/format.hpp>
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <numeric>
 #include <string> 
+#include <vector>
+#include <map>
+#include <utility>
 // for asctime()
 #include <ctime>
 
 #include <algorithm>
 using std::min;
 using std::max;
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
 #ifndef STIR_NO_NAMESPACE
 using std::cerr;
 using std::endl;
@@ -125,6 +136,37 @@ START_NAMESPACE_STIR
 // should be private member, TODO
 static ofstream full_log;
 
+// write a line to full_log. Used when several threads can write at the same time.
+static void write_to_full_log(const std::string& text)
+{
+#ifdef STIR_OPENMP
+#pragma omp critical(FBP3DRP_FULL_LOG)
+#endif
+  full_log << text << endl;
+}
+
+#ifndef NRFFT
+namespace {
+  //! the parameters that determine the Colsher filter for a segment
+  struct ColsherFilterGeometry
+  {
+    int height;
+    int width;
+    float theta;
+    float d_a;
+    float d_b;
+    bool operator<(const ColsherFilterGeometry& other) const
+    {
+      if (height != other.height) return height < other.height;
+      if (width != other.width) return width < other.width;
+      if (theta != other.theta) return theta < other.theta;
+      if (d_a != other.d_a) return d_a < other.d_a;
+      return d_b < other.d_b;
+    }
+  };
+}
+#endif
+
 // terribly ugly. can be replaced using LORCoordinates stuff (TODO)
 static void find_rmin_rmax(int& rmin, int& rmax, 
                            const ProjDataInfoCylindrical& proj_data_info_cyl,
@@ -661,71 +703,115 @@ void FBP3DRPReconstruction::do_3D_Reconstruction(
   shared_ptr<DataSymmetriesForViewSegmentNumbers> symmetries_sptr(
 								  back_projector_sptr->get_symmetries_used()->clone());
 
-  for (int seg_num= -max_segment_num_to_process; seg_num <= max_segment_num_to_process; seg_num++) 
-  {
+#ifndef NRFFT
+  set_up_colsher_filters();
+#endif
+  set_num_threads();
 
-    // a bool value that will be used to determine if we are starting processing for this segment
-    bool first_view_in_segment = true;
-        
-    const int orig_min_axial_pos_num = proj_data_ptr->get_min_axial_pos_num(seg_num);
-    const int orig_max_axial_pos_num = proj_data_ptr->get_max_axial_pos_num(seg_num);
-            
-    for (int view_num=proj_data_ptr->get_min_view_num(); view_num <= proj_data_ptr->get_max_view_num(); ++view_num) {         
-      const ViewSegmentNumbers vs_num(view_num, seg_num);
-      if (!symmetries_sptr->is_basic(vs_num))
-	continue;
+  /* All segments are processed in one parallel loop, unless we need to
+     save the image after every segment.
+  */
+  const bool process_segments_one_by_one =
+    save_intermediate_files && !_disable_output;
 
-    const int new_min_axial_pos_num = 
-      proj_data_info_with_missing_data_sptr->get_min_axial_pos_num(seg_num);
-    const int new_max_axial_pos_num = 
-      proj_data_info_with_missing_data_sptr->get_max_axial_pos_num(seg_num);
+  for (int first_seg_num= -max_segment_num_to_process; first_seg_num <= max_segment_num_to_process; ) 
+  {
+    const int last_seg_num =
+      process_segments_one_by_one ? first_seg_num : max_segment_num_to_process;
 
-      if (first_view_in_segment)
-	{
-	  full_log << "\n--------------------------------\n";
-	  full_log << "PROCESSING SEGMENT  No " << seg_num << endl ;
+    // find the basic view/segment numbers to process
+    std::vector<ViewSegmentNumbers> vs_nums_to_process;
+    for (int seg_num=first_seg_num; seg_num<=last_seg_num; ++seg_num)
+      {
+	// a bool value that will be used to determine if we are starting processing for this segment
+	bool first_view_in_segment = true;
+
+	for (int view_num=proj_data_ptr->get_min_view_num(); view_num <= proj_data_ptr->get_max_view_num(); ++view_num) {         
+	  const ViewSegmentNumbers vs_num(view_num, seg_num);
+	  if (!symmetries_sptr->is_basic(vs_num))
+	    continue;
+	  vs_nums_to_process.push_back(vs_num);
+
+	  if (first_view_in_segment)
+	    {
+	      full_log << "\n--------------------------------\n";
+	      full_log << "SEGMENT  No " << seg_num << endl ;
 	  
-	  full_log << "Average delta= " <<  input_proj_data_info_cyl().get_average_ring_difference(seg_num)
-		   << " with span= " << input_proj_data_info_cyl().get_max_ring_difference(seg_num) - input_proj_data_info_cyl().get_min_ring_difference(seg_num) +1
-		   << " and extended axial position numbers: min= " << new_min_axial_pos_num << " and max= " << new_max_axial_pos_num  <<endl;
+	      full_log << "Average delta= " <<  input_proj_data_info_cyl().get_average_ring_difference(seg_num)
+		       << " with span= " << input_proj_data_info_cyl().get_max_ring_difference(seg_num) - input_proj_data_info_cyl().get_min_ring_difference(seg_num) +1
+		       << " and extended axial position numbers: min= " 
+		       << proj_data_info_with_missing_data_sptr->get_min_axial_pos_num(seg_num)
+		       << " and max= " 
+		       << proj_data_info_with_missing_data_sptr->get_max_axial_pos_num(seg_num)  <<endl;
 	  
-	  first_view_in_segment = false;
+	      first_view_in_segment = false;
+	    }
 	}
+      }
 
-      full_log << "\n*************************************************************";
-      full_log << "\n        Processing view " << vs_num.view_num()
-	       << " of segment " << vs_num.segment_num() << endl;
-	      
-      full_log << "\n  - Getting related viewgrams"  << endl;
- 
-      RelatedViewgrams<float> viewgrams = 
-	proj_data_ptr->get_related_viewgrams(vs_num, symmetries_sptr);
+    // every thread back projects into its own image, these are added at the end
+    ThreadLocalImages local_images(image);
+
+    // note: the NRFFT version of the Colsher filter cannot be used by several threads
+#if defined(STIR_OPENMP) && !defined(NRFFT)
+#pragma omp parallel for shared(local_images, symmetries_sptr) schedule(dynamic)
+#endif
+    for (int i=0; i<static_cast<int>(vs_nums_to_process.size()); ++i)
+      {
+	const ViewSegmentNumbers vs_num = vs_nums_to_process[i];
+	const int seg_num = vs_num.segment_num();
+	const int orig_min_axial_pos_num = proj_data_ptr->get_min_axial_pos_num(seg_num);
+	const int orig_max_axial_pos_num = proj_data_ptr->get_max_axial_pos_num(seg_num);
+	const int new_min_axial_pos_num = 
+	  proj_data_info_with_missing_data_sptr->get_min_axial_pos_num(seg_num);
+	const int new_max_axial_pos_num = 
+	  proj_data_info_with_missing_data_sptr->get_max_axial_pos_num(seg_num);
+
+	write_to_full_log(boost::str(boost::format("\n        Processing view %1% of segment %2%")
+				     % vs_num.view_num() % seg_num));
+
+	RelatedViewgrams<float> viewgrams;
+#ifdef STIR_OPENMP
+	// only lock when the projection data cannot be read by several threads at once.
+	// Other threads continue forward projecting and filtering in the mean time.
+	if (proj_data_ptr->supports_concurrent_read())
+	  viewgrams =
+	    proj_data_ptr->get_related_viewgrams(vs_num, symmetries_sptr);
+	else
+#pragma omp critical(FBP3DRP_get_viewgrams)
+#endif
+	  {
+	    viewgrams = 
+	      proj_data_ptr->get_related_viewgrams(vs_num, symmetries_sptr);
+	  }
         
-      do_process_viewgrams(
-			   viewgrams,
-			   new_min_axial_pos_num, new_max_axial_pos_num, orig_min_axial_pos_num, orig_max_axial_pos_num,
-			   image);
- 
-                 
-    }    
-    // do some logging etc, but only when this segment had any processing
+	do_process_viewgrams(
+			     viewgrams,
+			     new_min_axial_pos_num, new_max_axial_pos_num, orig_min_axial_pos_num, orig_max_axial_pos_num,
+			     dynamic_cast<VoxelsOnCartesianGrid<float>&>(local_images.get_local_image()));
+      }    
+    local_images.reduce();
+
+    // do some logging etc, but only when these segments had any processing
     // (some segment_nums might not because of the symmetries)
-    if (!first_view_in_segment)
+    if (!vs_nums_to_process.empty())
       {
 	full_log << "\n*************************************************************";
-	full_log << "\nEnd of this segment. Current image values:\n"
+	full_log << "\nEnd of segment(s) " << first_seg_num << " to " << last_seg_num 
+		 << ". Current image values:\n"
 		 << "Min= " << image.find_min()
 		 << " Max = " << image.find_max()
 		 << " Sum = " << image.sum() << endl;
 #ifndef PARALLEL
-    if(save_intermediate_files && !_disable_output){
+	if(process_segments_one_by_one){
 	  char *file = new char[output_filename_prefix.size() + 20];
-	  sprintf(file,"%s_afterseg%d",output_filename_prefix.c_str(),seg_num);
+	  sprintf(file,"%s_afterseg%d",output_filename_prefix.c_str(),first_seg_num);
 	  do_save_img(file, image);        
 	  delete[] file;
 	}
-      }
 #endif 
+      }
+    first_seg_num = last_seg_num+1;
   }
   // Normalise the image
   if (dynamic_cast<BackProjectorByBinUsingInterpolation const *>(back_projector_sptr.get()) == 0)
@@ -812,10 +898,9 @@ void FBP3DRPReconstruction::do_forward_project_view(RelatedViewgrams<float> & vi
   // do not forward project if we don't need to...
   if (new_min_axial_pos_num <= orig_min_axial_pos_num-1)
     {
-      full_log << "  - Forward projection of missing data first from ring No " 
-	       << new_min_axial_pos_num
-	       << " to "
-	       << orig_min_axial_pos_num-1 << endl;
+      write_to_full_log(boost::str(boost::format("  - Forward projection of missing data of view %1% of segment %2% first from ring No %3% to %4%")
+				   % viewgrams.get_basic_view_num() % viewgrams.get_basic_segment_num()
+				   % new_min_axial_pos_num % (orig_min_axial_pos_num-1)));
 
       forward_projector_sptr->forward_project(viewgrams, estimated_image(),
 					     new_min_axial_pos_num ,orig_min_axial_pos_num-1);	    
@@ -824,9 +909,9 @@ void FBP3DRPReconstruction::do_forward_project_view(RelatedViewgrams<float> & vi
 
   if (orig_max_axial_pos_num+1 <= new_max_axial_pos_num)
     {
-      full_log << "  - Forward projection from ring No "
-	       << orig_max_axial_pos_num+1
-	       << " to " << new_max_axial_pos_num << endl;
+      write_to_full_log(boost::str(boost::format("  - Forward projection of missing data of view %1% of segment %2% from ring No %3% to %4%")
+				   % viewgrams.get_basic_view_num() % viewgrams.get_basic_segment_num()
+				   % (orig_max_axial_pos_num+1) % new_max_axial_pos_num));
     
       forward_projector_sptr->forward_project(viewgrams, estimated_image(),
 					     orig_max_axial_pos_num+1, new_max_axial_pos_num);
@@ -849,6 +934,10 @@ void FBP3DRPReconstruction::do_forward_project_view(RelatedViewgrams<float> & vi
 #endif
 
   if(display_level>2) {
+    // this is called by several threads, so make sure only one of them displays at a time
+#ifdef STIR_OPENMP
+#pragma omp critical(FBP3DRP_display)
+#endif
     display( viewgrams,viewgrams.find_max(),"Original+Forward projected");
   }
 }
@@ -860,12 +949,28 @@ void FBP3DRPReconstruction::do_colsher_filter_view( RelatedViewgrams<float> & vi
   assert(dynamic_cast<ProjDataInfoCylindricalArcCorr const *>
 	 (viewgrams.get_proj_data_info_ptr()));
 
+  const int seg_num = viewgrams.get_basic_segment_num();
+
+#ifndef NRFFT
+  // find the filter for this segment (set-up by set_up_colsher_filters())
+  const std::map<int, shared_ptr<const ColsherFilter> >::const_iterator filter_iter =
+    colsher_filter_per_segment.find(seg_num);
+  if (filter_iter == colsher_filter_per_segment.end())
+    error("FBP3DRP: Colsher filter was not set-up for segment %d", seg_num);
+  const ColsherFilter& filter = *filter_iter->second;
+
+  //  do not use std::for_each. at present on gcc it copies the filter for every viewgram
+  //  std::for_each(viewgrams.begin(), viewgrams.end(), 
+  //		colsher_filter);
+  RelatedViewgrams<float>::iterator viewgram_iter = viewgrams.begin();
+  for (; viewgram_iter != viewgrams.end(); ++viewgram_iter) 
+    filter(*viewgram_iter);
+
+#else
+
   // TODO make into object member instead of static
   static int prev_seg_num = viewgrams.get_proj_data_info_ptr()->get_min_segment_num()-1;  
-#ifdef NRFFT
   static ColsherFilter colsher_filter(0,0,0,0,0,0,0,0,0,0);
-#endif
-  const int seg_num = viewgrams.get_basic_segment_num();
 
   if (prev_seg_num != seg_num)
   {
@@ -877,7 +982,6 @@ void FBP3DRPReconstruction::do_colsher_filter_view( RelatedViewgrams<float> & vi
     const int width = (int) pow(2., ((int) ceil(log((PadS + 1.) * nprojs) / log(2.))));
     const int height = (int) pow(2., ((int) ceil(log((PadZ + 1.) * nrings) / log(2.))));	
     
-    
     const float theta_max = atan(viewgrams.get_proj_data_info_ptr()->get_tantheta(Bin(max_segment_num_to_process,0,0,0)));
     
     const float theta = 
@@ -891,26 +995,15 @@ void FBP3DRPReconstruction::do_colsher_filter_view( RelatedViewgrams<float> & vi
       << " d_a = " << sampling_in_s
 	     << " d_b = " << sampling_in_t << endl;
     
-    
-#ifdef NRFFT
     colsher_filter = 
       ColsherFilter(height, width, _PI/2 - theta, theta_max, 
                     sampling_in_s, 
                     sampling_in_t,
                     alpha_colsher_axial, fc_colsher_axial,
                     alpha_colsher_planar, fc_colsher_planar);
-#else
-    if (colsher_filter.set_up(height, width, 
-			      theta, 
-			      sampling_in_s, 
-			      sampling_in_t)
-	!= Succeeded::yes)
-      error("Exiting");
-#endif
   }
 
   full_log << "  - Apply Colsher filter to complete oblique sinograms" << endl;
-#ifdef NRFFT
 
   assert(viewgrams.get_num_viewgrams()%2 == 0);
     
@@ -921,15 +1014,6 @@ void FBP3DRPReconstruction::do_colsher_filter_view( RelatedViewgrams<float> & vi
                         colsher_filter,
                         PadS, PadZ); 
 
-#else
-
-  //  do not use std::for_each. at present on gcc it copies the filter for every viewgram
-  //  std::for_each(viewgrams.begin(), viewgrams.end(), 
-  //		colsher_filter);
-  RelatedViewgrams<float>::iterator viewgram_iter = viewgrams.begin();
-  for (; viewgram_iter != viewgrams.end(); ++viewgram_iter) 
-    colsher_filter(*viewgram_iter);
-
 #endif
   /* If the segment is really an amalgam of different ring differences,
      we have to multiply it with the number of ring differences 
@@ -943,24 +1027,92 @@ void FBP3DRPReconstruction::do_colsher_filter_view( RelatedViewgrams<float> & vi
 	const int num_ring_differences = 
 	  input_proj_data_info_cyl().get_max_ring_difference(seg_num) - 
 	  input_proj_data_info_cyl().get_min_ring_difference(seg_num) + 1;
-	full_log << "  - Multiplying filtered projections by " << num_ring_differences << endl;
 	if (num_ring_differences != 1){
           viewgrams *= static_cast<float>(num_ring_differences);
 	}
       
       }
     if(display_level>2) {
+#ifdef STIR_OPENMP
+#pragma omp critical(FBP3DRP_display)
+#endif
       display( viewgrams,viewgrams.find_max(), "Colsher filtered");
     }
 }
 
 
+#ifndef NRFFT
+void FBP3DRPReconstruction::set_up_colsher_filters()
+{
+  colsher_filter_per_segment.clear();
+
+  const ProjDataInfo& proj_data_info = *proj_data_info_with_missing_data_sptr;
+  const float theta_max =
+    atan(proj_data_info.get_tantheta(Bin(max_segment_num_to_process,0,0,0)));
+
+  // first find the filters that are needed, sharing them between segments with the same geometry
+  std::map<ColsherFilterGeometry, shared_ptr<ColsherFilter> > filter_per_geometry;
+  for (int seg_num= -max_segment_num_to_process; seg_num <= max_segment_num_to_process; ++seg_num)
+    {
+      // find size of the viewgrams after do_grow3D_viewgram()
+      const int nrings =
+	max(proj_data_info.get_max_axial_pos_num(seg_num), proj_data_ptr->get_max_axial_pos_num(seg_num)) -
+	min(proj_data_info.get_min_axial_pos_num(seg_num), proj_data_ptr->get_min_axial_pos_num(seg_num)) + 1;
+      const int nprojs = proj_data_info.get_num_tangential_poss();
+
+      ColsherFilterGeometry geometry;
+      // no need to pad to a power of 2
+      geometry.width = get_efficient_fourier_length((PadS + 1) * nprojs);
+      geometry.height = get_efficient_fourier_length((PadZ + 1) * nrings);
+      // the filter only depends on cos(theta), so positive and negative segments can use the same filter
+      geometry.theta =
+	static_cast<float>(fabs(atan(proj_data_info.get_tantheta(Bin(seg_num,0,0,0)))));
+      geometry.d_a = proj_data_info.get_sampling_in_s(Bin(seg_num,0,0,0));
+      geometry.d_b = proj_data_info.get_sampling_in_t(Bin(seg_num,0,0,0));
+
+      shared_ptr<ColsherFilter>& filter_sptr = filter_per_geometry[geometry];
+      if (is_null_ptr(filter_sptr))
+	{
+	  full_log << "  - Constructing Colsher filter for segment " << seg_num << '\n';
+	  full_log << "Colsher filter theta_max = " << theta_max << " theta = " << geometry.theta
+		   << " d_a = " << geometry.d_a
+		   << " d_b = " << geometry.d_b << endl;
+	  // copy the parameters from colsher_filter
+	  filter_sptr.reset(new ColsherFilter(colsher_filter));
+	}
+      else
+	full_log << "  - Segment " << seg_num << " uses the same Colsher filter as a previous segment" << endl;
+      colsher_filter_per_segment[seg_num] = filter_sptr;
+    }
+
+  // now set them up (in parallel)
+  const std::vector<std::pair<ColsherFilterGeometry, shared_ptr<ColsherFilter> > >
+    filters(filter_per_geometry.begin(), filter_per_geometry.end());
+  int num_failures = 0;
+  colsher_filter.start_timers();
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:num_failures)
+#endif
+  for (int i=0; i<static_cast<int>(filters.size()); ++i)
+    {
+      const ColsherFilterGeometry& geometry = filters[i].first;
+      if (filters[i].second->set_up(geometry.height, geometry.width,
+				    geometry.theta,
+				    geometry.d_a,
+				    geometry.d_b)
+	  != Succeeded::yes)
+	++num_failures;
+    }
+  colsher_filter.stop_timers();
+  if (num_failures > 0)
+    error("FBP3DRP: error setting up the Colsher filters. Exiting");
+}
+#endif
+
 void FBP3DRPReconstruction::do_3D_backprojection_view(const RelatedViewgrams<float> & viewgrams,
                                                         VoxelsOnCartesianGrid<float> &image,
                                                         int new_min_axial_pos_num, int new_max_axial_pos_num)
 { 
-    full_log << "  - Backproject the filtered Colsher complete sinograms" << endl;
-
     back_projector_sptr->back_project(image, viewgrams,new_min_axial_pos_num, new_max_axial_pos_num);
         
 }
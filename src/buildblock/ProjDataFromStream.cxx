@@ -12,7 +12,7 @@
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000 - 2011-12-21, Hammersmith Imanet Ltd
     Copyright (C) 2011-2012, Kris Thielemans
-    Copyright (C) 2013, University College London
+    Copyright (C) 2013, 2016, University College London
 
     This file is part of STIR.
 
@@ -42,14 +42,21 @@
 #include "stir/IO/interfile.h"
 #include "stir/IO/write_data.h"
 #include "stir/IO/read_data.h"
+#include "stir/is_null_ptr.h"
+#include "stir/info.h"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+#include "boost/format.hpp"
 #include <numeric>
 #include <iostream>
 #include <fstream>
+#include <streambuf>
 
 #ifndef STIR_NO_NAMESPACES
 using std::find;
 using std::ios;
 using std::iostream;
+using std::istream;
 using std::streamoff;
 using std::fstream;
 using std::cout;
@@ -66,6 +73,60 @@ using std::vector;
 #endif
 
 START_NAMESPACE_STIR
+
+namespace {
+  /* A read-only std::streambuf for a block of memory. The memory is not copied.
+     Only seeking in the get area is supported.
+  */
+  class ReadOnlyMemoryStreamBuf : public std::streambuf
+  {
+  public:
+    ReadOnlyMemoryStreamBuf(const char * const start, const std::size_t size)
+    {
+      // streambuf needs non-const pointers, but we never write
+      char * const start_ptr = const_cast<char *>(start);
+      this->setg(start_ptr, start_ptr, start_ptr + size);
+    }
+
+  protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                             std::ios_base::openmode which = std::ios_base::in)
+    {
+      if (which & std::ios_base::out)
+        return pos_type(off_type(-1));
+      char * new_pos;
+      if (dir == std::ios_base::beg)
+        new_pos = this->eback() + off;
+      else if (dir == std::ios_base::cur)
+        new_pos = this->gptr() + off;
+      else
+        new_pos = this->egptr() + off;
+      if (new_pos < this->eback() || new_pos > this->egptr())
+        return pos_type(off_type(-1));
+      this->setg(this->eback(), new_pos, this->egptr());
+      return pos_type(new_pos - this->eback());
+    }
+
+    virtual pos_type seekpos(pos_type pos,
+                             std::ios_base::openmode which = std::ios_base::in)
+    {
+      return this->seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+  };
+
+  class ReadOnlyMemoryStream : public std::istream
+  {
+  public:
+    ReadOnlyMemoryStream(const char * const start, const std::size_t size)
+      : std::istream(0), buf(start, size)
+    {
+      this->rdbuf(&buf);
+    }
+  private:
+    ReadOnlyMemoryStreamBuf buf;
+  };
+}
+
 //---------------------------------------------------------
 // constructors
 //---------------------------------------------------------
@@ -129,7 +190,9 @@ ProjDataFromStream::get_viewgram(const int view_num, const int segment_num,
   {
     error("ProjDataFromStream::get_viewgram: stream ptr is 0\n");
   }
-  if (! *sino_stream)
+  shared_ptr<istream> mapped_stream_sptr;
+  istream& input = get_input_stream(mapped_stream_sptr);
+  if (! input)
   {
     error("ProjDataFromStream::get_viewgram: error in stream state before reading\n");
   }
@@ -140,10 +203,10 @@ ProjDataFromStream::get_viewgram(const int view_num, const int segment_num,
   const streamoff beg_view_offset = offsets[1];
   const streamoff intra_views_offset = offsets[2];
   
-  sino_stream->seekg(segment_offset, ios::beg); // start of segment
-  sino_stream->seekg(beg_view_offset, ios::cur); // start of view within segment
+  input.seekg(segment_offset, ios::beg); // start of segment
+  input.seekg(beg_view_offset, ios::cur); // start of view within segment
   
-  if (! *sino_stream)
+  if (! input)
   {
     error("ProjDataFromStream::get_viewgram: error after seekg\n");
   }
@@ -156,21 +219,21 @@ ProjDataFromStream::get_viewgram(const int view_num, const int segment_num,
     for (int ax_pos_num = get_min_axial_pos_num(segment_num); ax_pos_num <= get_max_axial_pos_num(segment_num); ax_pos_num++)
     {
       
-      if (read_data(*sino_stream, viewgram[ax_pos_num], on_disk_data_type, scale, on_disk_byte_order)
+      if (read_data(input, viewgram[ax_pos_num], on_disk_data_type, scale, on_disk_byte_order)
         == Succeeded::no)
         error("ProjDataFromStream: error reading data\n");
       if(scale != 1)
         error("ProjDataFromStream: error reading data: scale factor returned by read_data should be 1\n");
       // seek to next line unless it was the last we need to read
       if(ax_pos_num != get_max_axial_pos_num(segment_num))
-         sino_stream->seekg(intra_views_offset, ios::cur);
+         input.seekg(intra_views_offset, ios::cur);
     }
   }
   
   
   else if (get_storage_order() == Segment_View_AxialPos_TangPos)
   {
-    if(read_data(*sino_stream, viewgram, on_disk_data_type, scale, on_disk_byte_order)
+    if(read_data(input, viewgram, on_disk_data_type, scale, on_disk_byte_order)
       == Succeeded::no)
       error("ProjDataFromStream: error reading data\n");
     if(scale != 1)
@@ -447,7 +510,9 @@ ProjDataFromStream::get_sinogram(const int ax_pos_num, const int segment_num,
   {
     error("ProjDataFromStream::get_sinogram: stream ptr is 0\n");
   }
-  if (! *sino_stream)
+  shared_ptr<istream> mapped_stream_sptr;
+  istream& input = get_input_stream(mapped_stream_sptr);
+  if (! input)
   {
     error("ProjDataFromStream::get_sinogram: error in stream state before reading\n");
   }
@@ -460,10 +525,10 @@ ProjDataFromStream::get_sinogram(const int ax_pos_num, const int segment_num,
   const streamoff beg_ax_pos_offset = offsets[1];
   const streamoff intra_ax_pos_offset = offsets[2];
   
-  sino_stream->seekg(segment_offset, ios::beg); // start of segment
-  sino_stream->seekg(beg_ax_pos_offset, ios::cur); // start of view within segment
+  input.seekg(segment_offset, ios::beg); // start of segment
+  input.seekg(beg_ax_pos_offset, ios::cur); // start of view within segment
   
-  if (! *sino_stream)
+  if (! input)
   {
     error("ProjDataFromStream::get_sinogram: error after seekg\n");
   }
@@ -473,7 +538,7 @@ ProjDataFromStream::get_sinogram(const int ax_pos_num, const int segment_num,
   
   if (get_storage_order() == Segment_AxialPos_View_TangPos)
   {    
-      if(read_data(*sino_stream, sinogram, on_disk_data_type, scale, on_disk_byte_order)
+      if(read_data(input, sinogram, on_disk_data_type, scale, on_disk_byte_order)
         == Succeeded::no)
         error("ProjDataFromStream: error reading data\n");
       if(scale != 1)
@@ -485,14 +550,14 @@ ProjDataFromStream::get_sinogram(const int ax_pos_num, const int segment_num,
   {
    for (int view = get_min_view_num(); view <= get_max_view_num(); view++)
     {
-     if (read_data(*sino_stream, sinogram[view], on_disk_data_type, scale, on_disk_byte_order)
+     if (read_data(input, sinogram[view], on_disk_data_type, scale, on_disk_byte_order)
         == Succeeded::no)
         error("ProjDataFromStream: error reading data\n");
      if(scale != 1)
        error("ProjDataFromStream: error reading data: scale factor returned by read_data should be 1\n");
       // seek to next line unless it was the last we need to read
       if(view != get_max_view_num())
-        sino_stream->seekg(intra_ax_pos_offset, ios::cur);
+        input.seekg(intra_ax_pos_offset, ios::cur);
    }    
   }
   sinogram *= scale_factor;
@@ -643,14 +708,16 @@ ProjDataFromStream::get_segment_by_sinogram(const int segment_num) const
   {
     error("ProjDataFromStream::get_segment_by_sinogram: stream ptr is 0\n");
   }
-  if (! *sino_stream)
+  shared_ptr<istream> mapped_stream_sptr;
+  istream& input = get_input_stream(mapped_stream_sptr);
+  if (! input)
   {
     error("ProjDataFromStream::get_segment_by_sinogram: error in stream state before reading\n");
   }
     
   streamoff segment_offset = get_offset_segment(segment_num);
-  sino_stream->seekg(segment_offset, ios::beg);
-  if (! *sino_stream)
+  input.seekg(segment_offset, ios::beg);
+  if (! input)
   {
     error("ProjDataFromStream::get_segment_by_sinogram: error after seekg\n");
   }
@@ -660,7 +727,7 @@ ProjDataFromStream::get_segment_by_sinogram(const int segment_num) const
     SegmentBySinogram<float> segment(proj_data_info_ptr,segment_num);
     {
       float scale = float(1);
-      if(read_data(*sino_stream, segment, on_disk_data_type, scale, on_disk_byte_order)        
+      if(read_data(input, segment, on_disk_data_type, scale, on_disk_byte_order)        
         == Succeeded::no)
       error("ProjDataFromStream: error reading data\n");
       if(scale != 1)
@@ -689,7 +756,9 @@ ProjDataFromStream::get_segment_by_view(const int segment_num) const
   {
     error("ProjDataFromStream::get_segment_by_view: stream ptr is 0\n");
   }
-  if (! *sino_stream)
+  shared_ptr<istream> mapped_stream_sptr;
+  istream& input = get_input_stream(mapped_stream_sptr);
+  if (! input)
   {
     error("ProjDataFromStream::get_segment_by_view: error in stream state before reading\n");
   }
@@ -698,9 +767,9 @@ ProjDataFromStream::get_segment_by_view(const int segment_num) const
   {
     
     streamoff segment_offset = get_offset_segment(segment_num);
-    sino_stream->seekg(segment_offset, ios::beg);
+    input.seekg(segment_offset, ios::beg);
     
-    if (! *sino_stream)
+    if (! input)
     {
       error("ProjDataFromStream::get_segment_by_sinogram: error after seekg\n");
     }
@@ -709,7 +778,7 @@ ProjDataFromStream::get_segment_by_view(const int segment_num) const
     
     {
       float scale = float(1);
-      if(read_data(*sino_stream, segment, on_disk_data_type, scale, on_disk_byte_order)
+      if(read_data(input, segment, on_disk_data_type, scale, on_disk_byte_order)
         == Succeeded::no)
       error("ProjDataFromStream: error reading data\n");
       if(scale != 1)
@@ -1033,6 +1102,59 @@ ProjDataFromStream::get_scale_factor() const
 { 
   return scale_factor;}
 
+Succeeded
+ProjDataFromStream::set_up_concurrent_read(const std::string& data_filename)
+{
+  using namespace boost::interprocess;
+  mapped_region_sptr.reset();
+
+  streamoff num_sinograms = 0;
+  for (std::size_t i=0; i<segment_sequence.size(); ++i)
+    num_sinograms += get_num_axial_poss(segment_sequence[i]);
+  const streamoff data_size =
+    num_sinograms *
+    get_num_tangential_poss() *
+    get_num_views() *
+    on_disk_data_type.size_in_bytes();
+  // only the part of the file up to the end of the data is mapped
+  const streamoff end_of_data = offset + data_size;
+  {
+    std::ifstream file(data_filename.c_str(), ios::in | ios::binary | ios::ate);
+    // files that do not contain all data yet (e.g. templates) are read via the stream
+    if (!file || data_size == 0 || static_cast<streamoff>(file.tellg()) < end_of_data)
+      return Succeeded::no;
+  }
+  try
+    {
+      file_mapping mapping(data_filename.c_str(), read_only);
+      mapped_region_sptr.reset(new mapped_region(mapping, read_only, 0, static_cast<std::size_t>(end_of_data)));
+    }
+  catch (interprocess_exception& e)
+    {
+      info(boost::format("ProjDataFromStream: %1% could not be mapped into memory (%2%). "
+                         "Data will be read via the stream.") % data_filename % e.what());
+      mapped_region_sptr.reset();
+      return Succeeded::no;
+    }
+  return Succeeded::yes;
+}
+
+bool
+ProjDataFromStream::supports_concurrent_read() const
+{
+  return !is_null_ptr(mapped_region_sptr);
+}
+
+istream&
+ProjDataFromStream::get_input_stream(shared_ptr<istream>& mapped_stream_sptr) const
+{
+  if (is_null_ptr(mapped_region_sptr))
+    return *sino_stream;
+  mapped_stream_sptr.reset(new ReadOnlyMemoryStream(static_cast<const char *>(mapped_region_sptr->get_address()),
+                                                    mapped_region_sptr->get_size()));
+  return *mapped_stream_sptr;
+}
+
 
 
 END_NAMESPACE_STIR
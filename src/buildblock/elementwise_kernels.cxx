@@ -0,0 +1,409 @@
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup Array
+
+  \brief Implementation of the float versions of the functions declared in
+  stir/elementwise_kernels.h
+
+  The loops are written such that the compiler can vectorise them. They are compiled
+  once for every supported instruction set (using the \c target attribute of gcc and clang),
+  and the version used is selected at run-time.
+*/
+
+#include "stir/elementwise_kernels.h"
+#include <algorithm>
+#include <cmath>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STIR_ELEMENTWISE_KERNELS_X86
+#endif
+
+START_NAMESPACE_STIR
+
+namespace
+{
+  typedef void (*BinaryKernel)(float *, const float *, std::size_t);
+  typedef void (*ScalarKernel)(float *, float, std::size_t);
+  typedef void (*UnaryKernel)(float *, std::size_t);
+  typedef void (*ThresholdKernel)(float *, std::size_t, float, float);
+  typedef void (*DivideUnlessSmallKernel)(float *, const float *, std::size_t, float);
+
+  //! pointers to the versions of all operations for one instruction set
+  struct KernelTable
+  {
+    const char * name;
+    BinaryKernel add;
+    BinaryKernel subtract;
+    BinaryKernel multiply;
+    BinaryKernel divide;
+    ScalarKernel add_scalar;
+    ScalarKernel subtract_scalar;
+    ScalarKernel multiply_scalar;
+    ScalarKernel divide_scalar;
+    UnaryKernel log;
+    UnaryKernel exp;
+    ThresholdKernel threshold_upper_lower;
+    BinaryKernel divide_or_zero;
+    DivideUnlessSmallKernel divide_unless_small;
+  };
+
+/* Defines all operations with the given function attribute, such that they can be
+   compiled for different instruction sets.
+*/
+#define STIR_ELEMENTWISE_KERNELS(TARGET)                                \
+  TARGET void add(float * a, const float * b, std::size_t n)           \
+  { for (std::size_t i=0; i<n; ++i) a[i] += b[i]; }                     \
+  TARGET void subtract(float * a, const float * b, std::size_t n)      \
+  { for (std::size_t i=0; i<n; ++i) a[i] -= b[i]; }                     \
+  TARGET void multiply(float * a, const float * b, std::size_t n)      \
+  { for (std::size_t i=0; i<n; ++i) a[i] *= b[i]; }                     \
+  TARGET void divide(float * a, const float * b, std::size_t n)        \
+  { for (std::size_t i=0; i<n; ++i) a[i] /= b[i]; }                     \
+  TARGET void add_scalar(float * a, float value, std::size_t n)         \
+  { for (std::size_t i=0; i<n; ++i) a[i] += value; }                    \
+  TARGET void subtract_scalar(float * a, float value, std::size_t n)    \
+  { for (std::size_t i=0; i<n; ++i) a[i] -= value; }                    \
+  TARGET void multiply_scalar(float * a, float value, std::size_t n)    \
+  { for (std::size_t i=0; i<n; ++i) a[i] *= value; }                    \
+  TARGET void divide_scalar(float * a, float value, std::size_t n)      \
+  { for (std::size_t i=0; i<n; ++i) a[i] /= value; }                    \
+  TARGET void log(float * a, std::size_t n)                             \
+  { for (std::size_t i=0; i<n; ++i) a[i] = std::log(a[i]); }            \
+  TARGET void exp(float * a, std::size_t n)                             \
+  { for (std::size_t i=0; i<n; ++i) a[i] = std::exp(a[i]); }            \
+  TARGET void threshold_upper_lower(float * a, std::size_t n,           \
+                                    float new_min, float new_max)       \
+  {                                                                     \
+    for (std::size_t i=0; i<n; ++i)                                     \
+      a[i] = a[i] > new_max ? new_max : (new_min > a[i] ? new_min : a[i]); \
+  }                                                                     \
+  TARGET void divide_or_zero(float * a, const float * b, std::size_t n) \
+  { for (std::size_t i=0; i<n; ++i) a[i] = b[i] != 0 ? a[i]/b[i] : 0.F; } \
+  TARGET void divide_unless_small(float * a, const float * b, std::size_t n, \
+                                  float small_value)                    \
+  {                                                                     \
+    for (std::size_t i=0; i<n; ++i)                                     \
+      a[i] = std::fabs(b[i])<=small_value && std::fabs(a[i])<=small_value ? \
+        0.F : a[i]/b[i];                                                \
+  }
+
+#define STIR_ELEMENTWISE_KERNEL_TABLE(NAME, NAMESPACE)                  \
+  { NAME,                                                               \
+      &NAMESPACE::add, &NAMESPACE::subtract, &NAMESPACE::multiply, &NAMESPACE::divide, \
+      &NAMESPACE::add_scalar, &NAMESPACE::subtract_scalar,              \
+      &NAMESPACE::multiply_scalar, &NAMESPACE::divide_scalar,           \
+      &NAMESPACE::log, &NAMESPACE::exp,                                 \
+      &NAMESPACE::threshold_upper_lower,                                \
+      &NAMESPACE::divide_or_zero, &NAMESPACE::divide_unless_small }
+
+#define STIR_TARGET_GENERIC
+  namespace generic_kernels
+  {
+    STIR_ELEMENTWISE_KERNELS(STIR_TARGET_GENERIC)
+  }
+
+  const KernelTable generic_table = STIR_ELEMENTWISE_KERNEL_TABLE("generic", generic_kernels);
+
+#ifdef STIR_ELEMENTWISE_KERNELS_X86
+#define STIR_TARGET_AVX2 __attribute__((target("avx2")))
+#define STIR_TARGET_AVX512 __attribute__((target("avx512f")))
+  namespace avx2_kernels
+  {
+    STIR_ELEMENTWISE_KERNELS(STIR_TARGET_AVX2)
+  }
+  namespace avx512_kernels
+  {
+    STIR_ELEMENTWISE_KERNELS(STIR_TARGET_AVX512)
+  }
+
+  const KernelTable avx2_table = STIR_ELEMENTWISE_KERNEL_TABLE("avx2", avx2_kernels);
+  const KernelTable avx512_table = STIR_ELEMENTWISE_KERNEL_TABLE("avx512", avx512_kernels);
+#endif
+
+  //! all tables that can be used on this processor, in order of preference
+  std::vector<const KernelTable *>
+  get_supported_tables()
+  {
+    std::vector<const KernelTable *> tables;
+    tables.push_back(&generic_table);
+#ifdef STIR_ELEMENTWISE_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      tables.push_back(&avx2_table);
+    if (__builtin_cpu_supports("avx512f"))
+      tables.push_back(&avx512_table);
+#endif
+    return tables;
+  }
+
+  //! the pointer to the table currently in use (initialised to the best supported one)
+  /*! Only use this via current_table() and set_current_table(). */
+  const KernelTable *&
+  current_table_ptr()
+  {
+    static const KernelTable * table = get_supported_tables().back();
+    return table;
+  }
+
+  //! the table currently in use
+  /*! The pointer is read atomically, as it can be changed by set_elementwise_instruction_set()
+      while other threads are using it. */
+  const KernelTable *
+  current_table()
+  {
+    const KernelTable *& table_ptr = current_table_ptr();
+    const KernelTable * table;
+#ifdef STIR_OPENMP
+#pragma omp atomic read
+#endif
+    table = table_ptr;
+    return table;
+  }
+
+  void
+  set_current_table(const KernelTable * const table)
+  {
+    const KernelTable *& table_ptr = current_table_ptr();
+#ifdef STIR_OPENMP
+#pragma omp atomic write
+#endif
+    table_ptr = table;
+  }
+
+  //! minimum number of elements before splitting the work over threads
+  const std::size_t min_num_elements_per_thread = 1 << 15;
+
+  /* Calls f(start, count) for chunks that cover 0..n-1.
+     With OpenMP, the chunks are processed in parallel. Chunks start at a
+     multiple of 16 elements to preserve alignment.
+  */
+  template <class ChunkFunction>
+  void
+  apply_in_chunks(const std::size_t n, const ChunkFunction& f)
+  {
+#ifdef STIR_OPENMP
+    const int num_chunks =
+      static_cast<int>(std::min(static_cast<std::size_t>(omp_get_max_threads()),
+                                n / min_num_elements_per_thread));
+    if (num_chunks > 1 && !omp_in_parallel())
+      {
+#pragma omp parallel for schedule(static)
+        for (int chunk_num = 0; chunk_num < num_chunks; ++chunk_num)
+          {
+            const std::size_t start =
+              (n / num_chunks * chunk_num) & ~static_cast<std::size_t>(15);
+            const std::size_t end =
+              chunk_num == num_chunks-1
+              ? n
+              : (n / num_chunks * (chunk_num+1)) & ~static_cast<std::size_t>(15);
+            f(start, end - start);
+          }
+        return;
+      }
+#endif
+    f(0, n);
+  }
+
+  class CallBinaryKernel
+  {
+  public:
+    CallBinaryKernel(BinaryKernel kernel, float * a, const float * b)
+      : kernel(kernel), a(a), b(b)
+    {}
+    void operator()(const std::size_t start, const std::size_t count) const
+    { kernel(a + start, b + start, count); }
+  private:
+    BinaryKernel kernel;
+    float * a;
+    const float * b;
+  };
+
+  class CallScalarKernel
+  {
+  public:
+    CallScalarKernel(ScalarKernel kernel, float * a, const float value)
+      : kernel(kernel), a(a), value(value)
+    {}
+    void operator()(const std::size_t start, const std::size_t count) const
+    { kernel(a + start, value, count); }
+  private:
+    ScalarKernel kernel;
+    float * a;
+    float value;
+  };
+
+  class CallUnaryKernel
+  {
+  public:
+    CallUnaryKernel(UnaryKernel kernel, float * a)
+      : kernel(kernel), a(a)
+    {}
+    void operator()(const std::size_t start, const std::size_t count) const
+    { kernel(a + start, count); }
+  private:
+    UnaryKernel kernel;
+    float * a;
+  };
+
+  class CallThresholdKernel
+  {
+  public:
+    CallThresholdKernel(ThresholdKernel kernel, float * a, const float new_min, const float new_max)
+      : kernel(kernel), a(a), new_min(new_min), new_max(new_max)
+    {}
+    void operator()(const std::size_t start, const std::size_t count) const
+    { kernel(a + start, count, new_min, new_max); }
+  private:
+    ThresholdKernel kernel;
+    float * a;
+    float new_min;
+    float new_max;
+  };
+
+  class CallDivideUnlessSmallKernel
+  {
+  public:
+    CallDivideUnlessSmallKernel(DivideUnlessSmallKernel kernel, float * a, const float * b,
+                                const float small_value)
+      : kernel(kernel), a(a), b(b), small_value(small_value)
+    {}
+    void operator()(const std::size_t start, const std::size_t count) const
+    { kernel(a + start, b + start, count, small_value); }
+  private:
+    DivideUnlessSmallKernel kernel;
+    float * a;
+    const float * b;
+    float small_value;
+  };
+
+} // end of unnamed namespace
+
+void
+elementwise_add(float * const a, const float * const b, const std::size_t n)
+{
+  apply_in_chunks(n, CallBinaryKernel(current_table()->add, a, b));
+}
+
+void
+elementwise_subtract(float * const a, const float * const b, const std::size_t n)
+{
+  apply_in_chunks(n, CallBinaryKernel(current_table()->subtract, a, b));
+}
+
+void
+elementwise_multiply(float * const a, const float * const b, const std::size_t n)
+{
+  apply_in_chunks(n, CallBinaryKernel(current_table()->multiply, a, b));
+}
+
+void
+elementwise_divide(float * const a, const float * const b, const std::size_t n)
+{
+  apply_in_chunks(n, CallBinaryKernel(current_table()->divide, a, b));
+}
+
+void
+elementwise_add_scalar(float * const a, const float& value, const std::size_t n)
+{
+  apply_in_chunks(n, CallScalarKernel(current_table()->add_scalar, a, value));
+}
+
+void
+elementwise_subtract_scalar(float * const a, const float& value, const std::size_t n)
+{
+  apply_in_chunks(n, CallScalarKernel(current_table()->subtract_scalar, a, value));
+}
+
+void
+elementwise_multiply_scalar(float * const a, const float& value, const std::size_t n)
+{
+  apply_in_chunks(n, CallScalarKernel(current_table()->multiply_scalar, a, value));
+}
+
+void
+elementwise_divide_scalar(float * const a, const float& value, const std::size_t n)
+{
+  apply_in_chunks(n, CallScalarKernel(current_table()->divide_scalar, a, value));
+}
+
+void
+elementwise_log(float * const a, const std::size_t n)
+{
+  apply_in_chunks(n, CallUnaryKernel(current_table()->log, a));
+}
+
+void
+elementwise_exp(float * const a, const std::size_t n)
+{
+  apply_in_chunks(n, CallUnaryKernel(current_table()->exp, a));
+}
+
+void
+elementwise_threshold_upper_lower(float * const a, const std::size_t n,
+                                  const float new_min, const float new_max)
+{
+  apply_in_chunks(n, CallThresholdKernel(current_table()->threshold_upper_lower, a, new_min, new_max));
+}
+
+void
+elementwise_divide_or_zero(float * const a, const float * const b, const std::size_t n)
+{
+  apply_in_chunks(n, CallBinaryKernel(current_table()->divide_or_zero, a, b));
+}
+
+void
+elementwise_divide_unless_small(float * const a, const float * const b, const std::size_t n,
+                                const float small_value)
+{
+  apply_in_chunks(n, CallDivideUnlessSmallKernel(current_table()->divide_unless_small, a, b, small_value));
+}
+
+std::string
+get_elementwise_instruction_set()
+{
+  return current_table()->name;
+}
+
+std::vector<std::string>
+get_supported_elementwise_instruction_sets()
+{
+  const std::vector<const KernelTable *> tables = get_supported_tables();
+  std::vector<std::string> names;
+  for (unsigned int i=0; i<tables.size(); ++i)
+    names.push_back(tables[i]->name);
+  return names;
+}
+
+Succeeded
+set_elementwise_instruction_set(const std::string& name)
+{
+  const std::vector<const KernelTable *> tables = get_supported_tables();
+  for (unsigned int i=0; i<tables.size(); ++i)
+    if (name == tables[i]->name)
+      {
+        set_current_table(tables[i]);
+        return Succeeded::yes;
+      }
+  return Succeeded::no;
+}
+
+END_NAMESPACE_STIR
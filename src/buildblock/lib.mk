@@ -2,6 +2,7 @@ dir:=buildblock
 
 $(dir)_LIB_SOURCES := \
   Array.cxx  \
+  elementwise_kernels.cxx \
   IndexRange.cxx \
   PatientPosition.cxx \
   ProjData.cxx \
@@ -3,6 +3,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR. 
  
     This file is free software; you can redistribute it and/or modify 
@@ -38,6 +39,7 @@
 #include "stir/Viewgram.h"
 #include "stir/SegmentByView.h"
 #include "stir/SegmentBySinogram.h"
+#include "stir/elementwise_kernels.h"
 
 #include <numeric>
 
@@ -300,6 +302,14 @@ void divide_and_truncate(RelatedViewgrams<float>& numerator, const RelatedViewgr
 
 void divide_array(SegmentByView<float>& numerator,const SegmentByView<float>& denominator)
 {
+  if (numerator.is_contiguous() && denominator.is_contiguous() &&
+      numerator.get_index_range() == denominator.get_index_range())
+    {
+      elementwise_divide_or_zero(numerator.get_full_data_ptr(),
+                                 denominator.get_const_full_data_ptr(),
+                                 numerator.size_all());
+      return;
+    }
   
   const int vs=numerator.get_min_view_num();
   const int ve=numerator.get_max_view_num();
@@ -327,6 +337,13 @@ void divide_array(DiscretisedDensity<3,float>& numerator, const DiscretisedDensi
   assert(numerator.get_index_range() == denominator.get_index_range());
   float small_value= numerator.find_max()*SMALL_NUM;
   small_value=(small_value>0.0F)?small_value:0.0F;   
+  if (numerator.is_contiguous() && denominator.is_contiguous())
+    {
+      elementwise_divide_unless_small(numerator.get_full_data_ptr(),
+                                      denominator.get_const_full_data_ptr(),
+                                      numerator.size_all(), small_value);
+      return;
+    }
   // TODO rewrite in terms of 'full' iterator
  
   for (int z=numerator.get_min_index(); z<=numerator.get_max_index(); z++)
@@ -51,6 +51,9 @@ protected:
 
   virtual void start_new_time_frame(const unsigned int new_frame_num);
 
+  //! returns \c false, as the motion is updated for every time event
+  virtual bool supports_parallel_binning() const { return false; }
+
    
   virtual void set_defaults();
   virtual void initialise_keymap();
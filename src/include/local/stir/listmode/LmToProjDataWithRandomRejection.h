@@ -93,6 +93,9 @@ protected:
 
   virtual void get_bin_from_event(Bin& bin, const CListEvent&) const;
 
+  //! returns \c false, as a pseudo-random number generator is used for every event
+  virtual bool supports_parallel_binning() const { return false; }
+
 
   // \name parsing variables
   //@{
@@ -41,6 +41,8 @@
 #include "stir/NumericVectorWithOffset.h"
 #include "stir/ByteOrder.h"
 #include "stir/IndexRange.h"   
+#include <boost/shared_array.hpp>
+#include <cstddef>
 
 START_NAMESPACE_STIR
 class NumericType;
@@ -72,6 +74,20 @@ Array inherits its numeric operators from NumericVectorWithOffset.
 In particular this means that operator+= etc. potentially grow
 the object. However, as grow() is a virtual function, Array::grow is
 called, which initialises new elements first to 0.
+
+\par Storage
+
+When an Array is constructed (or copied, assigned with a different range, or resized), all
+its elements are stored in one contiguous block of memory (aligned to 64 bytes when
+possible), in the order of the full_iterator. The nested lower-dimensional arrays are views
+into this block (see VectorWithOffset for arrays using existing memory). This avoids a
+memory allocation for every row, and allows operations on the whole array such as fill(),
+operator+=(), find_max() and read_data()/write_data() to work on one flat block.
+
+Changing the range of one of the nested arrays (e.g. <tt>a[1].resize(...)</tt>) moves its
+elements to a new block. The array then still works as before, but is_contiguous() will
+return \c false, and the operations above use the (slower) recursive implementation.
+This is also the case for arrays grown by operator+= etc.
 */
 
 template <int num_dimensions, typename elemT>
@@ -133,18 +149,25 @@ public:
   
 #ifndef SWIG
   //! Construct an Array from an object of its base_type
+  /*! The elements are copied into one contiguous block. */
   inline Array(const base_type& t);
 #else
   // swig 2.0.4 gets confused by base_type (due to numeric template arguments)
   // therefore, we declare this constructor using the "self" type, 
   // i.e. it's just a copy-constructor.
   // This is less powerful as in C++, but swig-generated interfaces don't need to know about the base_type anyway
-  inline Array(const self& t);
 #endif
+  //! Copy constructor, the elements are copied into one contiguous block
+  inline Array(const self& t);
   
   //! virtual destructor, frees up any allocated memory
   inline virtual ~Array();
 
+  //! assignment operator
+  /*! When the index ranges are the same, the elements are copied in place. Otherwise,
+      a new contiguous block is allocated. */
+  inline self& operator=(const self& t);
+
   /*! @name functions returning full_iterators*/
   //@{
   //! start value for iterating through all elements in the array, see full_iterator
@@ -166,11 +189,28 @@ public:
   //! return the total number of elements in this array
   inline size_t size_all() const;	
 
+  //! checks if all elements are stored in one block of memory, in the order of the full_iterator
+  /*! This is the case after construction, but not necessarily after resizing one of the
+      nested arrays. Implementation note: this checks the start of every row.
+  */
+  inline bool is_contiguous() const;
+
+  //! access to the data via an elemT*
+  /*! The array has to be contiguous, otherwise error() is called. The pointer is only valid
+      as long as the index range of the array (or of the nested arrays) is not changed.
+      It is 0 for an array without elements.
+  */
+  inline elemT* get_full_data_ptr();
+
+  //! access to the data via a const elemT*, see get_full_data_ptr()
+  inline const elemT* get_const_full_data_ptr() const;
+
   /* Implementation note: grow() and resize() are inline such that they are
      defined for any type you happen to use for elemT. Otherwise, we would
      need instantiation in Array.cxx.
   */
   //! change the array to a new range of indices, new elements are set to 0  
+  /*! The elements are (again) stored in one contiguous block afterwards. */
   inline virtual void 
     resize(const IndexRange<num_dimensions>& range);
 
@@ -193,6 +233,23 @@ public:
   //! Fill elements with value n (overrides VectorWithOffset::fill)
   inline void fill(const elemT &n);
 
+  /*! \name arithmetic assignment operators
+      These use the functions in elementwise_kernels.h on all elements when the array is
+      contiguous (and for the versions with arrays, when \a v is contiguous and has the
+      same index range). Otherwise, the NumericVectorWithOffset versions are used (which
+      grow the array when necessary).
+  */
+  //@{
+  inline self& operator+= (const base_type& v);
+  inline self& operator-= (const base_type& v);
+  inline self& operator*= (const base_type& v);
+  inline self& operator/= (const base_type& v);
+  inline self& operator+= (const elemT& v);
+  inline self& operator-= (const elemT& v);
+  inline self& operator*= (const elemT& v);
+  inline self& operator/= (const elemT& v);
+  //@}
+
   //! checks if the index range is 'regular'
   /*! Implementation note: this works by calling get_index_range().is_regular().
       We cannot rely on remembering if it was a regular range at construction (or
@@ -239,6 +296,39 @@ public:
   inline const elemT&
     at(const BasicCoordinate<num_dimensions,int> &c) const;
   //@}
+
+protected:
+  template <int num_dimensions2, typename elemT2> friend class Array;
+
+  //! let the array (and the nested arrays) use existing memory, without initialisation
+  /*! The memory has to stay allocated for the lifetime of the array (or until
+      it is resized). */
+  inline void init(const IndexRange<num_dimensions>& range, elemT * const data_ptr);
+
+  //! check if the data is contiguous and starts at \a next_ptr (if non-zero)
+  /*! On return, \a next_ptr is set to the end of the data (if non-empty). */
+  inline bool check_contiguous(const elemT*& next_ptr) const;
+
+  //! pointer to the first element (or 0 if there are no elements)
+  inline const elemT* get_first_elem_ptr() const;
+
+private:
+  //! the block with all elements (if allocated by this array)
+  boost::shared_array<elemT> full_data_sptr;
+
+  //! allocate a contiguous block for \a range (without initialisation) and let the nested arrays use it
+  inline void allocate_contiguous(const IndexRange<num_dimensions>& range);
+
+  //! allocate a contiguous block for the index range of \a t and copy its elements
+  inline void copy_to_contiguous(const base_type& t);
+
+  //! find the start and end of the data, returns \c false if the array is not contiguous
+  inline bool get_full_data_range(const elemT*& begin_ptr, const elemT*& end_ptr) const;
+
+  //! get pointers to the data of both arrays if they are contiguous and have the same range
+  inline bool get_full_data_ptrs(const base_type& v,
+                                 elemT*& data_ptr, const elemT*& v_data_ptr,
+                                 std::size_t& num_elements);
 };
 
 
@@ -304,6 +394,10 @@ public:
 
   //! constructor from basetype
   inline Array(const NumericVectorWithOffset<elemT,elemT> &il);
+
+  //! constructor using existing data (no initialisation)
+  /*! The array does not own the memory, see VectorWithOffset. */
+  inline Array(const IndexRange<1>& range, elemT * const data_ptr);
   
   //! virtual destructor
   inline virtual ~Array();
@@ -330,6 +424,15 @@ public:
   //! return the total number of elements in this array
   inline size_t size_all() const;	
 
+  //! checks if all elements are stored in one block of memory (always \c true as this is the 1D case)
+  inline bool is_contiguous() const;
+
+  //! access to the data via an elemT*, see Array::get_full_data_ptr()
+  inline elemT* get_full_data_ptr();
+
+  //! access to the data via a const elemT*, see Array::get_full_data_ptr()
+  inline const elemT* get_const_full_data_ptr() const;
+
   //! Array::grow initialises new elements to 0
   inline virtual void grow(const IndexRange<1>& range);
   
@@ -361,6 +464,22 @@ public:
   bool get_regular_range(
      BasicCoordinate<1, int>& min,
      BasicCoordinate<1, int>& max) const;
+
+  /*! \name arithmetic assignment operators
+      These use the functions in elementwise_kernels.h (for the versions with arrays,
+      only when \a v has the same index range). Otherwise, the NumericVectorWithOffset
+      versions are used (which grow the array when necessary).
+  */
+  //@{
+  inline self& operator+= (const base_type& v);
+  inline self& operator-= (const base_type& v);
+  inline self& operator*= (const base_type& v);
+  inline self& operator/= (const base_type& v);
+  inline self& operator+= (const elemT& v);
+  inline self& operator-= (const elemT& v);
+  inline self& operator*= (const elemT& v);
+  inline self& operator/= (const elemT& v);
+  //@}
   
 #ifndef STIR_USE_BOOST
   
@@ -426,7 +545,17 @@ public:
     at(const BasicCoordinate<1,int> &c) const;
   //@}
 
-  
+protected:
+  template <int num_dimensions2, typename elemT2> friend class Array;
+
+  //! let the array use existing memory, without initialisation
+  inline void init(const IndexRange<1>& range, elemT * const data_ptr);
+
+  //! check if the data starts at \a next_ptr (if non-zero), see Array::check_contiguous()
+  inline bool check_contiguous(const elemT*& next_ptr) const;
+
+  //! pointer to the first element (or 0 if there are no elements)
+  inline const elemT* get_first_elem_ptr() const;
 };
 
 
@@ -4,6 +4,7 @@
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000 - 2011-01-11, Hammersmith Imanet Ltd
     Copyright (C) 2011-07-01 - 2012, Kris Thielemans
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -31,9 +32,68 @@
 // include for min,max definitions
 #include <algorithm>
 #include "stir/assign.h"
+#include "stir/error.h"
+#include "stir/elementwise_kernels.h"
 
 START_NAMESPACE_STIR
 
+namespace detail
+{
+  //! allocate memory for \a num_elements (without initialisation), aligned to 64 bytes when possible
+  /*! \ingroup Array
+      The memory is owned by \a sptr. Returns 0 when \a num_elements is 0.
+  */
+  template <typename elemT>
+  inline elemT*
+  allocate_contiguous_block(const std::size_t num_elements, boost::shared_array<elemT>& sptr)
+  {
+    if (num_elements == 0)
+      {
+        sptr.reset();
+        return 0;
+      }
+    const std::size_t alignment = 64;
+    const std::size_t num_extra_elements =
+      alignment % sizeof(elemT) == 0 ? alignment/sizeof(elemT) - 1 : 0;
+    sptr.reset(new elemT[num_elements + num_extra_elements]);
+    elemT* data_ptr = sptr.get();
+    const std::size_t misalignment = reinterpret_cast<std::size_t>(data_ptr) % alignment;
+    if (num_extra_elements > 0 && misalignment != 0 &&
+        (alignment - misalignment) % sizeof(elemT) == 0)
+      data_ptr += (alignment - misalignment)/sizeof(elemT);
+    return data_ptr;
+  }
+
+  //! copy the elements in the common index range of 2 arrays
+  template <int num_dimensions, typename elemT>
+  inline void
+  copy_overlap(Array<num_dimensions, elemT>& to, const Array<num_dimensions, elemT>& from);
+
+  template <typename elemT>
+  inline void
+  copy_overlap(Array<1, elemT>& to, const Array<1, elemT>& from);
+
+  template <int num_dimensions, typename elemT>
+  void
+  copy_overlap(Array<num_dimensions, elemT>& to, const Array<num_dimensions, elemT>& from)
+  {
+    const int min_index = std::max(to.get_min_index(), from.get_min_index());
+    const int max_index = std::min(to.get_max_index(), from.get_max_index());
+    for (int i=min_index; i<=max_index; ++i)
+      copy_overlap(to[i], from[i]);
+  }
+
+  template <typename elemT>
+  void
+  copy_overlap(Array<1, elemT>& to, const Array<1, elemT>& from)
+  {
+    const int min_index = std::max(to.get_min_index(), from.get_min_index());
+    const int max_index = std::min(to.get_max_index(), from.get_max_index());
+    for (int i=min_index; i<=max_index; ++i)
+      to[i] = from[i];
+  }
+}
+
 /**********************************************
  inlines for Array<num_dimensions, elemT>
  **********************************************/
@@ -41,15 +101,80 @@ START_NAMESPACE_STIR
 template <int num_dimensions, typename elemT>
 void 
 Array<num_dimensions, elemT>::
-resize(const IndexRange<num_dimensions>& range)
+init(const IndexRange<num_dimensions>& range, elemT * const data_ptr)
 {
-  base_type::resize(range.get_min_index(), range.get_max_index());
+  this->full_data_sptr.reset();
+  if (this->get_min_index() != range.get_min_index() ||
+      this->get_max_index() != range.get_max_index())
+    {
+      // avoid copying the current rows
+      this->recycle();
+      base_type::resize(range.get_min_index(), range.get_max_index());
+    }
+  elemT* next_ptr = data_ptr;
   typename base_type::iterator iter = this->begin();
   typename IndexRange<num_dimensions>::const_iterator range_iter = range.begin();
   for (;
        iter != this->end(); 
        ++iter, ++range_iter)
-    (*iter).resize(*range_iter);
+    {
+      (*iter).init(*range_iter, next_ptr);
+      next_ptr += range_iter->size_all();
+    }
+}
+
+template <int num_dimensions, typename elemT>
+void 
+Array<num_dimensions, elemT>::
+allocate_contiguous(const IndexRange<num_dimensions>& range)
+{
+  boost::shared_array<elemT> new_full_data_sptr;
+  elemT * const data_ptr =
+    detail::allocate_contiguous_block(range.size_all(), new_full_data_sptr);
+  this->init(range, data_ptr);
+  this->full_data_sptr = new_full_data_sptr;
+}
+
+template <int num_dimensions, typename elemT>
+void 
+Array<num_dimensions, elemT>::
+copy_to_contiguous(const base_type& t)
+{
+  VectorWithOffset<IndexRange<num_dimensions-1> > 
+    ranges(t.get_min_index(), t.get_max_index());
+  for (int i=t.get_min_index(); i<=t.get_max_index(); ++i)
+    ranges[i] = t[i].get_index_range();
+  this->allocate_contiguous(IndexRange<num_dimensions>(ranges));
+
+  elemT* data_ptr = this->get_full_data_ptr();
+  for (int i=t.get_min_index(); i<=t.get_max_index(); ++i)
+    data_ptr = std::copy(t[i].begin_all_const(), t[i].end_all_const(), data_ptr);
+}
+
+template <int num_dimensions, typename elemT>
+void 
+Array<num_dimensions, elemT>::
+resize(const IndexRange<num_dimensions>& range)
+{
+  elemT zero;
+  assign(zero, 0);
+  if (this->size() == 0)
+    {
+      this->allocate_contiguous(range);
+      this->fill(zero);
+      return;
+    }
+  if (range == this->get_index_range() && this->is_contiguous())
+    return;
+  // allocate new memory and copy the elements in the overlap
+  self new_array;
+  new_array.allocate_contiguous(range);
+  new_array.fill(zero);
+  detail::copy_overlap(new_array, *this);
+  // now use the new memory
+  const boost::shared_array<elemT> new_full_data_sptr = new_array.full_data_sptr;
+  this->init(range, new_array.get_full_data_ptr());
+  this->full_data_sptr = new_full_data_sptr;
 }
 
 template <int num_dimensions, typename elemT>
@@ -72,20 +197,257 @@ Array<num_dimensions, elemT>::Array(const IndexRange<num_dimensions>& range)
   grow(range);
 }
 
+#ifndef SWIG
 template <int num_dimensions, typename elemT>
-#ifdef SWIG
-// swig-specific work-around (see Array.h)
-Array<num_dimensions, elemT>::Array(const self& t)
-#else
 Array<num_dimensions, elemT>::Array(const base_type& t)
+:  base_type()
+{
+  this->copy_to_contiguous(t);
+}
 #endif
-:  base_type(t)
-{}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>::Array(const self& t)
+:  base_type()
+{
+  this->copy_to_contiguous(t);
+}
 
 template <int num_dimensions, typename elemT>
 Array<num_dimensions, elemT>::~Array()
 {}
 
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator=(const self& t)
+{
+  if (this == &t)
+    return *this;
+  if (this->get_index_range() == t.get_index_range())
+    {
+      const elemT* begin_ptr;
+      const elemT* end_ptr;
+      const elemT* t_begin_ptr;
+      const elemT* t_end_ptr;
+      if (this->get_full_data_range(begin_ptr, end_ptr) &&
+          t.get_full_data_range(t_begin_ptr, t_end_ptr))
+        std::copy(t_begin_ptr, t_end_ptr, const_cast<elemT*>(begin_ptr));
+      else
+        base_type::operator=(t);
+    }
+  else
+    this->copy_to_contiguous(t);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+bool
+Array<num_dimensions, elemT>::check_contiguous(const elemT*& next_ptr) const
+{
+  for (const_iterator iter = this->begin(); iter != this->end(); ++iter)
+    if (!(*iter).check_contiguous(next_ptr))
+      return false;
+  return true;
+}
+
+template <int num_dimensions, typename elemT>
+const elemT*
+Array<num_dimensions, elemT>::get_first_elem_ptr() const
+{
+  for (const_iterator iter = this->begin(); iter != this->end(); ++iter)
+    {
+      const elemT* const ptr = (*iter).get_first_elem_ptr();
+      if (ptr != 0)
+        return ptr;
+    }
+  return 0;
+}
+
+template <int num_dimensions, typename elemT>
+bool
+Array<num_dimensions, elemT>::
+get_full_data_range(const elemT*& begin_ptr, const elemT*& end_ptr) const
+{
+  const elemT* next_ptr = 0;
+  if (!this->check_contiguous(next_ptr))
+    return false;
+  begin_ptr = this->get_first_elem_ptr();
+  end_ptr = begin_ptr == 0 ? begin_ptr : next_ptr;
+  return true;
+}
+
+template <int num_dimensions, typename elemT>
+bool
+Array<num_dimensions, elemT>::is_contiguous() const
+{
+  const elemT* next_ptr = 0;
+  return this->check_contiguous(next_ptr);
+}
+
+template <int num_dimensions, typename elemT>
+elemT*
+Array<num_dimensions, elemT>::get_full_data_ptr()
+{
+  if (!this->is_contiguous())
+    error("Array::get_full_data_ptr: array is not contiguous");
+  return const_cast<elemT*>(this->get_first_elem_ptr());
+}
+
+template <int num_dimensions, typename elemT>
+const elemT*
+Array<num_dimensions, elemT>::get_const_full_data_ptr() const
+{
+  if (!this->is_contiguous())
+    error("Array::get_const_full_data_ptr: array is not contiguous");
+  return this->get_first_elem_ptr();
+}
+
+template <int num_dimensions, typename elemT>
+bool
+Array<num_dimensions, elemT>::
+get_full_data_ptrs(const base_type& v,
+                   elemT*& data_ptr, const elemT*& v_data_ptr,
+                   std::size_t& num_elements)
+{
+  const self* const v_ptr = dynamic_cast<const self*>(&v);
+  if (v_ptr == 0)
+    return false;
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  const elemT* v_end_ptr;
+  if (!this->get_full_data_range(begin_ptr, end_ptr) ||
+      !v_ptr->get_full_data_range(v_data_ptr, v_end_ptr) ||
+      this->get_index_range() != v_ptr->get_index_range())
+    return false;
+  data_ptr = const_cast<elemT*>(begin_ptr);
+  num_elements = static_cast<std::size_t>(end_ptr - begin_ptr);
+  return true;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator+= (const base_type& v)
+{
+  elemT* data_ptr;
+  const elemT* v_data_ptr;
+  std::size_t num_elements;
+  if (this->get_full_data_ptrs(v, data_ptr, v_data_ptr, num_elements))
+    {
+      elementwise_add(data_ptr, v_data_ptr, num_elements);
+    }
+  else
+    base_type::operator+=(v);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator-= (const base_type& v)
+{
+  elemT* data_ptr;
+  const elemT* v_data_ptr;
+  std::size_t num_elements;
+  if (this->get_full_data_ptrs(v, data_ptr, v_data_ptr, num_elements))
+    {
+      elementwise_subtract(data_ptr, v_data_ptr, num_elements);
+    }
+  else
+    base_type::operator-=(v);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator*= (const base_type& v)
+{
+  elemT* data_ptr;
+  const elemT* v_data_ptr;
+  std::size_t num_elements;
+  if (this->get_full_data_ptrs(v, data_ptr, v_data_ptr, num_elements))
+    {
+      elementwise_multiply(data_ptr, v_data_ptr, num_elements);
+    }
+  else
+    base_type::operator*=(v);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator/= (const base_type& v)
+{
+  elemT* data_ptr;
+  const elemT* v_data_ptr;
+  std::size_t num_elements;
+  if (this->get_full_data_ptrs(v, data_ptr, v_data_ptr, num_elements))
+    {
+      elementwise_divide(data_ptr, v_data_ptr, num_elements);
+    }
+  else
+    base_type::operator/=(v);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator+= (const elemT& v)
+{
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  if (this->get_full_data_range(begin_ptr, end_ptr))
+    {
+      elementwise_add_scalar(const_cast<elemT*>(begin_ptr), v, static_cast<std::size_t>(end_ptr - begin_ptr));
+    }
+  else
+    base_type::operator+=(v);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator-= (const elemT& v)
+{
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  if (this->get_full_data_range(begin_ptr, end_ptr))
+    {
+      elementwise_subtract_scalar(const_cast<elemT*>(begin_ptr), v, static_cast<std::size_t>(end_ptr - begin_ptr));
+    }
+  else
+    base_type::operator-=(v);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator*= (const elemT& v)
+{
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  if (this->get_full_data_range(begin_ptr, end_ptr))
+    {
+      elementwise_multiply_scalar(const_cast<elemT*>(begin_ptr), v, static_cast<std::size_t>(end_ptr - begin_ptr));
+    }
+  else
+    base_type::operator*=(v);
+  return *this;
+}
+
+template <int num_dimensions, typename elemT>
+Array<num_dimensions, elemT>&
+Array<num_dimensions, elemT>::operator/= (const elemT& v)
+{
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  if (this->get_full_data_range(begin_ptr, end_ptr))
+    {
+      elementwise_divide_scalar(const_cast<elemT*>(begin_ptr), v, static_cast<std::size_t>(end_ptr - begin_ptr));
+    }
+  else
+    base_type::operator/=(v);
+  return *this;
+}
+
 
 template <int num_dimensions, typename elemT>
 typename Array<num_dimensions, elemT>::full_iterator 
@@ -208,6 +570,10 @@ elemT
 Array<num_dimensions, elemT>::find_max() const
 {
   this->check_state();
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  if (this->get_full_data_range(begin_ptr, end_ptr) && begin_ptr != end_ptr)
+    return *std::max_element(begin_ptr, end_ptr);
   if (this->size() > 0)
   {
     elemT maxval= this->num[this->get_min_index()].find_max();
@@ -229,6 +595,10 @@ elemT
 Array<num_dimensions, elemT>::find_min() const
 {
   this->check_state();
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  if (this->get_full_data_range(begin_ptr, end_ptr) && begin_ptr != end_ptr)
+    return *std::min_element(begin_ptr, end_ptr);
   if (this->size() > 0)
   {
     elemT minval= this->num[this->get_min_index()].find_min();
@@ -254,8 +624,13 @@ void
 Array<num_dimensions, elemT>::fill(const elemT &n) 
 {
   this->check_state();
-  for(int i=this->get_min_index(); i<=this->get_max_index();  i++)
-    this->num[i].fill(n);
+  const elemT* begin_ptr;
+  const elemT* end_ptr;
+  if (this->get_full_data_range(begin_ptr, end_ptr))
+    std::fill(const_cast<elemT*>(begin_ptr), const_cast<elemT*>(end_ptr), n);
+  else
+    for(int i=this->get_min_index(); i<=this->get_max_index();  i++)
+      this->num[i].fill(n);
   this->check_state();
 }
 
@@ -408,6 +783,61 @@ Array<1, elemT>::Array(const base_type &il)
 : base_type(il)
 {}
 
+template <class elemT>
+Array<1, elemT>::Array(const IndexRange<1>& range, elemT * const data_ptr)
+: base_type()
+{
+  this->init(range, data_ptr);
+}
+
+template <class elemT>
+void
+Array<1, elemT>::init(const IndexRange<1>& range, elemT * const data_ptr)
+{
+  base_type::init(range.get_min_index(), range.get_max_index(), data_ptr);
+}
+
+template <class elemT>
+bool
+Array<1, elemT>::check_contiguous(const elemT*& next_ptr) const
+{
+  const elemT* const first_ptr = this->get_first_elem_ptr();
+  if (first_ptr == 0)
+    return true;
+  if (next_ptr != 0 && next_ptr != first_ptr)
+    return false;
+  next_ptr = first_ptr + this->size();
+  return true;
+}
+
+template <class elemT>
+const elemT*
+Array<1, elemT>::get_first_elem_ptr() const
+{
+  return this->size() == 0 ? 0 : &(*this->begin());
+}
+
+template <class elemT>
+bool
+Array<1, elemT>::is_contiguous() const
+{
+  return true;
+}
+
+template <class elemT>
+elemT*
+Array<1, elemT>::get_full_data_ptr()
+{
+  return const_cast<elemT*>(this->get_first_elem_ptr());
+}
+
+template <class elemT>
+const elemT*
+Array<1, elemT>::get_const_full_data_ptr() const
+{
+  return this->get_first_elem_ptr();
+}
+
 template <typename elemT>
 Array<1, elemT>::~Array()
 {}
@@ -558,6 +988,86 @@ Array<1, elemT>::get_regular_range(
   return range.get_regular_range(min,max);
 }
 
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator+= (const base_type& v)
+{
+  if (this->size() > 0 &&
+      this->get_min_index() == v.get_min_index() && this->get_max_index() == v.get_max_index())
+    elementwise_add(this->get_full_data_ptr(), &(*v.begin()), this->size());
+  else
+    base_type::operator+=(v);
+  return *this;
+}
+
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator-= (const base_type& v)
+{
+  if (this->size() > 0 &&
+      this->get_min_index() == v.get_min_index() && this->get_max_index() == v.get_max_index())
+    elementwise_subtract(this->get_full_data_ptr(), &(*v.begin()), this->size());
+  else
+    base_type::operator-=(v);
+  return *this;
+}
+
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator*= (const base_type& v)
+{
+  if (this->size() > 0 &&
+      this->get_min_index() == v.get_min_index() && this->get_max_index() == v.get_max_index())
+    elementwise_multiply(this->get_full_data_ptr(), &(*v.begin()), this->size());
+  else
+    base_type::operator*=(v);
+  return *this;
+}
+
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator/= (const base_type& v)
+{
+  if (this->size() > 0 &&
+      this->get_min_index() == v.get_min_index() && this->get_max_index() == v.get_max_index())
+    elementwise_divide(this->get_full_data_ptr(), &(*v.begin()), this->size());
+  else
+    base_type::operator/=(v);
+  return *this;
+}
+
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator+= (const elemT& v)
+{
+  elementwise_add_scalar(this->get_full_data_ptr(), v, this->size());
+  return *this;
+}
+
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator-= (const elemT& v)
+{
+  elementwise_subtract_scalar(this->get_full_data_ptr(), v, this->size());
+  return *this;
+}
+
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator*= (const elemT& v)
+{
+  elementwise_multiply_scalar(this->get_full_data_ptr(), v, this->size());
+  return *this;
+}
+
+template <class elemT>
+Array<1, elemT>&
+Array<1, elemT>::operator/= (const elemT& v)
+{
+  elementwise_divide_scalar(this->get_full_data_ptr(), v, this->size());
+  return *this;
+}
+
 #ifndef STIR_USE_BOOST
 
 /* KT 31/01/2000 I had to add these functions here, although they are 
@@ -7,6 +7,7 @@
 */
 /*
     Copyright (C) 2004-2009, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -93,7 +94,8 @@ public:
       twice as long as the input and output arrays.
 
       As this function uses fourier_for_real_data(), see there for restrictions 
-      on the possible kernel length, but at time of writing, it has to be a power of 2.
+      on the possible kernel length. At time of writing, the last dimension has to be even.
+      See get_efficient_fourier_length() to find lengths for which the filtering is fast.
   */
   Succeeded 
     set_kernel(const Array<num_dimensions, elemT>& real_filter_kernel);
@@ -108,7 +110,7 @@ public:
       twice as long as the input and output arrays.
 
       See fourier() for restrictions on the possible
-      kernel length, but at time of writing, it has to be a power of 2.
+      kernel length. See get_efficient_fourier_length() to find lengths for which the filtering is fast.
   */
   Succeeded
     set_kernel_in_frequency_space(const Array<num_dimensions, std::complex<elemT> >& kernel_in_frequency_space);
@@ -1,6 +1,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2007, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -32,6 +33,7 @@
 #include "stir/BasicCoordinate.h"
 #include "stir/array_index_functions.h"
 #include "stir/modulo.h"
+#include "stir/elementwise_kernels.h"
 
 #include <cmath>
 #include <complex>
@@ -51,8 +53,7 @@ template <class elemT>
 inline Array<1,elemT>&
 in_place_log(Array<1,elemT>& v)  
 {	
-  for(int i=v.get_min_index(); i<=v.get_max_index(); i++)
-    v[i] = std::log(v[i]); 
+  elementwise_log(v.get_full_data_ptr(), v.size());
   return v; 
 }
 
@@ -71,8 +72,11 @@ template <int num_dimensions, class elemT>
 inline Array<num_dimensions, elemT>& 
 in_place_log(Array<num_dimensions, elemT>& v)  
 {	
-  for(int i=v.get_min_index(); i<=v.get_max_index(); i++)
-    in_place_log(v[i]); 
+  if (v.is_contiguous())
+    elementwise_log(v.get_full_data_ptr(), v.size_all());
+  else
+    for(int i=v.get_min_index(); i<=v.get_max_index(); i++)
+      in_place_log(v[i]); 
   return v; 
 }
 
@@ -81,8 +85,7 @@ template <class elemT>
 inline Array<1,elemT>& 
 in_place_exp(Array<1,elemT>& v)  
 {	
-  for(int i=v.get_min_index(); i<=v.get_max_index(); i++)
-    v[i] = std::exp(v[i]); 
+  elementwise_exp(v.get_full_data_ptr(), v.size());
   return v; 
 }
 #else
@@ -99,8 +102,11 @@ template <int num_dimensions, class elemT>
 inline Array<num_dimensions, elemT>& 
 in_place_exp(Array<num_dimensions, elemT>& v)  
 {	
-  for(int i=v.get_min_index(); i<=v.get_max_index(); i++)
-    in_place_exp(v[i]); 
+  if (v.is_contiguous())
+    elementwise_exp(v.get_full_data_ptr(), v.size_all());
+  else
+    for(int i=v.get_min_index(); i<=v.get_max_index(); i++)
+      in_place_exp(v[i]); 
   return v; 
 }
 
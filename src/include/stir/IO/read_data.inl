@@ -1,5 +1,6 @@
 /*
     Copyright (C) 2004- 2007, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -70,6 +71,13 @@ namespace detail
 		 IStreamT& s, Array<num_dimensions,elemT>& data, 
 		 const ByteOrder byte_order)
   {
+    if (data.is_contiguous())
+      {
+        // read all data in one go
+        // (the number of elements can be too large for an int)
+        return
+          read_data_1d(s, data.get_full_data_ptr(), data.size_all(), byte_order);
+      }
     for (typename Array<num_dimensions,elemT>::iterator iter= data.begin();
 	 iter != data.end();
 	 ++iter)
@@ -55,6 +55,22 @@ inline Succeeded
 read_data_1d(FILE*& , Array<1, elemT>& data,
 	     const ByteOrder byte_order);
 
+/* \ingroup Array_IO_detail
+  \brief  As above, but reading \a num_elements elements to memory starting at \a data_ptr
+  \internal
+  This is used to read all elements of a contiguous multi-dimensional Array in one go.
+ */
+template <class elemT>
+inline Succeeded
+read_data_1d(std::istream& s, elemT* const data_ptr, const std::size_t num_elements,
+	     const ByteOrder byte_order);
+
+//! \internal As above, but for \c FILE*
+template <class elemT>
+inline Succeeded
+read_data_1d(FILE*& , elemT* const data_ptr, const std::size_t num_elements,
+	     const ByteOrder byte_order);
+
 } // end namespace detail
 END_NAMESPACE_STIR
 
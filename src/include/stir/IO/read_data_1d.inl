@@ -35,7 +35,7 @@ namespace detail {
 
 template <class elemT>
 Succeeded
-read_data_1d(std::istream& s, Array<1, elemT>& data,
+read_data_1d(std::istream& s, elemT* const data_ptr, const std::size_t num_elements,
 	   const ByteOrder byte_order)
 {
   if (!s || 
@@ -43,59 +43,77 @@ read_data_1d(std::istream& s, Array<1, elemT>& data,
       (dynamic_cast<std::fstream*>(&s)!=0 && !dynamic_cast<std::fstream*>(&s)->is_open()))
     { warning("read_data: error before reading from stream.\n"); return Succeeded::no; }
 
-  // note: find num_to_read (using size()) outside of s.read() function call
-  // otherwise Array::check_state() in size() might abort if
-  // get_data_ptr() is called before size() (which is compiler dependent)
   const std::streamsize num_to_read =
-    static_cast<std::streamsize>(data.size())* sizeof(elemT);
-  s.read(reinterpret_cast<char *>(data.get_data_ptr()), num_to_read);
-  data.release_data_ptr();
+    static_cast<std::streamsize>(num_elements * sizeof(elemT));
+  s.read(reinterpret_cast<char *>(data_ptr), num_to_read);
 
   if (!s)
   { warning("read_data: error after reading from stream.\n"); return Succeeded::no; }
 	    
   if (!byte_order.is_native_order())
   {
-    for(int i=data.get_min_index(); i<=data.get_max_index(); ++i)
-      ByteOrder::swap_order(data[i]);
+    for(std::size_t i=0; i<num_elements; ++i)
+      ByteOrder::swap_order(data_ptr[i]);
   }
 
   return Succeeded::yes;
 }
 
+template <class elemT>
+Succeeded
+read_data_1d(std::istream& s, Array<1, elemT>& data,
+	   const ByteOrder byte_order)
+{
+  // note: find num_elements (using size()) before calling get_data_ptr()
+  // otherwise Array::check_state() in size() might abort
+  const std::size_t num_elements = static_cast<std::size_t>(data.size());
+  const Succeeded success =
+    read_data_1d(s, data.get_data_ptr(), num_elements, byte_order);
+  data.release_data_ptr();
+  return success;
+}
+
 /***************** version for FILE *******************************/
 // largely a copy of above, but with calls to stdio function
 
 template <class elemT>
 Succeeded
-read_data_1d(FILE* & fptr_ref, Array<1, elemT>& data,
+read_data_1d(FILE* & fptr_ref, elemT* const data_ptr, const std::size_t num_elements,
 	   const ByteOrder byte_order)
 {
   FILE *fptr = fptr_ref;
   if (fptr==NULL || ferror(fptr))
     { warning("read_data: error before reading from FILE.\n"); return Succeeded::no; }
 
-  // note: find num_to_read (using size()) outside of s.read() function call
-  // otherwise Array::check_state() in size() might abort if
-  // get_data_ptr() is called before size() (which is compiler dependent)
-  const std::size_t num_to_read =
-    static_cast<std::size_t>(data.size());
   const std::size_t num_read =
-    fread(reinterpret_cast<char *>(data.get_data_ptr()), sizeof(elemT), num_to_read, fptr);
-  data.release_data_ptr();
+    fread(reinterpret_cast<char *>(data_ptr), sizeof(elemT), num_elements, fptr);
 
-  if (ferror(fptr) || num_to_read!=num_read)
+  if (ferror(fptr) || num_elements!=num_read)
   { warning("read_data: error after reading from FILE.\n"); return Succeeded::no; }
 	    
   if (!byte_order.is_native_order())
   {
-    for(int i=data.get_min_index(); i<=data.get_max_index(); ++i)
-      ByteOrder::swap_order(data[i]);
+    for(std::size_t i=0; i<num_elements; ++i)
+      ByteOrder::swap_order(data_ptr[i]);
   }
 
   return Succeeded::yes;
 }
 
+template <class elemT>
+Succeeded
+read_data_1d(FILE* & fptr_ref, Array<1, elemT>& data,
+	   const ByteOrder byte_order)
+{
+  // note: find num_elements (using size()) before calling get_data_ptr()
+  // otherwise Array::check_state() in size() might abort
+  const std::size_t num_elements = static_cast<std::size_t>(data.size());
+  const Succeeded success =
+    read_data_1d(fptr_ref, data.get_data_ptr(), num_elements, byte_order);
+  data.release_data_ptr();
+  return success;
+}
+
 
 } // end of namespace detail
 END_NAMESPACE_STIR
@@ -1,5 +1,6 @@
 /*
   Copyright (C) 2004 - 2008, Hammersmith Imanet Ltd
+  Copyright (C) 2016, University College London
   This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -101,6 +102,14 @@ namespace detail
 					  const ByteOrder byte_order,
 					  const bool can_corrupt_data)
   {
+    if (typeid(OutputType) == typeid(elemT) && scale_factor==1 &&
+        data.is_contiguous())
+      {
+        // write all data in one go
+        // (the number of elements can be too large for an int)
+        return
+          write_data_1d(s, data.get_const_full_data_ptr(), data.size_all(), byte_order, can_corrupt_data);
+      }
     for (typename Array<num_dimensions,elemT>::const_iterator iter= data.begin();
 	 iter != data.end();
 	 ++iter)
@@ -58,6 +58,25 @@ inline Succeeded
 write_data_1d(FILE* & fptr_ref, const Array<1, elemT>& data,
 	   const ByteOrder byte_order,
 	   const bool can_corrupt_data);
+
+/* \ingroup Array_IO_detail
+  \brief  As above, but writing \a num_elements elements from memory starting at \a data_ptr
+  \internal
+  This is used to write all elements of a contiguous multi-dimensional Array in one go.
+  The data are byte-swapped in place if necessary (and swapped back unless \a can_corrupt_data).
+ */
+template <class elemT>
+inline Succeeded
+write_data_1d(std::ostream& s, const elemT* const data_ptr, const std::size_t num_elements,
+	      const ByteOrder byte_order,
+	      const bool can_corrupt_data);
+
+//! \internal As above, but for \c FILE*
+template <class elemT>
+inline Succeeded
+write_data_1d(FILE* & fptr_ref, const elemT* const data_ptr, const std::size_t num_elements,
+	      const ByteOrder byte_order,
+	      const bool can_corrupt_data);
 }
 
 END_NAMESPACE_STIR
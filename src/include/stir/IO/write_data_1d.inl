@@ -35,7 +35,7 @@ namespace detail {
 
 template <class elemT>
 inline Succeeded
-write_data_1d(std::ostream& s, const Array<1, elemT>& data,
+write_data_1d(std::ostream& s, const elemT* const data_ptr, const std::size_t num_elements,
 	   const ByteOrder byte_order,
 	   const bool can_corrupt_data)
 {
@@ -44,7 +44,7 @@ write_data_1d(std::ostream& s, const Array<1, elemT>& data,
       (dynamic_cast<std::fstream*>(&s)!=0 && !dynamic_cast<std::fstream*>(&s)->is_open()))
     { warning("write_data: error before writing to stream.\n"); return Succeeded::no; }
   
-  // While writing, the array is potentially byte-swapped.
+  // While writing, the data are potentially byte-swapped.
   // We catch exceptions to prevent problems with this.
   // Alternative and safe way: (but involves creating an extra copy of the data)
   /*
@@ -56,37 +56,29 @@ write_data_1d(std::ostream& s, const Array<1, elemT>& data,
   return write_data(s, a_copy, ByteOrder::native, true);
   }
   */
+  elemT* const data_ref_ptr = const_cast<elemT*>(data_ptr);
   if (!byte_order.is_native_order())
   {
-    Array<1,elemT>& data_ref =
-      const_cast<Array<1,elemT>&>(data);
-    for(int i=data.get_min_index(); i<=data.get_max_index(); ++i)
-      ByteOrder::swap_order(data_ref[i]);
+    for(std::size_t i=0; i<num_elements; ++i)
+      ByteOrder::swap_order(data_ref_ptr[i]);
   }
   
-  // note: find num_to_write (using size()) outside of s.write() function call
-  // otherwise Array::check_state() in size() might abort if
-  // get_const_data_ptr() is called before size() (which is compiler dependent)
   const std::streamsize num_to_write =
-    static_cast<std::streamsize>(data.size())* sizeof(elemT);
+    static_cast<std::streamsize>(num_elements * sizeof(elemT));
   bool writing_ok=true;
   try
   {
-    s.write(reinterpret_cast<const char *>(data.get_const_data_ptr()), num_to_write);
+    s.write(reinterpret_cast<const char *>(data_ptr), num_to_write);
   }
   catch(...)
   {
     writing_ok=false;
   }
 
-  data.release_const_data_ptr();	    
-
   if (!can_corrupt_data && !byte_order.is_native_order())
   {
-    Array<1,elemT>& data_ref =
-      const_cast<Array<1,elemT>&>(data);
-    for(int i=data.get_min_index(); i<=data.get_max_index(); ++i)
-      ByteOrder::swap_order(data_ref[i]);
+    for(std::size_t i=0; i<num_elements; ++i)
+      ByteOrder::swap_order(data_ref_ptr[i]);
   }
 
   if (!writing_ok || !s)
@@ -95,12 +87,27 @@ write_data_1d(std::ostream& s, const Array<1, elemT>& data,
   return Succeeded::yes;
 }
 
+template <class elemT>
+inline Succeeded
+write_data_1d(std::ostream& s, const Array<1, elemT>& data,
+	   const ByteOrder byte_order,
+	   const bool can_corrupt_data)
+{
+  // note: find num_elements (using size()) before calling get_const_data_ptr()
+  // otherwise Array::check_state() in size() might abort
+  const std::size_t num_elements = static_cast<std::size_t>(data.size());
+  const Succeeded success =
+    write_data_1d(s, data.get_const_data_ptr(), num_elements, byte_order, can_corrupt_data);
+  data.release_const_data_ptr();	    
+  return success;
+}
+
 /***************** version for FILE *******************************/
 // largely a copy of above, but with calls to stdio function
 
 template <class elemT>
 inline Succeeded
-write_data_1d(FILE* & fptr_ref, const Array<1, elemT>& data,
+write_data_1d(FILE* & fptr_ref, const elemT* const data_ptr, const std::size_t num_elements,
 	   const ByteOrder byte_order,
 	   const bool can_corrupt_data)
 {
@@ -108,50 +115,44 @@ write_data_1d(FILE* & fptr_ref, const Array<1, elemT>& data,
   if (fptr==0|| ferror(fptr))
     { warning("write_data: error before writing to FILE.\n"); return Succeeded::no; }
   
-  // While writing, the array is potentially byte-swapped.
-  // We catch exceptions to prevent problems with this.
-  // Alternative and safe way: (but involves creating an extra copy of the data)
-  /*
+  // While writing, the data are potentially byte-swapped.
+  elemT* const data_ref_ptr = const_cast<elemT*>(data_ptr);
   if (!byte_order.is_native_order())
   {
-  Array<1, elemT> a_copy(data);
-  for(int i=data.get_min_index(); i<=data.get_max_index(); i++)
-  ByteOrder::swap_order(a_copy[i]);
-  return write_data(s, a_copy, ByteOrder::native, true);
-  }
-  */
-  if (!byte_order.is_native_order())
-  {
-    Array<1,elemT>& data_ref =
-      const_cast<Array<1,elemT>&>(data);
-    for(int i=data.get_min_index(); i<=data.get_max_index(); ++i)
-      ByteOrder::swap_order(data_ref[i]);
+    for(std::size_t i=0; i<num_elements; ++i)
+      ByteOrder::swap_order(data_ref_ptr[i]);
   }
   
-  // note: find num_to_write (using size()) outside of s.write() function call
-  // otherwise Array::check_state() in size() might abort if
-  // get_const_data_ptr() is called before size() (which is compiler dependent)
-  const std::size_t num_to_write =
-    static_cast<std::size_t>(data.size());
   const std::size_t num_written =
-    fwrite(reinterpret_cast<const char *>(data.get_const_data_ptr()), sizeof(elemT), num_to_write, fptr);
+    fwrite(reinterpret_cast<const char *>(data_ptr), sizeof(elemT), num_elements, fptr);
   
-  data.release_const_data_ptr();	    
-
   if (!can_corrupt_data && !byte_order.is_native_order())
   {
-    Array<1,elemT>& data_ref =
-      const_cast<Array<1,elemT>&>(data);
-    for(int i=data.get_min_index(); i<=data.get_max_index(); ++i)
-      ByteOrder::swap_order(data_ref[i]);
+    for(std::size_t i=0; i<num_elements; ++i)
+      ByteOrder::swap_order(data_ref_ptr[i]);
   }
 
-  if (num_written!=num_to_write || ferror(fptr))
+  if (num_written!=num_elements || ferror(fptr))
   { warning("write_data: error after writing to FILE.\n"); return Succeeded::no; }
 
   return Succeeded::yes;
 }
 
+template <class elemT>
+inline Succeeded
+write_data_1d(FILE* & fptr_ref, const Array<1, elemT>& data,
+	   const ByteOrder byte_order,
+	   const bool can_corrupt_data)
+{
+  // note: find num_elements (using size()) before calling get_const_data_ptr()
+  // otherwise Array::check_state() in size() might abort
+  const std::size_t num_elements = static_cast<std::size_t>(data.size());
+  const Succeeded success =
+    write_data_1d(fptr_ref, data.get_const_data_ptr(), num_elements, byte_order, can_corrupt_data);
+  data.release_const_data_ptr();	    
+  return success;
+}
+
 
 } // end of namespace detail
 END_NAMESPACE_STIR
@@ -117,6 +117,9 @@ public:
   //! checks if the range is 'regular'
   inline bool is_regular() const;
 
+  //! return the total number of elements in this range
+  inline size_t size_all() const;
+
   //! find regular range, returns false if the range is not regular
   bool get_regular_range(
 			 BasicCoordinate<num_dimensions, int>& min,
@@ -162,6 +165,9 @@ public:
   inline int get_max_index() const;
   inline int get_length() const;
 
+  //! return the total number of elements in this range
+  inline size_t size_all() const;
+
   inline bool operator==(const IndexRange<1>& range2) const;
 
   //! checks if the range is 'regular' (always true for the 1d case)
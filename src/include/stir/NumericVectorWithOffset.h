@@ -65,6 +65,10 @@ public:
   //! Construct a NumericVectorWithOffset of elements with offset \c min_index
   inline NumericVectorWithOffset(const int min_index, const int max_index);
 
+  //! Construct a NumericVectorWithOffset with offset \c min_index using existing data (no initialisation)
+  inline NumericVectorWithOffset(const int min_index, const int max_index,
+                                 T * const data_ptr, T * const end_of_data_ptr);
+
   //! Constructor from an object of this class' base_type
   inline NumericVectorWithOffset(const VectorWithOffset<T>& t);
 
@@ -50,6 +50,14 @@ NumericVectorWithOffset<T, NUMBER>::NumericVectorWithOffset(const int min_index,
   : base_type(min_index, max_index)
 {}
 
+template <class T, class NUMBER>
+inline 
+NumericVectorWithOffset<T, NUMBER>::
+NumericVectorWithOffset(const int min_index, const int max_index,
+                        T * const data_ptr, T * const end_of_data_ptr)
+  : base_type(min_index, max_index, data_ptr, end_of_data_ptr)
+{}
+
 template <class T, class NUMBER>
 NumericVectorWithOffset<T, NUMBER>::
 NumericVectorWithOffset(const VectorWithOffset<T>& t)
@@ -4,6 +4,7 @@
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000 - 2007-10-08, Hammersmith Imanet Ltd
     Copyright (C) 2012-06-05 - 2012, Kris Thielemans
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -74,6 +75,12 @@ class PoissonLogLikelihoodWithLinearModelForMean;
     \f[\sum_{b \in \rm{subset}} p_{bv} = 
        { \sum_b p_{bv} \over \rm{numsubsets} } \f]
 
+  The division by the denominator, the thresholding of the update (between
+  minimum and maximum relative change) and the multiplication with the current
+  estimate are done in a single pass over the image (parallelised over planes
+  with OpenMP for DiscretisedDensity<3,float>). The images used for the update
+  and the prior gradient are allocated once and re-used for all subiterations.
+
   \warning This class should be the last in a Reconstruction hierarchy.
 */
 template <typename TargetT>
@@ -198,6 +205,11 @@ private:
   //! the principal operations for updating the image iterates at each iteration
   virtual void update_estimate (TargetT& current_image_estimate);
 
+  //! work image for the multiplicative update, kept between subiterations
+  shared_ptr<TargetT> multiplicative_update_image_sptr;
+  //! work image for the gradient of the prior, kept between subiterations
+  shared_ptr<TargetT> prior_gradient_image_sptr;
+
   PoissonLogLikelihoodWithLinearModelForMean<TargetT >&
     objective_function();
 
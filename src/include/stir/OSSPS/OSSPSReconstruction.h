@@ -3,6 +3,7 @@
 //
 /*
     Copyright (C) 2002- 2009, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -86,6 +87,18 @@ START_NAMESPACE_STIR
   <code>relaxation_gamma</code>. Ahn and Fessler recommend to set \f$\alpha \approx 1\f$ and
   \f$\gamma\f$ small (e.g. 0.1).
 
+  \par Cache for the precomputed denominator
+
+  Computing the denominator needs a forward and back projection of all data.
+  If <code>precomputed denominator cache directory</code> is set (and no
+  <code>precomputed denominator</code> file is given), the computed denominator is written
+  to that directory, together with a key file describing everything it depends on
+  (see GeneralisedObjectiveFunction::get_approximate_Hessian_cache_key_description()),
+  which includes a hash of the measured data. The name of the key file is derived from a hash
+  of this description. A later reconstruction with the same data, normalisation,
+  projectors and image geometry reads the denominator from the cache instead of computing it.
+  Caching is skipped (with a warning) if the objective function does not support it.
+
   \warning This class should be the last in the Reconstruction hierarchy.
   \todo split into a preconditioned subgradient descent class and something that computes
   the preconditioner.
@@ -142,6 +155,16 @@ public:
 */
   Succeeded 
     precompute_denominator_of_conditioner_without_penalty();
+
+  //! set directory used to cache the precomputed denominator
+  /*! Set to an empty string to switch caching off. The directory has to exist. */
+  void set_precomputed_denominator_cache_directory(const std::string&);
+  //! check if the last call to set_up() read the precomputed denominator from the cache
+  bool get_precomputed_denominator_was_read_from_cache() const;
+  //! find the description of the denominator and the name of its key file in the cache
+  /*! \return \c false if caching is switched off, or not supported by the objective function. */
+  bool get_precomputed_denominator_cache_key(std::string& key_filename, std::string& description,
+                                             const TargetT& target) const;
  
 
  protected: // could be private, but this way the doxygen comments are always listed
@@ -158,6 +181,9 @@ public:
   /*! If not specified, the corresponding object will be computed. */
   std::string precomputed_denominator_filename;
 
+  //! optional directory where the computed "precomputed denominator" is cached (see class documentation)
+  std::string precomputed_denominator_cache_directory;
+
 #if 0
   bool do_line_search;
 #endif
@@ -177,6 +203,9 @@ private:
   //! pointer to the precomputed denominator 
   shared_ptr<TargetT > precomputed_denominator_ptr;
 
+  //! \c true if the last call to set_up() read the precomputed denominator from the cache
+  bool precomputed_denominator_was_read_from_cache;
+
   //! data corresponding to the gometric forward projection of an image full of ones
   /*! This is needed for the precomputed denominator. However, if the parameter is 
       not set, precompute_denominator_without_penalty_of_conditioner() will compute it.
@@ -185,6 +214,14 @@ private:
 
   //! operations prior to the iterations
   virtual Succeeded set_up(shared_ptr <TargetT > const& target_image_ptr);
+
+  //! read the denominator listed in the key file, if its description matches
+  Succeeded read_precomputed_denominator_from_cache(const std::string& key_filename,
+                                                    const std::string& description,
+                                                    const TargetT& target);
+  //! write the denominator and the key file
+  Succeeded write_precomputed_denominator_to_cache(const std::string& key_filename,
+                                                   const std::string& description) const;
  
   //! the principal operations for updating the image iterates at each iteration
   virtual void update_estimate(TargetT &current_image_estimate);
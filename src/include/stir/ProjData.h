@@ -1,7 +1,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2012, Hammersmith Imanet Ltd
-    Copyright (C) 2013, 2015, University College London
+    Copyright (C) 2013, 2015, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -191,6 +191,14 @@ public:
     const bool make_num_tangential_poss_odd = false) const;
   //! Set related viewgrams
   virtual Succeeded set_related_viewgrams(const RelatedViewgrams<float>& viewgrams);
+
+  //! Check if the get_* functions can be called by several threads at the same time
+  /*! Defaults to \c false. Derived classes that override this to return \c true
+      need to make sure that reading data does not modify any shared state
+      (such as the position in a stream).
+      This is only relevant for reading. Writing always needs to be serialised.
+  */
+  virtual bool supports_concurrent_read() const { return false; }
   
 
   //! Get empty related viewgrams, where the symmetries_ptr specifies the symmetries to use
@@ -16,6 +16,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2013, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -40,6 +41,9 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+
+namespace boost { namespace interprocess { class mapped_region; } }
 
 START_NAMESPACE_STIR
 
@@ -138,6 +142,27 @@ public:
   //! Get scale factor
   float get_scale_factor() const;  
 
+  //! Map the data file in memory (read-only) such that data can be read by several threads at the same time
+  /*! \a data_filename has to be the name of the file that the stream reads from.
+      After a successful call, all get_* functions read from the memory mapping instead of
+      from the stream. They do not modify the stream (or any other member), and
+      supports_concurrent_read() returns \c true. Byte order conversion and the
+      scale factor are handled as before.
+
+      Only the file up to the end of the data is mapped. If the file is shorter than that
+      (e.g. an empty template file), Succeeded::no is returned and the stream will be used
+      as before. This also happens if the file cannot be mapped (e.g. because it is too large
+      for the address space), in which case info() is called.
+
+      \warning Data written via the set_* functions go via the stream, and might therefore
+      not be seen by the get_* functions until the stream is flushed. This function should
+      therefore only be used for data that are not modified while the object is in use.
+  */
+  Succeeded set_up_concurrent_read(const std::string& data_filename);
+
+  //! Returns \c true if set_up_concurrent_read() was successful
+  virtual bool supports_concurrent_read() const;
+
     
 protected:
   //! the stream with the data
@@ -162,6 +187,15 @@ private:
   // scale_factor is only used when reading data from file. Data are stored in
   // memory as float, with the scale factor multiplied out
   float scale_factor;
+
+  //! read-only memory mapping of the data, see set_up_concurrent_read()
+  shared_ptr<boost::interprocess::mapped_region> mapped_region_sptr;
+
+  //! Returns the stream to read from
+  /*! This is either \c *sino_stream, or a new stream reading from the memory mapping
+      (in which case \a mapped_stream_sptr is set to that stream).
+  */
+  std::istream& get_input_stream(shared_ptr<std::istream>& mapped_stream_sptr) const;
   
   //! Calculate the offset for the given segmnet
   std::streamoff get_offset_segment(const int segment_num) const;
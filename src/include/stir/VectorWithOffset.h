@@ -382,6 +382,12 @@ protected:
   //! Called internally to see if all variables are consistent
   inline void check_state() const;
 
+  //! let the vector use existing data (no initialisation)
+  /*! Memory owned by the vector is deallocated first. Afterwards, owns_memory_for_data()
+      will be \c false (unless the range is empty).
+  */
+  inline void init(const int min_index, const int max_index, T * const data_ptr);
+
 private:
   //! length of vector
   unsigned int length;	
@@ -45,6 +45,28 @@ VectorWithOffset<T>::init()
   end_allocated_memory = 0;
 }
 
+template <class T>
+void
+VectorWithOffset<T>::
+init(const int min_index, const int max_index, T * const data_ptr)
+{
+  this->check_state();
+  this->_destruct_and_deallocate();
+  if (min_index > max_index)
+    {
+      this->init();
+      this->_owns_memory_for_data = true;
+      return;
+    }
+  this->_owns_memory_for_data = false;
+  this->length = static_cast<unsigned>(max_index - min_index) + 1;
+  this->start = min_index;
+  this->begin_allocated_memory = data_ptr;
+  this->end_allocated_memory = data_ptr + this->length;
+  this->num = data_ptr - min_index;
+  this->check_state();
+}
+
 template <class T>
 bool
 VectorWithOffset<T>::owns_memory_for_data() const
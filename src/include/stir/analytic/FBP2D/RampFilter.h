@@ -12,6 +12,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
 
     This file is part of STIR.
 
@@ -37,8 +38,11 @@
 #include "stir/TimedObject.h"
 #endif
 #include <string>
+#include <vector>
 
 START_NAMESPACE_STIR
+
+template <typename elemT> class RelatedViewgrams;
 /*!
   \ingroup FBP2D
   \brief The ramp filter used for (2D) FBP
@@ -54,6 +58,13 @@ START_NAMESPACE_STIR
   The actual implementation works differently to overcome problems with defining the ramp in frequency 
   space (with a well-known DC offset as consequence). We therefore compute the ramp*Hanning in 
   "ordinary" space in continuous form, do the sampling there, and then DFT it. 
+
+  Apart from filtering a single row (using the ArrayFilterUsingRealDFTWithPadding
+  interface), the filter can be applied to all rows of a 2D or 3D array
+  (e.g. a Viewgram or a SegmentByView) or of RelatedViewgrams in one go using
+  apply_to_rows(). This uses the precomputed kernel in frequency space and a plan
+  for the real DFT (see RealFFTPlan) for all rows, and avoids memory allocations
+  for every row.
 */
 class RampFilter : 
 #ifdef NRFFT
@@ -72,7 +83,23 @@ private:
  RampFilter(float sampledist_v, int length_v , float alpha_v=1, float fc_v=.5); 
 
  virtual std::string parameter_info() const;
- 
+
+#ifndef NRFFT
+ //! filter all rows of \a data (e.g. a Viewgram or Sinogram)
+ /*! When STIR_OPENMP is defined, the rows are distributed over the threads
+     (unless this is called from inside a parallel region). */
+ void apply_to_rows(Array<2,float>& data) const;
+ //! filter all rows of \a data (e.g. a SegmentByView)
+ /*! \see apply_to_rows(Array<2,float>&) const */
+ void apply_to_rows(Array<3,float>& data) const;
+ //! filter all rows of all viewgrams in \a viewgrams
+ /*! \see apply_to_rows(Array<2,float>&) const */
+ void apply_to_rows(RelatedViewgrams<float>& viewgrams) const;
+
+ private:
+ //! filter the rows in one batch
+ void filter_rows(const std::vector<Array<1,float> *>& rows) const;
+#endif
 };
 
 END_NAMESPACE_STIR
@@ -12,6 +12,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2004, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
 
     This file is part of STIR.
 
@@ -48,6 +49,9 @@ template <typename elemT> class Viewgram;
   \brief This class contains the Colsher filter used for 3D-PET reconstruction.
 
   The Colsher filter is combined with a 2-dimensional apodising Hamming filter.
+
+  After set_up(), filtering does not modify the object, so the same filter can be
+  used by several threads at the same time (except when NRFFT is defined).
 */
 class ColsherFilter: 
 #ifdef NRFFT
@@ -3,6 +3,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2007, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
 
     This file is part of STIR.
 
@@ -40,6 +41,7 @@
 #include "stir/ArcCorrection.h"
 #include "stir/shared_ptr.h"
 #include "stir/RegisteredParsingObject.h"
+#include <map>
 
 START_NAMESPACE_STIR
 
@@ -90,8 +92,17 @@ class Succeeded;
 	  appropriate voxel sizes, i.e. it is up to the backprojector to perform
 	  the zooming.
 	  - So, no zooming is needed on the final image.
-     
 
+  \par Parallelisation
+  When STIR_OPENMP is defined, the oblique segments are processed in parallel:
+  every thread reads related viewgrams, forward projects the missing data,
+  Colsher-filters and backprojects them into its own image (see ThreadLocalImages).
+  Reading the measured data (which needs a lock unless ProjData::supports_concurrent_read())
+  therefore overlaps with the forward projection and filtering in other threads.
+  The Colsher filters are set up for all segments before the
+  parallel loop, and shared between segments with the same geometry.
+  When intermediate images are saved, the segments are processed one at a time
+  (with the views of every segment in parallel).
 */
 class FBP3DRPReconstruction: public
         RegisteredParsingObject<
@@ -267,7 +278,13 @@ private:
   shared_ptr<ForwardProjectorByBin> forward_projector_sptr; 
   shared_ptr<BackProjectorByBin> back_projector_sptr;
 #ifndef NRFFT
+  //! Colsher filter with the parameters, but not set-up for a particular segment
   ColsherFilter colsher_filter;
+  //! Colsher filters for every segment, set-up by set_up_colsher_filters()
+  /*! Segments with the same geometry share the same filter. */
+  std::map<int, shared_ptr<const ColsherFilter> > colsher_filter_per_segment;
+  //! set up the Colsher filters for all segments that will be processed
+  void set_up_colsher_filters();
 #endif
   float alpha_fit;
   float beta_fit;
@@ -0,0 +1,219 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+#ifndef __stir_elementwise_kernels_H__
+#define __stir_elementwise_kernels_H__
+/*!
+  \file
+  \ingroup Array
+
+  \brief Declaration of functions that apply numeric operations to
+  contiguous blocks of elements
+
+  These are used by stir::Array (and related functions) when all elements
+  are stored contiguously (see Array::is_contiguous()).
+
+  For \c float, the functions are implemented in elementwise_kernels.cxx.
+  This file contains versions compiled for several instruction sets
+  (currently "generic", "avx2" and "avx512" on x86 processors when using gcc or clang),
+  the best of which is selected at run-time. In addition, when STIR_OPENMP is
+  defined, large blocks are split over the available threads (unless the
+  function is called from inside a parallel region).
+
+  For other types, the (inline) template versions in this file are used.
+
+  Arrays passed to these functions have to be either identical or non-overlapping.
+*/
+
+#include "stir/Succeeded.h"
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+START_NAMESPACE_STIR
+
+/*! \ingroup Array
+   \name Element-wise operations on contiguous blocks of elements
+*/
+//@{
+
+//! a[i] += b[i] for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_add(elemT * const a, const elemT * const b, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] += b[i];
+}
+
+//! a[i] -= b[i] for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_subtract(elemT * const a, const elemT * const b, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] -= b[i];
+}
+
+//! a[i] *= b[i] for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_multiply(elemT * const a, const elemT * const b, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] *= b[i];
+}
+
+//! a[i] /= b[i] for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_divide(elemT * const a, const elemT * const b, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] /= b[i];
+}
+
+//! a[i] += value for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_add_scalar(elemT * const a, const elemT& value, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] += value;
+}
+
+//! a[i] -= value for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_subtract_scalar(elemT * const a, const elemT& value, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] -= value;
+}
+
+//! a[i] *= value for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_multiply_scalar(elemT * const a, const elemT& value, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] *= value;
+}
+
+//! a[i] /= value for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_divide_scalar(elemT * const a, const elemT& value, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] /= value;
+}
+
+//! a[i] = log(a[i]) for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_log(elemT * const a, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] = std::log(a[i]);
+}
+
+//! a[i] = exp(a[i]) for i=0..n-1
+template <typename elemT>
+inline void
+elementwise_exp(elemT * const a, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] = std::exp(a[i]);
+}
+
+//! sets a[i] to new_max if it is larger, or to new_min if it is smaller
+template <typename elemT>
+inline void
+elementwise_threshold_upper_lower(elemT * const a, const std::size_t n,
+                                  const elemT new_min, const elemT new_max)
+{
+  for (std::size_t i=0; i<n; ++i)
+    {
+      if (a[i] > new_max)
+        a[i] = new_max;
+      else if (new_min > a[i])
+        a[i] = new_min;
+    }
+}
+
+//! a[i] /= b[i], but sets a[i] to 0 when b[i] is 0
+template <typename elemT>
+inline void
+elementwise_divide_or_zero(elemT * const a, const elemT * const b, const std::size_t n)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] = b[i] != 0 ? a[i]/b[i] : 0;
+}
+
+//! a[i] /= b[i], but sets a[i] to 0 when the absolute values of a[i] and b[i] are not larger than \a small_value
+template <typename elemT>
+inline void
+elementwise_divide_unless_small(elemT * const a, const elemT * const b, const std::size_t n,
+                                const elemT small_value)
+{
+  for (std::size_t i=0; i<n; ++i)
+    a[i] = std::fabs(b[i])<=small_value && std::fabs(a[i])<=small_value ? 0 : a[i]/b[i];
+}
+
+// non-template versions for float (these are used in preference to the templates)
+void elementwise_add(float * const a, const float * const b, const std::size_t n);
+void elementwise_subtract(float * const a, const float * const b, const std::size_t n);
+void elementwise_multiply(float * const a, const float * const b, const std::size_t n);
+void elementwise_divide(float * const a, const float * const b, const std::size_t n);
+void elementwise_add_scalar(float * const a, const float& value, const std::size_t n);
+void elementwise_subtract_scalar(float * const a, const float& value, const std::size_t n);
+void elementwise_multiply_scalar(float * const a, const float& value, const std::size_t n);
+void elementwise_divide_scalar(float * const a, const float& value, const std::size_t n);
+void elementwise_log(float * const a, const std::size_t n);
+void elementwise_exp(float * const a, const std::size_t n);
+void elementwise_threshold_upper_lower(float * const a, const std::size_t n,
+                                       const float new_min, const float new_max);
+void elementwise_divide_or_zero(float * const a, const float * const b, const std::size_t n);
+void elementwise_divide_unless_small(float * const a, const float * const b, const std::size_t n,
+                                     const float small_value);
+//@}
+
+/*! \ingroup Array
+   \name Selection of the instruction set used by the float versions of the element-wise operations
+*/
+//@{
+//! the name of the instruction set currently in use
+std::string get_elementwise_instruction_set();
+
+//! the names of all instruction sets that can be used on this processor
+/*! The first is always "generic", the last is the one selected by default. */
+std::vector<std::string> get_supported_elementwise_instruction_sets();
+
+//! select an instruction set (e.g. to compare timings)
+/*! Returns Succeeded::no (and keeps the current one) if the instruction set
+    is not supported. The selection is changed atomically, so this can be called
+    while other threads are using the element-wise operations. Calls that have
+    already started finish with the previous instruction set. */
+Succeeded set_elementwise_instruction_set(const std::string& name);
+//@}
+
+END_NAMESPACE_STIR
+
+#endif
@@ -1,6 +1,7 @@
 /*
     Copyright (C) 2003 - 2011-06-24, Hammersmith Imanet Ltd
     Copyright (C) 2011-07-01 - 2014, Kris Thielemans
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -29,6 +30,8 @@
 #include "stir/Scanner.h"
 #include "stir/shared_ptr.h"
 #include <string>
+#include <vector>
+#include <ios>
 #include <ctime>
 
 #include "stir/IO/ExamData.h"
@@ -113,6 +116,18 @@ class ExamInfo;
     error("Help!");
   \endcode
 
+  To go to a particular time in the list, an index of time records can be used.
+  This index is built by reading all the data once (see build_time_index()), but
+  can be written to (and read from) a separate file.
+  \code
+  double current_time;
+  if (lm_data_sptr->set_get_position_for_time(start_time, current_time)
+     != Succeeded::yes)
+    error("Help!");
+  // now current_time <= start_time, and the next record is the first one after
+  // the time record for current_time
+  \endcode
+
   \todo Currently, this class (and CListRecord) is specific to PET, i.e. to
   coincidence detection (hence the 'C'). However, the only part that
   is not general are the functions related to prompts and delayeds.
@@ -215,6 +230,43 @@ public:
   virtual
     Succeeded set_get_position(const SavedPosition&) = 0;
 
+  //! Set the position for reading to the last indexed time record at or before \a time
+  /*! Reading will continue just after the time record (or at the start of the data), whose
+      time (in secs) is returned in \a time_of_position. Events up to the next time record
+      therefore have time \a time_of_position.
+
+      If there is no time index yet, build_time_index() is called first.
+      \return Succeeded::no if the index could not be built, e.g. because the derived class
+      does not support set_get_position().
+  */
+  Succeeded set_get_position_for_time(const double time, double& time_of_position);
+
+  //! Build the index used by set_get_position_for_time() by reading all data
+  /*! Entries are added for time records that are at least \a min_time_interval secs
+      later than the previous entry. Calls reset() at the end.
+  */
+  Succeeded build_time_index(const double min_time_interval = 1.);
+
+  //! Check if there is a time index
+  bool has_time_index() const;
+
+  //! Write the time index to a (text) file
+  /*! \return Succeeded::no if the derived class cannot convert saved positions to stream positions.
+   */
+  Succeeded write_time_index(const std::string& filename) const;
+
+  //! Read the time index from a file written by write_time_index()
+  /*! The file is rejected if it was written for list mode data with a different name,
+      or if the data have changed since then (see get_data_signature()).
+   */
+  Succeeded read_time_index(const std::string& filename);
+
+  //! Read the time index from file, or build it and write it to file if that fails
+  /*! This is a convenience function, intended for a time index in a 'sidecar' file.
+      If \a filename is empty, the index is only built (if there is none yet).
+  */
+  Succeeded set_up_time_index(const std::string& filename);
+
   //! Get scanner pointer  
   /*! Returns a pointer to a scanner object that is appropriate for the 
       list mode data that is being read.
@@ -236,8 +288,44 @@ public:
 protected:
   //! Has to be set by the derived class
   shared_ptr<Scanner> scanner_sptr;
+
+  //! Find the stream positions corresponding to saved positions
+  /*! Used by write_time_index(). The default implementation returns Succeeded::no.
+      Derived classes that read from a single stream should override this.
+  */
+  virtual Succeeded
+    get_stream_positions(std::vector<std::streampos>& stream_positions,
+                         const std::vector<SavedPosition>& saved_positions) const;
+
+  //! Save stream positions such that they can be used with set_get_position()
+  /*! Used by read_time_index(). The default implementation returns Succeeded::no.
+      Positions that were saved earlier have to remain valid.
+  */
+  virtual Succeeded
+    save_stream_positions(std::vector<SavedPosition>& saved_positions,
+                          const std::vector<std::streampos>& stream_positions);
+
+  //! Get a description of the data on disk, used to check if a time index file is still valid
+  /*! Used by write_time_index() and read_time_index(). The default implementation returns
+      get_file_signature() of get_name(). Derived classes that store the data in
+      another file should override this.
+  */
+  virtual std::string get_data_signature() const;
+
+  //! Get the size and modification time of a file as a string (empty if the file does not exist)
+  static std::string get_file_signature(const std::string& filename);
+
   //! Has to be set by the derived class
 //  shared_ptr<ExamInfo> exam_info_sptr;
+
+private:
+  struct TimeIndexEntry
+  {
+    double time;
+    SavedPosition position;
+  };
+  //! index of time records, sorted on time
+  std::vector<TimeIndexEntry> time_index;
 };
 
 END_NAMESPACE_STIR
@@ -1,5 +1,5 @@
 /*
-    Copyright (C) 2013-2014 University College London
+    Copyright (C) 2013-2014, 2016 University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -76,6 +76,16 @@ public:
   /*! \todo this might depend on the acquisition parameters */
   virtual bool has_delayeds() const { return true; }
 
+protected:
+  virtual Succeeded
+    get_stream_positions(std::vector<std::streampos>& stream_positions,
+                         const std::vector<SavedPosition>& saved_positions) const;
+  virtual Succeeded
+    save_stream_positions(std::vector<SavedPosition>& saved_positions,
+                          const std::vector<std::streampos>& stream_positions);
+  //! uses the Interfile header and the data file
+  virtual std::string get_data_signature() const;
+
 private:
   typedef CListRecordECAT8_32bit CListRecordT;
   std::string listmode_filename;
@@ -0,0 +1,133 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup listmode
+  \brief Declaration of class stir::ListModeEventCache
+*/
+
+#ifndef __stir_listmode_ListModeEventCache_H__
+#define __stir_listmode_ListModeEventCache_H__
+
+#include "stir/shared_ptr.h"
+#include "stir/VectorWithOffset.h"
+#include <boost/cstdint.hpp>
+#include <vector>
+
+START_NAMESPACE_STIR
+
+class CListModeData;
+class ProjDataInfo;
+class Bin;
+class Succeeded;
+
+/*!
+  \brief A compact in-memory copy of the (decoded) events in list mode data
+  \ingroup listmode
+
+  Decoding list mode records (and finding the corresponding bin) can take a
+  substantial part of the time when going through list mode data repeatedly,
+  as in list mode reconstructions. This class stores every (valid) event as a 32-bit
+  number, encoding the bin in the projection data (see the constructor) and if the event
+  is a prompt or delayed. A time index is kept as well, such that the events in a
+  time interval can be found with a binary search.
+
+  Events for which CListEvent::get_bin() returns a bin with value 0 or less are not stored.
+  Other values (e.g. weights set by the event decoder) are stored as well, but only
+  once an event has a value different from 1, such that this does not use any memory
+  for most scanners.
+
+  \par Usage
+  \code
+  ListModeEventCache cache(proj_data_info_sptr);
+  cache.fill(lm_data);
+  std::size_t begin, end;
+  cache.get_event_range_for_time_interval(begin, end, start_time, end_time);
+  Bin bin;
+  for (std::size_t i=begin; i<end; ++i)
+    if (cache.is_prompt(i))
+      {
+        cache.get_bin(bin, i);
+        // do something
+      }
+  \endcode
+*/
+class ListModeEventCache
+{
+public:
+  //! Construct an empty cache
+  /*! Bins will be found via \a proj_data_info_sptr (which has to be appropriate
+      for the list mode data). The total number of bins has to be smaller than 2^31.
+  */
+  explicit ListModeEventCache(const shared_ptr<ProjDataInfo>& proj_data_info_sptr);
+
+  //! Read all events from the list mode data
+  /*! Calls CListModeData::reset() first. Any events already in the cache are removed. */
+  Succeeded fill(CListModeData& lm_data);
+
+  //! Number of events stored
+  std::size_t get_num_events() const { return events.size(); }
+
+  //! Number of bytes used by the events and time index
+  std::size_t get_memory_usage_in_bytes() const;
+
+  //! Find events with a time in the interval [\a start_time, \a end_time)
+  /*! The time of an event is the time of the last time record that precedes the event
+      (or 0 if there is none). On return, events \a begin_index up to (but excluding)
+      \a end_index are in the interval.
+  */
+  void get_event_range_for_time_interval(std::size_t& begin_index, std::size_t& end_index,
+                                         const double start_time, const double end_time) const;
+
+  //! Check if an event is a prompt
+  bool is_prompt(const std::size_t event_index) const
+  { return (events[event_index] & prompt_bit) != 0; }
+
+  //! Get the bin of an event
+  /*! The value of the bin is set to the value found by CListEvent::get_bin() in fill(). */
+  void get_bin(Bin& bin, const std::size_t event_index) const;
+
+  //! Get the bin index used for a bin
+  /*! \return a number between 0 and the total number of bins.*/
+  boost::uint32_t get_bin_index(const Bin& bin) const;
+
+private:
+  typedef boost::uint32_t event_type;
+  static const event_type prompt_bit = 0x80000000U;
+
+  struct TimeMark
+  {
+    double time;
+    //! index of the first event with this time
+    std::size_t first_event_index;
+  };
+
+  shared_ptr<ProjDataInfo> proj_data_info_sptr;
+  std::vector<event_type> events;
+  //! values of the bins of the events, empty if they are all 1
+  std::vector<float> bin_values;
+  std::vector<TimeMark> time_marks;
+
+  //! first bin index for every segment (with one more element for the total number of bins)
+  VectorWithOffset<boost::uint32_t> segment_offsets;
+};
+
+END_NAMESPACE_STIR
+
+#endif
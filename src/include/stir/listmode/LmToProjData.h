@@ -14,6 +14,7 @@
 */
 /*
     Copyright (C) 2000- 2009, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -106,9 +107,16 @@ class CListTime;
     List event coordinates := 0
 
     ; if you're short of RAM (i.e. a single projdata does not fit into memory),
-    ; you can use this to process the list mode data in multiple passes.
+    ; you can use this to store only some segments in memory. Events for the
+    ; other segments are written to temporary files (in the same directory as
+    ; the output), which are processed after reading the list mode data.
     num_segments_in_memory := -1
 
+    ; file with an index of time records in the list mode data (see CListModeData).
+    ; If the file does not exist, it will be created. This makes it faster to
+    ; go to the start of a time frame when frames overlap or have gaps.
+    time index filename :=
+
   End := 
   \endverbatim
   
@@ -194,6 +202,14 @@ protected:
     normalisation or angle info for a rotating scanner.*/
   virtual void get_bin_from_event(Bin& bin, const CListEvent&) const;
 
+  //! Returns \c true if get_bin_from_event() can be called for events in any order and by multiple threads
+  /*! When compiled with OpenMP, process_data() decodes and stores events in parallel
+      if this function returns \c true and the normalisation is trivial, and time frames are used.
+      Derived classes that rely on the order of events (or use random numbers)
+      should return \c false.
+  */
+  virtual bool supports_parallel_binning() const;
+
   //! A function that should return the number of uncompressed bins in the current bin
   /*! \todo it is not compatiable with e.g. HiDAC doesn't belong here anyway
       (more ProjDataInfo?)
@@ -221,6 +237,8 @@ protected:
   //! frame definitions
   /*! Will be read using TimeFrameDefinitions */
   std::string frame_definition_filename;
+  //! file used for the time index of the list mode data (can be empty)
+  std::string time_index_filename;
   bool do_pre_normalisation;
   bool store_prompts;
   bool store_delayeds;
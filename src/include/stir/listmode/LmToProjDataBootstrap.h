@@ -89,6 +89,9 @@ protected:
 
   virtual void get_bin_from_event(Bin& bin, const CListEvent&) const;
 
+  //! returns \c false, as the events need to be processed in order
+  virtual bool supports_parallel_binning() const { return false; }
+
 
   // \name parsing variables
   //@{
@@ -0,0 +1,151 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+#ifndef __stir_numerics_FFTPlan_H__
+#define __stir_numerics_FFTPlan_H__
+/*!
+  \file
+  \ingroup DFT
+  \brief Declaration of classes stir::FFTPlan and stir::RealFFTPlan
+
+  These classes do the actual work for the functions in stir/numerics/fourier.h.
+*/
+
+#include "stir/shared_ptr.h"
+#include <complex>
+#include <vector>
+
+START_NAMESPACE_STIR
+
+/*! \ingroup DFT
+  \brief A plan to compute one-dimensional discrete fourier transforms of complex data of a fixed length
+
+  The length is split in factors 4, 2, 3, 5 (and any other primes that remain).
+  Each factor corresponds to a pass with a butterfly of that radix (mixed-radix
+  Cooley-Tukey algorithm). Lengths of the form \f$2^a 3^b 5^c\f$ are therefore
+  handled efficiently, and other lengths are still supported (but are slower
+  for large prime factors). See get_efficient_fourier_length().
+
+  The factorisation and all twiddle factors are computed when the plan is constructed.
+  A plan is not modified after construction, so the same plan can be used by
+  multiple threads at the same time. get_plan() returns plans from a cache, such
+  that they are only constructed once for every length and sign.
+
+  The convention for the DFT is the same as for fourier_1d(), i.e.
+  \f[
+    r_s = \sum_{s=0}^{n-1} c_r e^{\mathrm{sign} 2\pi i r s/n}
+  \f]
+  No scaling is applied (also not when \c sign is -1).
+*/
+template <typename T>
+class FFTPlan
+{
+public:
+  typedef std::complex<T> complex_type;
+
+  //! get a plan from the cache (constructing it if necessary)
+  /*! This function can be called from multiple threads at the same time. */
+  static shared_ptr<const FFTPlan<T> > get_plan(const int length, const int sign);
+
+  //! constructor, consider using get_plan() instead
+  FFTPlan(const int length, const int sign);
+
+  int get_length() const { return length; }
+  int get_sign() const { return sign; }
+  //! the radices of the passes, in the order that they are applied
+  std::vector<int> get_radices() const;
+
+  //! compute the DFT of \c in[0], \c in[in_stride], ... and store it in \c out[0], \c out[1], ...
+  /*! \a in and \a out cannot overlap. */
+  void transform(complex_type * const out, const complex_type * const in, const int in_stride = 1) const;
+
+  //! compute the DFT of \a data in place
+  /*! \a scratch has to have space for get_length() elements */
+  void transform_in_place(complex_type * const data, complex_type * const scratch) const;
+
+  //! compute the DFT of \a num_transforms arrays starting at \c data, \c data+distance, ...
+  /*! When STIR_OPENMP is defined, the transforms are distributed over the threads
+      (unless this is called from inside a parallel region). */
+  void transform_many_in_place(complex_type * const data, const int num_transforms, const int distance) const;
+
+private:
+  int length;
+  int sign;
+  //! pairs (radix, length of the sub-transforms) for every pass
+  std::vector<int> factors;
+  //! twiddles[k] = exp(sign*2*pi*i*k/length)
+  std::vector<complex_type> twiddles;
+
+  void do_transform(complex_type * const out, const complex_type * in,
+                    const int in_stride, const int fstride, const int factor_num) const;
+  void butterfly_2(complex_type * const out, const int fstride, const int m) const;
+  void butterfly_3(complex_type * const out, const int fstride, const int m) const;
+  void butterfly_4(complex_type * const out, const int fstride, const int m) const;
+  void butterfly_5(complex_type * const out, const int fstride, const int m) const;
+  void butterfly_generic(complex_type * const out, const int fstride, const int m, const int radix) const;
+};
+
+/*! \ingroup DFT
+  \brief A plan to compute one-dimensional discrete fourier transforms of real data of a fixed (even) length
+
+  The DFT of real data of length \c 2n is computed via a complex DFT of
+  length \c n (see fourier_1d_for_real_data()). This class stores the plans
+  for that complex DFT and the factors that are needed to compute the
+  result from it.
+
+  As for FFTPlan, a plan can be used by multiple threads at the same time.
+*/
+template <typename T>
+class RealFFTPlan
+{
+public:
+  typedef std::complex<T> complex_type;
+
+  //! get a plan from the cache (constructing it if necessary)
+  /*! This function can be called from multiple threads at the same time. */
+  static shared_ptr<const RealFFTPlan<T> > get_plan(const int length, const int sign);
+
+  //! constructor, consider using get_plan() instead
+  /*! \a length has to be even. */
+  RealFFTPlan(const int length, const int sign);
+
+  int get_length() const { return length; }
+  int get_sign() const { return sign; }
+
+  //! compute the positive frequencies of the DFT of \c in[0],...,in[get_length()-1]
+  /*! \a out has to have space for get_length()/2+1 elements, \a scratch for get_length()/2. */
+  void transform(complex_type * const out, const T * const in, complex_type * const scratch) const;
+
+  //! compute the inverse of transform(), including the scale factor 1/get_length()
+  /*! \a in has get_length()/2+1 elements, and is overwritten. \a scratch has to have
+      space for get_length()/2 elements. */
+  void inverse_transform(T * const out, complex_type * const in, complex_type * const scratch) const;
+
+private:
+  int length;
+  int sign;
+  shared_ptr<const FFTPlan<T> > plan_sptr;
+  shared_ptr<const FFTPlan<T> > inverse_plan_sptr;
+  //! factors to combine the DFTs of the even and odd elements
+  std::vector<complex_type> forward_factors;
+  std::vector<complex_type> inverse_factors;
+};
+
+END_NAMESPACE_STIR
+
+#endif
@@ -6,11 +6,16 @@
   \ingroup DFT
   \brief Functions for computing FFTs
 
+  The transforms are computed using stir::FFTPlan and stir::RealFFTPlan. These
+  handle lengths with factors 2, 3 and 5 efficiently (other lengths are supported but
+  slower). Use get_efficient_fourier_length() to find a suitable length for padding.
+
   \author Kris Thielemans
 
 */
 /*
     Copyright (C) 2003- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -85,7 +90,6 @@ inline void inverse_fourier(T& c, const int sign=1)
   \param[in] sign This can be used to implement a different convention for the DFT
 
   \warning Currently, the array has to be indexed from 0.
-  \warning Currently, the length of the array has to be a power of 2.
    
   The convention used is as follows.
   For a vector of length \a n, the result is
@@ -95,13 +99,10 @@ inline void inverse_fourier(T& c, const int sign=1)
   This means that the zero-frequency will be returned in <tt>c[0]</tt>
    
   This function can be used with more general type of \a c (if instantiated in fourier.cxx).
-  The type \a T has to be such that \a T::value_type, \a T::reference and 
-  <tt> T::reference T::operator[](const int)</tt> exist. Moreover, numerical
-  operations
-  <tt>operator*=(T::reference, std::complex\<float\>)</tt>,
-  <tt>operator+=(T::reference, T::value_type)</tt> and
-  <tt>operator*=(T::reference, int)</tt>,
-   have to be defined as well.
+  The type \a T has to be derived from <code>VectorWithOffset\<elemT\></code>, where \c elemT
+  is either a complex number or an Array of complex numbers (where all elements have the same size).
+  In the latter case, the transform is computed for every "column" of \a c, using multiple
+  threads when STIR_OPENMP is defined.
 */
 template <typename T>
 void fourier_1d(T& c, const int sign);
@@ -144,7 +145,7 @@ inline void inverse_fourier_1d(T& c, const int sign=1)
   efficiently by creating a complex array of half the length (by putting the
   even-numbered elements as the real part, and the odd-numbered as the imaginary part).
 
-  This function implements the above and is hence (probably) a faster way to compute
+  This function implements the above (see RealFFTPlan) and is hence a faster way to compute
   DFTs of real arrays. Note however, that in contrast to the Numerical Recipes routines,
   the result is not stored in the same memory location as the input. For a recent
   compiler that implements the Named-Return-Value-Optimisation, this should not be a problem
@@ -187,6 +188,41 @@ template <typename T>
 Array<1,T>
   inverse_fourier_1d_for_real_data_corrupting_input(Array<1,std::complex<T> >& c, const int sign);
 
+/*! \ingroup DFT
+
+  \brief Compute the one-dimensional discrete fourier transform of all rows of a real array (of even length).
+
+  \param[out] result will contain the positive frequencies of the DFT of every row. It is resized
+  (if necessary) to have the same outer index range as \a rows, and indices from 0 to <tt>n/2</tt> for
+  rows of length \c n.
+  \param[in] rows The rows can start from any index. The first element of every row is
+  used as the element at index 0 for the DFT. Every row has to have the same (even) length.
+  \param[in] sign  This can be used to implement a different convention for the DFT.
+
+  This can be used for (1D) filtering of all rows of a stir::Sinogram or stir::Viewgram.
+  The rows are distributed over the threads when STIR_OPENMP is defined.
+
+  Result is such that <tt>result[i]</tt> is equal to <tt>fourier_1d_for_real_data(rows[i], sign)</tt>
+  (if the row would be indexed from 0).
+*/
+template <typename T>
+void
+fourier_1d_for_real_data_of_rows(Array<2,std::complex<T> >& result, const Array<2,T>& rows, const int sign = 1);
+
+/*! \ingroup DFT
+
+  \brief Compute the inverse of fourier_1d_for_real_data_of_rows()
+
+  \param[out] result will contain the inverse DFT of every row. If \a result has the
+  correct sizes already, its index range is not modified (so that the rows can start from
+  any index). Otherwise, it is resized to have rows indexed from 0.
+  \param[in] c the positive frequencies of every row
+  \param[in] sign  This can be used to implement a different convention for the DFT.
+*/
+template <typename T>
+void
+inverse_fourier_1d_for_real_data_of_rows(Array<2,T>& result, const Array<2,std::complex<T> >& c, const int sign = 1);
+
 /*! \ingroup DFT
 
   \brief Compute discrete fourier transform of a real array (with the last dimensions of even size).
@@ -247,6 +283,14 @@ template <int num_dimensions, typename T>
 Array<num_dimensions, std::complex<T> > 
 pos_frequencies_to_all(const Array<num_dimensions, std::complex<T> >& c);
 
+/*! \ingroup DFT
+  \brief Find a length that is at least \a min_length and for which DFTs can be computed efficiently
+
+  This returns the smallest even number of the form \f$2^a 3^b 5^c\f$ that is not smaller
+  than \a min_length. Use this to decide how much data need to be padded, instead of
+  padding to a power of 2.
+*/
+int get_efficient_fourier_length(const int min_length);
 
 END_NAMESPACE_STIR
 
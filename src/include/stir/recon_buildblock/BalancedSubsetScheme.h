@@ -0,0 +1,86 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Declaration of class stir::BalancedSubsetScheme
+*/
+
+#ifndef __stir_recon_buildblock_BalancedSubsetScheme_H__
+#define __stir_recon_buildblock_BalancedSubsetScheme_H__
+
+#include "stir/recon_buildblock/SubsetScheme.h"
+#include "stir/RegisteredParsingObject.h"
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup recon_buildblock
+  \brief A subset scheme that balances the number of viewgrams in every subset
+
+  With the interleaved scheme (see InterleavedSubsetScheme), the subsets are only
+  balanced when the number of subsets is compatible with the symmetries of the projector
+  (as only 'basic' views are assigned to a subset, together with all their related views).
+  Otherwise some subsets contain many more viewgrams than others, which is a problem for
+  algorithms such as OSMAPOSL, and means that some subiterations take much longer.
+
+  This scheme goes through all basic view/segment numbers in order of increasing view number
+  (and then segment number) and assigns each of them to the subset with the smallest number
+  of viewgrams so far. When there is a tie, the next subset after the previous assignment is
+  used, so that when all view/segment numbers have the same number of related viewgrams,
+  the subsets are the same as for the interleaved scheme without symmetries. Subsets therefore
+  still contain views that are spread over all angles.
+
+  In each subset, the view/segment numbers are sorted by decreasing number of bins (in all
+  related viewgrams). Processing the largest tasks first reduces the time that threads or
+  MPI slaves are idle at the end of a subiteration.
+
+  Of course, perfect balancing is not always possible (e.g. when there are fewer basic
+  view/segment numbers than subsets).
+
+  \par Parameters for parsing
+  \verbatim
+  subset scheme type := Balanced
+  Balanced Subset Scheme Parameters :=
+  End Balanced Subset Scheme Parameters :=
+  \endverbatim
+*/
+class BalancedSubsetScheme :
+  public RegisteredParsingObject<BalancedSubsetScheme, SubsetScheme>
+{
+public:
+  //! Name which will be used when parsing a SubsetScheme object
+  static const char * const registered_name;
+
+  BalancedSubsetScheme();
+
+  virtual std::vector<ViewSegmentNumbers>
+    find_basic_vs_nums_in_subset(const ProjDataInfo& proj_data_info,
+                                 const DataSymmetriesForViewSegmentNumbers& symmetries,
+                                 const int min_segment_num, const int max_segment_num,
+                                 const int subset_num, const int num_subsets) const;
+
+protected:
+  virtual void set_defaults();
+  virtual void initialise_keymap();
+};
+
+END_NAMESPACE_STIR
+
+#endif
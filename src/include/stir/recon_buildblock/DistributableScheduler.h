@@ -0,0 +1,133 @@
+//
+//
+#ifndef __stir_recon_buildblock_DistributableScheduler_H__
+#define __stir_recon_buildblock_DistributableScheduler_H__
+
+/*!
+  \file
+  \ingroup distributable
+  \brief Declaration of class stir::DistributableScheduler
+
+*/
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/ViewSegmentNumbers.h"
+#include <vector>
+#include <deque>
+#include <map>
+
+START_NAMESPACE_STIR
+
+class ProjDataInfo;
+class DataSymmetriesForViewSegmentNumbers;
+
+/*!
+  \ingroup distributable
+  \brief Cost model and work-stealing task queues for distributable_computation()
+
+  The time needed to process a set of related viewgrams varies a lot, e.g. between
+  segment 0 and oblique segments, with the number of related viewgrams, and with
+  the state of the cache of the projection matrix. This class
+  - estimates the cost of every basic view/segment number. If the time needed for it was
+    measured before (see set_measured_time()), this time is used. Otherwise the cost is
+    taken proportional to the number of bins in all related viewgrams, scaled with the
+    average measured time per bin (if any).
+  - sorts the view/segment numbers by decreasing cost, such that the largest tasks are
+    handed out first.
+  - distributes the tasks over a queue per worker (thread), assigning every task
+    to the queue with the smallest total estimated cost. A worker processes its own queue
+    from the front (i.e. largest first). When its queue is empty, it steals from the back
+    of the queue with the largest remaining cost.
+
+  The queues are protected by a single critical section. This is cheap compared to
+  the time needed to process a set of related viewgrams.
+
+  \par Usage
+  \code
+  scheduler.sort_by_estimated_cost(vs_nums, proj_data_info, symmetries);
+  scheduler.start(scheduler.get_estimated_costs(vs_nums, proj_data_info, symmetries), num_threads);
+  #pragma omp parallel
+  {
+    int task_num;
+    while (scheduler.get_next_task(task_num, omp_get_thread_num()))
+      { process vs_nums[task_num] and time it }
+  }
+  for all tasks: scheduler.set_measured_time(vs_nums[task_num], time, num_bins);
+  \endcode
+*/
+class DistributableScheduler
+{
+public:
+  DistributableScheduler();
+
+  //! forget all measured times
+  void clear();
+
+  //! the number of bins in all viewgrams related to \a vs_num
+  static long get_num_bins(const ViewSegmentNumbers& vs_num,
+                           const ProjDataInfo& proj_data_info,
+                           const DataSymmetriesForViewSegmentNumbers& symmetries);
+
+  //! estimate the cost of every element of \a vs_nums
+  /*! Measured times are in seconds. When no measurements are available, the
+      estimates are just the number of bins. */
+  std::vector<double>
+    get_estimated_costs(const std::vector<ViewSegmentNumbers>& vs_nums,
+                        const ProjDataInfo& proj_data_info,
+                        const DataSymmetriesForViewSegmentNumbers& symmetries) const;
+
+  //! sort by decreasing estimated cost (preserving the order for equal costs)
+  void sort_by_estimated_cost(std::vector<ViewSegmentNumbers>& vs_nums,
+                              const ProjDataInfo& proj_data_info,
+                              const DataSymmetriesForViewSegmentNumbers& symmetries) const;
+
+  //! store the time (in seconds) needed to process the viewgrams related to \a vs_num
+  /*! This replaces any previous measurement for \a vs_num. */
+  void set_measured_time(const ViewSegmentNumbers& vs_num, const double time, const long num_bins);
+
+  //! distribute tasks 0,1,... over the queues of \a num_workers workers
+  /*! \a costs should be sorted in decreasing order for the queues to be processed
+      largest first. This has to be called outside a parallel region. */
+  void start(const std::vector<double>& costs, const int num_workers);
+
+  //! get the next task for a worker
+  /*! Returns \c false when all tasks have been handed out. This can be called by
+      all threads at the same time. */
+  bool get_next_task(int& task_num, const int worker_num);
+
+  //! the number of tasks that were stolen since start()
+  int get_num_stolen_tasks() const;
+
+private:
+  struct Measurement
+  {
+    double time;
+    long num_bins;
+  };
+  std::map<ViewSegmentNumbers, Measurement> measurements;
+
+  std::vector<double> costs;
+  std::vector<std::deque<int> > queues;
+  //! sum of the costs of the tasks in every queue
+  std::vector<double> remaining_costs;
+  int num_stolen_tasks;
+};
+
+END_NAMESPACE_STIR
+
+#endif
@@ -15,6 +15,7 @@
     Copyright (C) 2003 - 2005, Hammersmith Imanet Ltd
     Copyright (C) 2004 - 2005 DKFZ Heidelberg, Germany
     Copyright (C) 2011-07-01 - 2012, Kris Thielemans
+    Copyright (C) 2016, University College London
 
     This file is part of STIR.
 
@@ -173,7 +174,7 @@ class FourierRebinning : public   RegisteredParsingObject<
   \brief Fourier rebinning
 
   This method takes as input the 3D data set (Array3D) in Fourier space of one sinogram
-  for a given delta as the data dimension are (1,fft_size,nviews_pow2), the scanner informations
+  for a given delta as the data dimension are (1,fft_size,nviews_fft), the scanner informations
   and returns the updated stack of 2D rebinned sinograms still in Fourier space,
   the updated weigthing factors as well as  the new rebinned elements counter.
 
@@ -181,7 +182,7 @@ class FourierRebinning : public   RegisteredParsingObject<
 */
     void rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weights_for_FT_rebinned_data,
        PETCount_rebinned &num_rebinned, const Array<2,std::complex<float> > &FT_current_sinogram, const float z, 
-       const float average_ring_difference_in_segment, const int num_views_pow2, const int num_tang_poss_pow2,
+       const float average_ring_difference_in_segment, const int num_views_fft, const int num_tang_poss_fft,
        const float half_distance_between_rings, const float sampling_distance_in_s, const float radial_sampling_freq_w,
        const float R_field_of_view_mm, const float ratio_ring_spacing_to_ring_radius);
 
@@ -198,8 +199,8 @@ class FourierRebinning : public   RegisteredParsingObject<
 */
 
     void do_rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weights_for_FT_rebinned_data,
-                      PETCount_rebinned &count_rebinned, const SegmentBySinogram<float> &segment, const int num_tang_poss_pow2,
-                      const int num_views_pow2, const int num_planes, const float average_ring_difference_in_segment,
+                      PETCount_rebinned &count_rebinned, const SegmentBySinogram<float> &segment, const int num_tang_poss_fft,
+                      const int num_views_fft, const int num_planes, const float average_ring_difference_in_segment,
                       const float half_distance_between_rings, const float sampling_distance_in_s, 
                       const float radial_sampling_freq_w, const float R_field_of_view_mm,
                       const float ratio_ring_spacing_to_ring_radius);
@@ -221,7 +222,7 @@ class FourierRebinning : public   RegisteredParsingObject<
     void do_adjust_nb_views_to_pow2(SegmentBySinogram<float> &segment) ;
 
 //! This function checks if the steering and input paramters for FORE are inside the possible range of parameters
-    Succeeded fore_check_parameters(int num_tang_poss_pow2, int num_views_pow2, int max_segment_num_to_process);
+    Succeeded fore_check_parameters(int num_tang_poss_fft, int num_views_fft, int max_segment_num_to_process);
 
     
  protected:
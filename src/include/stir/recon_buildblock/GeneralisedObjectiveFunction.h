@@ -197,6 +197,17 @@ public:
     fill_nonidentifiable_target_parameters(TargetT& target, const float value ) const
   {}
 
+  //! describe everything (apart from the target) that the approximate Hessian depends on
+  /*! This is used to cache images computed from the approximate Hessian, such as the
+      precomputed denominator in OSSPSReconstruction. The description therefore has to
+      identify the measured data as well. It should be called after set_up().
+
+      The default returns an empty string, meaning that caching is not supported.
+  */
+  virtual std::string
+    get_approximate_Hessian_cache_key_description() const
+  { return std::string(); }
+
   //! \name multiplication with (sub)Hessian
   /*! \brief Functions that multiply the (sub)Hessian with a \'vector\'.
       
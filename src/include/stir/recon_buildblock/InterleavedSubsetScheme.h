@@ -0,0 +1,102 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Declaration of class stir::InterleavedSubsetScheme
+*/
+
+#ifndef __stir_recon_buildblock_InterleavedSubsetScheme_H__
+#define __stir_recon_buildblock_InterleavedSubsetScheme_H__
+
+#include "stir/recon_buildblock/SubsetScheme.h"
+#include "stir/RegisteredParsingObject.h"
+#include <string>
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup recon_buildblock
+  \brief The traditional subset scheme, where every subset contains every \c num_subsets-th view
+
+  A subset contains the basic view/segment numbers with views
+  \code
+  proj_data_info.get_min_view_num() + offset + n*num_subsets
+  \endcode
+  for n=0,1,..., and all segments in the range.
+
+  With <tt>subset order := natural</tt>, the offset is equal to the subset number. This is the
+  scheme that STIR always used.
+
+  The other orders permute the offsets, such that consecutive subsets (as processed by
+  IterativeReconstruction) use views that are further apart:
+  - <tt>golden angle</tt>: subset \c k uses the rank of <i>frac(k*0.618...)</i>
+    among all subsets as offset, such that every next subset lies approximately in the largest
+    remaining angular gap.
+  - <tt>random</tt>: a random permutation of the offsets, determined by the <tt>random seed</tt>.
+    (This permutation is fixed, unlike the one used for <tt>uniformly randomise subset order</tt>
+    in IterativeReconstruction, which changes at every iteration.)
+
+  \par Parameters for parsing
+  \verbatim
+  subset scheme type := Interleaved
+  Interleaved Subset Scheme Parameters :=
+    ; possible values: natural, golden angle, random
+    subset order := natural
+    ; only used for random subset order
+    random seed := 0
+  End Interleaved Subset Scheme Parameters :=
+  \endverbatim
+*/
+class InterleavedSubsetScheme :
+  public RegisteredParsingObject<InterleavedSubsetScheme, SubsetScheme>
+{
+public:
+  //! Name which will be used when parsing a SubsetScheme object
+  static const char * const registered_name;
+
+  //! Default constructor (using natural order)
+  InterleavedSubsetScheme();
+
+  virtual std::vector<ViewSegmentNumbers>
+    find_basic_vs_nums_in_subset(const ProjDataInfo& proj_data_info,
+                                 const DataSymmetriesForViewSegmentNumbers& symmetries,
+                                 const int min_segment_num, const int max_segment_num,
+                                 const int subset_num, const int num_subsets) const;
+
+  //! the offset of the first view used by the subset (w.r.t. the minimum view number)
+  int get_view_offset(const int subset_num, const int num_subsets) const;
+
+  //! set the order, has to be one of "natural", "golden angle" or "random"
+  void set_subset_order(const std::string&);
+  void set_random_seed(const int);
+
+protected:
+  virtual void set_defaults();
+  virtual void initialise_keymap();
+  virtual bool post_processing();
+
+private:
+  std::string subset_order;
+  int random_seed;
+};
+
+END_NAMESPACE_STIR
+
+#endif
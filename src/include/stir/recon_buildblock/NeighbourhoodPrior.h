@@ -0,0 +1,226 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details.
+*/
+/*!
+  \file
+  \ingroup priors
+  \brief Declaration of class stir::NeighbourhoodPrior, and functions for
+  the weights of neighbourhood priors
+
+*/
+
+#ifndef __stir_recon_buildblock_NeighbourhoodPrior_H__
+#define __stir_recon_buildblock_NeighbourhoodPrior_H__
+
+#include "stir/RegisteredParsingObject.h"
+#include "stir/recon_buildblock/PriorWithParabolicSurrogate.h"
+#include "stir/recon_buildblock/PriorPotentials.h"
+#include "stir/Array.h"
+#include "stir/DiscretisedDensity.h"
+#include "stir/CartesianCoordinate3D.h"
+#include "stir/shared_ptr.h"
+#include <string>
+
+START_NAMESPACE_STIR
+
+//! set weights for a neighbourhood prior to x-voxel_size divided by the Euclidean distance
+/*! \ingroup priors
+    Uses a 3x3x3 neighbourhood, or 1x3x3 if \a only_2D is \c true. The centre weight is 0.
+*/
+void
+compute_inverse_distance_weights(Array<3,float>& weights,
+                                 const CartesianCoordinate3D<float>& grid_spacing,
+                                 const bool only_2D);
+
+//! set the index ranges of weights (as parsed) such that the centre is at index 0
+/*! \ingroup priors
+    \return \c false if the weights are not regular (in which case nothing is changed).
+    \a has_even_size is set if the size in any dimension is even.
+*/
+bool
+centre_neighbourhood_weights(Array<3,float>& weights, bool& has_even_size);
+
+/*!
+  \ingroup priors
+  \brief
+  A class in the GeneralisedPrior hierarchy for priors that are a sum of a potential
+  function over all pairs of neighbouring voxels.
+
+  The value of the prior is computed as
+  \f[
+  \frac{1}{2} \sum_r \sum_{dr} w_{dr} \phi(\lambda_r, \lambda_{r+dr}) \kappa_r \kappa_{r+dr}
+  \f]
+  where \f$\lambda\f$ is the image and \f$r\f$ and \f$dr\f$ are indices and the sum
+  is over the neighbourhood where the weights \f$w_{dr}\f$ are non-zero.
+  The potential \f$\phi\f$ is specified by the template argument \c PotentialT,
+  which has to be symmetric in its arguments (as are the weights). The gradient is then
+  \f[
+  g_r = \sum_{dr} w_{dr} \frac{\partial \phi}{\partial \lambda_r}(\lambda_r, \lambda_{r+dr}) \kappa_r \kappa_{r+dr}
+  \f]
+
+  The weights and \f$\kappa\f$ have the same meaning as for QuadraticPrior.
+  With a potential \f$\phi(\lambda_r,\lambda_n) = (\lambda_r-\lambda_n)^2/2\f$,
+  this class gives the same results as QuadraticPrior.
+
+  A potential class has to provide the following members (see HuberPotential for an example)
+  - \c set_defaults(), \c initialise_keymap(KeyParser&) and \c post_processing() for its parameters
+  - \c value(centre,neighbour)
+  - \c derivative_10(centre,neighbour), \c derivative_20(centre,neighbour) and
+    \c derivative_11(centre,neighbour): the first and second derivatives w.r.t. the
+    first argument, and the mixed derivative
+  - \c surrogate_curvature(centre,neighbour): curvature used for the parabolic surrogate,
+    such that the parabola lies above the potential as a function of the centre. For a
+    potential of the difference only, this is normally \c derivative_10()/(centre-neighbour)
+    (see RelativeDifferencePotential for a different case)
+  These are called from the inner loops, so they should be inline.
+
+  All sums over the neighbourhood are computed with NeighbourhoodStencil, i.e. row by
+  row and in parallel over planes when using OpenMP.
+
+  \par Parsing
+  These are the keywords that can be used in addition to the ones in GeneralPrior,
+  for example for the Huber potential (other potentials have different parameters,
+  and use their registered name in the start and stop keys)
+  \verbatim
+  Huber Prior Parameters:=
+  ; next defaults to 0, set to 1 for 2D inverse Euclidean weights, 0 for 3D
+  only 2D:= 0
+  ; next can be used to set weights explicitly. Needs to be a 3D array (of floats).
+  ; weights:={{{0,1,0},{1,0,1},{0,1,0}}}
+  ; use next parameter to specify an image with penalisation factors (a la Fessler)
+  ; kappa filename:=
+  ; use next parameter to get gradient images at every subiteration
+  gradient filename prefix:=
+  ; parameters of the potential
+  delta := 1
+  END Huber Prior Parameters:=
+  \endverbatim
+
+  \warning add_multiplication_with_approximate_Hessian() is not implemented, as the
+  Hessian of a non-quadratic prior depends on the image.
+*/
+template <typename elemT, typename PotentialT>
+class NeighbourhoodPrior:  public
+                       RegisteredParsingObject< NeighbourhoodPrior<elemT,PotentialT>,
+                                                GeneralisedPrior<DiscretisedDensity<3,elemT> >,
+                                                PriorWithParabolicSurrogate<DiscretisedDensity<3,elemT> >
+                                              >
+{
+ private:
+  typedef
+    RegisteredParsingObject< NeighbourhoodPrior<elemT,PotentialT>,
+                             GeneralisedPrior<DiscretisedDensity<3,elemT> >,
+                             PriorWithParabolicSurrogate<DiscretisedDensity<3,elemT> > >
+    base_type;
+
+ public:
+  //! Name which will be used when parsing a GeneralisedPrior object
+  static const char * const registered_name;
+
+  //! Default constructor
+  NeighbourhoodPrior();
+
+  //! Constructs it explicitly
+  NeighbourhoodPrior(const bool only_2D, float penalisation_factor,
+                     const PotentialT& potential = PotentialT());
+
+  virtual bool
+    parabolic_surrogate_curvature_depends_on_argument() const
+    { return true; }
+
+  //! compute the value of the function
+  double
+    compute_value(const DiscretisedDensity<3,elemT> &current_image_estimate);
+
+  //! compute gradient
+  void compute_gradient(DiscretisedDensity<3,elemT>& prior_gradient,
+                        const DiscretisedDensity<3,elemT> &current_image_estimate);
+
+  //! compute the parabolic surrogate for the prior
+  /*! This is the sum of the weights times the \c surrogate_curvature of the potential */
+  void parabolic_surrogate_curvature(DiscretisedDensity<3,elemT>& parabolic_surrogate_curvature,
+                                     const DiscretisedDensity<3,elemT> &current_image_estimate);
+
+  //! compute Hessian
+  void compute_Hessian(DiscretisedDensity<3,elemT>& prior_Hessian_for_single_densel,
+                       const BasicCoordinate<3,int>& coords,
+                       const DiscretisedDensity<3,elemT> &current_image_estimate);
+
+  //! get penalty weights for the neigbourhood
+  Array<3,float> get_weights() const;
+
+  //! set penalty weights for the neigbourhood
+  void set_weights(const Array<3,float>&);
+
+  //! get current kappa image
+  /*! \warning As this function returns a shared_ptr, this is dangerous. You should not
+      modify the image by manipulating the image refered to by this pointer.
+      Unpredictable results will occur.
+  */
+  shared_ptr<DiscretisedDensity<3,elemT> > get_kappa_sptr() const;
+
+  //! set kappa image
+  void set_kappa_sptr(const shared_ptr<DiscretisedDensity<3,elemT> >&);
+
+  //! get the potential (with its parameters)
+  const PotentialT& get_potential() const;
+
+  //! set the potential (with its parameters)
+  void set_potential(const PotentialT&);
+
+protected:
+  //! can be set during parsing to restrict the weights to the 2D case
+  bool only_2D;
+  //! filename prefix for outputing the gradient whenever compute_gradient() is called.
+  /*! An internal counter is used to keep track of the number of times the
+     gradient is computed. The filename will be constructed by concatenating
+     gradient_filename_prefix and the counter.
+  */
+  std::string gradient_filename_prefix;
+
+  //! penalty weights
+  Array<3,float> weights;
+  //! Filename for the \f$\kappa\f$ image that will be read by post_processing()
+  std::string kappa_filename;
+
+  //! the potential function
+  PotentialT potential;
+
+  virtual void set_defaults();
+  virtual void initialise_keymap();
+  virtual bool post_processing();
+ private:
+  shared_ptr<DiscretisedDensity<3,elemT> > kappa_ptr;
+
+  //! computes the weights if necessary, and checks the kappa image
+  void set_up_for_image(const DiscretisedDensity<3,elemT>& current_image_estimate);
+};
+
+//! Prior with the Huber potential, see HuberPotential
+/*! \ingroup priors */
+typedef NeighbourhoodPrior<float, HuberPotential<float> > HuberPrior;
+//! Prior with the log-cosh potential, see LogCoshPotential
+/*! \ingroup priors */
+typedef NeighbourhoodPrior<float, LogCoshPotential<float> > LogCoshPrior;
+//! Relative Difference Prior, see RelativeDifferencePotential
+/*! \ingroup priors */
+typedef NeighbourhoodPrior<float, RelativeDifferencePotential<float> > RelativeDifferencePrior;
+
+END_NAMESPACE_STIR
+
+#endif
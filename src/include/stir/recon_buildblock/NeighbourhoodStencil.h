@@ -0,0 +1,105 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details.
+*/
+/*!
+  \file
+  \ingroup priors
+  \brief Declaration of class stir::NeighbourhoodStencil
+
+*/
+
+#ifndef __stir_recon_buildblock_NeighbourhoodStencil_H__
+#define __stir_recon_buildblock_NeighbourhoodStencil_H__
+
+#include "stir/Array.h"
+#include <vector>
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup priors
+  \brief Applies a computation over all pairs of neighbouring voxels of an image, row by row
+
+  Priors such as QuadraticPrior compute for every voxel \f$r\f$ a sum over its
+  neighbours \f$r+dr\f$ with non-zero weight \f$w_{dr}\f$. Doing this voxel by voxel
+  needs a check on the image boundaries for every voxel and every neighbour, and
+  accesses all voxels via the nested Array::operator[].
+
+  This class reorganises the loops: for every row \f$(z,y)\f$ of the image and every
+  neighbour offset \f$(dz,dy,dx)\f$, it determines once which part of the row has this
+  neighbour inside the image, and passes contiguous pointers to this part of the centre
+  row and of the neighbouring row to a \e kernel. The inner loop of the kernel is then
+  a simple loop over \c x which the compiler can vectorise. Rows are handled in parallel
+  over \c z when OpenMP is enabled.
+
+  A kernel is a function object with the following signature
+  \code
+  double operator()(elemT* output, const elemT* centre, const elemT* neighbour,
+                    const elemT* kappa_centre, const elemT* kappa_neighbour,
+                    const int length, const float weight) const;
+  \endcode
+  All pointers point to the first voxel of the current part of the row. \c kappa_centre
+  and \c kappa_neighbour are 0 if there is no \f$\kappa\f$ image, \c output is 0
+  if no output image is computed. The return value is accumulated (as \c double).
+
+  For every voxel, the kernel is called for the neighbours in the same order
+  (increasing \c dz, then \c dy, then \c dx), which is also the order used by a voxel
+  by voxel loop. The output of a row is first accumulated in a buffer that is
+  initialised to 0, and then multiplied by a scale factor and either assigned or added
+  to the output image. The result therefore does not depend on the number of threads.
+  It is not necessarily bitwise identical to the result of a voxel by voxel loop though,
+  as the compiler can reorder the arithmetic in the kernels (e.g. with \c -ffast-math).
+
+  \warning The centre of the weights has to be at index (0,0,0), with a regular index range.
+*/
+template <typename elemT>
+class NeighbourhoodStencil
+{
+public:
+  //! Store the offsets of all neighbours with non-zero weight
+  explicit NeighbourhoodStencil(const Array<3,float>& weights);
+
+  //! Apply \a kernel to all rows and neighbours
+  /*!
+    \param output_ptr if not 0, the image where the (scaled) output of the kernel is stored
+    \param add_to_output if \c true, the output is added to \c *output_ptr, otherwise it is overwritten
+    \param scale factor with which the output of the kernel is multiplied
+    \param input image over whose neighbourhoods the kernel is applied
+    \param kappa_ptr if not 0, the \f$\kappa\f$ image (with the same index range as \a input)
+    \param kernel the function object (see class documentation)
+    \return the sum of all return values of \a kernel
+  */
+  template <class KernelT>
+  double apply(Array<3,elemT>* output_ptr, const bool add_to_output, const float scale,
+               const Array<3,elemT>& input, const Array<3,elemT>* kappa_ptr,
+               const KernelT& kernel) const;
+
+private:
+  struct Neighbour
+  {
+    int dz, dy, dx;
+    float weight;
+  };
+  std::vector<Neighbour> neighbours;
+};
+
+END_NAMESPACE_STIR
+
+#include "stir/recon_buildblock/NeighbourhoodStencil.inl"
+
+#endif
@@ -0,0 +1,138 @@
+//
+//
+/*!
+  \file
+  \ingroup priors
+  \brief Implementation of class stir::NeighbourhoodStencil
+
+*/
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include <algorithm>
+
+START_NAMESPACE_STIR
+
+template <typename elemT>
+NeighbourhoodStencil<elemT>::
+NeighbourhoodStencil(const Array<3,float>& weights)
+{
+  for (int dz=weights.get_min_index(); dz<=weights.get_max_index(); ++dz)
+    for (int dy=weights[dz].get_min_index(); dy<=weights[dz].get_max_index(); ++dy)
+      for (int dx=weights[dz][dy].get_min_index(); dx<=weights[dz][dy].get_max_index(); ++dx)
+        {
+          // zero weights do not contribute, so skip them (this includes the centre)
+          if (weights[dz][dy][dx] == 0)
+            continue;
+          Neighbour neighbour;
+          neighbour.dz = dz;
+          neighbour.dy = dy;
+          neighbour.dx = dx;
+          neighbour.weight = weights[dz][dy][dx];
+          this->neighbours.push_back(neighbour);
+        }
+}
+
+template <typename elemT>
+template <class KernelT>
+double
+NeighbourhoodStencil<elemT>::
+apply(Array<3,elemT>* output_ptr, const bool add_to_output, const float scale,
+      const Array<3,elemT>& input, const Array<3,elemT>* kappa_ptr,
+      const KernelT& kernel) const
+{
+  const int min_z = input.get_min_index();
+  const int max_z = input.get_max_index();
+  const int num_neighbours = static_cast<int>(this->neighbours.size());
+  // sum per plane, such that the total does not depend on the number of threads
+  std::vector<double> plane_results(input.size(), 0.);
+
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int z=min_z; z<=max_z; ++z)
+    {
+      std::vector<elemT> row_output;
+      double plane_result = 0.;
+      for (int y=input[z].get_min_index(); y<=input[z].get_max_index(); ++y)
+        {
+          const Array<1,elemT>& centre_row = input[z][y];
+          const int min_x = centre_row.get_min_index();
+          const int max_x = centre_row.get_max_index();
+          if (max_x < min_x)
+            continue;
+          if (output_ptr != 0)
+            row_output.assign(static_cast<std::size_t>(max_x - min_x + 1), elemT(0));
+
+          for (int n=0; n<num_neighbours; ++n)
+            {
+              const Neighbour& neighbour = this->neighbours[n];
+              const int neighbour_z = z + neighbour.dz;
+              if (neighbour_z < min_z || neighbour_z > max_z)
+                continue;
+              const int neighbour_y = y + neighbour.dy;
+              if (neighbour_y < input[neighbour_z].get_min_index() ||
+                  neighbour_y > input[neighbour_z].get_max_index())
+                continue;
+              const Array<1,elemT>& neighbour_row = input[neighbour_z][neighbour_y];
+              // part of the row for which this neighbour is inside the image
+              const int start_x = std::max(min_x, neighbour_row.get_min_index() - neighbour.dx);
+              const int end_x = std::min(max_x, neighbour_row.get_max_index() - neighbour.dx);
+              if (end_x < start_x)
+                continue;
+
+              const elemT* kappa_centre = 0;
+              const elemT* kappa_neighbour = 0;
+              if (kappa_ptr != 0)
+                {
+                  kappa_centre = &(*kappa_ptr)[z][y][start_x];
+                  kappa_neighbour = &(*kappa_ptr)[neighbour_z][neighbour_y][start_x + neighbour.dx];
+                }
+              plane_result +=
+                kernel(output_ptr != 0 ? &row_output[start_x - min_x] : 0,
+                       &centre_row[start_x],
+                       &neighbour_row[start_x + neighbour.dx],
+                       kappa_centre, kappa_neighbour,
+                       end_x - start_x + 1, neighbour.weight);
+            }
+
+          if (output_ptr != 0)
+            {
+              elemT* const output_row = &(*output_ptr)[z][y][min_x];
+              const int length = max_x - min_x + 1;
+              if (add_to_output)
+                {
+                  for (int i=0; i<length; ++i)
+                    output_row[i] += row_output[i] * scale;
+                }
+              else
+                {
+                  for (int i=0; i<length; ++i)
+                    output_row[i] = row_output[i] * scale;
+                }
+            }
+        }
+      plane_results[z - min_z] = plane_result;
+    }
+
+  double result = 0.;
+  for (std::size_t i=0; i<plane_results.size(); ++i)
+    result += plane_results[i];
+  return result;
+}
+
+END_NAMESPACE_STIR
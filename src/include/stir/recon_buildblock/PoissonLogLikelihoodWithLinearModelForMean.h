@@ -1,6 +1,7 @@
 /*
     Copyright (C) 2003 - 2011-01-14, Hammersmith Imanet Ltd
     Copyright (C) 2012, Kris Thielemans
+    Copyright (C) 2016, University College London
 
     This file is free software; you can redistribute it and/or modify
     it under the terms of the GNU Lesser General Public License as published by
@@ -111,8 +112,25 @@ START_NAMESPACE_STIR
   ; e.g. subsens_%d.hv
   ; boost::format is used with the pattern (which means you can use it like sprintf)
   subset sensitivity filenames:=
+  ; directory where computed sensitivities are cached (see below)
+  ; leave empty to switch caching off
+  sensitivity cache directory:=
   \endverbatim
 
+  \par Sensitivity cache
+  If \c sensitivity_cache_directory is set, computed sensitivities are written to that
+  directory, together with a key file describing everything the sensitivity depends on
+  (see get_sensitivity_cache_key_description()). The name of the key file is derived from
+  a hash of this description. When the sensitivity would otherwise have to be computed
+  (i.e. no filenames were set), set_up() will first try to read it from the cache.
+  This is skipped if \c recompute_sensitivity was set explicitly
+  (in which case the cache entry is refreshed).
+
+  The description contains the parameters of all objects involved (such as the
+  normalisation and projectors), but not the content of any data they use. If a file
+  is overwritten with different data (or data in memory is changed), you have to
+  recompute the sensitivity explicitly.
+
   \par Terminology
   We currently use \c sub_gradient for the gradient of the likelihood of the subset (not 
   the mathematical subgradient).
@@ -229,6 +247,18 @@ public  GeneralisedObjectiveFunction<TargetT>
   Calls error() if the pattern is invalid.
  */
   void set_subsensitivity_filenames(const std::string&);
+
+  //! get directory used to cache sensitivities (empty if caching is off)
+  std::string get_sensitivity_cache_directory() const;
+  //! set directory used to cache sensitivities
+  /*! Set to an empty string to switch caching off. The directory has to exist. */
+  void set_sensitivity_cache_directory(const std::string&);
+  //! check if the last call to set_up() read the sensitivity from the cache
+  bool get_sensitivity_was_read_from_cache() const;
+  //! find the description of the sensitivity and the name of its key file in the cache
+  /*! \return \c false if caching is switched off, or not supported by the derived class. */
+  bool get_sensitivity_cache_key(std::string& key_filename, std::string& description,
+                                 const TargetT& target) const;
   //@}
 
   /*! The implementation checks if the sensitivity of a voxel is zero. If so,
@@ -243,6 +273,8 @@ public  GeneralisedObjectiveFunction<TargetT>
   std::string subsensitivity_filenames;
   bool recompute_sensitivity;
   bool use_subset_sensitivities;
+  std::string sensitivity_cache_directory;
+  bool sensitivity_was_read_from_cache;
 
   VectorWithOffset<shared_ptr<TargetT> > subsensitivity_sptrs;
   shared_ptr<TargetT> sensitivity_sptr;
@@ -260,6 +292,14 @@ public  GeneralisedObjectiveFunction<TargetT>
   */
   void set_total_or_subset_sensitivities();
 
+  //! read (sub)sensitivities listed in the key file, if its description matches
+  Succeeded read_sensitivities_from_cache(const std::string& key_filename,
+                                          const std::string& description,
+                                          const TargetT& target);
+  //! write (sub)sensitivities and the key file
+  Succeeded write_sensitivities_to_cache(const std::string& key_filename,
+                                         const std::string& description) const;
+
 protected:
   //! set-up specifics for the derived class 
   virtual Succeeded 
@@ -272,6 +312,16 @@ protected:
   */
   void compute_sensitivities();
 
+  //! describe everything (apart from the target) that the sensitivity depends on
+  /*! This is used for the sensitivity cache, see the class documentation.
+      It is called after set_up_before_sensitivity().
+      The default returns an empty string, meaning that caching is not supported.
+      Derived classes should include all relevant parameters (e.g. by using
+      parameter_info() of their projectors and normalisation).
+      The target geometry and the subset settings are added by this class.
+  */
+  virtual std::string get_sensitivity_cache_key_description() const;
+
   //! Sets defaults for parsing 
   /*! Resets \c sensitivity_filename, \c subset_sensitivity_filenames to empty,
      \c recompute_sensitivity to \c false, and \c use_subset_sensitivities to false.
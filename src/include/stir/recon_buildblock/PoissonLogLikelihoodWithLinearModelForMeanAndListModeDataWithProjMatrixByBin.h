@@ -2,6 +2,7 @@
 //
 /*
     Copyright (C) 2003- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
 
     This file is free software; you can redistribute it and/or modify
     it under the terms of the GNU Lesser General Public License as published by
@@ -35,8 +36,12 @@
 #include "stir/ProjDataInMemory.h"
 
 #include "stir/ExamInfo.h"
+#include <vector>
 START_NAMESPACE_STIR
 
+class CListRecord;
+class ListModeEventCache;
+
 
 /*!
   \ingroup GeneralisedObjectiveFunction
@@ -49,6 +54,36 @@ START_NAMESPACE_STIR
   If the list mode data is binned (with LmToProjData) without merging
   any bins, then the log likelihood computed from list mode data and
   projection data will be identical.
+
+  When compiled with OpenMP, the gradient is computed in parallel, see
+  compute_sub_gradient_without_penalty_plus_sensitivity().
+
+  Subsets are defined in terms of views, similar to
+  PoissonLogLikelihoodWithLinearModelForMeanAndProjData: an event belongs to subset
+  \c s if the view number of its bin (in the uncompressed projection data), counted from
+  the first view, modulo the number of subsets is equal to \c s. Every subiteration therefore reads
+  the whole list mode file, but only forward and back projects the events of the subset.
+  The subset sensitivities are computed by back projecting the efficiencies (i.e. the
+  inverse of the normalisation factors, see BinNormalisation::undo()) for all bins of the
+  subset. The normalisation can be set with the <tt>Bin Normalisation type</tt> keyword.
+  As the efficiency of the bin of an event cancels in the gradient, it is not used there.
+  The additive sinogram therefore has to be divided by the efficiencies (as opposed to
+  PoissonLogLikelihoodWithLinearModelForMeanAndProjData).
+
+  As decoding the list mode records has to be repeated for every subiteration, the decoded
+  events can be kept in memory (see ListModeEventCache) by using
+  \verbatim
+  cache decoded events := 1
+  \endverbatim
+  This needs 4 bytes per event (for the whole list mode file, and 4 more if the events
+  have weights), but avoids reading and decoding the list mode file after the set-up.
+
+  Events are read and processed in batches (see
+  compute_sub_gradient_without_penalty_plus_sensitivity()). The size of a batch
+  can be set with
+  \verbatim
+  number of events per batch := 100000
+  \endverbatim
 */
 
 template <typename TargetT>
@@ -93,17 +128,45 @@ protected:
   virtual Succeeded 
     set_up_before_sensitivity(shared_ptr <TargetT > const& target_sptr); 
  
-  // TODO
   virtual void
-    add_subset_sensitivity(TargetT& sensitivity, const int subset_num) const
-  {
-    error("add_subset_sensitivity not implemented yet");
-  }
+    add_subset_sensitivity(TargetT& sensitivity, const int subset_num) const;
+
+  //! describes the (uncompressed) scanner geometry and the projection matrix
+  virtual std::string get_sensitivity_cache_key_description() const;
+
+  //! Checks if a bin is in the subset
+  /*! This has to be consistent with the views used in add_subset_sensitivity(). */
+  bool is_bin_in_subset(const Bin& bin, const int subset_num) const;
   
   //! Maximum ring difference to take into account
   /*! \todo Might be removed */
   int  max_ring_difference_num_to_process;
 
+  //! Number of events that are read before they are processed (in parallel)
+  unsigned long num_events_per_batch;
+
+  //! If \c true, decoded events are stored in memory during set-up
+  bool cache_decoded_events;
+
+  //! Decoded events (only used if \c cache_decoded_events is \c true)
+  shared_ptr<ListModeEventCache> event_cache_sptr;
+
+  //! Read prompts of the current frame from the list mode data
+  /*! Only prompts in the subset are returned. Stops after \c num_events_per_batch prompts. 
+      \return \c false if the end of the frame (or the list mode data) was reached.
+
+      If the events are cached, \a record, \a current_time, \a start_time and \a end_time are
+      ignored. Instead, events \a cached_event_num up to \a end_cached_event_num are used, and
+      \a cached_event_num is advanced.
+  */
+  bool read_batch_of_events(std::vector<Bin>& measured_bins,
+                            std::vector<float>& additive_values,
+                            CListRecord& record,
+                            double& current_time,
+                            const double start_time, const double end_time,
+                            std::size_t& cached_event_num, const std::size_t end_cached_event_num,
+                            const int subset_num) const;
+
   //! Stores the projectors that are used for the computations
   shared_ptr<ProjMatrixByBin> PM_sptr;
   //shared_ptr<ProjectorByBinPair> projector_by_bin_pair;
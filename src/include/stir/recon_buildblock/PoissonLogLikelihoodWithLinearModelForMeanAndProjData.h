@@ -40,6 +40,7 @@
 START_NAMESPACE_STIR
 
 class DistributedCachingInformation;
+class SubsetScheme;
 
 //#ifdef STIR_MPI_CLASS_DEFINITION
 //#define PoissonLogLikelihoodWithLinearModelForMeanAndProjData PoissonLogLikelihoodWithLinearModelForMeanAndProjData_MPI
@@ -122,6 +123,9 @@ class DistributedCachingInformation;
   ; see BinNormalisation hierarchy for possible values
   Bin Normalisation type :=
 
+  ; see SubsetScheme hierarchy for possible values (defaults to Interleaved)
+  subset scheme type :=
+
   End PoissonLogLikelihoodWithLinearModelForMeanAndProjData Parameters :=
   \endverbatim
 */
@@ -194,6 +198,7 @@ public:
   const TimeFrameDefinitions& get_time_frame_definitions() const;
   const BinNormalisation& get_normalisation() const;
   const shared_ptr<BinNormalisation>& get_normalisation_sptr() const;
+  const shared_ptr<SubsetScheme>& get_subset_scheme_sptr() const;
   //@}
   /*! \name Functions to set parameters
     This can be used as alternative to the parsing mechanism.
@@ -213,6 +218,7 @@ public:
   void set_frame_num(const int);
   void set_frame_definitions(const TimeFrameDefinitions&);
   virtual void set_normalisation_sptr(const shared_ptr<BinNormalisation>&);
+  void set_subset_scheme_sptr(const shared_ptr<SubsetScheme>&);
 
   virtual void set_input_data(const shared_ptr<ExamData> &);
   //@}
@@ -229,10 +235,17 @@ public:
   virtual void
     add_subset_sensitivity(TargetT& sensitivity, const int subset_num) const;
 
+  //! as the sensitivity description, with the input and additive data and a hash of the measured data
+  /*! The hash is computed from all projection data that are used, so this reads all of them. */
+  virtual std::string get_approximate_Hessian_cache_key_description() const;
+
  protected:
   virtual Succeeded 
     set_up_before_sensitivity(shared_ptr <TargetT > const& target_sptr);
 
+  //! describes scanner geometry, segments used, projectors, normalisation and time frame
+  virtual std::string get_sensitivity_cache_key_description() const;
+
   virtual double
     actual_compute_objective_function_without_penalty(const TargetT& current_estimate,
                                                       const int subset_num);
@@ -262,6 +275,9 @@ public:
     \f[ P_{ij} = {1 \over n_i } G_{ij}\f]
 
     It has also been suggested to use \f$1 \over y_i+1 \f$ (at least if the data are still Poisson.
+
+    The computation is done by distributable_computation(), i.e. in parallel
+    when using OpenMP or MPI.
   */
   virtual Succeeded 
       actual_add_multiplication_with_approximate_sub_Hessian_without_penalty(TargetT& output,
@@ -321,6 +337,9 @@ protected:
 
   shared_ptr<BinNormalisation> normalisation_sptr;
 
+  //! determines which view/segment numbers are in each subset
+  shared_ptr<SubsetScheme> subset_scheme_sptr;
+
  // TODO doc
   int frame_num;
   std::string frame_definition_filename;
@@ -365,6 +384,7 @@ protected:
 //made available to be called from DistributedWorker object
 RPC_process_related_viewgrams_type RPC_process_related_viewgrams_gradient;
 RPC_process_related_viewgrams_type RPC_process_related_viewgrams_accumulate_loglikelihood;
+RPC_process_related_viewgrams_type RPC_process_related_viewgrams_approximate_Hessian;
 #endif
 
 END_NAMESPACE_STIR
@@ -0,0 +1,263 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details.
+*/
+/*!
+  \file
+  \ingroup priors
+  \brief Declaration of the potential functions for stir::NeighbourhoodPrior:
+  stir::HuberPotential, stir::LogCoshPotential and stir::RelativeDifferencePotential
+
+*/
+
+#ifndef __stir_recon_buildblock_PriorPotentials_H__
+#define __stir_recon_buildblock_PriorPotentials_H__
+
+#include "stir/KeyParser.h"
+#include "stir/warning.h"
+#include <cmath>
+#include <algorithm>
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup priors
+  \brief Huber potential
+
+  With \f$t\f$ the difference between the voxel and its neighbour
+  \f[
+  \psi(t) = t^2/2 \mbox{ if } |t|\le\delta, \quad \delta|t| - \delta^2/2 \mbox{ otherwise}
+  \f]
+  i.e. quadratic for small differences, and linear for large ones (which preserves edges).
+
+  \par Parsing
+  \verbatim
+  ; transition between the quadratic and linear part
+  delta := 1
+  \endverbatim
+*/
+template <typename elemT>
+class HuberPotential
+{
+public:
+  HuberPotential() { set_defaults(); }
+  explicit HuberPotential(const float delta) : delta(delta) {}
+
+  void set_defaults() { this->delta = 1.F; }
+  void initialise_keymap(KeyParser& parser) { parser.add_key("delta", &this->delta); }
+  //! \return \c true if the parameters are invalid (as ParsingObject::post_processing())
+  bool post_processing()
+  {
+    if (this->delta <= 0)
+      { warning("Huber potential: delta has to be positive"); return true; }
+    return false;
+  }
+
+  //! value of the potential for a voxel value \a centre and a neighbouring value \a neighbour
+  inline elemT value(const elemT centre, const elemT neighbour) const
+  {
+    const elemT t = std::abs(centre - neighbour);
+    return t <= this->delta ? t*t/2 : this->delta*(t - this->delta/2);
+  }
+  //! derivative of value() w.r.t. \a centre
+  inline elemT derivative_10(const elemT centre, const elemT neighbour) const
+  {
+    const elemT t = centre - neighbour;
+    return t > this->delta ? this->delta : (t < -this->delta ? -this->delta : t);
+  }
+  //! second derivative of value() w.r.t. \a centre
+  inline elemT derivative_20(const elemT centre, const elemT neighbour) const
+  {
+    return std::abs(centre - neighbour) <= this->delta ? elemT(1) : elemT(0);
+  }
+  //! derivative of value() w.r.t. \a centre and \a neighbour
+  inline elemT derivative_11(const elemT centre, const elemT neighbour) const
+  { return -this->derivative_20(centre, neighbour); }
+  //! curvature of the parabolic surrogate, i.e. derivative_10()/(centre-neighbour)
+  inline elemT surrogate_curvature(const elemT centre, const elemT neighbour) const
+  {
+    const elemT t = std::abs(centre - neighbour);
+    return t <= this->delta ? elemT(1) : this->delta/t;
+  }
+
+  float delta;
+};
+
+/*!
+  \ingroup priors
+  \brief Log-cosh potential
+
+  With \f$t\f$ the difference between the voxel and its neighbour
+  \f[
+  \psi(t) = \delta^2 \log\cosh(t/\delta)
+  \f]
+  which behaves as \f$t^2/2\f$ for small differences, and as \f$\delta|t|\f$ for large
+  ones, but is (unlike the Huber potential) infinitely differentiable.
+
+  \par Parsing
+  \verbatim
+  ; scale of the differences at the transition between quadratic and linear behaviour
+  delta := 1
+  \endverbatim
+*/
+template <typename elemT>
+class LogCoshPotential
+{
+public:
+  LogCoshPotential() { set_defaults(); }
+  explicit LogCoshPotential(const float delta) : delta(delta) {}
+
+  void set_defaults() { this->delta = 1.F; }
+  void initialise_keymap(KeyParser& parser) { parser.add_key("delta", &this->delta); }
+  bool post_processing()
+  {
+    if (this->delta <= 0)
+      { warning("Log-cosh potential: delta has to be positive"); return true; }
+    return false;
+  }
+
+  inline elemT value(const elemT centre, const elemT neighbour) const
+  {
+    // log(cosh(x)) = |x| + log(1+exp(-2|x|)) - log(2), which does not overflow
+    const elemT x = std::abs(centre - neighbour)/this->delta;
+    return this->delta*this->delta*
+      static_cast<elemT>(x + std::log(1 + std::exp(-2*x)) - 0.69314718055994530942);
+  }
+  inline elemT derivative_10(const elemT centre, const elemT neighbour) const
+  { return this->delta*std::tanh((centre - neighbour)/this->delta); }
+  inline elemT derivative_20(const elemT centre, const elemT neighbour) const
+  {
+    const elemT tanh_x = std::tanh((centre - neighbour)/this->delta);
+    return 1 - tanh_x*tanh_x;
+  }
+  inline elemT derivative_11(const elemT centre, const elemT neighbour) const
+  { return -this->derivative_20(centre, neighbour); }
+  inline elemT surrogate_curvature(const elemT centre, const elemT neighbour) const
+  {
+    const elemT x = (centre - neighbour)/this->delta;
+    // tanh(x)/x tends to 1 for small x
+    return std::abs(x) < 1.E-4F ? elemT(1) : std::tanh(x)/x;
+  }
+
+  float delta;
+};
+
+/*!
+  \ingroup priors
+  \brief Potential of the Relative Difference Prior
+
+  For a voxel value \f$\lambda_r\f$ and its neighbour \f$\lambda_n\f$
+  \f[
+  \phi(\lambda_r,\lambda_n) = {(\lambda_r - \lambda_n)^2 \over
+                               \lambda_r + \lambda_n + \gamma|\lambda_r - \lambda_n| + \epsilon}
+  \f]
+  See J. Nuyts et al., <i>A concave prior penalizing relative differences for
+  maximum-a-posteriori reconstruction in emission tomography</i>,
+  IEEE Trans. Nucl. Sci. 49 (2002) 56-60.
+
+  The images have to be non-negative. Pairs where the denominator is zero do not contribute.
+
+  \par Parsing
+  \verbatim
+  ; edge-preservation parameter
+  gamma := 2
+  ; small number to avoid division by zero
+  epsilon := 0
+  \endverbatim
+*/
+template <typename elemT>
+class RelativeDifferencePotential
+{
+public:
+  RelativeDifferencePotential() { set_defaults(); }
+  RelativeDifferencePotential(const float gamma, const float epsilon)
+    : gamma(gamma), epsilon(epsilon) {}
+
+  void set_defaults() { this->gamma = 2.F; this->epsilon = 0.F; }
+  void initialise_keymap(KeyParser& parser)
+  {
+    parser.add_key("gamma", &this->gamma);
+    parser.add_key("epsilon", &this->epsilon);
+  }
+  bool post_processing()
+  {
+    if (this->gamma < 0)
+      { warning("Relative difference potential: gamma has to be non-negative"); return true; }
+    if (this->epsilon < 0)
+      { warning("Relative difference potential: epsilon has to be non-negative"); return true; }
+    return false;
+  }
+
+  inline elemT value(const elemT centre, const elemT neighbour) const
+  {
+    const elemT diff = centre - neighbour;
+    const elemT denominator = this->denominator(centre, neighbour);
+    return denominator > 0 ? diff*diff/denominator : elemT(0);
+  }
+  inline elemT derivative_10(const elemT centre, const elemT neighbour) const
+  {
+    const elemT diff = centre - neighbour;
+    const elemT denominator = this->denominator(centre, neighbour);
+    return denominator > 0 ?
+      diff*(centre + 3*neighbour + this->gamma*std::abs(diff) + 2*this->epsilon)/(denominator*denominator) :
+      elemT(0);
+  }
+  inline elemT derivative_20(const elemT centre, const elemT neighbour) const
+  {
+    const elemT denominator = this->denominator(centre, neighbour);
+    const elemT factor = 2*neighbour + this->epsilon;
+    return denominator > 0 ? 2*factor*factor/(denominator*denominator*denominator) : elemT(0);
+  }
+  inline elemT derivative_11(const elemT centre, const elemT neighbour) const
+  {
+    const elemT denominator = this->denominator(centre, neighbour);
+    return denominator > 0 ?
+      -2*(2*centre + this->epsilon)*(2*neighbour + this->epsilon)/(denominator*denominator*denominator) :
+      elemT(0);
+  }
+  //! curvature of the parabolic surrogate
+  /*! The potential is not a function of the difference between \a centre and \a neighbour
+      only, so derivative_10()/(centre-neighbour) does not give a parabola that lies above
+      the potential. Instead, this returns the maximum of derivative_20() over all
+      non-negative values of the centre, i.e.
+      \f[ 2(2\lambda_n+\epsilon)^2 / (\min(1+\gamma,2)\lambda_n + \epsilon)^3 \f]
+      (the denominator of the potential is smallest for \f$\lambda_r=0\f$ or
+      \f$\lambda_r=\lambda_n\f$). This is a valid but conservative bound, which is
+      independent of \a centre. It is large for small neighbour values,
+      unless \c epsilon is positive.
+  */
+  inline elemT surrogate_curvature(const elemT centre, const elemT neighbour) const
+  {
+    const elemT min_denominator =
+      std::min(1 + this->gamma, 2.F)*neighbour + this->epsilon;
+    const elemT factor = 2*neighbour + this->epsilon;
+    return min_denominator > 0 ?
+      2*factor*factor/(min_denominator*min_denominator*min_denominator) :
+      elemT(0);
+  }
+
+  float gamma;
+  float epsilon;
+
+private:
+  inline elemT denominator(const elemT centre, const elemT neighbour) const
+  { return centre + neighbour + this->gamma*std::abs(centre - neighbour) + this->epsilon; }
+};
+
+END_NAMESPACE_STIR
+
+#endif
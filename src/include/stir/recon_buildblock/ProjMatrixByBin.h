@@ -39,6 +39,9 @@
 #include "stir/VectorWithOffset.h"
 #include "stir/TimedObject.h"
 #include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+#include <iosfwd>
 //#include <map>
 #include <boost/unordered_map.hpp>
 #ifdef STIR_OPENMP
@@ -60,6 +63,8 @@ class SubsetInfo;
 */
 	    
 class Bin;	    
+class ProjMatrixByBinCompressedCache;
+class ProjMatrixByBinConcurrentCache;
 	    
 /*!
 \ingroup projection
@@ -80,10 +85,20 @@ class Bin;
   \verbatim
   disable caching := false
   store only basic bins in cache := true
+  cache type := hash map
   \endverbatim
   The 2nd option allows to cache the whole matrix. This results in the fastest
   behaviour IF your system does not start swapping. The default choice caches 
   only the 'basic' bins, and computes symmetry related bins from the 'basic' ones.
+
+  The <tt>cache type</tt> selects how rows are stored in the cache:
+  - <tt>hash map</tt>: every row is stored as a ProjMatrixElemsForOneBin in a hash-table.
+  - <tt>compressed</tt>: rows are stored in a compact format in one arena per
+    (view,segment), see ProjMatrixByBinCompressedCache. This needs typically
+    3 times less memory, but values are stored with reduced precision. 
+  - <tt>concurrent</tt>: rows are stored once and never modified afterwards, see 
+    ProjMatrixByBinConcurrentCache. Lookups do not need a lock, which avoids
+    contention when using many OpenMP threads. 
 */
 class ProjMatrixByBin :  
   public RegisteredObject<ProjMatrixByBin>,  
@@ -122,6 +137,28 @@ public:
     get_proj_matrix_elems_for_one_bin(
        ProjMatrixElemsForOneBin&,
        const Bin&) STIR_MUTABLE_CONST;
+
+  //! Get the rows for all bins related to a basic bin
+  /*! 
+  \a related_rows is resized to the number of bins related to \a basic_bin
+  (within the range of axial and tangential positions, see 
+  DataSymmetriesForBins::get_related_bins). The row for the basic bin is obtained
+  only once (from the cache or via calculate_proj_matrix_elems_for_one_bin), 
+  after which a copy is transformed for each related bin. The bin of each row can be
+  found via ProjMatrixElemsForOneBin::get_bin().
+
+  This is much faster than calling get_proj_matrix_elems_for_one_bin() for 
+  every related bin when the cache is disabled or stores only basic bins, as there is
+  only 1 cache lookup (or calculation) and no search for the basic bin for each row.
+
+  \warning \a basic_bin has to be a 'basic' bin.
+  */
+  inline void
+    get_proj_matrix_elems_for_related_bins(
+       std::vector<ProjMatrixElemsForOneBin>& related_rows,
+       const Bin& basic_bin,
+       const int min_axial_pos_num, const int max_axial_pos_num,
+       const int min_tangential_pos_num, const int max_tangential_pos_num) STIR_MUTABLE_CONST;
   
 #if 0
   // TODO
@@ -149,6 +186,17 @@ public:
   bool is_cache_enabled() const;
   bool does_cache_store_only_basic_bins() const;
 
+  //! Different ways to store the cache
+  enum CacheType { hash_map_cache, compressed_cache, concurrent_cache };
+  //! Set the cache type
+  /*! \warning Has to be called before set_up() */
+  void set_cache_type(const CacheType);
+  CacheType get_cache_type() const;
+
+  //! Write statistics on cache usage to a stream
+  /*! Currently only the concurrent cache keeps statistics. */
+  void report_cache_statistics(std::ostream&) const;
+
   // void reserve_num_elements_in_cache(const std::size_t);
   //! Remove all elements from the cache
   void clear_cache() STIR_MUTABLE_CONST;
@@ -191,6 +239,7 @@ protected:
 
   bool cache_disabled;  
   bool cache_stores_only_basic_bins;
+  CacheType cache_type;
 
   /*! \brief The method that tries to get data from the cache.
   
@@ -227,6 +276,14 @@ private:
   VectorWithOffset<VectorWithOffset<omp_lock_t> > cache_locks;
 #endif
 
+  //! used for the compressed cache (allocated in set_up())
+  shared_ptr<ProjMatrixByBinCompressedCache> compressed_cache_sptr;
+  //! used for the concurrent cache (allocated in set_up())
+  shared_ptr<ProjMatrixByBinConcurrentCache> concurrent_cache_sptr;
+
+  //! variable used for parsing the cache type
+  std::string cache_type_name;
+
   //! create the key for caching
   // KT 15/05/2002 not static anymore as it uses cache_stores_only_basic_bins
   CacheKey cache_key(const Bin& bin) const;
@@ -15,6 +15,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2013, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -105,4 +106,53 @@ get_proj_matrix_elems_for_one_bin(
   // stop_timers(); TODO, can't do this in a const member
 }
 
+inline void
+ProjMatrixByBin::
+get_proj_matrix_elems_for_related_bins(
+                                       std::vector<ProjMatrixElemsForOneBin>& related_rows,
+                                       const Bin& basic_bin,
+                                       const int min_axial_pos_num, const int max_axial_pos_num,
+                                       const int min_tangential_pos_num, const int max_tangential_pos_num) STIR_MUTABLE_CONST
+{
+  assert(symmetries_ptr->is_basic(basic_bin));
+
+  std::vector<Bin> related_bins;
+  symmetries_ptr->get_related_bins(related_bins, basic_bin,
+                                   min_axial_pos_num, max_axial_pos_num,
+                                   min_tangential_pos_num, max_tangential_pos_num);
+  // note: resize keeps the capacity of the existing rows, so no reallocation when called repeatedly
+  related_rows.resize(related_bins.size());
+  if (related_bins.size() == 0)
+    return;
+
+  // get the basic row, and store it in the last element such that
+  // we do not need to copy it for the last related bin
+  ProjMatrixElemsForOneBin& basic_row = related_rows.back();
+  basic_row.erase();
+  basic_row.set_bin(basic_bin);
+  if (get_cached_proj_matrix_elems_for_one_bin(basic_row) ==
+      Succeeded::no)
+    {
+      calculate_proj_matrix_elems_for_one_bin(basic_row);
+#ifndef NDEBUG
+      basic_row.check_state();
+#endif
+      cache_proj_matrix_elems_for_one_bin(basic_row);
+    }
+  // the cached row might have a different bin value
+  basic_row.set_bin(basic_bin);
+
+  for (std::size_t i=0; i<related_bins.size(); ++i)
+    {
+      ProjMatrixElemsForOneBin& row = related_rows[i];
+      if (i+1 < related_bins.size())
+        row = basic_row;
+      Bin bin = related_bins[i];
+      std::auto_ptr<SymmetryOperation> symm_ptr = 
+        symmetries_ptr->find_symmetry_operation_from_basic_bin(bin);
+      assert(bin == basic_bin);
+      symm_ptr->transform_proj_matrix_elems_for_one_bin(row);
+    }
+}
+
 END_NAMESPACE_STIR
@@ -0,0 +1,149 @@
+//
+//
+#ifndef __stir_recon_buildblock_ProjMatrixByBinCompressedCache_H__
+#define __stir_recon_buildblock_ProjMatrixByBinCompressedCache_H__
+
+/*!
+  \file
+  \ingroup projection
+  \brief Declaration of class stir::ProjMatrixByBinCompressedCache
+
+*/
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/VectorWithOffset.h"
+#include <boost/cstdint.hpp>
+#include <vector>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+
+START_NAMESPACE_STIR
+
+class ProjDataInfo;
+class ProjMatrixElemsForOneBin;
+class DataSymmetriesForBins;
+class Succeeded;
+
+/*!
+  \ingroup projection
+  \brief A compact, read-mostly cache for rows of a ProjMatrixByBin
+
+  Rows are stored per (view, segment) 'slab' in one contiguous arena of 16-bit words,
+  together with an index into that arena. This avoids the per-row heap allocation and
+  hash-node overhead of the default cache.
+
+  The index only has an entry for rows that can be stored (i.e. basic bins when only
+  basic bins are cached). A bitmask over all (axial, tangential) positions of the slab,
+  with the number of set bits preceding every 32-bit word of the mask, maps a bin to its
+  entry.
+
+  Each row is encoded as follows:
+  - 2 words: number of elements
+  - 2 words: a scale factor (the largest absolute value in the row), omitted for empty rows
+  - a sequence of runs of elements with consecutive x-coordinates (and identical z and y).
+    Each run starts with 1 word with the run length (4 bits) and the (z,y,x) differences
+    of its first element to the previous element (2, 4 and 6 bits), or, if these do not
+    fit, an escape word with the run length (12 bits) followed by 3 words with the
+    absolute coordinates. This is followed by 1 word per element with the value divided
+    by the scale factor in IEEE half-precision.
+
+  For the rows of a ray tracing matrix, this typically takes about 3 bytes per element,
+  as opposed to 12 bytes plus allocation overhead for a ProjMatrixElemsForOneBin. The
+  price to pay is that values are only stored with a relative precision of about 5e-4.
+
+  When compiled with OpenMP, each slab has a lock which is used while the slab is being
+  filled. Once all rows expected for a slab are stored (i.e. all basic bins when only
+  basic bins are cached), the slab is marked as complete and lookups no longer take
+  the lock.
+*/
+class ProjMatrixByBinCompressedCache
+{
+public:
+  //! Construct an empty cache for the given projection data
+  explicit ProjMatrixByBinCompressedCache(const ProjDataInfo& proj_data_info);
+
+  ~ProjMatrixByBinCompressedCache();
+
+  //! Remove all elements from the cache
+  void clear();
+
+  //! Get a row from the cache (using the bin stored in the argument)
+  /*! If the row is found, \a probabilities is overwritten and Succeeded::yes is returned.
+      Otherwise, \a probabilities is not modified.
+  */
+  Succeeded get(ProjMatrixElemsForOneBin& probabilities) const;
+
+  //! Store a row in the cache
+  /*! If the row is already in the cache, nothing happens.
+
+      \a symmetries_ptr is used to find which rows are expected in a slab. If it is
+      zero, all bins are expected to be stored. Otherwise, only basic bins are, and
+      rows for other bins are not stored.
+  */
+  void insert(const ProjMatrixElemsForOneBin& probabilities,
+              const DataSymmetriesForBins * symmetries_ptr);
+
+  //! Number of bytes currently allocated by the cache (excluding the object itself)
+  std::size_t get_memory_usage_in_bytes() const;
+
+private:
+  typedef boost::uint16_t word_type;
+  typedef boost::uint32_t row_index_type;
+
+  //! storage for all rows of one (view, segment)
+  struct Slab
+  {
+    Slab();
+    int min_axial_pos_num;
+    int max_axial_pos_num;
+    int min_tangential_pos_num;
+    int max_tangential_pos_num;
+    //! one bit per (axial, tangential) position, set for rows that can be stored
+    std::vector<boost::uint32_t> mask;
+    //! number of bits set in \c mask before each of its words
+    std::vector<row_index_type> mask_rank;
+    //! position of each row that can be stored in \c data (or \c not_cached)
+    std::vector<row_index_type> row_start;
+    std::vector<word_type> data;
+    std::size_t num_rows_stored;
+    std::size_t num_rows_expected;
+    //! set when all expected rows are stored. \c data will not be modified afterwards.
+    volatile bool is_complete;
+  };
+
+  static const row_index_type not_cached;
+
+  VectorWithOffset<VectorWithOffset<Slab> > slabs;
+#ifdef STIR_OPENMP
+  mutable VectorWithOffset<VectorWithOffset<omp_lock_t> > locks;
+#endif
+
+  //! find the entry in \c row_start for a bin in the slab, returns \c not_cached if there is none
+  static row_index_type find_row_index(const Slab&, const int axial_pos_num, const int tangential_pos_num);
+  static void encode(std::vector<word_type>& data, const ProjMatrixElemsForOneBin&);
+  static void decode(ProjMatrixElemsForOneBin&, const word_type * data_ptr);
+
+  // the locks cannot be copied
+  ProjMatrixByBinCompressedCache(const ProjMatrixByBinCompressedCache&);
+  ProjMatrixByBinCompressedCache& operator=(const ProjMatrixByBinCompressedCache&);
+};
+
+END_NAMESPACE_STIR
+
+#endif
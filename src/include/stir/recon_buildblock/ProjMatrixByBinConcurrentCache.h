@@ -0,0 +1,163 @@
+//
+//
+#ifndef __stir_recon_buildblock_ProjMatrixByBinConcurrentCache_H__
+#define __stir_recon_buildblock_ProjMatrixByBinConcurrentCache_H__
+
+/*!
+  \file
+  \ingroup projection
+  \brief Declaration of class stir::ProjMatrixByBinConcurrentCache
+
+*/
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/VectorWithOffset.h"
+#include <vector>
+#include <iosfwd>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+
+START_NAMESPACE_STIR
+
+class Bin;
+class ProjDataInfo;
+class ProjMatrixElemsForOneBin;
+class Succeeded;
+
+/*!
+  \ingroup projection
+  \brief An insert-once, read-many cache for rows of a ProjMatrixByBin
+
+  Every (view, segment) has a 'bucket' with one slot per axial and tangential position. A slot
+  holds a pointer to a row which is never modified after it has been put in the cache.
+  Rows (and the array of slots of a bucket) are published by an atomic write of the pointer,
+  such that readers never need to take a lock. A lock is only taken when inserting a row
+  (and then only for the bucket of that row), in order to decide which thread wins
+  when 2 threads compute the same row.
+
+  For each bucket, the number of inserts and contentions is counted while holding its lock.
+  Hits and misses are counted per thread and per bucket, in memory that is only written by
+  that thread, such that readers do not write to shared memory. All counters are summed over
+  the threads on request, see Statistics, get_statistics() and get_total_statistics(). They can
+  be printed with report_statistics().
+*/
+class ProjMatrixByBinConcurrentCache
+{
+public:
+  //! counters of the cache
+  struct Statistics
+  {
+    Statistics();
+    //! number of times a row was found in the cache
+    unsigned long num_hits;
+    //! number of times a row was not found in the cache
+    unsigned long num_misses;
+    //! number of rows inserted
+    unsigned long num_inserts;
+    //! number of times a row was inserted when another thread had already done this
+    unsigned long num_duplicate_inserts;
+    //! number of times a thread had to wait for the lock of the bucket when inserting
+    unsigned long num_lock_contentions;
+
+    Statistics& operator+=(const Statistics&);
+  };
+
+  //! Construct an empty cache for the given projection data
+  explicit ProjMatrixByBinConcurrentCache(const ProjDataInfo& proj_data_info);
+
+  ~ProjMatrixByBinConcurrentCache();
+
+  //! Remove all elements from the cache (and reset the statistics)
+  /*! \warning This function is not thread-safe. */
+  void clear();
+
+  //! Get a row from the cache (using the bin stored in the argument)
+  /*! If the row is found, \a probabilities is overwritten and Succeeded::yes is returned.
+      Otherwise, \a probabilities is not modified.
+  */
+  Succeeded get(ProjMatrixElemsForOneBin& probabilities) const;
+
+  //! Store a row in the cache
+  /*! If the row is already in the cache, nothing happens (aside from updating the statistics).
+  */
+  void insert(const ProjMatrixElemsForOneBin& probabilities);
+
+  //! Get the counters for one bucket (summed over all threads)
+  /*! \warning This function is not thread-safe. */
+  Statistics get_statistics(const int view_num, const int segment_num) const;
+
+  //! Get the counters summed over all buckets and threads
+  /*! \warning This function is not thread-safe. */
+  Statistics get_total_statistics() const;
+
+  //! Write a summary of the statistics to a stream
+  void report_statistics(std::ostream&) const;
+
+private:
+  typedef ProjMatrixElemsForOneBin* slot_type;
+
+  struct Bucket
+  {
+    Bucket();
+    int min_axial_pos_num;
+    int max_axial_pos_num;
+    int min_tangential_pos_num;
+    int max_tangential_pos_num;
+    //! array of slots, allocated at the first insert
+    slot_type * slots;
+  };
+
+  //! number of hits and misses of one bucket
+  struct HitMissCounters
+  {
+    HitMissCounters();
+    unsigned long num_hits;
+    unsigned long num_misses;
+  };
+
+  VectorWithOffset<VectorWithOffset<Bucket> > buckets;
+  //! counters for inserts and contentions (only modified while holding the lock of the bucket)
+  VectorWithOffset<VectorWithOffset<Statistics> > statistics;
+  //! counters for hits and misses, for every thread one per bucket (see get_bucket_index())
+  /*! The counters of every thread are allocated separately, such that threads do not write
+      to the same memory. */
+  mutable std::vector<std::vector<HitMissCounters> > thread_counters;
+  //! counters for threads whose number is too large for \c thread_counters (updated atomically)
+  mutable std::vector<HitMissCounters> overflow_thread_counters;
+#ifdef STIR_OPENMP
+  VectorWithOffset<VectorWithOffset<omp_lock_t> > locks;
+#endif
+
+  //! returns 0 if the bin is out of range
+  static slot_type * find_slot(slot_type * slots, const Bucket& bucket, const Bin& bin);
+
+  //! index of the bucket in the hit and miss counters
+  std::size_t get_bucket_index(const int view_num, const int segment_num) const;
+
+  //! increment the number of hits or misses of a bucket for the current thread
+  void count_hit_or_miss(const bool hit, const std::size_t bucket_index) const;
+
+  // the locks cannot be copied
+  ProjMatrixByBinConcurrentCache(const ProjMatrixByBinConcurrentCache&);
+  ProjMatrixByBinConcurrentCache& operator=(const ProjMatrixByBinConcurrentCache&);
+};
+
+END_NAMESPACE_STIR
+
+#endif
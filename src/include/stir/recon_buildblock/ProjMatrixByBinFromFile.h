@@ -2,6 +2,7 @@
 //
 /*
     Copyright (C) 2004- 2008, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -34,9 +35,10 @@
 #include "stir/CartesianCoordinate3D.h"
 #include "stir/IndexRange.h"
 #include "stir/shared_ptr.h"
+#include <boost/cstdint.hpp>
 #include <iostream>
 
- 
+namespace boost { namespace interprocess { class mapped_region; } }
 
 START_NAMESPACE_STIR
 
@@ -46,10 +48,25 @@ class Bin;
   \ingroup projection
   \brief Reads/writes a projection matrix from/to file
 
-  The only supported file format consists of an Interfile-type header
+  The file format consists of an Interfile-type header
   and a binary file which stores the 'basic' elements in a sparse form, 
   i.e. only the elements that cannot by constructed via symmetries.
 
+  Two versions of the binary file are supported:
+  - Version 1.0 stores a sequence of rows, each preceded by its bin coordinates.
+    The whole file is read into the cache in set_up().
+  - Version 2.0 starts with a small header (with a hash of the scanner, projection
+    data and image geometry), followed by all elements (in the same layout as
+    in memory) and a sorted index of the rows. By default, this file is mapped
+    into memory (using boost::interprocess) such that rows are found with a binary
+    search and copied straight from the mapping. The operating system then shares a
+    single copy of the matrix between all processes on the same machine that use
+    it. In this case, the cache of ProjMatrixByBin is disabled. 
+    Set <tt>use memory mapping</tt> to 0 to read the matrix into the cache instead.
+
+  The binary file of version 2.0 is written in native byte order. It can only be
+  read on a machine with the same byte order.
+
   \todo this class currently only works with VoxelsOnCartesianGrid. 
   To fix this, we would need a DiscretisedDensityInfo class, and be able
   to have constructed the appropriate symmetries object by parsing the
@@ -58,7 +75,8 @@ class Bin;
   \par Example .par file
   \verbatim
     ProjMatrixByBinFromFile Parameters:=
-      Version := 1.0
+      ; 1.0 or 2.0
+      Version := 2.0
       symmetries type := PET_CartesianGrid
         PET_CartesianGrid symmetries parameters:=
 	  do_symmetry_90degrees_min_phi:= <bool>
@@ -73,6 +91,8 @@ class Bin;
       template density filename:= <filename>
       ; binary data with projection matrix elements
       data_filename:=<filename> 
+      ; only for version 2.0
+      use memory mapping := 1
      End ProjMatrixByBinFromFile Parameters:=
   \endverbatim
 */
@@ -92,12 +112,16 @@ public :
   /*! Currently this will write an interfile-type header, a file with the binary data,
       a template image and template sinogram. You will need all 4 to be able to read the
       matrix back in.
+
+      \a format_version has to be 1 or 2. When compiled with OpenMP, rows are computed
+      in parallel.
   */
 static Succeeded
   write_to_file(const std::string& output_filename_prefix, 
 		const ProjMatrixByBin& proj_matrix,
 		const shared_ptr<ProjDataInfo>& proj_data_info_sptr,
-		const DiscretisedDensity<3,float>& template_density);
+		const DiscretisedDensity<3,float>& template_density,
+		const int format_version = 2);
  
   //! Default constructor (calls set_defaults())
   ProjMatrixByBinFromFile();
@@ -132,6 +156,15 @@ private:
 
   shared_ptr<ProjDataInfo> proj_data_info_ptr;
 
+  //! only used for version 2.0
+  bool use_memory_mapping;
+  //! memory mapped data file (only used for version 2.0)
+  shared_ptr<boost::interprocess::mapped_region> mapped_region_sptr;
+  //! pointer to the start of the mapped file (offsets in the index are relative to this)
+  const char * mapped_elements_ptr;
+  //! pointer to the start of the index in the mapped file
+  const void * mapped_index_ptr;
+  boost::uint64_t num_mapped_rows;
 
   virtual void 
     calculate_proj_matrix_elems_for_one_bin(
@@ -142,6 +175,8 @@ private:
   virtual bool post_processing();
 
   Succeeded read_data();
+  //! read version 2.0 file (map it, and if necessary copy it to the cache)
+  Succeeded read_data_version_2();
     
 };
 
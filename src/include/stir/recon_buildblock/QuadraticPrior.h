@@ -2,6 +2,7 @@
 //
 /*
     Copyright (C) 2000- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -61,6 +62,9 @@ START_NAMESPACE_STIR
 
   By default, a 3x3 or 3x3x3 neigbourhood is used where the weights are set to 
   x-voxel_size divided by the Euclidean distance between the points.
+
+  The sums over the neighbourhood are computed with NeighbourhoodStencil, i.e. row by row
+  (in parallel over planes when using OpenMP).
  
   \par Parsing
   These are the keywords that can be used in addition to the ones in GeneralPrior.
@@ -0,0 +1,76 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Declaration of class stir::SubsetScheme
+*/
+
+#ifndef __stir_recon_buildblock_SubsetScheme_H__
+#define __stir_recon_buildblock_SubsetScheme_H__
+
+#include "stir/RegisteredObject.h"
+#include "stir/ViewSegmentNumbers.h"
+#include <vector>
+
+START_NAMESPACE_STIR
+
+class ProjDataInfo;
+class DataSymmetriesForViewSegmentNumbers;
+
+/*!
+  \ingroup recon_buildblock
+  \brief Abstract base class for the ways of dividing projection data into subsets
+
+  A subset is a list of view/segment numbers which are 'basic' w.r.t. the symmetries.
+  Processing a subset means processing these view/segment numbers together with all
+  their related view/segment numbers. Every basic view/segment number (in the segment range)
+  has to be in exactly one subset.
+
+  The order of the list is the order in which distributable_computation() hands out the
+  related viewgrams to the threads or MPI slaves.
+
+  Derived classes have to make sure that the result only depends on the arguments, as the
+  same subset is constructed several times (e.g. for the sensitivity and for the gradient).
+
+  \par Parameters for parsing
+  \verbatim
+  subset scheme type := Interleaved
+  \endverbatim
+  see the derived classes for possible values.
+*/
+class SubsetScheme : public RegisteredObject<SubsetScheme>
+{
+public:
+  virtual ~SubsetScheme();
+
+  //! construct the list of basic view/segment numbers in a subset
+  /*! \a min_segment_num and \a max_segment_num have to be such that the symmetries map this
+      range onto itself.
+  */
+  virtual std::vector<ViewSegmentNumbers>
+    find_basic_vs_nums_in_subset(const ProjDataInfo& proj_data_info,
+                                 const DataSymmetriesForViewSegmentNumbers& symmetries,
+                                 const int min_segment_num, const int max_segment_num,
+                                 const int subset_num, const int num_subsets) const = 0;
+};
+
+END_NAMESPACE_STIR
+
+#endif
@@ -0,0 +1,104 @@
+//
+//
+#ifndef __stir_recon_buildblock_ThreadLocalImages_H__
+#define __stir_recon_buildblock_ThreadLocalImages_H__
+
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Declaration of class stir::ThreadLocalImages
+
+*/
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/DiscretisedDensity.h"
+#include "stir/shared_ptr.h"
+#include <vector>
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup recon_buildblock
+  \brief Images for every thread to accumulate in, and their (parallel) reduction
+
+  When several threads back project into the same image, every thread needs its own
+  image, which have to be added at the end. This class manages these images:
+  - thread 0 accumulates directly in the target image, such that 1 copy is saved
+    (this means that the result is added to the current content of the target);
+  - the image of another thread is only allocated when that thread calls get_local_image()
+    (so threads that do not get any work do not use any memory);
+  - reduce() adds the images to the target in parallel, without locks. Every thread
+    handles a set of rows of the target image (tiles), adding the images of all threads
+    in the order of the thread number. The result therefore does not depend on the
+    number of threads used for the reduction. The thread-local images are then freed.
+
+  Without OpenMP, get_local_image() simply returns the target and reduce() does nothing.
+
+  \par Memory usage
+  Every thread other than thread 0 that gets work allocates a complete image, so this
+  needs up to (number of threads - 1) extra images. Allocating only the parts of the
+  image that a thread writes to (e.g. per tile) is not possible, as a back projector can
+  write anywhere in the DiscretisedDensity it is given. If this is too much memory,
+  reduce the number of threads (e.g. with \c OMP_NUM_THREADS).
+
+  \par Usage
+  \code
+  ThreadLocalImages local_images(image);
+  #pragma omp parallel for
+  for (int i=0; i<num; ++i)
+    back_projector.back_project(local_images.get_local_image(), ...);
+  local_images.reduce();
+  \endcode
+
+  \warning The object has to be constructed outside a parallel region, after the number
+  of threads has been set.
+*/
+class ThreadLocalImages
+{
+public:
+  //! Set up for the maximum number of threads
+  /*! \a target has to exist until reduce() is called. */
+  explicit ThreadLocalImages(DiscretisedDensity<3,float>& target);
+
+  //! Get the image for the current thread to accumulate in
+  /*! This can be called by all threads at the same time. The image of a thread
+      other than thread 0 is allocated (and filled with 0) at the first call. */
+  DiscretisedDensity<3,float>& get_local_image();
+
+  //! Get the image with the given number to accumulate in
+  /*! This is useful when the work is divided in parts that are not tied to a thread
+      (e.g. OpenMP tasks), but should go to the same image independent of which thread
+      processes them. \a image_num has to be less than the maximum number of threads,
+      and image 0 is the target. The caller has to make sure that an image is not used
+      by several threads at the same time.
+  */
+  DiscretisedDensity<3,float>& get_local_image(const int image_num);
+
+  //! Add all images of the threads to the target, and free them
+  /*! This has to be called outside a parallel region. */
+  void reduce();
+
+private:
+  DiscretisedDensity<3,float>& target;
+  //! images 1,2,...; element 0 is unused
+  std::vector<shared_ptr<DiscretisedDensity<3,float> > > local_image_sptrs;
+};
+
+END_NAMESPACE_STIR
+
+#endif
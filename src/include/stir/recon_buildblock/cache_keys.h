@@ -0,0 +1,118 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details.
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Functions to construct the keys of on-disk caches of images
+  (such as the sensitivity cache of stir::PoissonLogLikelihoodWithLinearModelForMean)
+
+  A cache entry is identified by a text description of everything the cached
+  image depends on. The name of its key file is derived from a hash of this
+  description, and the key file contains the description itself, such that
+  hash collisions can be detected.
+*/
+
+#ifndef __stir_recon_buildblock_cache_keys_H__
+#define __stir_recon_buildblock_cache_keys_H__
+
+#include "stir/DiscretisedDensity.h"
+#include "stir/DiscretisedDensityOnCartesianGrid.h"
+#include "stir/stream.h"
+#include "boost/cstdint.hpp"
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstddef>
+
+START_NAMESPACE_STIR
+
+//! 64-bit FNV-1a hash of a sequence of bytes
+/*! \ingroup recon_buildblock
+    Pass the result as \a hash to a next call to hash more data.
+*/
+inline boost::uint64_t
+hash_bytes(const void * const data, const std::size_t num_bytes,
+           boost::uint64_t hash = 14695981039346656037ULL)
+{
+  const unsigned char * const bytes = static_cast<const unsigned char *>(data);
+  for (std::size_t i=0; i<num_bytes; ++i)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+//! 64-bit FNV-1a hash of a string
+/*! \ingroup recon_buildblock */
+inline boost::uint64_t
+hash_string(const std::string& str)
+{
+  return str.empty() ? hash_bytes(0, 0) : hash_bytes(&str[0], str.size());
+}
+
+//! text with the geometry of an image, used for cache keys
+/*! \ingroup recon_buildblock */
+template <typename elemT>
+inline std::string
+get_geometry_description(const DiscretisedDensity<3,elemT>& density)
+{
+  std::ostringstream s;
+  s << "origin := " << density.get_origin() << '\n';
+  const DiscretisedDensityOnCartesianGrid<3,elemT>* const cartesian_density_ptr =
+    dynamic_cast<const DiscretisedDensityOnCartesianGrid<3,elemT>*>(&density);
+  if (cartesian_density_ptr != 0)
+    s << "grid spacing := " << cartesian_density_ptr->get_grid_spacing() << '\n';
+  BasicCoordinate<3,int> min_indices, max_indices;
+  if (density.get_regular_range(min_indices, max_indices))
+    s << "index range := " << min_indices << ' ' << max_indices << '\n';
+  else
+    {
+      s << "index range :=";
+      for (int z=density.get_min_index(); z<=density.get_max_index(); ++z)
+        {
+          s << ' ' << z << ':';
+          for (int y=density[z].get_min_index(); y<=density[z].get_max_index(); ++y)
+            s << ' ' << y << '(' << density[z][y].get_min_index() << ',' << density[z][y].get_max_index() << ')';
+        }
+      s << '\n';
+    }
+  return s.str();
+}
+
+//! name of the key file of a cache entry
+/*! \ingroup recon_buildblock
+    \return \a directory/\a prefix_<hash of description>_key.txt
+*/
+inline std::string
+get_cache_key_filename(const std::string& directory, const std::string& prefix,
+                       const std::string& description)
+{
+  std::ostringstream name;
+  name << directory;
+  if (!directory.empty() && *directory.rbegin() != '/')
+    name << '/';
+  name << prefix << '_' << std::hex << std::setfill('0') << std::setw(16)
+       << hash_string(description) << "_key.txt";
+  return name.str();
+}
+
+END_NAMESPACE_STIR
+
+#endif
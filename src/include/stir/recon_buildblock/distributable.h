@@ -1,7 +1,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000 - 2011, Hammersmith Imanet Ltd
-    Copyright (C) 2013, University College London
+    Copyright (C) 2013, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -47,6 +47,7 @@ class ForwardProjectorByBin;
 class BackProjectorByBin;
 class ProjectorByBinPair;
 class DistributedCachingInformation;
+class SubsetScheme;
 
 
 //! \name Task-ids currently understood by stir::DistributedWorker
@@ -57,12 +58,14 @@ const int task_setup_distributable_computation=200;
 const int task_do_distributable_gradient_computation=42;
 const int task_do_distributable_loglikelihood_computation=43;
 const int task_do_distributable_sensitivity_computation=44;
+const int task_do_distributable_approximate_Hessian_computation=45;
 //!@}
 
 //! set-up parameters before calling distributable_computation()
 /*!
     \ingroup distributable
-    Empty unless STIR_MPI is defined, in which case it sends parameters to the 
+    Sets the number of threads and forgets the times measured by previous calls to
+    distributable_computation(). If STIR_MPI is defined, it also sends parameters to the
     slaves (see stir::DistributedWorker).
 
     \todo currently uses some global variables for configuration in the distributed
@@ -113,7 +116,15 @@ typedef  void RPC_process_related_viewgrams_type (
 
   If STIR_MPI is defined, this function distributes the computation over the slaves.
 
-  Subsets are currently defined on views. A particular \a subset_num contains all views  which are symmetry related to 
+  The basic view/segment numbers in a subset are determined by \a subset_scheme, see
+  SubsetScheme. They are processed in order of decreasing estimated cost, using the
+  times measured during previous calls with the same \a RPC_process_related_viewgrams
+  (see DistributableScheduler). With OpenMP, threads whose tasks are finished steal tasks
+  from the other threads when possible, and the idle time of every thread is reported
+  (with verbosity 2 or higher). Calls with the same \a RPC_process_related_viewgrams share
+  a scheduler, and should therefore not run at the same time.
+  For instance, with InterleavedSubsetScheme
+  (in natural order), a particular \a subset_num contains all views which are symmetry related to
   \code 
   proj_data_ptr->min_view_num()+subset_num + n*num_subsets
   \endcode
@@ -137,6 +148,7 @@ typedef  void RPC_process_related_viewgrams_type (
          ProjData::get_empty_related_viewgrams is used.
   \param subset_num the number of the current subset (see above). Should be between 0 and num_subsets-1.
   \param num_subsets the number of subsets to consider. 1 will process all data.
+  \param subset_scheme determines which view/segment numbers are in the subset.
   \param min_segment_num Minimum segment_num to process.
   \param max_segment_num Maximum segment_num to process.
   \param zero_seg0_end_planes if true, the end planes for segment_num=0 in measured_viewgrams_ptr
@@ -157,8 +169,6 @@ typedef  void RPC_process_related_viewgrams_type (
   This usually means that \a min_segment_num = -\a max_segment_num. This assumption is checked with 
   assert().
 
-  \todo The subset-scheme should be moved somewhere else (a Subset class?).
-
   \warning If STIR_MPI is defined, there can only be one set_up active, as the 
   slaves use only one set of variabiles to store projectors etc.
 
@@ -173,6 +183,7 @@ void distributable_computation(
                                const shared_ptr<ProjData>& proj_data_ptr,
                                const bool read_from_proj_data,
                                int subset_num, int num_subsets,
+                               const SubsetScheme& subset_scheme,
                                int min_segment_num, int max_segment_num,
                                bool zero_seg0_end_planes,
                                double* double_out_ptr,
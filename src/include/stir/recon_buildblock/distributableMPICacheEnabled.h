@@ -39,6 +39,7 @@
 START_NAMESPACE_STIR
 
 class DistributedCachingInformation;
+class SubsetScheme;
 
 
 //!@{
@@ -65,6 +66,7 @@ void distributable_computation_cache_enabled(
                                              const shared_ptr<ProjData>& proj_data_sptr, 
                                              const bool read_from_proj_data,
                                              int subset_num, int num_subsets,
+                                             const SubsetScheme& subset_scheme,
                                              int min_segment_num, int max_segment_num,
                                              bool zero_seg0_end_planes,
                                              double*  double_out_ptr,
@@ -0,0 +1,79 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details.
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Functions to read and write images in an on-disk cache
+  (such as the sensitivity cache of stir::PoissonLogLikelihoodWithLinearModelForMean
+  and the precomputed denominator cache of stir::OSSPSReconstruction)
+
+  A cache entry consists of a key file (see get_cache_key_filename()) and one or more
+  images. The key file contains the number of images, their filenames (one per line)
+  and the description of the entry. It is written after the images, such that an
+  incomplete cache entry is never used.
+*/
+
+#ifndef __stir_recon_buildblock_image_cache_H__
+#define __stir_recon_buildblock_image_cache_H__
+
+#include "stir/shared_ptr.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+
+START_NAMESPACE_STIR
+
+class Succeeded;
+
+//! read the images of a cache entry, if its description matches
+/*! \ingroup recon_buildblock
+    \param image_sptrs is only modified if all images could be read
+    \param key_filename name of the key file of the entry
+    \param description has to be identical to the description in the key file
+    \param target every image has to have the same characteristics as \a target
+    \param num_images number of images the entry should have
+    \param name is used in messages (e.g. "sensitivity")
+    \return Succeeded::no if there is no such entry, or if it does not match (in which
+    case a warning is written).
+*/
+template <class TargetT>
+inline Succeeded
+read_images_from_cache(std::vector<shared_ptr<TargetT> >& image_sptrs,
+                       const std::string& key_filename,
+                       const std::string& description,
+                       const TargetT& target,
+                       const std::size_t num_images,
+                       const std::string& name);
+
+//! write images and the key file of a cache entry
+/*! \ingroup recon_buildblock
+    The images are written with the default output file format, with filenames
+    derived from \a key_filename.
+*/
+template <class TargetT>
+inline Succeeded
+write_images_to_cache(const std::string& key_filename,
+                      const std::string& description,
+                      const std::vector<shared_ptr<TargetT> >& image_sptrs);
+
+END_NAMESPACE_STIR
+
+#include "stir/recon_buildblock/image_cache.inl"
+
+#endif
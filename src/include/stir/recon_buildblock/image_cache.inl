@@ -0,0 +1,135 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details.
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Implementation of functions to read and write images in an on-disk cache
+*/
+
+#include "stir/IO/read_from_file.h"
+#include "stir/IO/write_to_file.h"
+#include "stir/Succeeded.h"
+#include "stir/info.h"
+#include "stir/warning.h"
+#include "boost/format.hpp"
+#include <fstream>
+#include <iterator>
+#include <exception>
+
+START_NAMESPACE_STIR
+
+template <class TargetT>
+Succeeded
+read_images_from_cache(std::vector<shared_ptr<TargetT> >& image_sptrs,
+                       const std::string& key_filename,
+                       const std::string& description,
+                       const TargetT& target,
+                       const std::size_t num_images,
+                       const std::string& name)
+{
+  std::ifstream key_file(key_filename.c_str());
+  if (!key_file)
+    return Succeeded::no;
+
+  std::size_t num_files = 0;
+  key_file >> num_files;
+  key_file.ignore(1);
+  std::vector<std::string> filenames;
+  if (key_file && num_files == num_images)
+    {
+      filenames.resize(num_files);
+      for (std::size_t i=0; i<num_files; ++i)
+        std::getline(key_file, filenames[i]);
+    }
+  const std::string description_in_file((std::istreambuf_iterator<char>(key_file)),
+                                         std::istreambuf_iterator<char>());
+  if (filenames.size() != num_images || description_in_file != description)
+    {
+      warning(boost::format("Cache file '%1%' for the %2% does not match the current settings. Ignored.") %
+              key_filename % name);
+      return Succeeded::no;
+    }
+
+  std::vector<shared_ptr<TargetT> > new_image_sptrs(num_files);
+  try
+    {
+      for (std::size_t i=0; i<num_files; ++i)
+        {
+          info(boost::format("Reading %1% from '%2%'") % name % filenames[i]);
+          new_image_sptrs[i].reset(read_from_file<TargetT>(filenames[i]).release());
+          std::string explanation;
+          if (!target.has_same_characteristics(*new_image_sptrs[i], explanation))
+            {
+              warning(boost::format("The %1% in the cache does not have the same characteristics as the target. Ignored.\n%2%") %
+                      name % explanation);
+              return Succeeded::no;
+            }
+        }
+    }
+  catch (std::exception& e)
+    {
+      warning(boost::format("Error reading the %1% from the cache. Ignored.\n%2%") % name % e.what());
+      return Succeeded::no;
+    }
+  catch (std::string&)
+    {
+      // error() was called, but it has already written a message
+      return Succeeded::no;
+    }
+  image_sptrs.swap(new_image_sptrs);
+  return Succeeded::yes;
+}
+
+template <class TargetT>
+Succeeded
+write_images_to_cache(const std::string& key_filename,
+                      const std::string& description,
+                      const std::vector<shared_ptr<TargetT> >& image_sptrs)
+{
+  const std::string prefix =
+    key_filename.substr(0, key_filename.size() - std::string("_key.txt").size());
+  std::vector<std::string> filenames;
+  try
+    {
+      for (std::size_t i=0; i<image_sptrs.size(); ++i)
+        filenames.push_back(write_to_file(image_sptrs.size() == 1
+                                          ? prefix
+                                          : boost::str(boost::format("%1%_%2%") % prefix % i),
+                                          *image_sptrs[i]));
+    }
+  catch (std::exception& e)
+    {
+      warning("%s", e.what());
+      return Succeeded::no;
+    }
+  catch (std::string&)
+    {
+      return Succeeded::no;
+    }
+
+  // write the key file last, such that an incomplete cache entry is never used
+  std::ofstream key_file(key_filename.c_str());
+  key_file << filenames.size() << '\n';
+  for (std::size_t i=0; i<filenames.size(); ++i)
+    key_file << filenames[i] << '\n';
+  key_file << description;
+  return key_file ? Succeeded::yes : Succeeded::no;
+}
+
+END_NAMESPACE_STIR
@@ -2,6 +2,7 @@
 //
 /*
     Copyright (C) 2000- 2007, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -30,6 +31,7 @@
 */
 
 #include "stir/min_positive_element.h"
+#include "stir/elementwise_kernels.h"
 #include <algorithm>
 
 START_NAMESPACE_STIR
@@ -63,6 +65,16 @@ threshold_upper_lower(forw_iterT begin, forw_iterT end,
     }
 }
 
+//! Threshold a contiguous sequence of floats from above and below
+/*! This uses elementwise_threshold_upper_lower(). */
+inline void
+threshold_upper_lower(float * const begin, float * const end,
+		      const float new_min, const float new_max)
+{
+  elementwise_threshold_upper_lower(begin, static_cast<std::size_t>(end - begin),
+                                    new_min, new_max);
+}
+
 //! Threshold a sequence from above
 /*! 
   \see threshold_upper_lower for type requirements */
@@ -4,6 +4,7 @@
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000 - 2011-12-31, Hammersmith Imanet Ltd
     Copyright (C) 2012-06-05 - 2012, Kris Thielemans
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -39,7 +40,6 @@
 #include "stir/ThresholdMinToSmallPositiveValueDataProcessor.h"
 #include "stir/ChainedDataProcessor.h"
 #include "stir/Succeeded.h"
-#include "stir/numerics/divide.h"
 #include "stir/thresholding.h"
 #include "stir/is_null_ptr.h"
 #include "stir/NumericInfo.h"
@@ -48,6 +48,7 @@
 #include "stir/DataSymmetriesForViewSegmentNumbers.h"
 #include "stir/ViewSegmentNumbers.h"
 #include "stir/info.h"
+#include "stir/error.h"
 
 #include "stir/modelling/ParametricDiscretisedDensity.h"
 #include "stir/modelling/KineticParameters.h"
@@ -61,10 +62,12 @@
 #endif
 
 #include <algorithm>
+#include <vector>
+#include <limits>
+#include <cmath>
 using std::min;
 using std::max;
 #ifndef STIR_NO_NAMESPACES
-using std::auto_ptr;
 using std::cerr;
 using std::endl;
 #endif
@@ -388,6 +391,155 @@ set_up(shared_ptr <TargetT > const& target_image_ptr)
 
 
 
+namespace
+{
+  //! how the prior gradient enters the denominator of the OSMAPOSL update
+  enum MAP_form { no_prior, additive_prior, multiplicative_prior };
+
+  //! parameters for fused_update()
+  struct FusedUpdateParameters
+  {
+    MAP_form form;
+    int num_subsets;
+    //! elements where numerator and denominator are both smaller than this are set to 0 (as in divide())
+    float small_value;
+    bool threshold;
+    float new_min;
+    float new_max;
+  };
+
+  /* Computes the multiplicative update for a range of elements and multiplies the
+     estimate with it.
+
+     On input, the update has to contain the numerator (i.e. the sub-gradient plus
+     the subset sensitivity). On output, it contains the update before
+     thresholding, such that it can still be written to file.
+     The minimum and maximum of this (unthresholded) update are returned as well.
+
+     \a prior_gradient_iter is not used when \a par.form is \c no_prior.
+
+     This does the same as the separate calls to divide(), threshold_upper_lower()
+     and the multiplication that were used before, but with a single pass over the data.
+  */
+  template <class UpdateIterT, class ConstIterT, class EstimateIterT>
+  void
+  fused_update(UpdateIterT update_iter, const UpdateIterT update_end,
+               ConstIterT sensitivity_iter, ConstIterT prior_gradient_iter,
+               EstimateIterT estimate_iter,
+               const FusedUpdateParameters& par,
+               float& current_min, float& current_max)
+  {
+    current_min = std::numeric_limits<float>::max();
+    current_max = -std::numeric_limits<float>::max();
+    for (; update_iter != update_end; ++update_iter, ++sensitivity_iter, ++estimate_iter)
+      {
+        const float sensitivity = *sensitivity_iter;
+        float denominator = sensitivity;
+        if (par.form == additive_prior)
+          {
+            // lambda_new = lambda / (p_v + beta*prior_gradient/ num_subsets) *
+            //                   sum_subset backproj(measured/forwproj(lambda))
+            // with p_v = sum_{b in subset} p_bv
+            // actually, we restrict 1 + beta*prior_gradient/num_subsets/p_v between .1 and 10
+            denominator = *prior_gradient_iter/par.num_subsets + sensitivity;
+            denominator = std::max(std::min(denominator, sensitivity*10), sensitivity/10);
+            ++prior_gradient_iter;
+          }
+        else if (par.form == multiplicative_prior)
+          {
+            // multiplicative form
+            // lambda_new = lambda / (p_v*(1 + beta*prior_gradient)) *
+            //                   sum_subset backproj(measured/forwproj(lambda))
+            // with p_v = sum_{b in subset} p_bv
+            // actually, we restrict 1 + beta*prior_gradient between .1 and 10
+            denominator = *prior_gradient_iter + 1;
+            denominator = std::max(std::min(denominator, 10.F), 1/10.F);
+            denominator *= sensitivity;
+            ++prior_gradient_iter;
+          }
+
+        float update;
+        if (std::fabs(denominator)<=par.small_value && std::fabs(*update_iter)<=par.small_value)
+          update = 0;
+        else
+          update = *update_iter / denominator;
+        *update_iter = update;
+
+        if (update < current_min)
+          current_min = update;
+        if (update > current_max)
+          current_max = update;
+
+        if (par.threshold)
+          {
+            if (update > par.new_max)
+              update = par.new_max;
+            else if (par.new_min > update)
+              update = par.new_min;
+          }
+        *estimate_iter *= update;
+      }
+  }
+
+  template <class TargetT>
+  float
+  find_max(const TargetT& image)
+  {
+    return *std::max_element(image.begin_all_const(), image.end_all_const());
+  }
+
+  //! parallel version over planes
+  float
+  find_max(const DiscretisedDensity<3,float>& image)
+  {
+    const int min_z = image.get_min_index();
+    const int max_z = image.get_max_index();
+    std::vector<float> plane_max(max_z - min_z + 1);
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int z = min_z; z <= max_z; ++z)
+      plane_max[z - min_z] =
+        *std::max_element(image[z].begin_all_const(), image[z].end_all_const());
+    return *std::max_element(plane_max.begin(), plane_max.end());
+  }
+
+  template <class TargetT>
+  void
+  apply_fused_update(TargetT& update, const TargetT& sensitivity, const TargetT& prior_gradient,
+                     TargetT& estimate, const FusedUpdateParameters& par,
+                     float& current_min, float& current_max)
+  {
+    fused_update(update.begin_all(), update.end_all(),
+                 sensitivity.begin_all_const(), prior_gradient.begin_all_const(),
+                 estimate.begin_all(), par, current_min, current_max);
+  }
+
+  //! parallel version over planes
+  void
+  apply_fused_update(DiscretisedDensity<3,float>& update,
+                     const DiscretisedDensity<3,float>& sensitivity,
+                     const DiscretisedDensity<3,float>& prior_gradient,
+                     DiscretisedDensity<3,float>& estimate, const FusedUpdateParameters& par,
+                     float& current_min, float& current_max)
+  {
+    const int min_z = update.get_min_index();
+    const int max_z = update.get_max_index();
+    std::vector<float> plane_min(max_z - min_z + 1);
+    std::vector<float> plane_max(max_z - min_z + 1);
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int z = min_z; z <= max_z; ++z)
+      fused_update(update[z].begin_all(), update[z].end_all(),
+                   sensitivity[z].begin_all_const(), prior_gradient[z].begin_all_const(),
+                   estimate[z].begin_all(), par,
+                   plane_min[z - min_z], plane_max[z - min_z]);
+    current_min = *std::min_element(plane_min.begin(), plane_min.end());
+    current_max = *std::max_element(plane_max.begin(), plane_max.end());
+  }
+}
+
 template <typename TargetT>
 void 
 OSMAPOSLReconstruction<TargetT>::
@@ -405,97 +557,55 @@ update_estimate(TargetT &current_image_estimate)
   timerSubset.Start();
 #endif // PARALLEL
   
-  // TODO make member parameter to avoid reallocation all the time
-  auto_ptr< TargetT > multiplicative_update_image_ptr =
-    auto_ptr< TargetT >(current_image_estimate.get_empty_copy());
+  if (is_null_ptr(this->multiplicative_update_image_sptr) ||
+      !this->multiplicative_update_image_sptr->has_same_characteristics(current_image_estimate))
+    this->multiplicative_update_image_sptr.reset(current_image_estimate.get_empty_copy());
+  TargetT& multiplicative_update_image = *this->multiplicative_update_image_sptr;
 
   const int subset_num=this->get_subset_num();  
   info(boost::format("Now processing subset #: %1%") % subset_num);
 
+  // not all objective functions overwrite the gradient
+  std::fill(multiplicative_update_image.begin_all(), multiplicative_update_image.end_all(), 0.F);
   this->objective_function().
-    compute_sub_gradient_without_penalty_plus_sensitivity(*multiplicative_update_image_ptr,
+    compute_sub_gradient_without_penalty_plus_sensitivity(multiplicative_update_image,
                                                           current_image_estimate,
                                                           subset_num); 
   
-  // divide by subset sensitivity  
-  {
-    const TargetT& sensitivity =
-      this->objective_function().get_subset_sensitivity(subset_num);
+  const TargetT& sensitivity =
+    this->objective_function().get_subset_sensitivity(subset_num);
 
-
-    int count = 0;
-    
-    //std::cerr <<this->MAP_model << std::endl;
-    
+  FusedUpdateParameters par;
+  par.num_subsets = this->get_num_subsets();
   if (this->objective_function_sptr->prior_is_zero())
+    par.form = no_prior;
+  else
     {
-      divide(multiplicative_update_image_ptr->begin_all(),
-             multiplicative_update_image_ptr->end_all(), 
-             sensitivity.begin_all(),
-             small_num);
-        
-    }
-    else
-    {
-      auto_ptr< TargetT > denominator_ptr = 
-        auto_ptr< TargetT >(current_image_estimate.get_empty_copy());
-      
-      
+      if (is_null_ptr(this->prior_gradient_image_sptr) ||
+          !this->prior_gradient_image_sptr->has_same_characteristics(current_image_estimate))
+        this->prior_gradient_image_sptr.reset(current_image_estimate.get_empty_copy());
       this->objective_function_sptr->
-        get_prior_ptr()->compute_gradient(*denominator_ptr, current_image_estimate); 
-      
-      typename TargetT::full_iterator denominator_iter = denominator_ptr->begin_all();
-      const typename TargetT::full_iterator denominator_end = denominator_ptr->end_all();
-      typename TargetT::const_full_iterator sensitivity_iter = sensitivity.begin_all();
-
-      if(this->MAP_model =="additive" )
-      {
-        // lambda_new = lambda / (p_v + beta*prior_gradient/ num_subsets) *
-        //                   sum_subset backproj(measured/forwproj(lambda))
-        // with p_v = sum_{b in subset} p_bv
-        // actually, we restrict 1 + beta*prior_gradient/num_subsets/p_v between .1 and 10
-        while (denominator_iter != denominator_end)
-          {
-            *denominator_iter = *denominator_iter/this->get_num_subsets() + (*sensitivity_iter);
-            // bound denominator between (*sensitivity_iter)/10 and (*sensitivity_iter)*10
-            *denominator_iter =
-                std::max(std::min(*denominator_iter, (*sensitivity_iter)*10),(*sensitivity_iter)/10);
-            ++denominator_iter;
-            ++sensitivity_iter;
-          }
-      }
+        get_prior_ptr()->compute_gradient(*this->prior_gradient_image_sptr, current_image_estimate); 
+      if (this->MAP_model == "additive")
+        par.form = additive_prior;
+      else if (this->MAP_model == "multiplicative")
+        par.form = multiplicative_prior;
       else
-      {
-        if(this->MAP_model =="multiplicative" )
-        {
-          // multiplicative form
-          // lambda_new = lambda / (p_v*(1 + beta*prior_gradient)) *
-          //                   sum_subset backproj(measured/forwproj(lambda))
-          // with p_v = sum_{b in subset} p_bv
-          // actually, we restrict 1 + beta*prior_gradient between .1 and 10
-        while (denominator_iter != denominator_end)
-          {
-            *denominator_iter += 1;
-            // bound denominator between 1/10 and 1*10
-            // TODO code will fail if *denominator_iter is not a float
-            *denominator_iter =
-                std::max(std::min(*denominator_iter, 10.F),1/10.F);
-            *denominator_iter *= (*sensitivity_iter);
-            ++denominator_iter;
-            ++sensitivity_iter;
-          }
-        }
-      }         
-      divide(multiplicative_update_image_ptr->begin_all(),
-             multiplicative_update_image_ptr->end_all(), 
-             denominator_ptr->begin_all(),
-             small_num);
+        error("OSMAPOSL: MAP_model should be additive or multiplicative, but is %s",
+              this->MAP_model.c_str());
     }
-    
-    info(boost::format("Number of (cancelled) singularities in Sensitivity division: %1%") % count);
-  }
-  
-    
+  const TargetT& prior_gradient =
+    par.form == no_prior ? sensitivity : *this->prior_gradient_image_sptr;
+
+  // divide the numerator by the denominator as in divide()
+  par.small_value = std::max(find_max(multiplicative_update_image)*small_num, 0.F);
+
+  par.threshold = this->subiteration_num != 1;
+  par.new_min = static_cast<float>(this->minimum_relative_change);
+  par.new_max = static_cast<float>(this->maximum_relative_change);
+
+  // The filter is applied to the current estimate before multiplying it with
+  // the update (which is computed from the unfiltered estimate).
   if(this->inter_update_filter_interval>0 &&
      !is_null_ptr(this->inter_update_filter_ptr) &&
      !(this->subiteration_num%this->inter_update_filter_interval))
@@ -503,7 +613,12 @@ update_estimate(TargetT &current_image_estimate)
     info("Applying inter-update filter");
     this->inter_update_filter_ptr->apply(current_image_estimate); 
   }
-  
+
+  float current_min, current_max;
+  apply_fused_update(multiplicative_update_image, sensitivity, prior_gradient,
+                     current_image_estimate, par,
+                     current_min, current_max);
+
   // KT 17/08/2000 limit update
   // TODO move below thresholding?
   if (this->write_update_image && !this->_disable_output)
@@ -515,40 +630,12 @@ update_estimate(TargetT &current_image_estimate)
     
     // Write it to file
     this->output_file_format_ptr->
-      write_to_file(fname, *multiplicative_update_image_ptr);
+      write_to_file(fname, multiplicative_update_image);
     delete[] fname;
   }
   
-  if (this->subiteration_num != 1)
-    {
-      const float current_min =
-        *std::min_element(multiplicative_update_image_ptr->begin_all(),
-                          multiplicative_update_image_ptr->end_all()); 
-      const float current_max = 
-        *std::max_element(multiplicative_update_image_ptr->begin_all(),
-                          multiplicative_update_image_ptr->end_all()); 
-      const float new_min = 
-        static_cast<float>(this->minimum_relative_change);
-      const float new_max = 
-        static_cast<float>(this->maximum_relative_change);
-      info(boost::format("Update image old min,max: %1%, %2%, new min,max %3%, %4%") % current_min % current_max % (min(current_min, new_min)) % (max(current_max, new_max)));
-
-      threshold_upper_lower(multiplicative_update_image_ptr->begin_all(),
-                            multiplicative_update_image_ptr->end_all(), 
-                            new_min, new_max);      
-    }  
-
-  //current_image_estimate *= *multiplicative_update_image_ptr; 
-  {
-    typename TargetT::const_full_iterator multiplicative_update_image_iter = multiplicative_update_image_ptr->begin_all_const(); 
-    const typename TargetT::const_full_iterator end_multiplicative_update_image_iter = multiplicative_update_image_ptr->end_all_const(); 
-    typename TargetT::full_iterator current_image_estimate_iter = current_image_estimate.begin_all(); 
-    while (multiplicative_update_image_iter!=end_multiplicative_update_image_iter) 
-      { 
-        *current_image_estimate_iter *= (*multiplicative_update_image_iter); 
-        ++current_image_estimate_iter; ++multiplicative_update_image_iter; 
-      } 
-  }
+  if (par.threshold)
+    info(boost::format("Update image old min,max: %1%, %2%, new min,max %3%, %4%") % current_min % current_max % (min(current_min, par.new_min)) % (max(current_max, par.new_max)));
   
 #ifndef PARALLEL
   //cerr << "Subset : " << subset_timer.value() << "secs " <<endl;
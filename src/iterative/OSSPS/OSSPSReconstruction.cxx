@@ -2,6 +2,7 @@
 //
 /*
     Copyright (C) 2002- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -38,7 +39,12 @@
 #include "stir/NumericInfo.h"
 #include "stir/utilities.h"
 #include "stir/IO/read_from_file.h"
+#include "stir/IO/write_to_file.h"
+#include "stir/recon_buildblock/cache_keys.h"
+#include "stir/recon_buildblock/image_cache.h"
+#include "stir/HighResWallClockTimer.h"
 #include "stir/info.h"
+#include "boost/format.hpp"
 
 #include <iostream>
 #include <memory>
@@ -63,6 +69,30 @@ using boost::lambda::_2;
 
 START_NAMESPACE_STIR
 
+namespace
+{
+  //! threshold all elements of the image
+  template <class TargetT>
+  void
+  threshold_image_upper_lower(TargetT& image, const float new_min, const float new_max)
+  {
+    threshold_upper_lower(image.begin_all(), image.end_all(), new_min, new_max);
+  }
+
+  //! version using the element-wise operations when the image is contiguous
+  void
+  threshold_image_upper_lower(DiscretisedDensity<3,float>& image, const float new_min, const float new_max)
+  {
+    if (image.is_contiguous())
+      {
+        float * const data_ptr = image.get_full_data_ptr();
+        threshold_upper_lower(data_ptr, data_ptr + image.size_all(), new_min, new_max);
+      }
+    else
+      threshold_upper_lower(image.begin_all(), image.end_all(), new_min, new_max);
+  }
+}
+
 //*************** parameters *************
 
 template <typename TargetT>
@@ -80,6 +110,8 @@ set_defaults()
   upper_bound = NumericInfo<float>().max_value();
   write_update_image = 0;
   precomputed_denominator_filename = "";
+  precomputed_denominator_cache_directory = "";
+  precomputed_denominator_was_read_from_cache = false;
 
   //MAP_model="additive"; 
   relaxation_parameter = 1;
@@ -105,6 +137,7 @@ initialise_keymap()
   this->parser.add_key("upper bound", &upper_bound);
   this->parser.add_key("write update image",&write_update_image);   
   this->parser.add_key("precomputed denominator", &precomputed_denominator_filename);
+  this->parser.add_key("precomputed denominator cache directory", &precomputed_denominator_cache_directory);
 
   this->parser.add_key("relaxation parameter", &relaxation_parameter);
   this->parser.add_key("relaxation gamma", &relaxation_gamma);
@@ -221,6 +254,9 @@ precompute_denominator_of_conditioner_without_penalty()
   CPUTimer timer;
   timer.reset();
   timer.start();
+  HighResWallClockTimer wall_clock_timer;
+  wall_clock_timer.reset();
+  wall_clock_timer.start();
 
   assert(*std::max_element(precomputed_denominator_ptr->begin_all(), precomputed_denominator_ptr->end_all()) == 0);
   assert(*std::min_element(precomputed_denominator_ptr->begin_all(), precomputed_denominator_ptr->end_all()) == 0);
@@ -238,7 +274,9 @@ precompute_denominator_of_conditioner_without_penalty()
 								*precomputed_denominator_ptr, 
 								*data_full_of_ones_aptr);
   timer.stop();
-  info(boost::format("Precomputing denominator took %1% s CPU time") % timer.value());
+  wall_clock_timer.stop();
+  info(boost::format("Precomputing denominator took %1% s CPU time, %2% s wall-clock time")
+       % timer.value() % wall_clock_timer.value());
   info(boost::format("min and max in precomputed denominator %1%, %2%") % *std::min_element(precomputed_denominator_ptr->begin_all(), precomputed_denominator_ptr->end_all()) % *std::max_element(precomputed_denominator_ptr->begin_all(), precomputed_denominator_ptr->end_all()));  
 
   // Write it to file
@@ -288,10 +326,27 @@ set_up(shared_ptr <TargetT > const& target_image_ptr)
 					  target_image_ptr->end_all(),
 					  10.E-6F);
   
+  this->precomputed_denominator_was_read_from_cache = false;
   if(this->precomputed_denominator_filename=="")
   {
-    precomputed_denominator_ptr.reset(target_image_ptr->get_empty_copy());
-    precompute_denominator_of_conditioner_without_penalty();
+    std::string cache_key_filename, cache_description;
+    const bool use_cache =
+      this->get_precomputed_denominator_cache_key(cache_key_filename, cache_description, *target_image_ptr);
+    if (use_cache &&
+        this->read_precomputed_denominator_from_cache(cache_key_filename, cache_description, *target_image_ptr)
+        == Succeeded::yes)
+      {
+        this->precomputed_denominator_was_read_from_cache = true;
+      }
+    else
+      {
+        precomputed_denominator_ptr.reset(target_image_ptr->get_empty_copy());
+        precompute_denominator_of_conditioner_without_penalty();
+        if (use_cache &&
+            this->write_precomputed_denominator_to_cache(cache_key_filename, cache_description) != Succeeded::yes)
+          warning("OSSPS: could not write precomputed denominator to cache directory '%s'",
+                  this->precomputed_denominator_cache_directory.c_str());
+      }
   }
   else if(this->precomputed_denominator_filename=="1")
   {
@@ -317,6 +372,72 @@ set_up(shared_ptr <TargetT > const& target_image_ptr)
 
 
 
+template <class TargetT>
+void
+OSSPSReconstruction<TargetT>::
+set_precomputed_denominator_cache_directory(const std::string& directory)
+{
+  this->precomputed_denominator_cache_directory = directory;
+}
+
+template <class TargetT>
+bool
+OSSPSReconstruction<TargetT>::
+get_precomputed_denominator_was_read_from_cache() const
+{
+  return this->precomputed_denominator_was_read_from_cache;
+}
+
+template <class TargetT>
+bool
+OSSPSReconstruction<TargetT>::
+get_precomputed_denominator_cache_key(std::string& key_filename, std::string& description,
+                                      const TargetT& target) const
+{
+  if (this->precomputed_denominator_cache_directory.empty())
+    return false;
+
+  const std::string objective_function_description =
+    this->objective_function_sptr->get_approximate_Hessian_cache_key_description();
+  if (objective_function_description.empty())
+    {
+      warning("OSSPS: 'precomputed denominator cache directory' is set, but the objective function does not support caching. Ignored.");
+      return false;
+    }
+
+  description =
+    objective_function_description + get_geometry_description(target);
+  key_filename =
+    get_cache_key_filename(this->precomputed_denominator_cache_directory, "OSSPS_denominator", description);
+  return true;
+}
+
+template <class TargetT>
+Succeeded
+OSSPSReconstruction<TargetT>::
+read_precomputed_denominator_from_cache(const std::string& key_filename,
+                                        const std::string& description,
+                                        const TargetT& target)
+{
+  std::vector<shared_ptr<TargetT> > denominator_sptrs;
+  if (read_images_from_cache(denominator_sptrs, key_filename, description, target, 1,
+                             "OSSPS precomputed denominator")
+      != Succeeded::yes)
+    return Succeeded::no;
+  this->precomputed_denominator_ptr = denominator_sptrs[0];
+  return Succeeded::yes;
+}
+
+template <class TargetT>
+Succeeded
+OSSPSReconstruction<TargetT>::
+write_precomputed_denominator_to_cache(const std::string& key_filename,
+                                       const std::string& description) const
+{
+  return write_images_to_cache(key_filename, description,
+                               std::vector<shared_ptr<TargetT> >(1, this->precomputed_denominator_ptr));
+}
+
 /*! \brief OSSPS additive update at every subiteration
   \warning This modifies *precomputed_denominator_ptr. So, you <strong>have to</strong>
   call set_up() before running a new reconstruction.
@@ -460,9 +581,7 @@ update_estimate(TargetT &current_image_estimate)
       static_cast<float>(upper_bound);
     info(boost::format("current image old min,max: %1%, %2%, new min,max %3%, %4%") % current_min % current_max % std::max(current_min, new_min) % std::min(current_max, new_max));
     
-    threshold_upper_lower(current_image_estimate.begin_all(),
-			  current_image_estimate.end_all(), 
-			  new_min, new_max);      
+    threshold_image_upper_lower(current_image_estimate, new_min, new_max);
   }  
 
 #ifndef PARALLEL
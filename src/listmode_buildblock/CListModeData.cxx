@@ -7,7 +7,7 @@
 */
 /*
     Copyright (C) 2003, Hammersmith Imanet Ltd
-    Copyright (C) 2014, University College London
+    Copyright (C) 2014, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -24,8 +24,17 @@
 */
 
 #include "stir/listmode/CListModeData.h"
+#include "stir/listmode/CListRecord.h"
 #include "stir/ExamInfo.h"
+#include "stir/Succeeded.h"
 #include "stir/is_null_ptr.h"
+#include "stir/info.h"
+#include "stir/warning.h"
+#include <boost/format.hpp>
+#include <fstream>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 START_NAMESPACE_STIR
 
@@ -59,6 +68,233 @@ get_scanner_ptr() const
   return this->scanner_sptr.get();
 }
 
+Succeeded
+CListModeData::
+get_stream_positions(std::vector<std::streampos>&,
+                     const std::vector<SavedPosition>&) const
+{
+  return Succeeded::no;
+}
+
+Succeeded
+CListModeData::
+save_stream_positions(std::vector<SavedPosition>&,
+                      const std::vector<std::streampos>&)
+{
+  return Succeeded::no;
+}
+
+std::string
+CListModeData::
+get_file_signature(const std::string& filename)
+{
+  struct stat file_info;
+  if (stat(filename.c_str(), &file_info) != 0)
+    return "";
+  return boost::str(boost::format("size %1% modified %2%") %
+                    static_cast<long long>(file_info.st_size) %
+                    static_cast<long long>(file_info.st_mtime));
+}
+
+std::string
+CListModeData::
+get_data_signature() const
+{
+  return get_file_signature(this->get_name());
+}
+
+bool
+CListModeData::
+has_time_index() const
+{
+  return !this->time_index.empty();
+}
+
+Succeeded
+CListModeData::
+build_time_index(const double min_time_interval)
+{
+  this->time_index.clear();
+  if (this->reset() == Succeeded::no)
+    return Succeeded::no;
+
+  TimeIndexEntry entry;
+  entry.time = 0;
+  entry.position = this->save_get_position();
+  std::vector<TimeIndexEntry> new_time_index(1, entry);
+
+  shared_ptr<CListRecord> record_sptr = this->get_empty_record_sptr();
+  CListRecord& record = *record_sptr;
+  while (this->get_next_record(record) == Succeeded::yes)
+    {
+      if (record.is_time())
+        {
+          const double time = record.time().get_time_in_secs();
+          if (time >= new_time_index.back().time + min_time_interval)
+            {
+              entry.time = time;
+              entry.position = this->save_get_position();
+              new_time_index.push_back(entry);
+            }
+        }
+    }
+  // check if positioning works at all
+  if (this->set_get_position(new_time_index[0].position) == Succeeded::no)
+    {
+      warning("CListModeData: cannot build time index as set_get_position() is not supported");
+      return Succeeded::no;
+    }
+  this->time_index.swap(new_time_index);
+  info(boost::format("CListModeData: time index built with %1% entries") % this->time_index.size());
+  return this->reset();
+}
+
+namespace {
+  struct time_index_entry_less
+  {
+    template <class T>
+    bool operator()(const double time, const T& entry) const
+    { return time < entry.time; }
+  };
+}
+
+Succeeded
+CListModeData::
+set_get_position_for_time(const double time, double& time_of_position)
+{
+  if (this->time_index.empty())
+    {
+      if (this->build_time_index() == Succeeded::no)
+        return Succeeded::no;
+    }
+  // find the last entry with entry.time <= time
+  std::vector<TimeIndexEntry>::const_iterator iter =
+    std::upper_bound(this->time_index.begin(), this->time_index.end(), time, time_index_entry_less());
+  if (iter != this->time_index.begin())
+    --iter;
+  time_of_position = iter->time;
+  return this->set_get_position(iter->position);
+}
+
+Succeeded
+CListModeData::
+write_time_index(const std::string& filename) const
+{
+  if (this->time_index.empty())
+    {
+      warning("CListModeData::write_time_index: there is no time index");
+      return Succeeded::no;
+    }
+  std::vector<SavedPosition> saved_positions(this->time_index.size());
+  for (std::size_t i=0; i<this->time_index.size(); ++i)
+    saved_positions[i] = this->time_index[i].position;
+  std::vector<std::streampos> stream_positions;
+  if (this->get_stream_positions(stream_positions, saved_positions) == Succeeded::no)
+    {
+      warning("CListModeData::write_time_index: not supported for this type of list mode data");
+      return Succeeded::no;
+    }
+
+  std::ofstream file(filename.c_str());
+  if (!file)
+    {
+      warning("CListModeData::write_time_index: cannot open file '%s'", filename.c_str());
+      return Succeeded::no;
+    }
+  file.precision(17);
+  file << "STIR list mode time index version 1.1\n"
+       << this->get_name() << '\n'
+       << this->get_data_signature() << '\n'
+       << this->time_index.size() << '\n';
+  for (std::size_t i=0; i<this->time_index.size(); ++i)
+    file << this->time_index[i].time << ' '
+         << static_cast<long long>(std::streamoff(stream_positions[i])) << '\n';
+  if (!file)
+    {
+      warning("CListModeData::write_time_index: error writing file '%s'", filename.c_str());
+      return Succeeded::no;
+    }
+  return Succeeded::yes;
+}
+
+Succeeded
+CListModeData::
+read_time_index(const std::string& filename)
+{
+  std::ifstream file(filename.c_str());
+  if (!file)
+    return Succeeded::no;
+  std::string line;
+  std::getline(file, line);
+  if (line != "STIR list mode time index version 1.1")
+    {
+      warning("CListModeData::read_time_index: file '%s' is not a time index (of the current version)",
+              filename.c_str());
+      return Succeeded::no;
+    }
+  std::getline(file, line);
+  if (line != this->get_name())
+    {
+      warning("CListModeData::read_time_index: file '%s' is for list mode data '%s', not '%s'",
+              filename.c_str(), line.c_str(), this->get_name().c_str());
+      return Succeeded::no;
+    }
+  std::getline(file, line);
+  if (line != this->get_data_signature())
+    {
+      warning("CListModeData::read_time_index: file '%s' was written for different data "
+              "(the list mode data has changed since then)",
+              filename.c_str());
+      return Succeeded::no;
+    }
+  std::size_t num_entries = 0;
+  file >> num_entries;
+  std::vector<TimeIndexEntry> new_time_index(num_entries);
+  std::vector<std::streampos> stream_positions(num_entries);
+  for (std::size_t i=0; i<num_entries; ++i)
+    {
+      long long stream_position;
+      file >> new_time_index[i].time >> stream_position;
+      stream_positions[i] = std::streampos(std::streamoff(stream_position));
+      if (i>0 && new_time_index[i].time < new_time_index[i-1].time)
+        file.setstate(std::ios::failbit);
+    }
+  if (!file || num_entries == 0)
+    {
+      warning("CListModeData::read_time_index: error reading file '%s'", filename.c_str());
+      return Succeeded::no;
+    }
+  std::vector<SavedPosition> saved_positions;
+  if (this->save_stream_positions(saved_positions, stream_positions) == Succeeded::no)
+    {
+      warning("CListModeData::read_time_index: not supported for this type of list mode data");
+      return Succeeded::no;
+    }
+  for (std::size_t i=0; i<num_entries; ++i)
+    new_time_index[i].position = saved_positions[i];
+  this->time_index.swap(new_time_index);
+  return Succeeded::yes;
+}
+
+Succeeded
+CListModeData::
+set_up_time_index(const std::string& filename)
+{
+  if (filename.empty())
+    return this->has_time_index() ? Succeeded::yes : this->build_time_index();
+
+  if (this->read_time_index(filename) == Succeeded::yes)
+    {
+      info(boost::format("CListModeData: time index read from '%1%'") % filename);
+      return Succeeded::yes;
+    }
+  if (this->build_time_index() == Succeeded::no)
+    return Succeeded::no;
+  if (this->write_time_index(filename) == Succeeded::no)
+    warning("CListModeData: time index could not be written to '%s'", filename.c_str());
+  return Succeeded::yes;
+}
+
 #if 0
 std::time_t 
 CListModeData::
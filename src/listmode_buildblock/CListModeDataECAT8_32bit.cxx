@@ -1,6 +1,6 @@
 /*
     Copyright (C) 2003-2012 Hammersmith Imanet Ltd
-    Copyright (C) 2013-2014 University College London
+    Copyright (C) 2013-2014, 2016 University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -164,5 +164,46 @@ set_get_position(const CListModeDataECAT8_32bit::SavedPosition& pos)
     current_lm_data_ptr->set_get_position(pos);
 }
 
+Succeeded
+CListModeDataECAT8_32bit::
+get_stream_positions(std::vector<std::streampos>& stream_positions,
+                     const std::vector<SavedPosition>& saved_positions) const
+{
+  const std::vector<std::streampos> all_positions = current_lm_data_ptr->get_saved_get_positions();
+  stream_positions.resize(saved_positions.size());
+  for (std::size_t i=0; i<saved_positions.size(); ++i)
+    {
+      if (saved_positions[i] >= all_positions.size())
+        return Succeeded::no;
+      stream_positions[i] = all_positions[saved_positions[i]];
+    }
+  return Succeeded::yes;
+}
+
+Succeeded
+CListModeDataECAT8_32bit::
+save_stream_positions(std::vector<SavedPosition>& saved_positions,
+                      const std::vector<std::streampos>& stream_positions)
+{
+  std::vector<std::streampos> all_positions = current_lm_data_ptr->get_saved_get_positions();
+  saved_positions.resize(stream_positions.size());
+  for (std::size_t i=0; i<stream_positions.size(); ++i)
+    {
+      saved_positions[i] = static_cast<SavedPosition>(all_positions.size());
+      all_positions.push_back(stream_positions[i]);
+    }
+  current_lm_data_ptr->set_saved_get_positions(all_positions);
+  return Succeeded::yes;
+}
+
+std::string
+CListModeDataECAT8_32bit::
+get_data_signature() const
+{
+  return
+    get_file_signature(this->listmode_filename) + "; " +
+    get_file_signature(this->interfile_parser.data_file_name);
+}
+
 } // namespace ecat
 END_NAMESPACE_STIR
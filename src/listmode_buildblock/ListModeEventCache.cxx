@@ -0,0 +1,198 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup listmode
+  \brief Implementation of class stir::ListModeEventCache
+*/
+
+#include "stir/listmode/ListModeEventCache.h"
+#include "stir/listmode/CListModeData.h"
+#include "stir/listmode/CListRecord.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/Bin.h"
+#include "stir/Succeeded.h"
+#include "stir/error.h"
+#include <algorithm>
+
+START_NAMESPACE_STIR
+
+const ListModeEventCache::event_type ListModeEventCache::prompt_bit;
+
+ListModeEventCache::
+ListModeEventCache(const shared_ptr<ProjDataInfo>& proj_data_info_sptr)
+  : proj_data_info_sptr(proj_data_info_sptr)
+{
+  const int min_segment_num = proj_data_info_sptr->get_min_segment_num();
+  const int max_segment_num = proj_data_info_sptr->get_max_segment_num();
+  this->segment_offsets.grow(min_segment_num, max_segment_num+1);
+  double total = 0;
+  for (int segment_num=min_segment_num; segment_num<=max_segment_num; ++segment_num)
+    {
+      this->segment_offsets[segment_num] = static_cast<boost::uint32_t>(total);
+      total +=
+        static_cast<double>(proj_data_info_sptr->get_num_views()) *
+        proj_data_info_sptr->get_num_axial_poss(segment_num) *
+        proj_data_info_sptr->get_num_tangential_poss();
+      if (total >= static_cast<double>(prompt_bit))
+        error("ListModeEventCache: too many bins in the projection data (%g)", total);
+    }
+  this->segment_offsets[max_segment_num+1] = static_cast<boost::uint32_t>(total);
+}
+
+boost::uint32_t
+ListModeEventCache::
+get_bin_index(const Bin& bin) const
+{
+  const ProjDataInfo& proj_data_info = *this->proj_data_info_sptr;
+  return
+    this->segment_offsets[bin.segment_num()] +
+    ((static_cast<boost::uint32_t>(bin.view_num() - proj_data_info.get_min_view_num()) *
+      proj_data_info.get_num_axial_poss(bin.segment_num()) +
+      (bin.axial_pos_num() - proj_data_info.get_min_axial_pos_num(bin.segment_num()))) *
+     proj_data_info.get_num_tangential_poss() +
+     (bin.tangential_pos_num() - proj_data_info.get_min_tangential_pos_num()));
+}
+
+void
+ListModeEventCache::
+get_bin(Bin& bin, const std::size_t event_index) const
+{
+  const ProjDataInfo& proj_data_info = *this->proj_data_info_sptr;
+  boost::uint32_t bin_index = this->events[event_index] & ~prompt_bit;
+  // find segment: last offset that is not larger than bin_index
+  const boost::uint32_t * const offsets_begin = &this->segment_offsets[this->segment_offsets.get_min_index()];
+  const boost::uint32_t * const offsets_end = offsets_begin + this->segment_offsets.size();
+  const int segment_num =
+    static_cast<int>(std::upper_bound(offsets_begin, offsets_end, bin_index) - offsets_begin) - 1 +
+    this->segment_offsets.get_min_index();
+  bin_index -= this->segment_offsets[segment_num];
+
+  const int num_tangential_poss = proj_data_info.get_num_tangential_poss();
+  const int num_axial_poss = proj_data_info.get_num_axial_poss(segment_num);
+  bin.segment_num() = segment_num;
+  bin.tangential_pos_num() =
+    static_cast<int>(bin_index % num_tangential_poss) + proj_data_info.get_min_tangential_pos_num();
+  bin_index /= num_tangential_poss;
+  bin.axial_pos_num() =
+    static_cast<int>(bin_index % num_axial_poss) + proj_data_info.get_min_axial_pos_num(segment_num);
+  bin.view_num() =
+    static_cast<int>(bin_index / num_axial_poss) + proj_data_info.get_min_view_num();
+  bin.set_bin_value(this->bin_values.empty() ? 1.F : this->bin_values[event_index]);
+}
+
+Succeeded
+ListModeEventCache::
+fill(CListModeData& lm_data)
+{
+  this->events.resize(0);
+  // free the memory for the values, as they might not be needed this time
+  std::vector<float>().swap(this->bin_values);
+  this->time_marks.resize(0);
+  if (lm_data.reset() == Succeeded::no)
+    return Succeeded::no;
+
+  shared_ptr<CListRecord> record_sptr = lm_data.get_empty_record_sptr();
+  CListRecord& record = *record_sptr;
+
+  // list mode data starts at time 0
+  {
+    TimeMark mark;
+    mark.time = 0;
+    mark.first_event_index = 0;
+    this->time_marks.push_back(mark);
+  }
+  const ProjDataInfo& proj_data_info = *this->proj_data_info_sptr;
+  Bin bin;
+  while (lm_data.get_next_record(record) == Succeeded::yes)
+    {
+      if (record.is_time())
+        {
+          const double time = record.time().get_time_in_secs();
+          if (time != this->time_marks.back().time)
+            {
+              if (time < this->time_marks.back().time)
+                error("ListModeEventCache: time in list mode data is decreasing");
+              if (this->time_marks.back().first_event_index == this->events.size())
+                {
+                  // no events for the previous time, so we can overwrite it
+                  this->time_marks.back().time = time;
+                }
+              else
+                {
+                  TimeMark mark;
+                  mark.time = time;
+                  mark.first_event_index = this->events.size();
+                  this->time_marks.push_back(mark);
+                }
+            }
+        }
+      if (record.is_event())
+        {
+          // set value in case the event decoder doesn't touch it
+          bin.set_bin_value(1);
+          record.event().get_bin(bin, proj_data_info);
+          if (bin.get_bin_value() <= 0)
+            continue;
+          const event_type event =
+            this->get_bin_index(bin) | (record.event().is_prompt() ? prompt_bit : 0);
+          // only store values when there is one that is not 1
+          if (this->bin_values.empty() && bin.get_bin_value() != 1)
+            this->bin_values.resize(this->events.size(), 1.F);
+          if (!this->bin_values.empty())
+            this->bin_values.push_back(bin.get_bin_value());
+          this->events.push_back(event);
+        }
+    }
+  return Succeeded::yes;
+}
+
+std::size_t
+ListModeEventCache::
+get_memory_usage_in_bytes() const
+{
+  return
+    this->events.capacity()*sizeof(event_type) +
+    this->bin_values.capacity()*sizeof(float) +
+    this->time_marks.capacity()*sizeof(TimeMark);
+}
+
+namespace {
+  struct time_mark_less
+  {
+    template <class T>
+    bool operator()(const T& mark, const double time) const
+    { return mark.time < time; }
+  };
+}
+
+void
+ListModeEventCache::
+get_event_range_for_time_interval(std::size_t& begin_index, std::size_t& end_index,
+                                  const double start_time, const double end_time) const
+{
+  std::vector<TimeMark>::const_iterator begin_iter =
+    std::lower_bound(this->time_marks.begin(), this->time_marks.end(), start_time, time_mark_less());
+  std::vector<TimeMark>::const_iterator end_iter =
+    std::lower_bound(begin_iter, this->time_marks.end(), end_time, time_mark_less());
+  begin_index = begin_iter == this->time_marks.end() ? this->events.size() : begin_iter->first_event_index;
+  end_index = end_iter == this->time_marks.end() ? this->events.size() : end_iter->first_event_index;
+}
+
+END_NAMESPACE_STIR
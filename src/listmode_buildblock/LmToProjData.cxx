@@ -9,7 +9,7 @@
 */
 /*
     Copyright (C) 2000 - 2011-12-31, Hammersmith Imanet Ltd
-    Copyright (C) 2013, University College London
+    Copyright (C) 2013, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -83,9 +83,12 @@ FRAME_BASED_DT_CORR:
 #include "stir/recon_buildblock/TrivialBinNormalisation.h"
 #include "stir/is_null_ptr.h"
 
+#include <boost/cstdint.hpp>
+#include <boost/format.hpp>
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include <cstdio>
 
 #ifndef STIR_NO_NAMESPACES
 using std::string;
@@ -140,6 +143,120 @@ construct_proj_data(shared_ptr<iostream>& output,
 		    const ExamInfo& exam_info,
                     const shared_ptr<ProjDataInfo>& proj_data_info_ptr);
 
+namespace {
+/*
+  A temporary file that stores events for a range of segments, such that they
+  can be added to the segments after reading the list mode data.
+  Events are buffered in memory, and written to file when the buffer is full.
+  The file is removed by the destructor.
+*/
+class SegmentSpillFile
+{
+public:
+  SegmentSpillFile(const string& filename, 
+		   const int start_segment_num, const int end_segment_num);
+  ~SegmentSpillFile();
+
+  int get_start_segment_num() const { return start_segment_num; }
+  int get_end_segment_num() const { return end_segment_num; }
+
+  //! store an event (\a value is the amount to add to the bin)
+  void add(const Bin& bin, const float value)
+  {
+    SpillRecord spill_record;
+    spill_record.segment_num = static_cast<boost::int16_t>(bin.segment_num());
+    spill_record.view_num = static_cast<boost::int16_t>(bin.view_num());
+    spill_record.axial_pos_num = static_cast<boost::int16_t>(bin.axial_pos_num());
+    spill_record.tangential_pos_num = static_cast<boost::int16_t>(bin.tangential_pos_num());
+    spill_record.value = value;
+    buffer.push_back(spill_record);
+    if (buffer.size() >= max_buffer_size)
+      flush();
+  }
+
+  //! add all stored events to the segments
+  void add_to_segments(VectorWithOffset<segment_type *>& segments);
+
+private:
+  struct SpillRecord
+  {
+    boost::int16_t segment_num;
+    boost::int16_t view_num;
+    boost::int16_t axial_pos_num;
+    boost::int16_t tangential_pos_num;
+    float value;
+  };
+  static const std::size_t max_buffer_size = 1024*1024;
+
+  string filename;
+  int start_segment_num;
+  int end_segment_num;
+  fstream file;
+  std::size_t num_records_in_file;
+  vector<SpillRecord> buffer;
+
+  void flush();
+};
+
+SegmentSpillFile::
+SegmentSpillFile(const string& filename_v, 
+		 const int start_segment_num_v, const int end_segment_num_v)
+  : filename(filename_v),
+    start_segment_num(start_segment_num_v),
+    end_segment_num(end_segment_num_v),
+    num_records_in_file(0)
+{
+  file.open(filename.c_str(), ios::in|ios::out|ios::binary|ios::trunc);
+  if (!file)
+    error("LmToProjData: error opening temporary file %s\n", filename.c_str());
+  buffer.reserve(max_buffer_size);
+}
+
+SegmentSpillFile::
+~SegmentSpillFile()
+{
+  file.close();
+  std::remove(filename.c_str());
+}
+
+void
+SegmentSpillFile::
+flush()
+{
+  if (buffer.empty())
+    return;
+  file.write(reinterpret_cast<const char *>(&buffer[0]), 
+	     static_cast<std::streamsize>(buffer.size()*sizeof(SpillRecord)));
+  if (!file)
+    error("LmToProjData: error writing temporary file %s\n", filename.c_str());
+  num_records_in_file += buffer.size();
+  buffer.resize(0);
+}
+
+void
+SegmentSpillFile::
+add_to_segments(VectorWithOffset<segment_type *>& segments)
+{
+  flush();
+  file.seekg(0);
+  std::size_t num_records_left = num_records_in_file;
+  while (num_records_left > 0)
+    {
+      buffer.resize(min(num_records_left, max_buffer_size));
+      file.read(reinterpret_cast<char *>(&buffer[0]), 
+		static_cast<std::streamsize>(buffer.size()*sizeof(SpillRecord)));
+      if (!file)
+	error("LmToProjData: error reading temporary file %s\n", filename.c_str());
+      for (vector<SpillRecord>::const_iterator iter = buffer.begin(); iter != buffer.end(); ++iter)
+	(*segments[iter->segment_num])[iter->view_num][iter->axial_pos_num][iter->tangential_pos_num] +=
+	  iter->value;
+      num_records_left -= buffer.size();
+    }
+  buffer.resize(0);
+}
+
+} // end of unnamed namespace
+
 /**************************************************************
  The 3 parsing functions
 ***************************************************************/
@@ -156,7 +273,7 @@ set_defaults()
   post_normalisation_ptr.reset(new TrivialBinNormalisation);
   do_pre_normalisation =0;
   num_events_to_store = 0;
-
+  time_index_filename = "";
 }
 
 void 
@@ -184,6 +301,7 @@ initialise_keymap()
     //parser.add_key("increment to use for 'delayeds'",&delayed_increment);
   }
   parser.add_key("List event coordinates",&interactive);
+  parser.add_key("time index filename", &time_index_filename);
   parser.add_stop_key("END");  
 
 }
@@ -208,6 +326,12 @@ post_processing()
 
   lm_data_ptr = stir::read_from_file<CListModeData>(input_filename);
 
+  if (time_index_filename.size()!=0)
+    {
+      if (lm_data_ptr->set_up_time_index(time_index_filename) == Succeeded::no)
+        warning("LmToProjData: could not set up time index. Frames will be found by reading all events.");
+    }
+
   if (template_proj_data_name.size()==0)
     {
       warning("You have to specify template_projdata\n");
@@ -504,11 +628,20 @@ LmToProjData::
 start_new_time_frame(const unsigned int)
 {}
 
+bool
+LmToProjData::
+supports_parallel_binning() const
+{
+  return true;
+}
+
 /**************************************************************
  Here follows the actual rebinning code (finally).
 
  It's essentially simple, but is in fact complicated because of the facility
- to store only part of the segments in memory.
+ to store only part of the segments in memory. In that case, events for the 
+ other segments are written to temporary files, such that the list mode data
+ is still read only once.
 ***************************************************************/
 void
 LmToProjData::
@@ -528,11 +661,27 @@ process_data()
     segments (template_proj_data_info_ptr->get_min_segment_num(), 
 	      template_proj_data_info_ptr->get_max_segment_num());
   
-  VectorWithOffset<CListModeData::SavedPosition> 
-    frame_start_positions(1, static_cast<int>(frame_defs.get_num_frames()));
   shared_ptr <CListRecord> record_sptr = lm_data_ptr->get_empty_record_sptr();
   CListRecord& record = *record_sptr;
 
+  // check if we can process events in parallel
+  // (only if normalisation factors do not depend on time and are thread-safe)
+  bool bin_events_in_parallel = false;
+#ifdef STIR_OPENMP
+  bin_events_in_parallel =
+    do_time_frame && !interactive && supports_parallel_binning() &&
+    !is_null_ptr(dynamic_cast<TrivialBinNormalisation *>(do_pre_normalisation
+                                                          ? normalisation_ptr.get()
+                                                          : post_normalisation_ptr.get()));
+#endif
+  vector<shared_ptr<CListRecord> > batch_of_records;
+  if (bin_events_in_parallel)
+    {
+      batch_of_records.resize(100000);
+      for (std::size_t i=0; i<batch_of_records.size(); ++i)
+        batch_of_records[i] = lm_data_ptr->get_empty_record_sptr();
+    }
+
   /* Here starts the main loop which will store the listmode data. */
   for (current_frame_num = 1;
        current_frame_num<=frame_defs.get_num_frames();
@@ -552,9 +701,8 @@ process_data()
       shared_ptr<ProjData> proj_data_ptr;
 
       {
-        char rest[50];
-        sprintf(rest, "_f%dg1d0b0", current_frame_num);
-        const string output_filename = output_filename_prefix + rest;
+        const string output_filename =
+          boost::str(boost::format("%1%_f%2%g1d0b0") % output_filename_prefix % current_frame_num);
       
         proj_data_ptr = 
           construct_proj_data(output, output_filename, this_frame_exam_info, template_proj_data_info_ptr);
@@ -567,148 +715,268 @@ process_data()
       const double end_time = frame_defs.get_end_time(current_frame_num);
 
       /*
-	 For each start_segment_index, we check which events occur in the
-	 segments between start_segment_index and 
-	 start_segment_index+num_segments_in_memory.
+	 All events of the frame are read in a single pass. Events in the segments
+	 between the minimum segment number and 
+	 min_segment_num+num_segments_in_memory-1 are stored in memory directly.
+	 Events in other segments are written to a (temporary) spill file for their
+	 batch of segments, which is processed after the pass over the list mode data.
        */
-       for (int start_segment_index = proj_data_ptr->get_min_segment_num(); 
-	    start_segment_index <= proj_data_ptr->get_max_segment_num(); 
-	    start_segment_index += num_segments_in_memory) 
-	 {
-	 
-	   const int end_segment_index = 
-	     min( proj_data_ptr->get_max_segment_num()+1, start_segment_index + num_segments_in_memory) - 1;
-    
-	   if (!interactive)
-	     allocate_segments(segments, start_segment_index, end_segment_index, proj_data_ptr->get_proj_data_info_ptr());
-
-	   // the next variable is used to see if there are more events to store for the current segments
-	   // num_events_to_store-more_events will be the number of allowed coincidence events currently seen in the file
-	   // ('allowed' independent on the fact of we have its segment in memory or not)
-	   // When do_time_frame=true, the number of events is irrelevant, so we 
-	   // just set more_events to 1, and never change it
-	   long more_events = 
-         do_time_frame? 1 : static_cast<long>(num_events_to_store);
-
-	   if (start_segment_index != proj_data_ptr->get_min_segment_num())
-	     {
-	       // we're going once more through the data (for the next batch of segments)
-	       cerr << "\nProcessing next batch of segments\n";
-	       // go to the beginning of the listmode data for this frame
-	       lm_data_ptr->set_get_position(frame_start_positions[current_frame_num]);
-	       current_time = start_time;
-	     }
-	   else
-	     {
-	       cerr << "\nProcessing time frame " << current_frame_num << '\n';
-
-	       // Note: we already have current_time from previous frame, so don't 
-	       // need to set it. In fact, setting it to start_time would be wrong
-	       // as we first might have to skip some events before we get to start_time.
-	       // So, let's do that now.
-	       while (current_time < start_time && 
-		      lm_data_ptr->get_next_record(record) == Succeeded::yes) 
-		 {
-		   if (record.is_time())
-		     current_time = record.time().get_time_in_secs();
-		 }
-	       // now save position such that we can go back
-	       frame_start_positions[current_frame_num] = 
-		 lm_data_ptr->save_get_position();
-	     }
-	   {      
-	     // loop over all events in the listmode file
-	     while (more_events)
-	       {
-		 if (lm_data_ptr->get_next_record(record) == Succeeded::no) 
-		   {
-		     // no more events in file for some reason
-		     break; //get out of while loop
-		   }
-         if (record.is_time() && end_time > 0.01) // Direct comparison within doubles is unsafe.
-		   {
-		     current_time = record.time().get_time_in_secs();
-		     if (do_time_frame && current_time >= end_time)
-		       break; // get out of while loop
-		     assert(current_time>=start_time);
-		     process_new_time_event(record.time());
-		   }
-		 // note: could do "else if" here if we would be sure that
-		 // a record can never be both timing and coincidence event
-		 // and there might be a scanner around that has them both combined.
-		 if (record.is_event())
-		   {
-		     assert(start_time <= current_time);
-		     Bin bin;
-		     // set value in case the event decoder doesn't touch it
-		     // otherwise it would be 0 and all events will be ignored
-		     bin.set_bin_value(1);
-                     get_bin_from_event(bin, record.event());
+      const int first_end_segment_index = 
+	min( proj_data_ptr->get_max_segment_num()+1,
+	     proj_data_ptr->get_min_segment_num() + num_segments_in_memory) - 1;
+      if (!interactive)
+	allocate_segments(segments, proj_data_ptr->get_min_segment_num(), first_end_segment_index,
+			  proj_data_ptr->get_proj_data_info_ptr());
+
+      std::vector<shared_ptr<SegmentSpillFile> > spill_files;
+      if (!interactive)
+	{
+	  for (int start_segment_index = first_end_segment_index+1; 
+	       start_segment_index <= proj_data_ptr->get_max_segment_num(); 
+	       start_segment_index += num_segments_in_memory) 
+	    {
+	      const int end_segment_index = 
+		min( proj_data_ptr->get_max_segment_num()+1, start_segment_index + num_segments_in_memory) - 1;
+	      const string spill_filename =
+		boost::str(boost::format("%1%_f%2%_spill%3%.tmp") %
+			   output_filename_prefix % current_frame_num % spill_files.size());
+	      spill_files.push_back(shared_ptr<SegmentSpillFile>
+				    (new SegmentSpillFile(spill_filename,
+							  start_segment_index, end_segment_index)));
+	    }
+	}
+      // for finding the spill file of a segment
+      VectorWithOffset<SegmentSpillFile *>
+	spill_file_for_segment(proj_data_ptr->get_min_segment_num(), proj_data_ptr->get_max_segment_num());
+      spill_file_for_segment.fill(0);
+      for (std::size_t i=0; i<spill_files.size(); ++i)
+	for (int seg=spill_files[i]->get_start_segment_num(); seg<=spill_files[i]->get_end_segment_num(); ++seg)
+	  spill_file_for_segment[seg] = spill_files[i].get();
+
+      // the next variable is used to see if there are more events to store
+      // num_events_to_store-more_events will be the number of allowed coincidence events currently seen in the file
+      // When do_time_frame=true, the number of events is irrelevant, so we 
+      // just set more_events to 1, and never change it
+      long more_events = 
+	do_time_frame? 1 : static_cast<long>(num_events_to_store);
+
+      cerr << "\nProcessing time frame " << current_frame_num << '\n';
+
+      // Note: we already have current_time from previous frame, so don't 
+      // need to set it. In fact, setting it to start_time would be wrong
+      // as we first might have to skip some events before we get to start_time.
+      // If we have a time index (or have gone past the start of the frame
+      // because frames overlap), we first jump to the last time record before start_time.
+      if (do_time_frame &&
+	  (lm_data_ptr->has_time_index() || current_time > start_time))
+	{
+	  if (lm_data_ptr->set_get_position_for_time(start_time, current_time) == Succeeded::no)
+	    error("LmToProjData: cannot go to the start of time frame %d", current_frame_num);
+	}
+      // So, let's skip events now.
+      while (current_time < start_time && 
+	     lm_data_ptr->get_next_record(record) == Succeeded::yes) 
+	{
+	  if (record.is_time())
+	    current_time = record.time().get_time_in_secs();
+	}
+
+      if (bin_events_in_parallel)
+	{
+	  /* Records are read sequentially in batches. The events of a batch are
+	     then decoded and stored by multiple threads. Time records are processed 
+	     while reading, as all events of the batch are in the current frame.
+	  */
+	  bool end_of_frame = false;
+	  while (!end_of_frame)
+	    {
+	      std::size_t num_events_in_batch = 0;
+	      while (num_events_in_batch < batch_of_records.size())
+		{
+		  CListRecord& batch_record = *batch_of_records[num_events_in_batch];
+		  if (lm_data_ptr->get_next_record(batch_record) == Succeeded::no) 
+		    {
+		      end_of_frame = true;
+		      break;
+		    }
+		  if (batch_record.is_time() && end_time > 0.01) // Direct comparison within doubles is unsafe.
+		    {
+		      current_time = batch_record.time().get_time_in_secs();
+		      if (current_time >= end_time)
+			{
+			  end_of_frame = true;
+			  break;
+			}
+		      assert(current_time>=start_time);
+		      process_new_time_event(batch_record.time());
+		    }
+		  if (batch_record.is_event())
+		    ++num_events_in_batch;
+		}
+
+	      long num_stored_events_in_batch = 0;
+	      long num_prompts_in_batch = 0;
+	      long num_delayeds_in_batch = 0;
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(static) reduction(+:num_stored_events_in_batch,num_prompts_in_batch,num_delayeds_in_batch)
+#endif
+	      for (int i=0; i<static_cast<int>(num_events_in_batch); ++i)
+		{
+		  const CListEvent& event = batch_of_records[i]->event();
+		  Bin bin;
+		  bin.set_bin_value(1);
+		  get_bin_from_event(bin, event);
+		  if (bin.get_bin_value()<=0
+		      || bin.tangential_pos_num()< proj_data_ptr->get_min_tangential_pos_num()
+		      || bin.tangential_pos_num()> proj_data_ptr->get_max_tangential_pos_num()
+		      || bin.axial_pos_num()<proj_data_ptr->get_min_axial_pos_num(bin.segment_num())
+		      || bin.axial_pos_num()>proj_data_ptr->get_max_axial_pos_num(bin.segment_num()))
+		    continue;
+		  const int event_increment =
+		    event.is_prompt() 
+		    ? ( store_prompts ? 1 : 0 )
+		    :  delayed_increment;
+		  if (event_increment==0)
+		    continue;
+		  do_post_normalisation(bin);
+		  num_stored_events_in_batch += event_increment;
+		  if (event.is_prompt())
+		    ++num_prompts_in_batch;
+		  else
+		    ++num_delayeds_in_batch;
+		  const float increment = bin.get_bin_value() * event_increment;
+		  if (bin.segment_num() <= first_end_segment_index)
+		    {
+		      elem_type& elem =
+			(*segments[bin.segment_num()])[bin.view_num()][bin.axial_pos_num()][bin.tangential_pos_num()];
+#ifdef STIR_OPENMP
+#pragma omp atomic
+#endif
+		      elem += increment;
+		    }
+		  else
+		    {
+#ifdef STIR_OPENMP
+#pragma omp critical(LmToProjData_spill)
+#endif
+		      spill_file_for_segment[bin.segment_num()]->add(bin, increment);
+		    }
+		}
+	      // report progress once per batch (as with the serial code, every 500000 events)
+	      if ((num_stored_events + num_stored_events_in_batch)/500000L != num_stored_events/500000L)
+		cout << "\r" << num_stored_events + num_stored_events_in_batch << " events stored" << flush;
+	      num_stored_events += num_stored_events_in_batch;
+	      num_prompts_in_frame += num_prompts_in_batch;
+	      num_delayeds_in_frame += num_delayeds_in_batch;
+	    }
+	  time_of_last_stored_event = 
+	    max(time_of_last_stored_event,current_time); 
+	}
+      else
+      {      
+	// loop over all events in the listmode file
+	while (more_events)
+	  {
+	    if (lm_data_ptr->get_next_record(record) == Succeeded::no) 
+	      {
+		// no more events in file for some reason
+		break; //get out of while loop
+	      }
+	    if (record.is_time() && end_time > 0.01) // Direct comparison within doubles is unsafe.
+	      {
+		current_time = record.time().get_time_in_secs();
+		if (do_time_frame && current_time >= end_time)
+		  break; // get out of while loop
+		assert(current_time>=start_time);
+		process_new_time_event(record.time());
+	      }
+	    // note: could do "else if" here if we would be sure that
+	    // a record can never be both timing and coincidence event
+	    // and there might be a scanner around that has them both combined.
+	    if (record.is_event())
+	      {
+		assert(start_time <= current_time);
+		Bin bin;
+		// set value in case the event decoder doesn't touch it
+		// otherwise it would be 0 and all events will be ignored
+		bin.set_bin_value(1);
+		get_bin_from_event(bin, record.event());
 		     		       
-		     // check if it's inside the range we want to store
-		     if (bin.get_bin_value()>0
-			 && bin.tangential_pos_num()>= proj_data_ptr->get_min_tangential_pos_num()
-			 && bin.tangential_pos_num()<= proj_data_ptr->get_max_tangential_pos_num()
-			 && bin.axial_pos_num()>=proj_data_ptr->get_min_axial_pos_num(bin.segment_num())
-			 && bin.axial_pos_num()<=proj_data_ptr->get_max_axial_pos_num(bin.segment_num())
-			 ) 
-		       {
-			 assert(bin.view_num()>=proj_data_ptr->get_min_view_num());
-			 assert(bin.view_num()<=proj_data_ptr->get_max_view_num());
+		// check if it's inside the range we want to store
+		if (bin.get_bin_value()>0
+		    && bin.tangential_pos_num()>= proj_data_ptr->get_min_tangential_pos_num()
+		    && bin.tangential_pos_num()<= proj_data_ptr->get_max_tangential_pos_num()
+		    && bin.axial_pos_num()>=proj_data_ptr->get_min_axial_pos_num(bin.segment_num())
+		    && bin.axial_pos_num()<=proj_data_ptr->get_max_axial_pos_num(bin.segment_num())
+		    ) 
+		  {
+		    assert(bin.view_num()>=proj_data_ptr->get_min_view_num());
+		    assert(bin.view_num()<=proj_data_ptr->get_max_view_num());
             
-			 // see if we increment or decrement the value in the sinogram
-			 const int event_increment =
-			   record.event().is_prompt() 
-			   ? ( store_prompts ? 1 : 0 ) // it's a prompt
-			   :  delayed_increment;//it is a delayed-coincidence event
+		    // see if we increment or decrement the value in the sinogram
+		    const int event_increment =
+		      record.event().is_prompt() 
+		      ? ( store_prompts ? 1 : 0 ) // it's a prompt
+		      :  delayed_increment;//it is a delayed-coincidence event
             
-			 if (event_increment==0)
-			   continue;
+		    if (event_increment==0)
+		      continue;
             
-			 if (!do_time_frame)
-			   more_events-= event_increment;
+		    if (!do_time_frame)
+		      more_events-= event_increment;
             
-			 // now check if we have its segment in memory
-			 if (bin.segment_num() >= start_segment_index && bin.segment_num()<=end_segment_index)
-			   {
-			     do_post_normalisation(bin);
+		    do_post_normalisation(bin);
 			 
-			     num_stored_events += event_increment;
-			     if (record.event().is_prompt())
-			       ++num_prompts_in_frame;
-			     else
-			       ++num_delayeds_in_frame;
+		    num_stored_events += event_increment;
+		    if (record.event().is_prompt())
+		      ++num_prompts_in_frame;
+		    else
+		      ++num_delayeds_in_frame;
 
-			     if (num_stored_events%500000L==0) cout << "\r" << num_stored_events << " events stored" << flush;
+		    if (num_stored_events%500000L==0) cout << "\r" << num_stored_events << " events stored" << flush;
                             
-			     if (interactive)
-			       printf("Seg %4d view %4d ax_pos %4d tang_pos %4d time %8g stored with incr %d \n", 
-				      bin.segment_num(), bin.view_num(), bin.axial_pos_num(), bin.tangential_pos_num(),
-				      current_time, event_increment);
-			     else
-			       (*segments[bin.segment_num()])[bin.view_num()][bin.axial_pos_num()][bin.tangential_pos_num()] += 
-			       bin.get_bin_value() * 
-			       event_increment;
-			   }
-		       }
-		     else 	// event is rejected for some reason
-		       {
-			 if (interactive)
-			   printf("Seg %4d view %4d ax_pos %4d tang_pos %4d time %8g ignored\n", 
-				  bin.segment_num(), bin.view_num(), bin.axial_pos_num(), bin.tangential_pos_num(), current_time);
-		       }     
-		   } // end of spatial event processing
-	       } // end of while loop over all events
-
-	     time_of_last_stored_event = 
-	       max(time_of_last_stored_event,current_time); 
-	   } 
-
-	   if (!interactive)
-	   save_and_delete_segments(output, segments, 
-				    start_segment_index, end_segment_index, 
-				    *proj_data_ptr);  
-	 } // end of for loop for segment range
+		    if (interactive)
+		      printf("Seg %4d view %4d ax_pos %4d tang_pos %4d time %8g stored with incr %d \n", 
+			     bin.segment_num(), bin.view_num(), bin.axial_pos_num(), bin.tangential_pos_num(),
+			     current_time, event_increment);
+		    else if (bin.segment_num() <= first_end_segment_index)
+		      (*segments[bin.segment_num()])[bin.view_num()][bin.axial_pos_num()][bin.tangential_pos_num()] += 
+			bin.get_bin_value() * 
+			event_increment;
+		    else
+		      spill_file_for_segment[bin.segment_num()]->add(bin, bin.get_bin_value() * event_increment);
+		  }
+		else 	// event is rejected for some reason
+		  {
+		    if (interactive)
+		      printf("Seg %4d view %4d ax_pos %4d tang_pos %4d time %8g ignored\n", 
+			     bin.segment_num(), bin.view_num(), bin.axial_pos_num(), bin.tangential_pos_num(), current_time);
+		  }     
+	      } // end of spatial event processing
+	  } // end of while loop over all events
+
+	time_of_last_stored_event = 
+	  max(time_of_last_stored_event,current_time); 
+      } 
+
+      if (!interactive)
+	{
+	  save_and_delete_segments(output, segments, 
+				   proj_data_ptr->get_min_segment_num(), first_end_segment_index, 
+				   *proj_data_ptr);
+	  // now process the other segments
+	  for (std::size_t i=0; i<spill_files.size(); ++i)
+	    {
+	      cerr << "\nProcessing next batch of segments\n";
+	      SegmentSpillFile& spill_file = *spill_files[i];
+	      allocate_segments(segments, spill_file.get_start_segment_num(), spill_file.get_end_segment_num(),
+				proj_data_ptr->get_proj_data_info_ptr());
+	      spill_file.add_to_segments(segments);
+	      save_and_delete_segments(output, segments, 
+				       spill_file.get_start_segment_num(), spill_file.get_end_segment_num(), 
+				       *proj_data_ptr);
+	    }
+	}
        cerr <<  "\nNumber of prompts stored in this time period : " << num_prompts_in_frame
 	    <<  "\nNumber of delayeds stored in this time period: " << num_delayeds_in_frame
 	    << '\n';
@@ -8,7 +8,8 @@ $(dir)_LIB_SOURCES = \
 	LmToProjData.cxx \
 	LmToProjDataBootstrap.cxx \
 	CListModeDataECAT8_32bit.cxx \
-	CListRecordECAT8_32bit.cxx
+	CListRecordECAT8_32bit.cxx \
+	ListModeEventCache.cxx
 
 ifeq ($(HAVE_LLN_MATRIX),1)
   $(dir)_LIB_SOURCES +=  \
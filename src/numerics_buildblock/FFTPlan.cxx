@@ -0,0 +1,444 @@
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup DFT
+  \brief Implementation of classes stir::FFTPlan and stir::RealFFTPlan
+
+  The complex transform is a recursive mixed-radix decimation-in-time
+  algorithm. At every level, the input is split in \c radix interleaved
+  sub-sequences. Their DFTs are computed (recursively) and stored
+  consecutively in the output. A butterfly pass then combines them.
+*/
+
+#include "stir/numerics/FFTPlan.h"
+#include "stir/is_null_ptr.h"
+#include "stir/common.h"
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <cmath>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+
+START_NAMESPACE_STIR
+
+namespace
+{
+  /* We write complex multiplication explicitly. std::complex operator*
+     checks for NaNs and infinities (unless using -ffast-math), which makes it
+     a lot slower.
+  */
+  template <typename T>
+  inline std::complex<T>
+  multiply(const std::complex<T>& a, const std::complex<T>& b)
+  {
+    return std::complex<T>(a.real()*b.real() - a.imag()*b.imag(),
+                           a.real()*b.imag() + a.imag()*b.real());
+  }
+
+  //! returns sign*i*a
+  template <typename T>
+  inline std::complex<T>
+  multiply_by_sign_i(const std::complex<T>& a, const int sign)
+  {
+    return sign>0 ? std::complex<T>(-a.imag(), a.real()) : std::complex<T>(a.imag(), -a.real());
+  }
+}
+
+/******************************************************************
+ FFTPlan
+*****************************************************************/
+
+template <typename T>
+shared_ptr<const FFTPlan<T> >
+FFTPlan<T>::
+get_plan(const int length, const int sign)
+{
+  // check here, as we cannot throw out of the critical section
+  if (length<0 || (sign!=1 && sign!=-1))
+    error("FFTPlan::get_plan called with invalid length (%d) or sign (%d)", length, sign);
+  shared_ptr<const FFTPlan<T> > plan_sptr;
+#ifdef STIR_OPENMP
+#pragma omp critical(STIR_FFTPLAN_GET_PLAN)
+#endif
+  {
+    static std::map<std::pair<int,int>, shared_ptr<const FFTPlan<T> > > cache;
+    shared_ptr<const FFTPlan<T> >& cached_plan_sptr = cache[std::make_pair(length, sign)];
+    if (is_null_ptr(cached_plan_sptr))
+      cached_plan_sptr.reset(new FFTPlan<T>(length, sign));
+    plan_sptr = cached_plan_sptr;
+  }
+  return plan_sptr;
+}
+
+template <typename T>
+FFTPlan<T>::
+FFTPlan(const int length_v, const int sign_v)
+  : length(length_v), sign(sign_v)
+{
+  if (length<0 || (sign!=1 && sign!=-1))
+    error("FFTPlan called with invalid length (%d) or sign (%d)", length, sign);
+
+  // find factors, starting with 4 (as that one needs the least operations per element)
+  int n = length;
+  int radix = 4;
+  while (n>1)
+    {
+      while (n % radix != 0)
+        {
+          switch (radix)
+            {
+            case 4: radix = 2; break;
+            case 2: radix = 3; break;
+            default: radix += 2; break;
+            }
+          if (radix*radix > n)
+            radix = n;
+        }
+      n /= radix;
+      factors.push_back(radix);
+      factors.push_back(n);
+    }
+
+  twiddles.resize(length);
+  for (int k=0; k<length; ++k)
+    {
+      const double angle = sign*2*_PI*k/length;
+      twiddles[k] = complex_type(static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle)));
+    }
+}
+
+template <typename T>
+std::vector<int>
+FFTPlan<T>::
+get_radices() const
+{
+  std::vector<int> radices;
+  for (unsigned int i=0; i<factors.size(); i+=2)
+    radices.push_back(factors[i]);
+  return radices;
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+transform(complex_type * const out, const complex_type * const in, const int in_stride) const
+{
+  if (length==0)
+    return;
+  if (length==1)
+    {
+      *out = *in;
+      return;
+    }
+  do_transform(out, in, in_stride, 1, 0);
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+transform_in_place(complex_type * const data, complex_type * const scratch) const
+{
+  std::copy(data, data+length, scratch);
+  transform(data, scratch);
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+transform_many_in_place(complex_type * const data, const int num_transforms, const int distance) const
+{
+  if (length==0)
+    return;
+#ifdef STIR_OPENMP
+#pragma omp parallel if (num_transforms > 1 && !omp_in_parallel())
+#endif
+  {
+    // every thread uses its own scratch space
+    std::vector<complex_type> scratch(length);
+#ifdef STIR_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int i=0; i<num_transforms; ++i)
+      transform_in_place(data + static_cast<std::ptrdiff_t>(i)*distance, &scratch[0]);
+  }
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+do_transform(complex_type * const out, const complex_type * in,
+             const int in_stride, const int fstride, const int factor_num) const
+{
+  const int radix = factors[factor_num];
+  const int m = factors[factor_num+1];
+  const complex_type * const out_end = out + radix*m;
+  const std::ptrdiff_t step = static_cast<std::ptrdiff_t>(fstride)*in_stride;
+
+  // compute the DFTs of the sub-sequences (or just copy if they have length 1)
+  if (m==1)
+    {
+      for (complex_type * out_ptr = out; out_ptr != out_end; ++out_ptr, in += step)
+        *out_ptr = *in;
+    }
+  else
+    {
+      for (complex_type * out_ptr = out; out_ptr != out_end; out_ptr += m, in += step)
+        do_transform(out_ptr, in, in_stride, fstride*radix, factor_num+2);
+    }
+
+  // combine them
+  switch (radix)
+    {
+    case 2: butterfly_2(out, fstride, m); break;
+    case 3: butterfly_3(out, fstride, m); break;
+    case 4: butterfly_4(out, fstride, m); break;
+    case 5: butterfly_5(out, fstride, m); break;
+    default: butterfly_generic(out, fstride, m, radix); break;
+    }
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+butterfly_2(complex_type * const out, const int fstride, const int m) const
+{
+  for (int k=0; k<m; ++k)
+    {
+      const complex_type t = multiply(out[k+m], twiddles[k*fstride]);
+      out[k+m] = out[k] - t;
+      out[k] += t;
+    }
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+butterfly_3(complex_type * const out, const int fstride, const int m) const
+{
+  const T half_sqrt3 = static_cast<T>(std::sqrt(3.)/2);
+  for (int k=0; k<m; ++k)
+    {
+      const complex_type a0 = out[k];
+      const complex_type a1 = multiply(out[k+m], twiddles[k*fstride]);
+      const complex_type a2 = multiply(out[k+2*m], twiddles[2*k*fstride]);
+      const complex_type sum = a1 + a2;
+      const complex_type base = a0 - sum*static_cast<T>(.5);
+      const complex_type rotated = multiply_by_sign_i((a1 - a2)*half_sqrt3, sign);
+      out[k] = a0 + sum;
+      out[k+m] = base + rotated;
+      out[k+2*m] = base - rotated;
+    }
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+butterfly_4(complex_type * const out, const int fstride, const int m) const
+{
+  for (int k=0; k<m; ++k)
+    {
+      const complex_type a0 = out[k];
+      const complex_type a1 = multiply(out[k+m], twiddles[k*fstride]);
+      const complex_type a2 = multiply(out[k+2*m], twiddles[2*k*fstride]);
+      const complex_type a3 = multiply(out[k+3*m], twiddles[3*k*fstride]);
+      const complex_type sum02 = a0 + a2;
+      const complex_type diff02 = a0 - a2;
+      const complex_type sum13 = a1 + a3;
+      const complex_type rotated = multiply_by_sign_i(a1 - a3, sign);
+      out[k] = sum02 + sum13;
+      out[k+m] = diff02 + rotated;
+      out[k+2*m] = sum02 - sum13;
+      out[k+3*m] = diff02 - rotated;
+    }
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+butterfly_5(complex_type * const out, const int fstride, const int m) const
+{
+  const T cos1 = static_cast<T>(std::cos(2*_PI/5));
+  const T cos2 = static_cast<T>(std::cos(4*_PI/5));
+  const T sin1 = static_cast<T>(std::sin(2*_PI/5));
+  const T sin2 = static_cast<T>(std::sin(4*_PI/5));
+  for (int k=0; k<m; ++k)
+    {
+      const complex_type a0 = out[k];
+      const complex_type a1 = multiply(out[k+m], twiddles[k*fstride]);
+      const complex_type a2 = multiply(out[k+2*m], twiddles[2*k*fstride]);
+      const complex_type a3 = multiply(out[k+3*m], twiddles[3*k*fstride]);
+      const complex_type a4 = multiply(out[k+4*m], twiddles[4*k*fstride]);
+      const complex_type sum14 = a1 + a4;
+      const complex_type diff14 = a1 - a4;
+      const complex_type sum23 = a2 + a3;
+      const complex_type diff23 = a2 - a3;
+      const complex_type base1 = a0 + sum14*cos1 + sum23*cos2;
+      const complex_type base2 = a0 + sum14*cos2 + sum23*cos1;
+      const complex_type rotated1 = multiply_by_sign_i(diff14*sin1 + diff23*sin2, sign);
+      const complex_type rotated2 = multiply_by_sign_i(diff14*sin2 - diff23*sin1, sign);
+      out[k] = a0 + sum14 + sum23;
+      out[k+m] = base1 + rotated1;
+      out[k+4*m] = base1 - rotated1;
+      out[k+2*m] = base2 + rotated2;
+      out[k+3*m] = base2 - rotated2;
+    }
+}
+
+template <typename T>
+void
+FFTPlan<T>::
+butterfly_generic(complex_type * const out, const int fstride, const int m, const int radix) const
+{
+  std::vector<complex_type> scratch(radix);
+  // twiddles[q*s*twiddle_step] = exp(sign*2*pi*i*q*s/radix)
+  const int twiddle_step = fstride*m;
+  for (int k=0; k<m; ++k)
+    {
+      for (int q=0; q<radix; ++q)
+        scratch[q] = multiply(out[k+q*m], twiddles[q*k*fstride]);
+      for (int s=0; s<radix; ++s)
+        {
+          complex_type sum = scratch[0];
+          int twiddle_index = 0;
+          for (int q=1; q<radix; ++q)
+            {
+              twiddle_index += s*twiddle_step;
+              if (twiddle_index >= length)
+                twiddle_index %= length;
+              sum += multiply(scratch[q], twiddles[twiddle_index]);
+            }
+          out[k+s*m] = sum;
+        }
+    }
+}
+
+/******************************************************************
+ RealFFTPlan
+*****************************************************************/
+
+template <typename T>
+shared_ptr<const RealFFTPlan<T> >
+RealFFTPlan<T>::
+get_plan(const int length, const int sign)
+{
+  // check here, as we cannot throw out of the critical section
+  if (length<0 || length%2!=0 || (sign!=1 && sign!=-1))
+    error("RealFFTPlan::get_plan called with invalid length (%d) or sign (%d). Length has to be even.",
+          length, sign);
+  shared_ptr<const RealFFTPlan<T> > plan_sptr;
+#ifdef STIR_OPENMP
+#pragma omp critical(STIR_REALFFTPLAN_GET_PLAN)
+#endif
+  {
+    static std::map<std::pair<int,int>, shared_ptr<const RealFFTPlan<T> > > cache;
+    shared_ptr<const RealFFTPlan<T> >& cached_plan_sptr = cache[std::make_pair(length, sign)];
+    if (is_null_ptr(cached_plan_sptr))
+      cached_plan_sptr.reset(new RealFFTPlan<T>(length, sign));
+    plan_sptr = cached_plan_sptr;
+  }
+  return plan_sptr;
+}
+
+template <typename T>
+RealFFTPlan<T>::
+RealFFTPlan(const int length_v, const int sign_v)
+  : length(length_v), sign(sign_v)
+{
+  if (length<0 || length%2!=0 || (sign!=1 && sign!=-1))
+    error("RealFFTPlan called with invalid length (%d) or sign (%d). Length has to be even.",
+          length, sign);
+  const int n = length/2;
+  plan_sptr = FFTPlan<T>::get_plan(n, sign);
+  inverse_plan_sptr = FFTPlan<T>::get_plan(n, -sign);
+  // forward_factors[k] = exp(i*(sign*pi*k/n - pi/2)), inverse_factors[k] = exp(i*(-sign*pi*k/n + pi/2))
+  forward_factors.resize(n/2+1);
+  inverse_factors.resize(n/2+1);
+  for (int k=0; k<=n/2; ++k)
+    {
+      const double angle = sign*_PI*k/n;
+      forward_factors[k] = complex_type(static_cast<T>(std::sin(angle)), static_cast<T>(-std::cos(angle)));
+      inverse_factors[k] = complex_type(static_cast<T>(std::sin(angle)), static_cast<T>(std::cos(angle)));
+    }
+}
+
+template <typename T>
+void
+RealFFTPlan<T>::
+transform(complex_type * const out, const T * const in, complex_type * const scratch) const
+{
+  if (length==0)
+    return;
+  const int n = length/2;
+  /* Put the even-numbered elements in the real part and the odd-numbered in
+     the imaginary part. We need to divide by 2 in the final result. To save
+     some time, we do that already here.
+  */
+  for (int i=0; i<n; ++i)
+    scratch[i] = complex_type(in[2*i]/2, in[2*i+1]/2);
+  plan_sptr->transform(out, scratch);
+  // now find the DFT of the real data from the DFT of the even and odd elements
+  for (int k=1; k<=n/2; ++k)
+    {
+      const complex_type t1 = out[k] + std::conj(out[n-k]);
+      const complex_type t2 = multiply(forward_factors[k], out[k] - std::conj(out[n-k]));
+      out[k] = t1 + t2;
+      out[n-k] = std::conj(t1 - t2);
+    }
+  const complex_type out0 = out[0];
+  out[0] = (out0.real() + out0.imag())*2;
+  out[n] = (out0.real() - out0.imag())*2;
+}
+
+template <typename T>
+void
+RealFFTPlan<T>::
+inverse_transform(T * const out, complex_type * const in, complex_type * const scratch) const
+{
+  if (length==0)
+    return;
+  const int n = length/2;
+  for (int k=1; k<=n/2; ++k)
+    {
+      const complex_type t1 = in[k] + std::conj(in[n-k]);
+      const complex_type t2 = multiply(inverse_factors[k], in[k] - std::conj(in[n-k]));
+      in[k] = t1 + t2;
+      in[n-k] = std::conj(t1 - t2);
+    }
+  in[0] = complex_type(in[0].real() + in[n].real(), in[0].real() - in[n].real());
+  inverse_plan_sptr->transform(scratch, in);
+  // extract real numbers, dividing by n for the inverse DFT, and by 2 for the above
+  const T scale = static_cast<T>(1)/length;
+  for (int i=0; i<n; ++i)
+    {
+      out[2*i] = scratch[i].real()*scale;
+      out[2*i+1] = scratch[i].imag()*scale;
+    }
+}
+
+/*****************************************************************
+ * INSTANTIATIONS
+ ******************************************************************/
+
+template class FFTPlan<float>;
+template class FFTPlan<double>;
+template class RealFFTPlan<float>;
+template class RealFFTPlan<double>;
+
+END_NAMESPACE_STIR
@@ -7,6 +7,7 @@
 */
 /*
     Copyright (C) 2003 - 2005-01-17, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
 
     This file is part of STIR.
 
@@ -23,121 +24,131 @@
     See STIR/LICENSE.txt for details
 */
 #include "stir/numerics/fourier.h"
-#include "stir/round.h"
+#include "stir/numerics/FFTPlan.h"
+#include "stir/IndexRange2D.h"
 #include "stir/modulo.h"
 #include "stir/array_index_functions.h"
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
 START_NAMESPACE_STIR
 
 
-template <typename T>
-static void bitreversal(VectorWithOffset<T>& data)
+namespace detail {
+
+/* A class that computes the 1D transform along the outer index.
+
+   This is done with a class because partial template specialisation is
+   more powerful than function overloading.
+*/
+template <typename elemT>
+struct fourier_1d_auxiliary
 {
-  const int n=data.get_length();
-  int   j=1;
-  for (int i=0;i<n;++i) {
-    if (j/2 > i) {
-      std::swap(data[j/2],data[i]);
-    }
-    int m=n;
-    while (m >= 2 && j > m) {
-      j -= m;
-      m >>= 1;
+  /* General case: the elements of c are arrays. We copy the data into a
+     contiguous block, and transform every "column" of that block (using
+     several threads if possible).
+  */
+  static void
+  do_fourier_1d(VectorWithOffset<elemT>& c, const int sign)
+  {
+    typedef typename std::iterator_traits<typename elemT::full_iterator>::value_type complex_t;
+    typedef typename complex_t::value_type real_t;
+    const int length = c.get_length();
+    const std::size_t inner_size = c[0].size_all();
+    for (int i=1; i<length; ++i)
+      if (c[i].size_all() != inner_size)
+        error("fourier_1d called with array where the elements do not have the same size\n");
+    if (inner_size==0)
+      return;
+
+    std::vector<complex_t> data(length*inner_size);
+    for (int i=0; i<length; ++i)
+      {
+        const elemT& current = c[i];
+        std::copy(current.begin_all(), current.end_all(), data.begin() + i*inner_size);
+      }
+
+    const shared_ptr<const FFTPlan<real_t> > plan_sptr = FFTPlan<real_t>::get_plan(length, sign);
+    const int num_columns = static_cast<int>(inner_size);
+#ifdef STIR_OPENMP
+#pragma omp parallel if (num_columns > 1 && !omp_in_parallel())
+#endif
+    {
+      // every thread uses its own buffer
+      std::vector<complex_t> column(length);
+#ifdef STIR_OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (int j=0; j<num_columns; ++j)
+        {
+          plan_sptr->transform(&column[0], &data[j], num_columns);
+          for (int i=0; i<length; ++i)
+            data[i*inner_size + j] = column[i];
+        }
     }
-    j += m;
+
+    for (int i=0; i<length; ++i)
+      std::copy(data.begin() + i*inner_size, data.begin() + (i+1)*inner_size, c[i].begin_all());
   }
-}
+};
 
-/* We cache factors exp(i*_PI/pow(2,k)). They will be computed during the first
-   call of the Fourier functions, and then stored in static arrays.
-*/
-// exparray[k][i] = exp(i*_PI/pow(2,k))
-typedef VectorWithOffset<VectorWithOffset<std::complex<float> > > exparray_t;
-static   exparray_t exparray;
+// specialisation for the one-dimensional case
+#ifndef BOOST_NO_TEMPLATE_PARTIAL_SPECIALIZATION
 
-static void init_exparray(const int k, const int pow2k)
+template <typename elemT>
+struct fourier_1d_auxiliary<std::complex<elemT> >
 {
-  if (exparray.get_max_index() >= k && exparray[k].size()>0)
-    return;
-
-  if (exparray.get_max_index() <k)
-    exparray.grow(0, k);
-  exparray[k].grow(0,pow2k-1);
-  for (int i=0; i< pow2k; ++i)
-    exparray[k][i]= std::exp(std::complex<float>(0, static_cast<float>((i*_PI)/pow2k)));
-}
+  static void
+  do_fourier_1d(VectorWithOffset<std::complex<elemT> >& c, const int sign)
+  {
+    std::vector<std::complex<elemT> > scratch(c.get_length());
+    FFTPlan<elemT>::get_plan(c.get_length(), sign)->transform_in_place(&c[0], &scratch[0]);
+  }
+};
 
-// expminarray[k][i] = exp(-i*_PI/pow(2,k))
-// obviously just the complex conjugate of exparray
-static   exparray_t expminarray;
+#else  //no partial template specialisation
 
-static void init_expminarray(const int k, const int pow2k)
+// we just list float and double explicitly
+struct fourier_1d_auxiliary<std::complex<float> >
 {
-  if (expminarray.get_max_index() >= k && expminarray[k].size()>0)
-    return;
+  static void
+  do_fourier_1d(VectorWithOffset<std::complex<float> >& c, const int sign)
+  {
+    std::vector<std::complex<float> > scratch(c.get_length());
+    FFTPlan<float>::get_plan(c.get_length(), sign)->transform_in_place(&c[0], &scratch[0]);
+  }
+};
 
-  if (expminarray.get_max_index() <k)
-    expminarray.grow(0, k);
-  expminarray[k].grow(0,pow2k-1);
-  for (int i=0; i< pow2k; ++i)
-    expminarray[k][i]= std::exp(std::complex<float>(0, static_cast<float>(-(i*_PI)/pow2k)));
-}
+struct fourier_1d_auxiliary<std::complex<double> >
+{
+  static void
+  do_fourier_1d(VectorWithOffset<std::complex<double> >& c, const int sign)
+  {
+    std::vector<std::complex<double> > scratch(c.get_length());
+    FFTPlan<double>::get_plan(c.get_length(), sign)->transform_in_place(&c[0], &scratch[0]);
+  }
+};
+#endif
 
+} // end of namespace detail
 
-/* First we define 1D fourier transforms of vectors with almost arbitrary
-   element types.
-   This is almost a straightforward 1D FFT implementation. The only tricky bit
-   is to make sure that all operations are written in a way that is defined
-   (and efficient) in the case that the element type is a vector again.
+/* The 1D transforms are computed using FFTPlan (which caches factorisations
+   and twiddle factors, and can be used by multiple threads).
 */
-
 template <typename T>
 void fourier_1d(T& c, const int sign)
 {
   if (c.size()==0) return;
   assert(c.get_min_index()==0);
   assert(sign==1 || sign ==-1);
-  bitreversal(c);
-  // find 'nn' which is such that length==2^nn
-  const int nn=round(log(static_cast<double>(c.size()))/log(2.));
-  if (c.get_length()!= round(pow(2.,nn)))
-    error ("fourier_1d called with array length %d which is not 2^%d\n", c.size(), nn);
-
-  int k=0;
-  int pow2k = 1; // will be updated to be round(pow(2,k))
-  const int pow2nn=c.get_length(); // ==round(pow(2,nn)); 
-  for (; k<nn; ++k, pow2k*=2)
-  {
-    if (sign==1)
-      init_exparray(k,pow2k);
-    else
-      init_expminarray(k,pow2k);
-    const exparray_t& cur_exparray =
-      sign==1? exparray : expminarray;      
-    for (int j=0; j< pow2nn;j+= pow2k*2) 
-      for (int i=0; i< pow2k; ++i)
-      {
-        typename T::reference c1= c[i + j];
-        typename T::reference c2= c[i + j + pow2k];
-        
-        typename T::value_type const t1 = c1; 
-	/* here is what we have to do:
-            typename T::value_type const t2 = 
-              c2*cur_exparray[k][i];
-            c1 = t1+t2; c2 = t1-t2;
-	 however, this would create an unnecessary copy of t2, which is 
-	 potentially large.
-	 So, we rewrite it without t2, and using operations that also 
-	 work when using multi-dim arrays.
-	 Note that for multi-dimensional arrays, this code involves 4 
-	 loops over the same data.
-	 Using expression templates would speed this up.
-	*/
-        c2 *= cur_exparray[k][i];
-        c1 += c2;
-        c2 *= -1;
-        c2 += t1;
-      }
-  }
+#if !defined(_MSC_VER) || _MSC_VER>1200
+  detail::fourier_1d_auxiliary<typename T::value_type>::do_fourier_1d(c,sign);
+#else
+  detail::fourier_1d_auxiliary<T::value_type>::do_fourier_1d(c,sign);
+#endif
 }
 
 namespace detail {
@@ -222,10 +233,7 @@ fourier(T& c, const int sign)
 template <typename T>
 Array<1,std::complex<T> >
 fourier_1d_for_real_data(const Array<1,T>& v, const int sign)
-//Array<1,std::complex<typename T::value_type> >
-//fourier_1d_for_real_data(const T& v, const int sign)
 {
-  //typedef std::complex<typename T::value_type> complex_t;
   typedef std::complex<T> complex_t;
   if (v.size()==0) return Array<1,complex_t>();
   assert(v.get_min_index()==0);
@@ -233,41 +241,10 @@ fourier_1d_for_real_data(const Array<1,T>& v, const int sign)
   if (v.size()%2!=0)
     error("fourier_1d_of_real can only handle arrays of even length.\n");
 
-  Array<1,complex_t> c;
-  const unsigned int n = static_cast<unsigned int>(v.size()/2);
-  // we reserve a range of 0,n here, such that 
-  // resize(n) later doesn't reallocate and copy
-  c.reserve(n+1);
-  c.resize(n);
-  // fill in complex numbers.
-  // note: we need to divide by 2 in the final result. To save
-  // some time, we do that already here.
-  for (int i=0; i<c.get_length(); ++i)
-    c[i] =  complex_t(v[2*i]/2, v[2*i+1]/2);
-
-  fourier_1d(c, sign);
-
-  //cout << "C: " << c;
-  c.resize(n+1);
-  for (unsigned int i=1; i<=n/2; ++i)
-    {
-      const complex_t t1 = 
-	(c[i]+std::conj(c[n-i]));
-      // TODO could get exp() from static exparray
-      // the nice thing about this code that it works even when the length is not a power of 2
-      // (but of course, the call to fourier_1d would currently abort in that case)
-      const complex_t t2 = 			   
-	std::exp(complex_t(0, static_cast<T>(sign*(i*_PI)/n-_PI/2)))*
-	(c[i]-std::conj(c[n-i]));
-
-      c[i] = (t1 + t2);
-      c[n-i] = std::conj(t1-t2);
-    }
-  {
-    const complex_t c0_copy = c[0];
-    c[0]=(c0_copy.real() + c0_copy.imag())*2;
-    c[n]=(c0_copy.real() - c0_copy.imag())*2;
-  }
+  const int n = v.get_length()/2;
+  Array<1,complex_t> c(n+1);
+  std::vector<complex_t> scratch(n);
+  RealFFTPlan<T>::get_plan(v.get_length(), sign)->transform(&c[0], &v[0], &scratch[0]);
   return c;
 }
 
@@ -281,48 +258,16 @@ inverse_fourier_1d_for_real_data_corrupting_input(Array<1,std::complex<T> >& c,
   assert(c.get_min_index()==0);
   assert(sign==1 || sign ==-1);
   const int n = c.get_length()-1;
-  if (n%2!=0)
-    error("inverse_fourier_1d_of_real_data can only handle arrays of even length.\n");
-
-  /* Problematic asserts to check that the imaginary part of c[0] and c[n] is 0
-     Trouble is that it could be only approximately 0 (e.g. when calling 
-     inverse_fourier_real_data on multi-dimensional arrays).
-     The version below tries to circumvent this problem by comparing with the
-     norm of c. That fails however when c is zero (up to numerical precision).
-     We can only know this by looking at the higher dimensional array, but
-     we don't have that one to our disposal in this function.
-     So, I disabled the asserts.
-  */
-  //assert(fabs(c[0].imag())<=.001*norm(c.begin_all(),c.end_all())/sqrt(n+1.)); // note divide by n+1 to avoid division by 0
-  //assert(fabs(c[n].imag())<=.001*norm(c.begin_all(),c.end_all())/sqrt(n+1.));
-  for (int i=1; i<=n/2; ++i)
-    {
-      const complex_t t1 = (c[i]+std::conj(c[n-i]));
-      // TODO could get exp() from static exparray
-      const complex_t t2 = 			   
-	std::exp(complex_t(0, static_cast<T>(-sign*(i*_PI)/n+_PI/2)))*
-	(c[i]-std::conj(c[n-i]));
-
-      c[i] = (t1 + t2);
-      c[n-i] = std::conj(t1-t2);
-    }
-  {
-    c[0]=complex_t((c[0].real() + c[n].real()),
-		   (c[0].real() - c[n].real())
-		   );
-  }
+  if (n==0) return Array<1,T>();
 
-  // now get rid of c[n] 
-  c.resize(n);
-  //cout << "\nC: " << c/4;
-  inverse_fourier(c, sign);
-  // extract real numbers.
+  /* Note: we do not check that the imaginary part of c[0] and c[n] is 0.
+     It could be only approximately 0 (e.g. when calling
+     inverse_fourier_real_data on multi-dimensional arrays), and
+     we don't know the size of the higher dimensional array here.
+  */
   Array<1,T> v(2*n);
-  for (int i=0; i<n; ++i)
-    {
-      v[2*i]= c[i].real()/2;
-      v[2*i+1]= c[i].imag()/2;
-    }
+  std::vector<complex_t> scratch(n);
+  RealFFTPlan<T>::get_plan(2*n, sign)->inverse_transform(&v[0], &c[0], &scratch[0]);
   return v;
 }
 
@@ -334,6 +279,91 @@ inverse_fourier_1d_for_real_data(const Array<1,std::complex<T> >& c, const int s
   return inverse_fourier_1d_for_real_data_corrupting_input(tmp, sign);
 }
 
+/******************************************************************
+ DFT of all rows of a 2D array of real data
+*****************************************************************/
+
+template <typename T>
+void
+fourier_1d_for_real_data_of_rows(Array<2,std::complex<T> >& result, const Array<2,T>& rows, const int sign)
+{
+  typedef std::complex<T> complex_t;
+  assert(sign==1 || sign ==-1);
+  const int min_row = rows.get_min_index();
+  const int max_row = rows.get_max_index();
+  const int length = rows.get_length()==0 ? 0 : rows[min_row].get_length();
+  for (int r=min_row; r<=max_row; ++r)
+    if (rows[r].get_length() != length)
+      error("fourier_1d_for_real_data_of_rows called with rows of different lengths\n");
+  if (length%2!=0)
+    error("fourier_1d_for_real_data_of_rows can only handle rows of even length.\n");
+
+  const IndexRange2D range(min_row, max_row, 0, length==0 ? -1 : length/2);
+  if (!(result.get_index_range() == range))
+    result.resize(range);
+  if (length==0)
+    return;
+
+  const shared_ptr<const RealFFTPlan<T> > plan_sptr = RealFFTPlan<T>::get_plan(length, sign);
+#ifdef STIR_OPENMP
+#pragma omp parallel if (max_row > min_row && !omp_in_parallel())
+#endif
+  {
+    // every thread uses its own scratch space
+    std::vector<complex_t> scratch(length/2);
+#ifdef STIR_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int r=min_row; r<=max_row; ++r)
+      plan_sptr->transform(&result[r][0], &rows[r][rows[r].get_min_index()], &scratch[0]);
+  }
+}
+
+template <typename T>
+void
+inverse_fourier_1d_for_real_data_of_rows(Array<2,T>& result, const Array<2,std::complex<T> >& c, const int sign)
+{
+  typedef std::complex<T> complex_t;
+  assert(sign==1 || sign ==-1);
+  const int min_row = c.get_min_index();
+  const int max_row = c.get_max_index();
+  const int num_frequencies = c.get_length()==0 ? 1 : c[min_row].get_length();
+  for (int r=min_row; r<=max_row; ++r)
+    if (c[r].get_length() != num_frequencies)
+      error("inverse_fourier_1d_for_real_data_of_rows called with rows of different lengths\n");
+  if (num_frequencies==0)
+    error("inverse_fourier_1d_for_real_data_of_rows called with empty rows\n");
+  const int length = 2*(num_frequencies-1);
+
+  // keep the index range of result if it has the correct sizes
+  bool result_has_correct_sizes =
+    result.get_min_index()==min_row && result.get_max_index()==max_row;
+  for (int r=min_row; r<=max_row && result_has_correct_sizes; ++r)
+    result_has_correct_sizes = result[r].get_length()==length;
+  if (!result_has_correct_sizes)
+    result.resize(IndexRange2D(min_row, max_row, 0, length-1));
+  if (length==0)
+    return;
+
+  const shared_ptr<const RealFFTPlan<T> > plan_sptr = RealFFTPlan<T>::get_plan(length, sign);
+#ifdef STIR_OPENMP
+#pragma omp parallel if (max_row > min_row && !omp_in_parallel())
+#endif
+  {
+    // every thread uses its own copy of the input (as it is overwritten) and scratch space
+    std::vector<complex_t> frequencies(num_frequencies);
+    std::vector<complex_t> scratch(length/2);
+#ifdef STIR_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int r=min_row; r<=max_row; ++r)
+      {
+        std::copy(c[r].begin(), c[r].end(), frequencies.begin());
+        plan_sptr->inverse_transform(&result[r][result[r].get_min_index()], &frequencies[0], &scratch[0]);
+      }
+  }
+}
+
 
 // multi-dimensional case
 
@@ -403,6 +433,27 @@ struct fourier_for_real_data_auxiliary<1,elemT>
   }
 };
 
+// specialisation for the two-dimensional case, using the transforms of all rows at once
+template <typename elemT>
+struct fourier_for_real_data_auxiliary<2,elemT>
+{
+  static Array<2,std::complex<elemT> >
+  do_fourier_for_real_data(const Array<2,elemT>& c, const int sign)
+  {
+    Array<2,std::complex<elemT> > array;
+    fourier_1d_for_real_data_of_rows(array, c, sign);
+    fourier_1d(array, sign);
+    return array;
+  }
+  static Array<2,elemT>
+  do_inverse_fourier_for_real_data_corrupting_input(Array<2,std::complex<elemT> >& c, const int sign)
+  {
+    inverse_fourier_1d(c, sign);
+    Array<2,elemT> array;
+    inverse_fourier_1d_for_real_data_of_rows(array, c, sign);
+    return array;
+  }
+};
 
 #else  //no partial template specialisation
 
@@ -509,12 +560,39 @@ pos_frequencies_to_all(const Array<num_dimensions, std::complex<T> >& c)
 }
 
 
+int
+get_efficient_fourier_length(const int min_length)
+{
+  for (int length = std::max(2, min_length + min_length%2); ; length += 2)
+    {
+      int remainder = length;
+      while (remainder%2 == 0)
+        remainder /= 2;
+      while (remainder%3 == 0)
+        remainder /= 3;
+      while (remainder%5 == 0)
+        remainder /= 5;
+      if (remainder == 1)
+        return length;
+    }
+}
+
 /*****************************************************************
  * INSTANTIATIONS
  * add any you need
  ******************************************************************/
 
-// note: instantiate the highest dimension you need. That will do all lower dimensions
+/* note: instantiate every dimension that is used. Lower dimensions are used by
+   higher ones, but are not guaranteed to be emitted when the compiler inlines them.
+*/
+template
+void 
+fourier<>(Array<1,std::complex<float> >& c, const int sign);
+
+template
+void 
+fourier<>(Array<2,std::complex<float> >& c, const int sign);
+
 template
 void 
 fourier<>(Array<3,std::complex<float> >& c, const int sign);
@@ -523,6 +601,26 @@ template
 void 
 fourier<>(VectorWithOffset<std::complex<float> >& c, const int sign);
 
+template
+void
+fourier_1d<>(Array<1,std::complex<float> >& c, const int sign);
+
+template
+void
+fourier_1d<>(VectorWithOffset<std::complex<float> >& c, const int sign);
+
+template
+Array<1,std::complex<float> >
+fourier_1d_for_real_data<>(const Array<1,float>& v, const int sign);
+
+template
+Array<1,float>
+inverse_fourier_1d_for_real_data_corrupting_input<>(Array<1,std::complex<float> >& c, const int sign);
+
+template
+Array<1,float>
+inverse_fourier_1d_for_real_data<>(const Array<1,std::complex<float> >& c, const int sign);
+
 #define INSTANTIATE(d,type) \
  template \
  Array<d,std::complex<type> > \
@@ -542,4 +640,11 @@ INSTANTIATE(2,float);
 INSTANTIATE(3,float);
 #undef INSTANTIATE
 
+template
+void
+fourier_1d_for_real_data_of_rows<>(Array<2,std::complex<float> >& result, const Array<2,float>& rows, const int sign);
+template
+void
+inverse_fourier_1d_for_real_data_of_rows<>(Array<2,float>& result, const Array<2,std::complex<float> >& c, const int sign);
+
 END_NAMESPACE_STIR
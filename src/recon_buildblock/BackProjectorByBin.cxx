@@ -13,7 +13,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000- 2011, Hammersmith Imanet Ltd
-    Copyright (C) 2015, University College London
+    Copyright (C) 2015, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -32,6 +32,7 @@
 
 #include "stir/recon_buildblock/BackProjectorByBin.h"
 #include "stir/recon_buildblock/find_basic_vs_nums_in_subsets.h"
+#include "stir/recon_buildblock/ThreadLocalImages.h"
 #include "stir/RelatedViewgrams.h"
 #include "stir/ProjData.h"
 #include <vector>
@@ -64,16 +65,13 @@ BackProjectorByBin::back_project(DiscretisedDensity<3,float>& image,
                                          proj_data.get_min_segment_num(), proj_data.get_max_segment_num(),
                                          0, 1/*subset_num, num_subsets*/);
 
+  // every thread back projects into its own image, these are added at the end
+  ThreadLocalImages local_output_images(image);
 #ifdef STIR_OPENMP
-  std::vector< shared_ptr<DiscretisedDensity<3,float> > > local_output_image_sptrs;
-#pragma omp parallel shared(proj_data, symmetries_sptr, local_output_image_sptrs)
+#pragma omp parallel shared(proj_data, symmetries_sptr, local_output_images)
 #endif
   { 
 #ifdef STIR_OPENMP
-#pragma omp single
-    {
-      local_output_image_sptrs.resize(omp_get_num_threads(), shared_ptr<DiscretisedDensity<3,float> >());
-    }
 #pragma omp for schedule(runtime)  
 #endif
     // note: older versions of openmp need an int as loop
@@ -88,25 +86,10 @@ BackProjectorByBin::back_project(DiscretisedDensity<3,float>& image,
         const RelatedViewgrams<float> viewgrams = 
           proj_data.get_related_viewgrams(vs, symmetries_sptr);
 #endif
-#ifdef STIR_OPENMP
-        const int thread_num=omp_get_thread_num();
-        if(is_null_ptr(local_output_image_sptrs[thread_num]))
-          local_output_image_sptrs[thread_num].reset(image.get_empty_copy());
-        
-        back_project(*(local_output_image_sptrs[thread_num]), viewgrams);	  
-#else            
-        back_project(image, viewgrams);
-#endif
+        back_project(local_output_images.get_local_image(), viewgrams);
       }
   }
-#ifdef STIR_OPENMP
-  // "reduce" data constructed by threads
-  {
-    for (int i=0; i<static_cast<int>(local_output_image_sptrs.size()); ++i)
-      if(!is_null_ptr(local_output_image_sptrs[i])) // only accumulate if a thread filled something in
-        image += *(local_output_image_sptrs[i]);
-  }
-#endif
+  local_output_images.reduce();
 }
 
 void 
@@ -123,8 +123,8 @@ actual_back_project(DiscretisedDensity<3,float>& image,
 		    const int min_axial_pos_num, const int max_axial_pos_num,
 		    const int min_tangential_pos_num, const int max_tangential_pos_num)
 {
-  if (proj_matrix_ptr->is_cache_enabled()/* &&
-					    !proj_matrix_ptr->does_cache_store_only_basic_bins()*/)
+  if (proj_matrix_ptr->is_cache_enabled() &&
+      !proj_matrix_ptr->does_cache_store_only_basic_bins())
     {
       // straightforward version which relies on ProjMatrixByBin to sort out all 
       // symmetries
@@ -155,17 +155,17 @@ actual_back_project(DiscretisedDensity<3,float>& image,
     }  
   else
     {
-      // complicated version which handles the symmetries explicitly
-      // faster when no caching is performed, about just as fast when there is caching
-      ProjMatrixElemsForOneBin proj_matrix_row;
-      ProjMatrixElemsForOneBin proj_matrix_row_copy;
+      // version which handles the symmetries explicitly:
+      // for every basic bin, we get the rows for all related bins in one go
+      // faster when no caching is performed, or when only basic bins are cached
+      vector<ProjMatrixElemsForOneBin> related_rows;
       const DataSymmetriesForBins* symmetries = proj_matrix_ptr->get_symmetries_ptr(); 
 
       Array<2,int> 
 	already_processed(IndexRange2D(min_axial_pos_num, max_axial_pos_num,
 				       min_tangential_pos_num, max_tangential_pos_num));
 
-      vector<AxTangPosNumbers> related_ax_tang_poss;
+      vector<Bin> related_bins;
       for ( int tang_pos = min_tangential_pos_num ;tang_pos  <= max_tangential_pos_num ;++tang_pos)  
 	for ( int ax_pos = min_axial_pos_num; ax_pos <= max_axial_pos_num ;++ax_pos)
 	  {       
@@ -177,58 +177,60 @@ actual_back_project(DiscretisedDensity<3,float>& image,
 			  ax_pos,
 			  tang_pos);
 	    symmetries->find_basic_bin(basic_bin);
+
+	    // avoid getting the rows if all related bins are 0
+	    {
+	      symmetries->get_related_bins(related_bins, basic_bin,
+					   min_axial_pos_num, max_axial_pos_num,
+					   min_tangential_pos_num, max_tangential_pos_num);
+	      bool all_zero = true;
+	      for (vector<Bin>::const_iterator bin_iter = related_bins.begin();
+		   bin_iter != related_bins.end();
+		   ++bin_iter)
+		{
+		  already_processed[bin_iter->axial_pos_num()][bin_iter->tangential_pos_num()] = 1;
+		  for (RelatedViewgrams<float>::const_iterator viewgram_iter = viewgrams.begin();
+		       viewgram_iter != viewgrams.end();
+		       ++viewgram_iter)
+		    if (viewgram_iter->get_view_num() == bin_iter->view_num() &&
+			viewgram_iter->get_segment_num() == bin_iter->segment_num() &&
+			(*viewgram_iter)[bin_iter->axial_pos_num()][bin_iter->tangential_pos_num()] != 0)
+		      all_zero = false;
+		}
+	      if (all_zero)
+		continue;
+	    }
+
+	    proj_matrix_ptr->get_proj_matrix_elems_for_related_bins(related_rows, basic_bin,
+								    min_axial_pos_num, max_axial_pos_num,
+								    min_tangential_pos_num, max_tangential_pos_num);
     
-	    proj_matrix_ptr->get_proj_matrix_elems_for_one_bin(proj_matrix_row, basic_bin);
-      
-	    related_ax_tang_poss.resize(0);
-	    symmetries->get_related_bins_factorised(related_ax_tang_poss,basic_bin,
-						    min_axial_pos_num, max_axial_pos_num,
-						    min_tangential_pos_num, max_tangential_pos_num);
-    
-	    for (
-#ifndef STIR_NO_NAMESPACES
-		 std::
-#endif
-		   vector<AxTangPosNumbers>::const_iterator r_ax_tang_poss_iter = related_ax_tang_poss.begin();
-		 r_ax_tang_poss_iter != related_ax_tang_poss.end();
-		 ++r_ax_tang_poss_iter)
+	    for (vector<ProjMatrixElemsForOneBin>::const_iterator row_iter = related_rows.begin();
+		 row_iter != related_rows.end();
+		 ++row_iter)
 	      {
-		const int axial_pos_tmp = (*r_ax_tang_poss_iter)[1];
-		const int tang_pos_tmp = (*r_ax_tang_poss_iter)[2];
-	  
-		// symmetries might take the ranges out of what the user wants
-		if ( !(min_axial_pos_num <= axial_pos_tmp && axial_pos_tmp <= max_axial_pos_num &&
-		       min_tangential_pos_num <=tang_pos_tmp  && tang_pos_tmp <= max_tangential_pos_num))
+		const Bin& related_bin = row_iter->get_bin();
+		const int axial_pos_tmp = related_bin.axial_pos_num();
+		const int tang_pos_tmp = related_bin.tangential_pos_num();
+
+		// find the corresponding viewgram
+		RelatedViewgrams<float>::const_iterator viewgram_iter = viewgrams.begin();
+		while (viewgram_iter != viewgrams.end() &&
+		       (viewgram_iter->get_view_num() != related_bin.view_num() ||
+			viewgram_iter->get_segment_num() != related_bin.segment_num()))
+		  ++viewgram_iter;
+		if (viewgram_iter == viewgrams.end())
+		  continue;
+
+		// KT 21/02/2002 added check on 0
+		if ((*viewgram_iter)[axial_pos_tmp][tang_pos_tmp] == 0)
 		  continue;
-	  
-		already_processed[axial_pos_tmp][tang_pos_tmp] = 1;
-       
-	  
-		for (RelatedViewgrams<float>::const_iterator viewgram_iter = viewgrams.begin();
-		     viewgram_iter != viewgrams.end();
-		     ++viewgram_iter)
-		  {
-		    // KT 21/02/2002 added check on 0
-		    if ((*viewgram_iter)[axial_pos_tmp][tang_pos_tmp] == 0)
-		      continue;
-		    proj_matrix_row_copy = proj_matrix_row;
-		    Bin bin(viewgram_iter->get_segment_num(),
-			    viewgram_iter->get_view_num(),
-			    axial_pos_tmp,
-			    tang_pos_tmp,
-			    (*viewgram_iter)[axial_pos_tmp][tang_pos_tmp]);
-	      
-		    auto_ptr<SymmetryOperation> symm_op_ptr = 
-		      symmetries->find_symmetry_operation_from_basic_bin(bin);
-		    // TODO replace with Bin::compare_coordinates or so
-		    assert(bin.segment_num() == basic_bin.segment_num());
-		    assert(bin.view_num() == basic_bin.view_num());
-		    assert(bin.axial_pos_num() == basic_bin.axial_pos_num());
-		    assert(bin.tangential_pos_num() == basic_bin.tangential_pos_num());
-	      
-		    symm_op_ptr->transform_proj_matrix_elems_for_one_bin(proj_matrix_row_copy);
-		    proj_matrix_row_copy.back_project(image, bin);
-		  }
+		Bin bin(related_bin.segment_num(),
+			related_bin.view_num(),
+			axial_pos_tmp,
+			tang_pos_tmp,
+			(*viewgram_iter)[axial_pos_tmp][tang_pos_tmp]);
+		row_iter->back_project(image, bin);
 	      }  
 	  }      
       assert(already_processed.sum() 
@@ -0,0 +1,126 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Implementation of class stir::BalancedSubsetScheme
+*/
+
+#include "stir/recon_buildblock/BalancedSubsetScheme.h"
+#include "stir/DataSymmetriesForViewSegmentNumbers.h"
+#include "stir/ProjDataInfo.h"
+#include <algorithm>
+#include <cassert>
+
+START_NAMESPACE_STIR
+
+const char * const
+BalancedSubsetScheme::registered_name = "Balanced";
+
+namespace
+{
+  //! basic view/segment numbers with their number of bins, used to sort them
+  struct VSNumsAndNumBins
+  {
+    ViewSegmentNumbers vs_num;
+    long num_bins;
+  };
+
+  bool has_more_bins(const VSNumsAndNumBins& a, const VSNumsAndNumBins& b)
+  {
+    return a.num_bins > b.num_bins;
+  }
+}
+
+BalancedSubsetScheme::
+BalancedSubsetScheme()
+{
+  set_defaults();
+}
+
+void
+BalancedSubsetScheme::
+set_defaults()
+{}
+
+void
+BalancedSubsetScheme::
+initialise_keymap()
+{
+  this->parser.add_start_key("Balanced Subset Scheme Parameters");
+  this->parser.add_stop_key("End Balanced Subset Scheme Parameters");
+}
+
+std::vector<ViewSegmentNumbers>
+BalancedSubsetScheme::
+find_basic_vs_nums_in_subset(const ProjDataInfo& proj_data_info,
+                             const DataSymmetriesForViewSegmentNumbers& symmetries,
+                             const int min_segment_num, const int max_segment_num,
+                             const int subset_num, const int num_subsets) const
+{
+  assert(subset_num >= 0);
+  assert(subset_num < num_subsets);
+
+  std::vector<int> num_viewgrams_in_subset(num_subsets, 0);
+  std::vector<VSNumsAndNumBins> vs_nums_in_this_subset;
+  int next_subset_num = 0;
+  for (int view_num = proj_data_info.get_min_view_num();
+       view_num <= proj_data_info.get_max_view_num();
+       ++view_num)
+    for (int segment_num = min_segment_num; segment_num <= max_segment_num; ++segment_num)
+      {
+        const ViewSegmentNumbers vs_num(view_num, segment_num);
+        if (!symmetries.is_basic(vs_num))
+          continue;
+        const int num_viewgrams = symmetries.num_related_view_segment_numbers(vs_num);
+
+        // find the subset with the fewest viewgrams, starting from next_subset_num for ties
+        int chosen_subset_num = next_subset_num;
+        for (int i=1; i<num_subsets; ++i)
+          {
+            const int s = (next_subset_num + i) % num_subsets;
+            if (num_viewgrams_in_subset[s] < num_viewgrams_in_subset[chosen_subset_num])
+              chosen_subset_num = s;
+          }
+        num_viewgrams_in_subset[chosen_subset_num] += num_viewgrams;
+        next_subset_num = (chosen_subset_num + 1) % num_subsets;
+
+        if (chosen_subset_num == subset_num)
+          {
+            VSNumsAndNumBins elem;
+            elem.vs_num = vs_num;
+            elem.num_bins =
+              static_cast<long>(num_viewgrams) *
+              proj_data_info.get_num_axial_poss(segment_num) *
+              proj_data_info.get_num_tangential_poss();
+            vs_nums_in_this_subset.push_back(elem);
+          }
+      }
+
+  std::stable_sort(vs_nums_in_this_subset.begin(), vs_nums_in_this_subset.end(), has_more_bins);
+  std::vector<ViewSegmentNumbers> vs_nums_to_process;
+  vs_nums_to_process.reserve(vs_nums_in_this_subset.size());
+  for (std::vector<VSNumsAndNumBins>::const_iterator iter = vs_nums_in_this_subset.begin();
+       iter != vs_nums_in_this_subset.end();
+       ++iter)
+    vs_nums_to_process.push_back(iter->vs_num);
+  return vs_nums_to_process;
+}
+
+END_NAMESPACE_STIR
@@ -0,0 +1,203 @@
+/*!
+
+  \file
+  \ingroup distributable
+
+  \brief  implementation of the stir::DistributableScheduler class
+*/
+/*
+    Copyright (C) 2016, University College London
+
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/recon_buildblock/DistributableScheduler.h"
+#include "stir/DataSymmetriesForViewSegmentNumbers.h"
+#include "stir/ProjDataInfo.h"
+#include <algorithm>
+#include <cassert>
+
+START_NAMESPACE_STIR
+
+namespace
+{
+  //! compare the indices of 2 tasks by decreasing cost
+  class HasLargerCost
+  {
+  public:
+    explicit HasLargerCost(const std::vector<double>& costs)
+      : costs(costs)
+    {}
+    bool operator()(const int a, const int b) const
+    { return costs[a] > costs[b]; }
+  private:
+    const std::vector<double>& costs;
+  };
+}
+
+DistributableScheduler::
+DistributableScheduler()
+  : num_stolen_tasks(0)
+{}
+
+void
+DistributableScheduler::
+clear()
+{
+  this->measurements.clear();
+}
+
+long
+DistributableScheduler::
+get_num_bins(const ViewSegmentNumbers& vs_num,
+             const ProjDataInfo& proj_data_info,
+             const DataSymmetriesForViewSegmentNumbers& symmetries)
+{
+  return
+    static_cast<long>(symmetries.num_related_view_segment_numbers(vs_num)) *
+    proj_data_info.get_num_axial_poss(vs_num.segment_num()) *
+    proj_data_info.get_num_tangential_poss();
+}
+
+std::vector<double>
+DistributableScheduler::
+get_estimated_costs(const std::vector<ViewSegmentNumbers>& vs_nums,
+                    const ProjDataInfo& proj_data_info,
+                    const DataSymmetriesForViewSegmentNumbers& symmetries) const
+{
+  // find average time per bin
+  double time_per_bin = 1.;
+  {
+    double total_time = 0.;
+    double total_num_bins = 0.;
+    for (std::map<ViewSegmentNumbers, Measurement>::const_iterator iter = this->measurements.begin();
+         iter != this->measurements.end();
+         ++iter)
+      {
+        total_time += iter->second.time;
+        total_num_bins += iter->second.num_bins;
+      }
+    if (total_time > 0 && total_num_bins > 0)
+      time_per_bin = total_time / total_num_bins;
+  }
+
+  std::vector<double> estimated_costs(vs_nums.size());
+  for (unsigned int i=0; i<vs_nums.size(); ++i)
+    {
+      const std::map<ViewSegmentNumbers, Measurement>::const_iterator iter =
+        this->measurements.find(vs_nums[i]);
+      if (iter != this->measurements.end())
+        estimated_costs[i] = iter->second.time;
+      else
+        estimated_costs[i] = time_per_bin * get_num_bins(vs_nums[i], proj_data_info, symmetries);
+    }
+  return estimated_costs;
+}
+
+void
+DistributableScheduler::
+sort_by_estimated_cost(std::vector<ViewSegmentNumbers>& vs_nums,
+                       const ProjDataInfo& proj_data_info,
+                       const DataSymmetriesForViewSegmentNumbers& symmetries) const
+{
+  const std::vector<double> estimated_costs =
+    this->get_estimated_costs(vs_nums, proj_data_info, symmetries);
+  std::vector<int> order(vs_nums.size());
+  for (unsigned int i=0; i<order.size(); ++i)
+    order[i] = static_cast<int>(i);
+  std::stable_sort(order.begin(), order.end(), HasLargerCost(estimated_costs));
+
+  const std::vector<ViewSegmentNumbers> org_vs_nums(vs_nums);
+  for (unsigned int i=0; i<order.size(); ++i)
+    vs_nums[i] = org_vs_nums[order[i]];
+}
+
+void
+DistributableScheduler::
+set_measured_time(const ViewSegmentNumbers& vs_num, const double time, const long num_bins)
+{
+  Measurement& measurement = this->measurements[vs_num];
+  measurement.time = time;
+  measurement.num_bins = num_bins;
+}
+
+void
+DistributableScheduler::
+start(const std::vector<double>& costs_v, const int num_workers)
+{
+  assert(num_workers > 0);
+  this->costs = costs_v;
+  this->queues.clear();
+  this->queues.resize(num_workers);
+  this->remaining_costs.assign(num_workers, 0.);
+  this->num_stolen_tasks = 0;
+
+  for (int task_num=0; task_num<static_cast<int>(this->costs.size()); ++task_num)
+    {
+      const int worker_num =
+        static_cast<int>(std::min_element(this->remaining_costs.begin(), this->remaining_costs.end())
+                         - this->remaining_costs.begin());
+      this->queues[worker_num].push_back(task_num);
+      this->remaining_costs[worker_num] += this->costs[task_num];
+    }
+}
+
+bool
+DistributableScheduler::
+get_next_task(int& task_num, const int worker_num)
+{
+  assert(worker_num >= 0);
+  bool found = false;
+#ifdef STIR_OPENMP
+#pragma omp critical(STIR_DISTRIBUTABLESCHEDULER)
+#endif
+  {
+    if (worker_num < static_cast<int>(this->queues.size()) &&
+        !this->queues[worker_num].empty())
+      {
+        task_num = this->queues[worker_num].front();
+        this->queues[worker_num].pop_front();
+        this->remaining_costs[worker_num] -= this->costs[task_num];
+        found = true;
+      }
+    else
+      {
+        // steal the smallest task of the queue with the most remaining work
+        int victim_num = -1;
+        for (int i=0; i<static_cast<int>(this->queues.size()); ++i)
+          if (!this->queues[i].empty() &&
+              (victim_num<0 || this->remaining_costs[i] > this->remaining_costs[victim_num]))
+            victim_num = i;
+        if (victim_num >= 0)
+          {
+            task_num = this->queues[victim_num].back();
+            this->queues[victim_num].pop_back();
+            this->remaining_costs[victim_num] -= this->costs[task_num];
+            ++this->num_stolen_tasks;
+            found = true;
+          }
+      }
+  }
+  return found;
+}
+
+int
+DistributableScheduler::
+get_num_stolen_tasks() const
+{
+  return this->num_stolen_tasks;
+}
+
+END_NAMESPACE_STIR
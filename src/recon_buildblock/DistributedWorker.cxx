@@ -176,6 +176,11 @@ namespace stir
 	      this->distributable_computation(RPC_process_related_viewgrams_accumulate_loglikelihood);
 	      break;
 	    }
+	  case task_do_distributable_approximate_Hessian_computation:
+	    {
+	      this->distributable_computation(RPC_process_related_viewgrams_approximate_Hessian);
+	      break;
+	    }
       /*
 	case task_do_distributable_sensitivity_computation;break;
       */
@@ -122,8 +122,8 @@ ForwardProjectorByBinUsingProjMatrixByBin::
 		  const int min_axial_pos_num, const int max_axial_pos_num,
 		  const int min_tangential_pos_num, const int max_tangential_pos_num)
 {
-  if (proj_matrix_ptr->is_cache_enabled()/* &&
-					    !proj_matrix_ptr->does_cache_store_only_basic_bins()*/)
+  if (proj_matrix_ptr->is_cache_enabled() &&
+      !proj_matrix_ptr->does_cache_store_only_basic_bins())
   {
     // straightforward version which relies on ProjMatrixByBin to sort out all 
     // symmetries
@@ -152,12 +152,12 @@ ForwardProjectorByBinUsingProjMatrixByBin::
   }
   else
   {
-    // Complicated version which handles the symmetries explicitly.
-    // Faster when no caching is performed, about just as fast when there is caching, 
-    // but of only basic bins.
+    // Version which handles the symmetries explicitly.
+    // For every basic bin, we get the rows for all related bins in one go, such 
+    // that the basic row is found (or computed) only once.
+    // Faster when no caching is performed, or when only basic bins are cached.
     
-    ProjMatrixElemsForOneBin proj_matrix_row;
-    ProjMatrixElemsForOneBin proj_matrix_row_copy;
+    std::vector<ProjMatrixElemsForOneBin> related_rows;
     const DataSymmetriesForBins* symmetries = proj_matrix_ptr->get_symmetries_ptr(); 
     
     Array<2,int> 
@@ -173,52 +173,32 @@ ForwardProjectorByBinUsingProjMatrixByBin::
         Bin basic_bin(viewgrams.get_basic_segment_num(),viewgrams.get_basic_view_num(),ax_pos,tang_pos);
         symmetries->find_basic_bin(basic_bin);
         
-        proj_matrix_ptr->get_proj_matrix_elems_for_one_bin(proj_matrix_row, basic_bin);
-        
-        vector<AxTangPosNumbers> r_ax_poss;
-        symmetries->get_related_bins_factorised(r_ax_poss,basic_bin,
-                                                min_axial_pos_num, max_axial_pos_num,
-                                                min_tangential_pos_num, max_tangential_pos_num);
+        proj_matrix_ptr->get_proj_matrix_elems_for_related_bins(related_rows, basic_bin,
+                                                                min_axial_pos_num, max_axial_pos_num,
+                                                                min_tangential_pos_num, max_tangential_pos_num);
         
-        for (
-#ifndef STIR_NO_NAMESPACES
-          std::
-#endif
-            vector<AxTangPosNumbers>::iterator r_ax_poss_iter = r_ax_poss.begin();
-          r_ax_poss_iter != r_ax_poss.end();
-          ++r_ax_poss_iter)
+        for (vector<ProjMatrixElemsForOneBin>::const_iterator row_iter = related_rows.begin();
+             row_iter != related_rows.end();
+             ++row_iter)
         {
-          const int axial_pos_tmp = (*r_ax_poss_iter)[1];
-          const int tang_pos_tmp = (*r_ax_poss_iter)[2];
+          Bin bin = row_iter->get_bin();
+          const int axial_pos_tmp = bin.axial_pos_num();
+          const int tang_pos_tmp = bin.tangential_pos_num();
           
-          // symmetries might take the ranges out of what the user wants
-          if ( !(min_axial_pos_num <= axial_pos_tmp && axial_pos_tmp <= max_axial_pos_num &&
-                 min_tangential_pos_num <=tang_pos_tmp  && tang_pos_tmp <= max_tangential_pos_num))
+          // find the corresponding viewgram
+          RelatedViewgrams<float>::iterator viewgram_iter = viewgrams.begin();
+          while (viewgram_iter != viewgrams.end() &&
+                 (viewgram_iter->get_view_num() != bin.view_num() ||
+                  viewgram_iter->get_segment_num() != bin.segment_num()))
+            ++viewgram_iter;
+          if (viewgram_iter == viewgrams.end())
             continue;
           
           already_processed[axial_pos_tmp][tang_pos_tmp] = 1;
           
-          
-          for (RelatedViewgrams<float>::iterator viewgram_iter = viewgrams.begin();
-               viewgram_iter != viewgrams.end();
-               ++viewgram_iter)
-          {
-            Viewgram<float>& viewgram = *viewgram_iter;
-            proj_matrix_row_copy = proj_matrix_row;
-            Bin bin(viewgram_iter->get_segment_num(),
-                    viewgram_iter->get_view_num(),
-                    axial_pos_tmp,
-                    tang_pos_tmp);
-            
-            auto_ptr<SymmetryOperation> symm_op_ptr = 
-              symmetries->find_symmetry_operation_from_basic_bin(bin);
-            assert(bin == basic_bin);
-            
-            symm_op_ptr->transform_proj_matrix_elems_for_one_bin(proj_matrix_row_copy);
-            proj_matrix_row_copy.forward_project(bin,image);
-            
-            viewgram[axial_pos_tmp][tang_pos_tmp] = bin.get_bin_value();
-          }
+          bin.set_bin_value(0);
+          row_iter->forward_project(bin,image);
+          (*viewgram_iter)[axial_pos_tmp][tang_pos_tmp] = bin.get_bin_value();
         }  
       }      
       assert(already_processed.sum() == (
@@ -14,7 +14,7 @@
     Copyright (C) 2003 - 2005, Hammersmith Imanet Ltd
     Copyright (C) 2004 - 2005 DKFZ Heidelberg, Germany
     Copyright (C) 2011-07-01 - 2012, Kris Thielemans
-    Copyright (C) 2013, University College London
+    Copyright (C) 2013, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -128,17 +128,19 @@ rebin()
   //CON return value 
   Succeeded success = Succeeded::yes;
     
-  //CL Find the number of views and tangential positions power of two
-  int num_views_pow2;
-  for ( num_views_pow2 = 1; num_views_pow2 < 2*proj_data_sptr->get_num_views() && num_views_pow2 < (1<<15); num_views_pow2*=2);
-  int num_tang_poss_pow2;
-  for ( num_tang_poss_pow2 = 1; num_tang_poss_pow2 < proj_data_sptr->get_num_tangential_poss() && num_tang_poss_pow2 < (1<<15); num_tang_poss_pow2*=2);
+  //CL Find the number of views and tangential positions for the FFT
+  //CON The number of views is a power of 2, as num_views_fft/2 is the number of views of the rebinned data.
+  //CON The tangential positions are only zero-padded, so their number only needs to have factors 2, 3 and 5
+  //CON (see get_efficient_fourier_length).
+  int num_views_fft;
+  for ( num_views_fft = 1; num_views_fft < 2*proj_data_sptr->get_num_views() && num_views_fft < (1<<15); num_views_fft*=2);
+  const int num_tang_poss_fft = get_efficient_fourier_length(proj_data_sptr->get_num_tangential_poss());
   
   //CL Initialise the 2D Fourier transform of all rebinned sinograms P(w,k)=0
    const int num_planes = proj_data_sptr->get_proj_data_info_ptr()->get_scanner_ptr()->get_num_rings()*2-1;
 
-  Array<3,std::complex<float> > FT_rebinned_data(IndexRange3D(0, num_planes-1, 0, num_views_pow2-1, 0, num_tang_poss_pow2-1));
-  Array<3,float> Weights_for_FT_rebinned_data(IndexRange3D(0, num_planes-1, 0,num_views_pow2-1, 0,num_tang_poss_pow2-1));
+  Array<3,std::complex<float> > FT_rebinned_data(IndexRange3D(0, num_planes-1, 0, num_views_fft-1, 0, num_tang_poss_fft-1));
+  Array<3,float> Weights_for_FT_rebinned_data(IndexRange3D(0, num_planes-1, 0,num_views_fft-1, 0,num_tang_poss_fft-1));
   //CON some statistics
   PETCount_rebinned num_rebinned(0,0,0);
 
@@ -148,7 +150,7 @@ rebin()
   shared_ptr<ProjDataInfo> rebinned_proj_data_info_sptr
     ( proj_data_sptr->get_proj_data_info_ptr()->clone());
   //CON Adapt the properties that will be modified by the rebinning.
-  rebinned_proj_data_info_sptr->set_num_views(num_views_pow2/2);
+  rebinned_proj_data_info_sptr->set_num_views(num_views_fft/2);
   //CON After rebinning we have of course only "direct" sinograms left e.q only segment 0 exists 
   rebinned_proj_data_info_sptr->reduce_segment_range(0,0);
   //CON maximal ring difference a LOR in the largest segment that is going to be rebinned 
@@ -169,7 +171,7 @@ rebin()
   const Scanner* scanner = rebinned_proj_data_sptr->get_proj_data_info_ptr()->get_scanner_ptr();
   const float half_distance_between_rings = scanner->get_ring_spacing()/2.F; 
   const float sampling_distance_in_s = rebinned_proj_data_info_sptr->get_sampling_in_s(Bin(0,0,0,0));
-  const float radial_sampling_freq_w = float(2.*_PI)/sampling_distance_in_s/num_tang_poss_pow2;
+  const float radial_sampling_freq_w = float(2.*_PI)/sampling_distance_in_s/num_tang_poss_fft;
   //CON D = #bins * binsize, R = D / 2
   const float R_field_of_view_mm = ((int) (rebinned_proj_data_info_sptr->get_num_tangential_poss() / 2) - 1)*sampling_distance_in_s;
   const float scanner_space_between_rings = scanner->get_ring_spacing();
@@ -177,7 +179,7 @@ rebin()
   const float ratio_ring_spacing_to_ring_radius = scanner_space_between_rings / scanner_ring_radius;
 
   //CON Check that the user defineable FORE parameters are inside a possible range of values
-  if(fore_check_parameters(num_tang_poss_pow2,num_views_pow2,max_segment_num_to_process) != Succeeded::yes){
+  if(fore_check_parameters(num_tang_poss_fft,num_views_fft,max_segment_num_to_process) != Succeeded::yes){
     error("FORE Rebinning :: Setup failed "); 
    };
   
@@ -236,10 +238,10 @@ rebin()
 	  display(segment, segment.find_max(), s);
 	}
 	
-    //CON the sinogramm dimensions need to have a dimension which is a power of 2 (required by the FFT algorithm) 
+    //CON the sinogramm dimensions need to have a size for which the FFT is efficient (see get_efficient_fourier_length)
     //CON for s (radial coordinate) pad the sinogramm with zeros to form a larger array. 
     //CON the phi (azimuthal cordinate (view)) coordinate is periodic. The samples need to be interpolated to the
-    //CON to the new matrix size. Do this by linear interpolation.             
+    //CON to the new matrix size (a power of 2). Do this by linear interpolation.             
     //CON -> DeFrise p. 153 Sec IV.C
     do_adjust_nb_views_to_pow2(segment);
 
@@ -250,7 +252,7 @@ rebin()
     //CON Weight has the same dimensions. It stores normalisation factors (floats)
     //CON to take into account the variable number of contributions to each frequency.     
     do_rebinning(FT_rebinned_data, Weights_for_FT_rebinned_data, num_rebinned, segment,
-                 num_tang_poss_pow2, num_views_pow2, num_planes, average_ring_difference_in_segment,
+                 num_tang_poss_fft, num_views_fft, num_planes, average_ring_difference_in_segment,
                  half_distance_between_rings, sampling_distance_in_s, radial_sampling_freq_w, R_field_of_view_mm,
 	         ratio_ring_spacing_to_ring_radius);
   
@@ -277,14 +279,14 @@ rebin()
   //CON the rebinning weights
   //CON before the inv. FFT can be applied this is not much overhead and it can be left like it was done when still 
   //CON using the numerical receipies FFT code.       
-   Array<2, std::complex<float> > FT_rebinned_sinogram(IndexRange2D(0,num_tang_poss_pow2-1,0,num_views_pow2/2));
+   Array<2, std::complex<float> > FT_rebinned_sinogram(IndexRange2D(0,num_tang_poss_fft-1,0,num_views_fft/2));
   //CON fourier_for_real_data will resize the array to its appropriate dimensions
    Array<2,float> rebinned_sinogram(IndexRange2D(0,1,0,1));
  
   //CON Normalise the rebinned sinograms by applying the weight factors
   //CON See DeFrise IV.D p154.   
- for (int j = 0; j < num_tang_poss_pow2; j++) {    
-   for (int i = 0; i <= num_views_pow2/2; i++) {   
+ for (int j = 0; j < num_tang_poss_fft; j++) {    
+   for (int i = 0; i <= num_views_fft/2; i++) {   
      const float Actual_Weight = (Weights_for_FT_rebinned_data[plane][i][j] == 0) ? 0 : 
        1.F/(Weights_for_FT_rebinned_data[plane][i][j]);
      FT_rebinned_sinogram[j][i] = FT_rebinned_data[plane][i][j]* Actual_Weight;
@@ -296,13 +298,13 @@ rebin()
     {
       char s[100];
       Array<2,float> real(FT_rebinned_sinogram.get_index_range());
-      for (int i = 0; i < num_views_pow2; i++) 
-	for (int j = 0; j <= num_tang_poss_pow2/2; j++) 
+      for (int i = 0; i < num_views_fft; i++) 
+	for (int j = 0; j <= num_tang_poss_fft/2; j++) 
           real[i][j] = FT_rebinned_sinogram[i][j].real();
       sprintf(s, "real part of FT of rebinned (extended) sinogram %d",plane);
       display(real, s, real.find_max());
-      for (int i = 0; i < num_views_pow2; i++) 
-	for (int j = 0; j <= num_tang_poss_pow2/2; j++) 
+      for (int i = 0; i < num_views_fft; i++) 
+	for (int j = 0; j <= num_tang_poss_fft/2; j++) 
           real[i][j] = FT_rebinned_sinogram[i][j].imag();
       sprintf(s, "imag part of FT of rebinned (extended) sinogram %d",plane);
       display(real, s, real.find_max());
@@ -312,8 +314,8 @@ rebin()
     rebinned_sinogram = inverse_fourier_for_real_data(FT_rebinned_sinogram); 
 
    //CL Keep only one half of data [o.._PI]
-    for (int i=0;i<(int)(num_views_pow2/2);i++) 
-     for (int j=0;j<num_tang_poss_pow2;j++)
+    for (int i=0;i<(int)(num_views_fft/2);i++) 
+     for (int j=0;j<num_tang_poss_fft;j++)
         if ((j+sino2D_rebinned.get_min_tangential_pos_num())<=sino2D_rebinned.get_max_tangential_pos_num()) 
           sino2D_rebinned[plane][i][j+sino2D_rebinned.get_min_tangential_pos_num()]=rebinned_sinogram[j][i];
            
@@ -348,8 +350,8 @@ void
 FourierRebinning::
 do_rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weights_for_FT_rebinned_data,
              PETCount_rebinned &count_rebinned, 
-             const SegmentBySinogram<float> &segment, const int num_tang_poss_pow2,
-             const int num_views_pow2, const int num_planes, const float average_ring_difference_in_segment,
+             const SegmentBySinogram<float> &segment, const int num_tang_poss_fft,
+             const int num_views_fft, const int num_planes, const float average_ring_difference_in_segment,
              const float half_distance_between_rings, const float sampling_distance_in_s, 
              const float radial_sampling_freq_w, const float R_field_of_view_mm,
              const float ratio_ring_spacing_to_ring_radius)
@@ -365,14 +367,14 @@ do_rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &We
      {
 
       if(axial_pos_num%10 == 0)  info(boost::format("FORE Rebinning z (slice) = %1%") % axial_pos_num);   
-      Array<2,float> current_sinogram(IndexRange2D(0,num_tang_poss_pow2-1,0,num_views_pow2-1));
+      Array<2,float> current_sinogram(IndexRange2D(0,num_tang_poss_fft-1,0,num_views_fft-1));
   
   //CL Calculate the 2D FFT of P(w,k) of the merged segment
   //CON copy the sinogram data of slice axial_pos_num from the segment array to slicedata
   //CON the sinogram is flipped. This will taken account for in the rebinning, where the assignment of the FFT
   //CON coefficients are assigned opposite.
      for (int j = 0; j < segment.get_num_tangential_poss(); j++) 
-      for (int i = 0; i < num_views_pow2; i++) 
+      for (int i = 0; i < num_views_fft; i++) 
         current_sinogram[j][i] = segment[axial_pos_num][i][j + segment.get_min_tangential_pos_num()];
        
   //CON FFT slicedata
@@ -384,8 +386,8 @@ do_rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &We
 
   //CON Call the rebinning kernel.                                                             
     rebinning(FT_rebinned_data,Weights_for_FT_rebinned_data,count_rebinned,FT_current_sinogram,
-              z_in_mm, average_ring_difference_in_segment, num_views_pow2,
-              num_tang_poss_pow2,half_distance_between_rings,sampling_distance_in_s,radial_sampling_freq_w,
+              z_in_mm, average_ring_difference_in_segment, num_views_fft,
+              num_tang_poss_fft,half_distance_between_rings,sampling_distance_in_s,radial_sampling_freq_w,
               R_field_of_view_mm,ratio_ring_spacing_to_ring_radius);
 
  }//CL End of loop of axial_pos_num
@@ -407,7 +409,7 @@ FourierRebinning::
 rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weights_for_FT_rebinned_data,
           PETCount_rebinned &num_rebinned, const Array<2,std::complex<float> > &FT_current_sinogram,
 	  const float z_in_mm, const float delta, 
-          const int num_views_pow2, const int num_tang_poss_pow2, const float half_distance_between_rings, 
+          const int num_views_fft, const int num_tang_poss_fft, const float half_distance_between_rings, 
 	  const float sampling_distance_in_s, const float radial_sampling_freq_w, const float R_field_of_view_mm, 
           const float ratio_ring_spacing_to_ring_radius)
 {
@@ -429,10 +431,10 @@ rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weigh
   //CON The integer Fourier index "k" corresponds to the azimuthal angle "view"
 
   //CON FORE regime (rebinning)
-  //CON Iterate over all frequency tuples (w,k) starting from wmin,kmin up to num_tang_poss_pow2/2,num_views_pow2/2
+  //CON Iterate over all frequency tuples (w,k) starting from wmin,kmin up to num_tang_poss_fft/2,num_views_fft/2
 
-      for (int j = wmin; j <= num_tang_poss_pow2/2;j++) {
-        for (int i = kmin; i <= num_views_pow2/2; i++) {
+      for (int j = wmin; j <= num_tang_poss_fft/2;j++) {
+        for (int i = kmin; i <= num_views_fft/2; i++) {
 
               float w = static_cast<float>(j) * radial_sampling_freq_w;
               float k = static_cast<float>(i);     
@@ -467,7 +469,7 @@ rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weigh
 
               int jj = j;
          
-             if(shift_direction==NEGATIVE_Z_SHIFT && j > 0)   jj = num_tang_poss_pow2 - j;
+             if(shift_direction==NEGATIVE_Z_SHIFT && j > 0)   jj = num_tang_poss_fft - j;
                 
                 //CON new_z_sl is the z-coordinate of the shifted z-position this contribution is assigned to.  	    
                 const float new_z_sl = static_cast<float>(z) + shift_direction * zshift/half_distance_between_rings;       
@@ -509,7 +511,7 @@ rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weigh
      //CON and therefore there will be only contributions to one direct sinogram and the weights are therefore always 1. 
     
        for (int j = 0; j < wmin; j++){
-         for (int i = 0; i <= num_views_pow2/2; i++) {
+         for (int i = 0; i <= num_views_fft/2; i++) {
 	 
 	       for(int shift_direction=POSITIVE_Z_SHIFT;shift_direction<=NEGATIVE_Z_SHIFT;shift_direction+=CHANGE_Z_SHIFT){
 
@@ -517,7 +519,7 @@ rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weigh
 
 		   // Take reverse ordering of tangential position in the negative segment into account (?)
                    if(shift_direction==NEGATIVE_Z_SHIFT && j > 0)  
-                      jj=num_tang_poss_pow2 - j;                  
+                      jj=num_tang_poss_fft - j;                  
       
                     
                     if (small_z >= 0 && small_z <= maxplane ) {      
@@ -533,8 +535,8 @@ rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weigh
       
 
 //CL Small k :
-//CL Next treat small k's and w=wNyq=(num_tang_poss_pow2 / 2)+1, k=1..klim :
-       for (int j = wmin; j <= num_tang_poss_pow2/2; j++) {
+//CL Next treat small k's and w=wNyq=(num_tang_poss_fft / 2)+1, k=1..klim :
+       for (int j = wmin; j <= num_tang_poss_fft/2; j++) {
          for (int i = 0; i <= kmin; i++) {
           
                for(int shift_direction=POSITIVE_Z_SHIFT;shift_direction<=NEGATIVE_Z_SHIFT;shift_direction+=CHANGE_Z_SHIFT){
@@ -543,7 +545,7 @@ rebinning(Array<3,std::complex<float> > &FT_rebinned_data, Array<3,float> &Weigh
 
 		   // Take reverse ordering of tangential position in the negative segment into account (?)
                     if(shift_direction==NEGATIVE_Z_SHIFT && j > 0)  
-                       jj=num_tang_poss_pow2 - j;  
+                       jj=num_tang_poss_fft - j;  
                
                    
                     if (small_z >= 0 && small_z <= maxplane ) {            
@@ -602,15 +604,16 @@ do_adjust_nb_views_to_pow2(SegmentBySinogram<float> &segment)
 {
 // Adjustment of the number of views to a power of two
 //CON Use the STIR overlap_interpolate method and remove the simlar private implementation (adjust_pow2) here.      
-  const int num_views_pow2 = stir::round(pow(2.,((int)ceil(log ((float)segment.get_num_views())/log(2.)))));
+  int num_views_fft;
+  for ( num_views_fft = 1; num_views_fft < segment.get_num_views() && num_views_fft < (1<<15); num_views_fft*=2);
   const float offset_for_overlap_interpolate = 0.F;
       
-    if (num_views_pow2 == segment.get_num_views()) 
+    if (num_views_fft == segment.get_num_views()) 
         return; 
 
     //CON Create the projection data info ptr for the resized segment
     shared_ptr<ProjDataInfo> out_proj_data_info_sptr(segment.get_proj_data_info_ptr()->clone());
-    out_proj_data_info_sptr->set_num_views(num_views_pow2);
+    out_proj_data_info_sptr->set_num_views(num_views_fft);
     //CON the re-dimensioned segment      
     SegmentBySinogram<float> out_segment = 
       out_proj_data_info_sptr->get_empty_segment_by_sinogram(segment.get_segment_num());
@@ -630,7 +633,7 @@ do_adjust_nb_views_to_pow2(SegmentBySinogram<float> &segment)
 }
 
 Succeeded FourierRebinning::
-fore_check_parameters(int num_tang_poss_pow2, int num_views_pow2, int max_segment_num_to_process){
+fore_check_parameters(int num_tang_poss_fft, int num_views_fft, int max_segment_num_to_process){
 
 //CON Check if the parameters given make sense.
 
@@ -648,20 +651,20 @@ fore_check_parameters(int num_tang_poss_pow2, int num_views_pow2, int max_segmen
  }
 
 
- if(wmin >= num_tang_poss_pow2/2 || kmin >= num_views_pow2/2) {
+ if(wmin >= num_tang_poss_fft/2 || kmin >= num_views_fft/2) {
    warning(boost::format("FORE initialisation :: The parameter wmin or kmin is larger than the highest frequency component computed by the FFT algorithm\n"
                          "                       Choose an value smaller than the largest frequency\n"
                          "                       kmin must be smaller than %1% and wmin must be smaller than %2%")
-           % (num_tang_poss_pow2/2) % (num_views_pow2/2));
+           % (num_tang_poss_fft/2) % (num_views_fft/2));
    return Succeeded::no; 
  }
 
 
- if(kc >= num_views_pow2/2) {
+ if(kc >= num_views_fft/2) {
    warning(boost::format("FORE initialisation :: Your parameter kc is larger than the highest frequency component in w (FTT of radial coordinate s)\n"
                          "                       Choose an value smaller than the largest frequency\n"
                          "                       kc must be smaller than %1%") 
-           % num_views_pow2);
+           % num_views_fft);
    return Succeeded::no; 
  } 
 
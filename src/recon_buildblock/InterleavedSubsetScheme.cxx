@@ -0,0 +1,156 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup recon_buildblock
+  \brief Implementation of class stir::InterleavedSubsetScheme
+*/
+
+#include "stir/recon_buildblock/InterleavedSubsetScheme.h"
+#include "stir/recon_buildblock/find_basic_vs_nums_in_subsets.h"
+#include "stir/error.h"
+#include "stir/warning.h"
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+START_NAMESPACE_STIR
+
+const char * const
+InterleavedSubsetScheme::registered_name = "Interleaved";
+
+InterleavedSubsetScheme::
+InterleavedSubsetScheme()
+{
+  set_defaults();
+}
+
+void
+InterleavedSubsetScheme::
+set_defaults()
+{
+  this->subset_order = "natural";
+  this->random_seed = 0;
+}
+
+void
+InterleavedSubsetScheme::
+initialise_keymap()
+{
+  this->parser.add_start_key("Interleaved Subset Scheme Parameters");
+  this->parser.add_key("subset order", &this->subset_order);
+  this->parser.add_key("random seed", &this->random_seed);
+  this->parser.add_stop_key("End Interleaved Subset Scheme Parameters");
+}
+
+bool
+InterleavedSubsetScheme::
+post_processing()
+{
+  if (this->subset_order != "natural" &&
+      this->subset_order != "golden angle" &&
+      this->subset_order != "random")
+    {
+      warning("Interleaved subset scheme: subset order should be natural, golden angle or random, but is %s",
+              this->subset_order.c_str());
+      return true;
+    }
+  return false;
+}
+
+void
+InterleavedSubsetScheme::
+set_subset_order(const std::string& arg)
+{
+  this->subset_order = arg;
+  if (this->post_processing())
+    error("Interleaved subset scheme: invalid subset order");
+}
+
+void
+InterleavedSubsetScheme::
+set_random_seed(const int arg)
+{
+  this->random_seed = arg;
+}
+
+int
+InterleavedSubsetScheme::
+get_view_offset(const int subset_num, const int num_subsets) const
+{
+  assert(subset_num >= 0);
+  assert(subset_num < num_subsets);
+
+  if (this->subset_order == "golden angle")
+    {
+      // rank of frac(subset_num*(sqrt(5)-1)/2) among all subsets
+      const double golden_ratio_fraction = (std::sqrt(5.)-1)/2;
+      std::vector<std::pair<double,int> > fractions(num_subsets);
+      for (int s=0; s<num_subsets; ++s)
+        {
+          const double value = s*golden_ratio_fraction;
+          fractions[s] = std::make_pair(value - std::floor(value), s);
+        }
+      std::sort(fractions.begin(), fractions.end());
+      for (int rank=0; rank<num_subsets; ++rank)
+        if (fractions[rank].second == subset_num)
+          return rank;
+      assert(false);
+      return subset_num;
+    }
+  else if (this->subset_order == "random")
+    {
+      // Fisher-Yates shuffle with a fixed seed
+      std::vector<int> offsets(num_subsets);
+      for (int s=0; s<num_subsets; ++s)
+        offsets[s] = s;
+      boost::mt19937 generator(static_cast<boost::uint32_t>(this->random_seed));
+      for (int s=num_subsets-1; s>0; --s)
+        {
+          boost::uniform_int<int> distribution(0, s);
+          boost::variate_generator<boost::mt19937&, boost::uniform_int<int> >
+            random_int(generator, distribution);
+          std::swap(offsets[s], offsets[random_int()]);
+        }
+      return offsets[subset_num];
+    }
+  else
+    return subset_num;
+}
+
+std::vector<ViewSegmentNumbers>
+InterleavedSubsetScheme::
+find_basic_vs_nums_in_subset(const ProjDataInfo& proj_data_info,
+                             const DataSymmetriesForViewSegmentNumbers& symmetries,
+                             const int min_segment_num, const int max_segment_num,
+                             const int subset_num, const int num_subsets) const
+{
+  return
+    detail::find_basic_vs_nums_in_subset(proj_data_info, symmetries,
+                                         min_segment_num, max_segment_num,
+                                         this->get_view_offset(subset_num, num_subsets), num_subsets);
+}
+
+END_NAMESPACE_STIR
@@ -0,0 +1,466 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup priors
+  \brief  implementation of the stir::NeighbourhoodPrior class and the functions
+  for the weights of neighbourhood priors
+
+*/
+
+#include "stir/recon_buildblock/NeighbourhoodPrior.h"
+#include "stir/recon_buildblock/NeighbourhoodStencil.h"
+#include "stir/Succeeded.h"
+#include "stir/DiscretisedDensityOnCartesianGrid.h"
+#include "stir/IndexRange3D.h"
+#include "stir/IO/write_to_file.h"
+#include "stir/IO/read_from_file.h"
+#include "stir/is_null_ptr.h"
+#include "stir/info.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+using std::min;
+using std::max;
+
+START_NAMESPACE_STIR
+
+void
+compute_inverse_distance_weights(Array<3,float>& weights,
+                                 const CartesianCoordinate3D<float>& grid_spacing,
+                                 const bool only_2D)
+{
+  int min_dz, max_dz;
+  if (only_2D)
+    {
+      min_dz = max_dz = 0;
+    }
+  else
+    {
+      min_dz = -1;
+      max_dz = 1;
+    }
+  weights = Array<3,float>(IndexRange3D(min_dz,max_dz,-1,1,-1,1));
+  for (int z=min_dz;z<=max_dz;++z)
+    for (int y=-1;y<=1;++y)
+      for (int x=-1;x<=1;++x)
+        {
+          if (z==0 && y==0 && x==0)
+            weights[0][0][0] = 0;
+          else
+            {
+              weights[z][y][x] =
+                grid_spacing.x()/
+                sqrt(square(x*grid_spacing.x())+
+                     square(y*grid_spacing.y())+
+                     square(z*grid_spacing.z()));
+            }
+        }
+}
+
+bool
+centre_neighbourhood_weights(Array<3,float>& weights, bool& has_even_size)
+{
+  has_even_size = false;
+  if (!weights.is_regular())
+    return false;
+
+  const unsigned int size_z = weights.size();
+  if (size_z%2==0)
+    has_even_size = true;
+  const int min_index_z = -static_cast<int>(size_z/2);
+  weights.set_min_index(min_index_z);
+
+  for (int z = min_index_z; z<= weights.get_max_index(); ++z)
+    {
+      const unsigned int size_y = weights[z].size();
+      if (size_y%2==0)
+        has_even_size = true;
+      const int min_index_y = -static_cast<int>(size_y/2);
+      weights[z].set_min_index(min_index_y);
+      for (int y = min_index_y; y<= weights[z].get_max_index(); ++y)
+        {
+          const unsigned int size_x = weights[z][y].size();
+          if (size_x%2==0)
+            has_even_size = true;
+          const int min_index_x = -static_cast<int>(size_x/2);
+          weights[z][y].set_min_index(min_index_x);
+        }
+    }
+  return true;
+}
+
+namespace
+{
+  /* Kernels for NeighbourhoodStencil (see QuadraticPrior.cxx).
+     The potential is called for every element, so it has to be inline for
+     the loops to be vectorised.
+  */
+
+  template <typename elemT, typename PotentialT>
+  class PotentialValueKernel
+  {
+  public:
+    explicit PotentialValueKernel(const PotentialT& potential) : potential(potential) {}
+    double operator()(elemT*, const elemT* centre, const elemT* neighbour,
+                      const elemT* kappa_centre, const elemT* kappa_neighbour,
+                      const int length, const float weight) const
+    {
+      double result = 0.;
+      if (kappa_centre == 0)
+        {
+          for (int i=0; i<length; ++i)
+            result += static_cast<double>(weight * potential.value(centre[i], neighbour[i])/2);
+        }
+      else
+        {
+          for (int i=0; i<length; ++i)
+            {
+              elemT current = weight * potential.value(centre[i], neighbour[i])/2;
+              current *= kappa_centre[i] * kappa_neighbour[i];
+              result += static_cast<double>(current);
+            }
+        }
+      return result;
+    }
+  private:
+    const PotentialT& potential;
+  };
+
+  template <typename elemT, typename PotentialT>
+  class PotentialGradientKernel
+  {
+  public:
+    explicit PotentialGradientKernel(const PotentialT& potential) : potential(potential) {}
+    double operator()(elemT* output, const elemT* centre, const elemT* neighbour,
+                      const elemT* kappa_centre, const elemT* kappa_neighbour,
+                      const int length, const float weight) const
+    {
+      if (kappa_centre == 0)
+        {
+          for (int i=0; i<length; ++i)
+            output[i] += weight * potential.derivative_10(centre[i], neighbour[i]);
+        }
+      else
+        {
+          for (int i=0; i<length; ++i)
+            {
+              elemT current = weight * potential.derivative_10(centre[i], neighbour[i]);
+              current *= kappa_centre[i] * kappa_neighbour[i];
+              output[i] += current;
+            }
+        }
+      return 0.;
+    }
+  private:
+    const PotentialT& potential;
+  };
+
+  template <typename elemT, typename PotentialT>
+  class PotentialCurvatureKernel
+  {
+  public:
+    explicit PotentialCurvatureKernel(const PotentialT& potential) : potential(potential) {}
+    double operator()(elemT* output, const elemT* centre, const elemT* neighbour,
+                      const elemT* kappa_centre, const elemT* kappa_neighbour,
+                      const int length, const float weight) const
+    {
+      if (kappa_centre == 0)
+        {
+          for (int i=0; i<length; ++i)
+            output[i] += weight * potential.surrogate_curvature(centre[i], neighbour[i]);
+        }
+      else
+        {
+          for (int i=0; i<length; ++i)
+            {
+              elemT current = weight * potential.surrogate_curvature(centre[i], neighbour[i]);
+              current *= kappa_centre[i] * kappa_neighbour[i];
+              output[i] += current;
+            }
+        }
+      return 0.;
+    }
+  private:
+    const PotentialT& potential;
+  };
+}
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::initialise_keymap()
+{
+  base_type::initialise_keymap();
+  this->parser.add_start_key(std::string(registered_name) + " Prior Parameters");
+  this->parser.add_key("only 2D", &only_2D);
+  this->parser.add_key("kappa filename", &kappa_filename);
+  this->parser.add_key("weights", &weights);
+  this->parser.add_key("gradient filename prefix", &gradient_filename_prefix);
+  this->potential.initialise_keymap(this->parser);
+  this->parser.add_stop_key(std::string("END ") + registered_name + " Prior Parameters");
+}
+
+template <typename elemT, typename PotentialT>
+bool
+NeighbourhoodPrior<elemT,PotentialT>::post_processing()
+{
+  if (base_type::post_processing()==true)
+    return true;
+  if (this->potential.post_processing()==true)
+    return true;
+  if (kappa_filename.size() != 0)
+    this->kappa_ptr = read_from_file<DiscretisedDensity<3,elemT> >(kappa_filename);
+
+  if (this->weights.size() !=0)
+    {
+      bool has_even_size;
+      if (!centre_neighbourhood_weights(this->weights, has_even_size))
+        {
+          warning("Sorry. NeighbourhoodPrior currently only supports regular arrays for the weights");
+          return true;
+        }
+      if (has_even_size)
+        warning("Parsing NeighbourhoodPrior: even number of weights occured in either x,y or z dimension.\n"
+                "I'll (effectively) make this odd by appending a 0 at the end.");
+    }
+  return false;
+}
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::set_defaults()
+{
+  base_type::set_defaults();
+  this->only_2D = false;
+  this->kappa_ptr.reset();
+  this->weights.recycle();
+  this->potential.set_defaults();
+}
+
+template <>
+const char * const
+NeighbourhoodPrior<float, HuberPotential<float> >::registered_name =
+  "Huber";
+
+template <>
+const char * const
+NeighbourhoodPrior<float, LogCoshPotential<float> >::registered_name =
+  "Log-Cosh";
+
+template <>
+const char * const
+NeighbourhoodPrior<float, RelativeDifferencePotential<float> >::registered_name =
+  "Relative Difference";
+
+template <typename elemT, typename PotentialT>
+NeighbourhoodPrior<elemT,PotentialT>::NeighbourhoodPrior()
+{
+  set_defaults();
+}
+
+template <typename elemT, typename PotentialT>
+NeighbourhoodPrior<elemT,PotentialT>::
+NeighbourhoodPrior(const bool only_2D_v, float penalisation_factor_v, const PotentialT& potential_v)
+  :  only_2D(only_2D_v), potential(potential_v)
+{
+  this->penalisation_factor = penalisation_factor_v;
+}
+
+template <typename elemT, typename PotentialT>
+Array<3,float>
+NeighbourhoodPrior<elemT,PotentialT>::
+get_weights() const
+{ return this->weights; }
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::
+set_weights(const Array<3,float>& w)
+{ this->weights = w; }
+
+template <typename elemT, typename PotentialT>
+shared_ptr<DiscretisedDensity<3,elemT> >
+NeighbourhoodPrior<elemT,PotentialT>::
+get_kappa_sptr() const
+{ return this->kappa_ptr; }
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::
+set_kappa_sptr(const shared_ptr<DiscretisedDensity<3,elemT> >& k)
+{ this->kappa_ptr = k; }
+
+template <typename elemT, typename PotentialT>
+const PotentialT&
+NeighbourhoodPrior<elemT,PotentialT>::
+get_potential() const
+{ return this->potential; }
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::
+set_potential(const PotentialT& p)
+{ this->potential = p; }
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::
+set_up_for_image(const DiscretisedDensity<3,elemT>& current_image_estimate)
+{
+  if (this->weights.get_length() ==0)
+    {
+      const DiscretisedDensityOnCartesianGrid<3,elemT>& current_image_cast =
+        dynamic_cast< const DiscretisedDensityOnCartesianGrid<3,elemT> &>(current_image_estimate);
+      compute_inverse_distance_weights(this->weights, current_image_cast.get_grid_spacing(), this->only_2D);
+    }
+
+  if (!is_null_ptr(kappa_ptr) && !kappa_ptr->has_same_characteristics(current_image_estimate))
+    error("NeighbourhoodPrior: kappa image has not the same index range as the reconstructed image\n");
+}
+
+template <typename elemT, typename PotentialT>
+double
+NeighbourhoodPrior<elemT,PotentialT>::
+compute_value(const DiscretisedDensity<3,elemT> &current_image_estimate)
+{
+  if (this->penalisation_factor==0)
+  {
+    return 0.;
+  }
+  this->set_up_for_image(current_image_estimate);
+
+  const NeighbourhoodStencil<elemT> stencil(this->weights);
+  const double result =
+    stencil.apply(0, false, 1.F, current_image_estimate, kappa_ptr.get(),
+                  PotentialValueKernel<elemT,PotentialT>(this->potential));
+  return result * this->penalisation_factor;
+}
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::
+compute_gradient(DiscretisedDensity<3,elemT>& prior_gradient,
+                 const DiscretisedDensity<3,elemT> &current_image_estimate)
+{
+  assert(  prior_gradient.has_same_characteristics(current_image_estimate));
+  if (this->penalisation_factor==0)
+  {
+    prior_gradient.fill(0);
+    return;
+  }
+  this->set_up_for_image(current_image_estimate);
+
+  const NeighbourhoodStencil<elemT> stencil(this->weights);
+  stencil.apply(&prior_gradient, /*add_to_output=*/false, this->penalisation_factor,
+                current_image_estimate, kappa_ptr.get(),
+                PotentialGradientKernel<elemT,PotentialT>(this->potential));
+
+  info(boost::format("Prior gradient max %1%, min %2%\n") % prior_gradient.find_max() % prior_gradient.find_min());
+
+  static int count = 0;
+  ++count;
+  if (gradient_filename_prefix.size()>0)
+    {
+      char *filename = new char[gradient_filename_prefix.size()+100];
+      sprintf(filename, "%s%d.v", gradient_filename_prefix.c_str(), count);
+      write_to_file(filename, prior_gradient);
+      delete[] filename;
+    }
+}
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::
+parabolic_surrogate_curvature(DiscretisedDensity<3,elemT>& parabolic_surrogate_curvature,
+                              const DiscretisedDensity<3,elemT> &current_image_estimate)
+{
+  assert( parabolic_surrogate_curvature.has_same_characteristics(current_image_estimate));
+  if (this->penalisation_factor==0)
+  {
+    parabolic_surrogate_curvature.fill(0);
+    return;
+  }
+  this->set_up_for_image(current_image_estimate);
+
+  const NeighbourhoodStencil<elemT> stencil(this->weights);
+  stencil.apply(&parabolic_surrogate_curvature, /*add_to_output=*/false, this->penalisation_factor,
+                current_image_estimate, kappa_ptr.get(),
+                PotentialCurvatureKernel<elemT,PotentialT>(this->potential));
+}
+
+template <typename elemT, typename PotentialT>
+void
+NeighbourhoodPrior<elemT,PotentialT>::
+compute_Hessian(DiscretisedDensity<3,elemT>& prior_Hessian_for_single_densel,
+                const BasicCoordinate<3,int>& coords,
+                const DiscretisedDensity<3,elemT> &current_image_estimate)
+{
+  assert(  prior_Hessian_for_single_densel.has_same_characteristics(current_image_estimate));
+  prior_Hessian_for_single_densel.fill(0);
+  if (this->penalisation_factor==0)
+  {
+    return;
+  }
+  this->set_up_for_image(current_image_estimate);
+
+  const bool do_kappa = !is_null_ptr(kappa_ptr);
+  const int z = coords[1];
+  const int y = coords[2];
+  const int x = coords[3];
+  const int min_dz = max(weights.get_min_index(), current_image_estimate.get_min_index()-z);
+  const int max_dz = min(weights.get_max_index(), current_image_estimate.get_max_index()-z);
+
+  const int min_dy = max(weights[0].get_min_index(), current_image_estimate[z].get_min_index()-y);
+  const int max_dy = min(weights[0].get_max_index(), current_image_estimate[z].get_max_index()-y);
+
+  const int min_dx = max(weights[0][0].get_min_index(), current_image_estimate[z][y].get_min_index()-x);
+  const int max_dx = min(weights[0][0].get_max_index(), current_image_estimate[z][y].get_max_index()-x);
+
+  const elemT centre = current_image_estimate[z][y][x];
+  elemT diagonal = 0;
+  for (int dz=min_dz;dz<=max_dz;++dz)
+    for (int dy=min_dy;dy<=max_dy;++dy)
+      for (int dx=min_dx;dx<=max_dx;++dx)
+      {
+        if (weights[dz][dy][dx] == 0)
+          continue;
+        const elemT neighbour = current_image_estimate[z+dz][y+dy][x+dx];
+        elemT factor = weights[dz][dy][dx];
+        if (do_kappa)
+          factor *= (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
+
+        diagonal += factor * this->potential.derivative_20(centre, neighbour);
+        prior_Hessian_for_single_densel[z+dz][y+dy][x+dx] =
+          factor * this->potential.derivative_11(centre, neighbour) * this->penalisation_factor;
+      }
+
+  prior_Hessian_for_single_densel[z][y][x]= diagonal * this->penalisation_factor;
+}
+
+#  ifdef _MSC_VER
+// prevent warning message on reinstantiation,
+// note that we get a linking error if we don't have the explicit instantiation below
+#  pragma warning(disable:4660)
+#  endif
+
+template class NeighbourhoodPrior<float, HuberPotential<float> >;
+template class NeighbourhoodPrior<float, LogCoshPotential<float> >;
+template class NeighbourhoodPrior<float, RelativeDifferencePotential<float> >;
+
+END_NAMESPACE_STIR
@@ -1,6 +1,7 @@
 /*
     Copyright (C) 2003 - 2011-06-29, Hammersmith Imanet Ltd
     Copyright (C) 2011-07-01 - 2012, Kris Thielemans
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -28,6 +29,8 @@
 #include "stir/is_null_ptr.h"
 #include "stir/IO/write_to_file.h"
 #include "stir/IO/read_from_file.h"
+#include "stir/recon_buildblock/cache_keys.h"
+#include "stir/recon_buildblock/image_cache.h"
 #include "stir/Succeeded.h"
 #include <algorithm>
 #include <exception>
@@ -35,6 +38,10 @@
 #include "stir/modelling/KineticParameters.h"
 #include "stir/info.h"
 #include "boost/format.hpp"
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <vector>
 
 using std::string;
 
@@ -51,6 +58,8 @@ set_defaults()
   this->subsensitivity_filenames = "";  
   this->recompute_sensitivity = false;
   this->use_subset_sensitivities = true;
+  this->sensitivity_cache_directory = "";
+  this->sensitivity_was_read_from_cache = false;
   this->subsensitivity_sptrs.resize(0);
 }
 
@@ -65,6 +74,7 @@ initialise_keymap()
   this->parser.add_key("subset sensitivity filenames", &this->subsensitivity_filenames);
   this->parser.add_key("recompute sensitivity", &this->recompute_sensitivity);
   this->parser.add_key("use_subset_sensitivities", &this->use_subset_sensitivities);
+  this->parser.add_key("sensitivity cache directory", &this->sensitivity_cache_directory);
 
 }
 
@@ -146,6 +156,30 @@ get_sensitivity() const
   return *this->sensitivity_sptr;
 }
 
+template<typename TargetT>
+std::string
+PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
+get_sensitivity_cache_directory() const
+{
+  return this->sensitivity_cache_directory;
+}
+
+template<typename TargetT>
+void
+PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
+set_sensitivity_cache_directory(const std::string& directory)
+{
+  this->sensitivity_cache_directory = directory;
+}
+
+template<typename TargetT>
+bool
+PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
+get_sensitivity_was_read_from_cache() const
+{
+  return this->sensitivity_was_read_from_cache;
+}
+
 template<typename TargetT>
 bool
 PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
@@ -196,6 +230,10 @@ set_up(shared_ptr<TargetT> const& target_sptr)
     return Succeeded::no;
 
   this->subsensitivity_sptrs.resize(this->num_subsets);
+  this->sensitivity_was_read_from_cache = false;
+
+  // the cache is only used when the sensitivity is not recomputed on request
+  const bool recompute_sensitivity_requested = this->recompute_sensitivity;
 
   if(!this->recompute_sensitivity)
     {      
@@ -309,11 +347,30 @@ set_up(shared_ptr<TargetT> const& target_sptr)
 
   if(this->recompute_sensitivity)
     {
-      info("Computing sensitivity");      
-      // preallocate one such that compute_sensitivities knows the size
-      this->subsensitivity_sptrs[0].reset(target_sptr->get_empty_copy());
-      this->compute_sensitivities();
-      info("Done computing sensitivity");
+      std::string cache_key_filename;
+      std::string cache_description;
+      const bool use_cache =
+        this->get_sensitivity_cache_key(cache_key_filename, cache_description, *target_sptr);
+      if (use_cache && !recompute_sensitivity_requested &&
+          this->read_sensitivities_from_cache(cache_key_filename, cache_description, *target_sptr)
+          == Succeeded::yes)
+        {
+          info(boost::format("Using sensitivity from cache '%1%'") % cache_key_filename);
+          this->sensitivity_was_read_from_cache = true;
+        }
+      else
+        {
+          info("Computing sensitivity");      
+          // preallocate one such that compute_sensitivities knows the size
+          this->subsensitivity_sptrs[0].reset(target_sptr->get_empty_copy());
+          this->compute_sensitivities();
+          info("Done computing sensitivity");
+
+          if (use_cache &&
+              this->write_sensitivities_to_cache(cache_key_filename, cache_description) != Succeeded::yes)
+            warning(boost::format("Error writing sensitivity to cache directory '%1%'. Continuing without.") %
+                    this->sensitivity_cache_directory);
+        }
 
       // write to file
       try
@@ -472,6 +529,85 @@ set_total_or_subset_sensitivities()
 
 }
 
+template<typename TargetT>
+std::string
+PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
+get_sensitivity_cache_key_description() const
+{
+  return "";
+}
+
+template<typename TargetT>
+bool
+PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
+get_sensitivity_cache_key(std::string& key_filename, std::string& description,
+                          const TargetT& target) const
+{
+  if (this->sensitivity_cache_directory.empty())
+    return false;
+
+  const std::string objective_function_description =
+    this->get_sensitivity_cache_key_description();
+  if (objective_function_description.empty())
+    {
+      warning("'sensitivity cache directory' is set, but this objective function does not support caching. Ignored.");
+      return false;
+    }
+
+  std::ostringstream s;
+  s << objective_function_description
+    << "number of subsets := " << this->num_subsets << '\n'
+    << "use_subset_sensitivities := " << this->use_subset_sensitivities << '\n'
+    << get_geometry_description(target);
+  description = s.str();
+
+  key_filename =
+    get_cache_key_filename(this->sensitivity_cache_directory, "sensitivity", description);
+  return true;
+}
+
+template<typename TargetT>
+Succeeded
+PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
+read_sensitivities_from_cache(const std::string& key_filename,
+                              const std::string& description,
+                              const TargetT& target)
+{
+  const std::size_t num_files =
+    this->get_use_subset_sensitivities() ? this->num_subsets : 1;
+  std::vector<shared_ptr<TargetT> > sensitivity_sptrs;
+  if (read_images_from_cache(sensitivity_sptrs, key_filename, description, target, num_files, "sensitivity")
+      != Succeeded::yes)
+    return Succeeded::no;
+  if (this->get_use_subset_sensitivities())
+    {
+      for (int subset=0; subset<this->num_subsets; ++subset)
+        this->subsensitivity_sptrs[subset] = sensitivity_sptrs[subset];
+    }
+  else
+    this->sensitivity_sptr = sensitivity_sptrs[0];
+  // compute total from subsensitivity or vice versa
+  this->set_total_or_subset_sensitivities();
+  return Succeeded::yes;
+}
+
+template<typename TargetT>
+Succeeded
+PoissonLogLikelihoodWithLinearModelForMean<TargetT>::
+write_sensitivities_to_cache(const std::string& key_filename,
+                             const std::string& description) const
+{
+  std::vector<shared_ptr<TargetT> > sensitivity_sptrs;
+  if (this->get_use_subset_sensitivities())
+    {
+      for (int subset=0; subset<this->num_subsets; ++subset)
+        sensitivity_sptrs.push_back(this->get_subset_sensitivity_sptr(subset));
+    }
+  else
+    sensitivity_sptrs.push_back(this->sensitivity_sptr);
+  return write_images_to_cache(key_filename, description, sensitivity_sptrs);
+}
+
 
 template<typename TargetT>
 void
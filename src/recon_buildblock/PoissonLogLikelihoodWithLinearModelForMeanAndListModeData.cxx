@@ -2,6 +2,7 @@
 // 
 /* 
     Copyright (C) 2003- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -30,6 +31,7 @@
 #include "stir/VoxelsOnCartesianGrid.h" 
 #include "stir/Succeeded.h" 
 #include "stir/IO/read_from_file.h"
+#include "stir/recon_buildblock/TrivialBinNormalisation.h"
 
 using std::vector;
 using std::pair;
@@ -53,7 +55,8 @@ set_defaults()
   this->list_mode_filename =""; 
   this->frame_defs_filename ="";
   this->list_mode_data_sptr.reset(); 
-  this->current_frame_num =0; 
+  this->current_frame_num =1; // frame numbers start from 1
+  this->normalisation_sptr.reset(new TrivialBinNormalisation);
  
   this->output_image_size_xy=-1; 
   this->output_image_size_z=-1; 
@@ -81,6 +84,7 @@ initialise_keymap()
   this->parser.add_key("time frame definition filename", &this->frame_defs_filename);
   // SM TODO -- later do not parse
   this->parser.add_key("time frame number", &this->current_frame_num);
+  this->parser.add_parsing_key("Bin Normalisation type", &this->normalisation_sptr);
      
 } 
 
@@ -1,6 +1,6 @@
 /*
     Copyright (C) 2003- 2011, Hammersmith Imanet Ltd
-    Copyright (C) 2014, University College London
+    Copyright (C) 2014, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -28,12 +28,21 @@
 #include "stir/recon_buildblock/ProjMatrixByBinUsingRayTracing.h" 
 #include "stir/recon_buildblock/ProjMatrixElemsForOneBin.h"
 #include "stir/recon_buildblock/ProjectorByBinPairUsingProjMatrixByBin.h"
+#include "stir/recon_buildblock/ThreadLocalImages.h"
+#include "stir/recon_buildblock/BinNormalisation.h"
+#include "stir/recon_buildblock/TrivialDataSymmetriesForBins.h"
+#include "stir/RelatedViewgrams.h"
 #include "stir/ProjDataInfoCylindricalNoArcCorr.h"
 #include "stir/ProjData.h"
 #include "stir/listmode/CListRecord.h"
+#include "stir/listmode/ListModeEventCache.h"
 #include "stir/Viewgram.h"
+#include "stir/ViewSegmentNumbers.h"
 #include "stir/info.h"
 #include <boost/format.hpp>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
 
 #ifdef STIR_MPI
 #include "stir/recon_buildblock/distributed_functions.h"
@@ -65,6 +74,9 @@ set_defaults()
   this->additive_proj_data_sptr.reset();
   this->additive_projection_data_filename ="0"; 
   this->max_ring_difference_num_to_process =-1;
+  this->num_events_per_batch = 100000;
+  this->cache_decoded_events = false;
+  this->event_cache_sptr.reset();
   this->PM_sptr.reset(new  ProjMatrixByBinUsingRayTracing()); 
 } 
  
@@ -79,6 +91,8 @@ initialise_keymap()
   this->parser.add_key("max ring difference num to process", &this->max_ring_difference_num_to_process);
   this->parser.add_parsing_key("Matrix type", &this->PM_sptr); 
   this->parser.add_key("additive sinogram",&this->additive_projection_data_filename); 
+  this->parser.add_key("cache decoded events", &this->cache_decoded_events);
+  this->parser.add_key("number of events per batch", &this->num_events_per_batch);
  
    
 } 
@@ -87,18 +101,32 @@ int
 PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<TargetT>::
 set_num_subsets(const int new_num_subsets)
 {
-  if (new_num_subsets!=1)
-    warning("PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin currently only supports 1 subset");
-  this->num_subsets = 1;
+  this->num_subsets = new_num_subsets;
   return this->num_subsets;
 }
 
 template<typename TargetT>
 bool
 PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<TargetT>::
-actual_subsets_are_approximately_balanced(std::string&) const
+actual_subsets_are_approximately_balanced(std::string& warning_message) const
+{
+  const int num_views = this->proj_data_info_cyl_uncompressed_ptr->get_num_views();
+  if (num_views % this->num_subsets == 0)
+    return true;
+  warning_message +=
+    boost::str(boost::format("Number of subsets %1% is not a divisor of the number of views %2%.\n") %
+               this->num_subsets % num_views);
+  return false; 
+}
+
+template <typename TargetT>
+bool
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<TargetT>::
+is_bin_in_subset(const Bin& bin, const int subset_num) const
 {
-  return true; 
+  // same as the loop over views in add_subset_sensitivity()
+  const int min_view_num = this->proj_data_info_cyl_uncompressed_ptr->get_min_view_num();
+  return (bin.view_num() - min_view_num) % this->num_subsets == subset_num;
 }
 
 template <typename TargetT>  
@@ -112,8 +140,42 @@ set_up_before_sensitivity(shared_ptr <TargetT > const& target_sptr)
 #endif
         
  
+  if (this->num_subsets > this->proj_data_info_cyl_uncompressed_ptr->get_num_views())
+    {
+      warning("Number of subsets %d is larger than the number of views %d",
+              this->num_subsets, this->proj_data_info_cyl_uncompressed_ptr->get_num_views());
+      return Succeeded::no;
+    }
+
   // set projector to be used for the calculations    
   this->PM_sptr->set_up(this->proj_data_info_cyl_uncompressed_ptr->create_shared_clone(),target_sptr); 
+
+  if (is_null_ptr(this->normalisation_sptr))
+    {
+      warning("Invalid normalisation object");
+      return Succeeded::no;
+    }
+  if (this->normalisation_sptr->set_up(this->proj_data_info_cyl_uncompressed_ptr->create_shared_clone()) == Succeeded::no)
+    {
+      warning("Set-up of the normalisation failed");
+      return Succeeded::no;
+    }
+
+  if (this->cache_decoded_events)
+    {
+      info("Reading and decoding all events of the list mode data");
+      this->event_cache_sptr.reset(new ListModeEventCache(this->proj_data_info_cyl_uncompressed_ptr));
+      if (this->event_cache_sptr->fill(*this->list_mode_data_sptr) == Succeeded::no)
+        {
+          warning("Error reading list mode data for the event cache");
+          return Succeeded::no;
+        }
+      info(boost::format("Stored %1% events (using %2% MB)")
+           % this->event_cache_sptr->get_num_events()
+           % (this->event_cache_sptr->get_memory_usage_in_bytes()/1000000.));
+    }
+  else
+    this->event_cache_sptr.reset();
   return Succeeded::yes;
 } 
  
@@ -131,6 +193,9 @@ PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<Tar
 
     { warning("You need to specify a projection matrix"); return true; } 
 
+  if (this->num_events_per_batch == 0)
+    { warning("number of events per batch should be positive"); return true; }
+
 #else
   if(is_null_ptr(this->projector_pair_sptr->get_forward_projector_sptr()))
     {
@@ -193,6 +258,84 @@ construct_target_ptr() const
 
 } 
  
+template <typename TargetT> 
+bool
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<TargetT>:: 
+read_batch_of_events(std::vector<Bin>& measured_bins,
+                     std::vector<float>& additive_values,
+                     CListRecord& record,
+                     double& current_time,
+                     const double start_time, const double end_time,
+                     std::size_t& cached_event_num, const std::size_t end_cached_event_num,
+                     const int subset_num) const
+{
+  measured_bins.resize(0);
+  additive_values.resize(0);
+  if (!is_null_ptr(this->event_cache_sptr))
+    {
+      const ListModeEventCache& event_cache = *this->event_cache_sptr;
+      Bin measured_bin;
+      while (measured_bins.size() < this->num_events_per_batch)
+        {
+          if (cached_event_num >= end_cached_event_num)
+            return false;
+          const std::size_t event_num = cached_event_num++;
+          if (!event_cache.is_prompt(event_num))
+            continue;
+          event_cache.get_bin(measured_bin, event_num);
+          if (!this->is_bin_in_subset(measured_bin, subset_num))
+            continue;
+          measured_bins.push_back(measured_bin);
+          additive_values.push_back(is_null_ptr(this->additive_proj_data_sptr)
+                                    ? 0.F
+                                    : this->additive_proj_data_sptr->get_bin_value(measured_bin));
+        }
+      return cached_event_num < end_cached_event_num;
+    }
+
+  while (measured_bins.size() < this->num_events_per_batch)
+    {
+      if (this->list_mode_data_sptr->get_next_record(record) != Succeeded::yes)
+        return false;
+      if(record.is_time())
+        {
+          current_time = record.time().get_time_in_secs();
+        }
+      if (current_time >= end_time)
+        {
+          return false;
+        }
+      if (current_time < start_time)
+        continue;
+      if (record.is_event() && record.event().is_prompt()) 
+        { 
+          Bin measured_bin; 
+          record.event().get_bin(measured_bin, *proj_data_info_cyl_uncompressed_ptr); 
+          if (measured_bin.get_bin_value() <= 0)
+            continue;      
+          if (!this->is_bin_in_subset(measured_bin, subset_num))
+            continue;
+          measured_bins.push_back(measured_bin);
+          // additive sinogram 
+          // (read here as ProjDataInMemory::get_bin_value is not thread-safe)
+          additive_values.push_back(is_null_ptr(this->additive_proj_data_sptr)
+                                    ? 0.F
+                                    : this->additive_proj_data_sptr->get_bin_value(measured_bin));
+        }
+    }
+  return true;
+}
+
+/*!
+  Events are read in batches. When compiled with OpenMP, the events of a batch are
+  divided into as many parts as there are threads, and every part is processed by a
+  task, while another task reads the next batch. Every part back projects into its own
+  image (the first part uses \a gradient), and these are added together at the end
+  (see ThreadLocalImages). As the parts only depend on the number of threads, the result
+  does not depend on timing, i.e. it is reproducible for a given number of threads.
+  Due to the different order of floating point operations, it differs slightly from
+  the result with 1 thread.
+*/
 template <typename TargetT> 
 void 
 PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<TargetT>:: 
@@ -203,55 +346,205 @@ compute_sub_gradient_without_penalty_plus_sensitivity(TargetT& gradient,
 
   const double start_time = this->frame_defs.get_start_time(this->current_frame_num);
   const double end_time = this->frame_defs.get_end_time(this->current_frame_num);
-  //go to the beginning of this frame
-  //  list_mode_data_sptr->set_get_position(start_time);
-  // TODO implement function that will do this for a random time
-  this->list_mode_data_sptr->reset();
+  std::size_t cached_event_num = 0;
+  std::size_t end_cached_event_num = 0;
   double current_time = 0.;
-  ProjMatrixElemsForOneBin proj_matrix_row; 
+  if (!is_null_ptr(this->event_cache_sptr))
+    {
+      this->event_cache_sptr->
+        get_event_range_for_time_interval(cached_event_num, end_cached_event_num,
+                                          start_time, end_time);
+    }
+  else
+    {
+      //go to the beginning of this frame
+      // (the list mode data starts at time 0, so we only need the time index for later frames)
+      if (start_time <= 0 ||
+          this->list_mode_data_sptr->set_get_position_for_time(start_time, current_time) == Succeeded::no)
+        {
+          this->list_mode_data_sptr->reset();
+          current_time = 0.;
+        }
+    }
   shared_ptr<CListRecord> record_sptr = this->list_mode_data_sptr->get_empty_record_sptr(); 
   CListRecord& record = *record_sptr; 
-  //  int count_of_events=0;
-  //int in_the_range =0;
-  while (this->list_mode_data_sptr->get_next_record(record) == Succeeded::yes) 
-  { 
-    //count_of_events++;
-    if(record.is_time())
+
+  // images for back projection for every part of a batch
+  ThreadLocalImages local_gradients(gradient);
+
+  // double buffering: events of the current batch are processed, while the next batch is read
+  std::vector<Bin> measured_bins[2];
+  std::vector<float> additive_values[2];
+  int current_batch = 0;
+  bool more_events =
+    this->read_batch_of_events(measured_bins[current_batch], additive_values[current_batch],
+                               record, current_time, start_time, end_time,
+                               cached_event_num, end_cached_event_num, subset_num);
+
+#ifdef STIR_OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+  {
+#ifdef STIR_OPENMP
+    const int num_parts = omp_get_num_threads();
+#else
+    const int num_parts = 1;
+#endif
+    while (measured_bins[current_batch].size() > 0)
       {
-        current_time = record.time().get_time_in_secs();
+        const int batch = current_batch;
+        const int next_batch = 1 - current_batch;
+        bool more_events_after_next = false;
+#ifdef STIR_OPENMP
+#pragma omp task shared(more_events_after_next)
+#endif
+        {
+          if (more_events)
+            more_events_after_next = 
+              this->read_batch_of_events(measured_bins[next_batch], additive_values[next_batch],
+                                         record, current_time, start_time, end_time,
+                                         cached_event_num, end_cached_event_num, subset_num);
+          else
+            {
+              measured_bins[next_batch].resize(0);
+              additive_values[next_batch].resize(0);
+            }
+        }
+
+        const int num_events = static_cast<int>(measured_bins[batch].size());
+        for (int part_num=0; part_num<num_parts; ++part_num)
+          {
+#ifdef STIR_OPENMP
+#pragma omp task
+#endif
+            {
+              TargetT& local_gradient = local_gradients.get_local_image(part_num);
+              ProjMatrixElemsForOneBin proj_matrix_row; 
+              const int end_event_num = static_cast<int>((static_cast<long>(part_num+1)*num_events)/num_parts);
+              for (int event_num=static_cast<int>((static_cast<long>(part_num)*num_events)/num_parts);
+                   event_num<end_event_num;
+                   ++event_num)
+                {
+                  Bin measured_bin = measured_bins[batch][event_num];
+                  this->PM_sptr->get_proj_matrix_elems_for_one_bin(proj_matrix_row, measured_bin); 
+                  Bin fwd_bin; 
+                  fwd_bin.set_bin_value(0);
+                  proj_matrix_row.forward_project(fwd_bin,current_estimate); 
+                  fwd_bin.set_bin_value(fwd_bin.get_bin_value() + additive_values[batch][event_num]);
+                  const float measured_div_fwd = measured_bin.get_bin_value()/fwd_bin.get_bin_value();
+                  measured_bin.set_bin_value(measured_div_fwd);
+                  proj_matrix_row.back_project(local_gradient, measured_bin); 
+                }
+            }
+          }
+#ifdef STIR_OPENMP
+#pragma omp taskwait
+#endif
+        more_events = more_events_after_next;
+        current_batch = next_batch;
       }
-    if (current_time >= end_time)
+  }
+
+  // add the images of the threads (in a fixed order for reproducibility)
+  local_gradients.reduce();
+}
+
+/*!
+  Back projects the normalisation factors (as found by BinNormalisation::undo() for the
+  current time frame) for all bins in the subset, as
+  PoissonLogLikelihoodWithLinearModelForMeanAndProjData does.
+  When compiled with OpenMP, every thread uses its own image, which are added at the end.
+*/
+template <typename TargetT> 
+void 
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<TargetT>:: 
+add_subset_sensitivity(TargetT& sensitivity, const int subset_num) const
+{
+  const ProjDataInfo& proj_data_info = *this->proj_data_info_cyl_uncompressed_ptr;
+  // list all (view,segment) combinations in this subset
+  std::vector<ViewSegmentNumbers> vs_nums;
+  for (int view_num = proj_data_info.get_min_view_num() + subset_num;
+       view_num <= proj_data_info.get_max_view_num();
+       view_num += this->num_subsets)
+    for (int segment_num = proj_data_info.get_min_segment_num();
+         segment_num <= proj_data_info.get_max_segment_num();
+         ++segment_num)
+      vs_nums.push_back(ViewSegmentNumbers(view_num, segment_num));
+  assert(vs_nums.size()==0 || this->is_bin_in_subset(Bin(vs_nums[0].segment_num(), vs_nums[0].view_num(), 0, 0), subset_num));
+
+  const bool use_normalisation = !this->normalisation_sptr->is_trivial();
+  const double start_time = this->frame_defs.get_start_time(this->current_frame_num);
+  const double end_time = this->frame_defs.get_end_time(this->current_frame_num);
+  // viewgrams are normalised one by one (the projection matrix handles the symmetries)
+  const shared_ptr<DataSymmetriesForViewSegmentNumbers>
+    symmetries_sptr(new TrivialDataSymmetriesForBins(this->proj_data_info_cyl_uncompressed_ptr->create_shared_clone()));
+
+  ThreadLocalImages local_sensitivities(sensitivity);
+
+#ifdef STIR_OPENMP
+#pragma omp parallel
+#endif
+  {
+    TargetT& local_sensitivity = local_sensitivities.get_local_image();
+    ProjMatrixElemsForOneBin proj_matrix_row; 
+#ifdef STIR_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int i=0; i<static_cast<int>(vs_nums.size()); ++i)
       {
-        break; // get out of while loop
-      }
-    if (current_time < start_time)
-      continue;
-    if (record.is_event() && record.event().is_prompt()) 
-      { 
-        Bin measured_bin; 
-        record.event().get_bin(measured_bin, *proj_data_info_cyl_uncompressed_ptr); 
-        if (measured_bin.get_bin_value() <= 0)
-          continue;      
-        this->PM_sptr->get_proj_matrix_elems_for_one_bin(proj_matrix_row, measured_bin); 
-        //in_the_range++;
-        Bin fwd_bin; 
-        proj_matrix_row.forward_project(fwd_bin,current_estimate); 
-        // additive sinogram 
-        if (!is_null_ptr(this->additive_proj_data_sptr))
+        const int view_num = vs_nums[i].view_num();
+        const int segment_num = vs_nums[i].segment_num();
+        RelatedViewgrams<float> efficiencies;
+        if (use_normalisation)
           {
-            float add_value = this->additive_proj_data_sptr->get_bin_value(measured_bin);
-            float value= fwd_bin.get_bin_value()+add_value;         
-            fwd_bin.set_bin_value(value);
+            efficiencies = proj_data_info.get_empty_related_viewgrams(vs_nums[i], symmetries_sptr);
+            efficiencies.fill(1.F);
+            // BinNormalisation objects are not guaranteed to be thread-safe
+#ifdef STIR_OPENMP
+#pragma omp critical(LISTMODE_SENSITIVITY_NORMALISATION)
+#endif
+            this->normalisation_sptr->undo(efficiencies, start_time, end_time);
           }
-        float  measured_div_fwd = measured_bin.get_bin_value()/fwd_bin.get_bin_value();
-        measured_bin.set_bin_value(measured_div_fwd);
-        proj_matrix_row.back_project(gradient, measured_bin); 
-         
-      } 
+        for (int axial_pos_num = proj_data_info.get_min_axial_pos_num(segment_num);
+             axial_pos_num <= proj_data_info.get_max_axial_pos_num(segment_num);
+             ++axial_pos_num)
+          for (int tangential_pos_num = proj_data_info.get_min_tangential_pos_num();
+               tangential_pos_num <= proj_data_info.get_max_tangential_pos_num();
+               ++tangential_pos_num)
+            {
+              const float efficiency =
+                use_normalisation ? (*efficiencies.begin())[axial_pos_num][tangential_pos_num] : 1.F;
+              if (efficiency == 0)
+                continue;
+              const Bin bin(segment_num, view_num, axial_pos_num, tangential_pos_num, efficiency);
+              this->PM_sptr->get_proj_matrix_elems_for_one_bin(proj_matrix_row, bin);
+              proj_matrix_row.back_project(local_sensitivity, bin);
+            }
+      }
   }
-  //  cerr << " The number_of_events " << count_of_events << "   ";
-  //cerr << " The number of events proecessed "  << in_the_range << "  ";
-    
+
+  local_sensitivities.reduce();
+}
+
+template<typename TargetT>
+std::string
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<TargetT>::
+get_sensitivity_cache_key_description() const
+{
+  std::string description =
+    this->proj_data_info_cyl_uncompressed_ptr->parameter_info() +
+    this->PM_sptr->ParsingObject::parameter_info();
+  if (!this->normalisation_sptr->is_trivial())
+    {
+      // the normalisation factors can depend on the time frame
+      description += this->normalisation_sptr->parameter_info();
+      description +=
+        boost::str(boost::format("time frame: %1$.17g %2$.17g\n")
+                   % this->frame_defs.get_start_time(this->current_frame_num)
+                   % this->frame_defs.get_end_time(this->current_frame_num));
+    }
+  return description;
 }
 
 #  ifdef _MSC_VER
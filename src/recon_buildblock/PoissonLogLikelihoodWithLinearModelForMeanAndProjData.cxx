@@ -30,6 +30,7 @@
 #include "stir/recon_buildblock/PoissonLogLikelihoodWithLinearModelForMeanAndProjData.h"
 #include "stir/VoxelsOnCartesianGrid.h"
 #include "stir/recon_buildblock/TrivialBinNormalisation.h"
+#include "stir/recon_buildblock/InterleavedSubsetScheme.h"
 #include "stir/Succeeded.h"
 #include "stir/RelatedViewgrams.h"
 #include "stir/stream.h"
@@ -59,9 +60,12 @@
 #include "stir/Viewgram.h"
 #include "stir/recon_array_functions.h"
 #include "stir/is_null_ptr.h"
+#include "stir/SegmentBySinogram.h"
+#include "stir/recon_buildblock/cache_keys.h"
 #include <iostream>
 #include <algorithm>
 #include <sstream>
+#include <iomanip>
 #ifdef STIR_MPI
 #include "stir/recon_buildblock/distributed_functions.h"
 #endif
@@ -79,6 +83,34 @@ using std::max;
 
 START_NAMESPACE_STIR
 
+namespace
+{
+  //! hash of the projection data in the segments that are used
+  boost::uint64_t
+  hash_proj_data(const ProjData& proj_data, const int max_segment_num)
+  {
+    boost::uint64_t hash = hash_bytes(0, 0);
+    for (int segment_num = -max_segment_num; segment_num <= max_segment_num; ++segment_num)
+      {
+        const SegmentBySinogram<float> segment = proj_data.get_segment_by_sinogram(segment_num);
+        for (SegmentBySinogram<float>::const_full_iterator iter = segment.begin_all_const();
+             iter != segment.end_all_const();
+             ++iter)
+          {
+            const float value = *iter;
+            hash = hash_bytes(&value, sizeof(value), hash);
+          }
+      }
+    return hash;
+  }
+}
+
+#ifndef STIR_MPI
+//! Call-back function for actual_add_multiplication_with_approximate_sub_Hessian_without_penalty
+/*! With MPI, this is declared in the .h file, such that DistributedWorker can use it. */
+static RPC_process_related_viewgrams_type RPC_process_related_viewgrams_approximate_Hessian;
+#endif
+
 const int rim_truncation_sino = 0; // TODO get rid of this
 
 template<typename TargetT>
@@ -120,6 +152,7 @@ set_defaults()
 				 new ProjectorByBinPairUsingSeparateProjectors(forward_projector_ptr, back_projector_ptr));
 
   this->normalisation_sptr.reset(new TrivialBinNormalisation);
+  this->subset_scheme_sptr.reset(new InterleavedSubsetScheme);
   this->frame_num = 1;
   this->frame_definition_filename = "";
   // make a single frame starting from 0 to 1.
@@ -177,6 +210,7 @@ initialise_keymap()
   this->parser.add_key("time frame definition filename", &this->frame_definition_filename); 
   this->parser.add_key("time frame number", &this->frame_num);
   this->parser.add_parsing_key("Bin Normalisation type", &this->normalisation_sptr);
+  this->parser.add_parsing_key("subset scheme type", &this->subset_scheme_sptr);
 
 #ifdef STIR_MPI
   //distributed stuff 
@@ -410,6 +444,12 @@ PoissonLogLikelihoodWithLinearModelForMeanAndProjData<TargetT>::
 get_normalisation_sptr() const
 { return this->normalisation_sptr; }
 
+template<typename TargetT>
+const shared_ptr<SubsetScheme>&
+PoissonLogLikelihoodWithLinearModelForMeanAndProjData<TargetT>::
+get_subset_scheme_sptr() const
+{ return this->subset_scheme_sptr; }
+
 
 /***************************************************************
   set_ functions
@@ -490,6 +530,14 @@ set_normalisation_sptr(const shared_ptr<BinNormalisation>& arg)
   this->normalisation_sptr = arg;
 }
 
+template<typename TargetT>
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndProjData<TargetT>::
+set_subset_scheme_sptr(const shared_ptr<SubsetScheme>& arg)
+{
+  this->subset_scheme_sptr = arg;
+}
+
 template<typename TargetT>
 void
 PoissonLogLikelihoodWithLinearModelForMeanAndProjData<TargetT>::
@@ -515,19 +563,17 @@ actual_subsets_are_approximately_balanced(std::string& warning_message) const
   num_vs_in_subset.fill(0);
   for (int subset_num=0; subset_num<this->num_subsets; ++subset_num)
     {
-      for (int segment_num = -this->max_segment_num_to_process; 
-           segment_num <= this->max_segment_num_to_process; 
-           ++segment_num)
-        for (int view_num = this->proj_data_sptr->get_min_view_num() + subset_num; 
-             view_num <= this->proj_data_sptr->get_max_view_num(); 
-             view_num += this->num_subsets)
-          {
-            const ViewSegmentNumbers view_segment_num(view_num, segment_num);
-            if (!symmetries.is_basic(view_segment_num))
-              continue;
-            num_vs_in_subset[subset_num] +=
-              symmetries.num_related_view_segment_numbers(view_segment_num);
-          }
+      const std::vector<ViewSegmentNumbers> vs_nums_in_subset =
+        this->subset_scheme_sptr->
+        find_basic_vs_nums_in_subset(*this->proj_data_sptr->get_proj_data_info_ptr(), symmetries,
+                                     -this->max_segment_num_to_process,
+                                     this->max_segment_num_to_process,
+                                     subset_num, this->num_subsets);
+      for (std::vector<ViewSegmentNumbers>::const_iterator iter = vs_nums_in_subset.begin();
+           iter != vs_nums_in_subset.end();
+           ++iter)
+        num_vs_in_subset[subset_num] +=
+          symmetries.num_related_view_segment_numbers(*iter);
     }
   for (int subset_num=1; subset_num<this->num_subsets; ++subset_num)
     {
@@ -544,7 +590,7 @@ actual_subsets_are_approximately_balanced(std::string& warning_message) const
               << this->proj_data_sptr->get_num_views()
               << "/2 or "
               << this->proj_data_sptr->get_num_views() 
-	      << ").\n";
+	      << "),\nor use the Balanced subset scheme.\n";
           warning_message = str.str();
           return false;
         }
@@ -580,6 +626,9 @@ set_up_before_sensitivity(shared_ptr<TargetT > const& target_sptr)
   if (is_null_ptr(this->projector_pair_ptr))
     { warning("You need to specify a projector pair"); return Succeeded::no; }
 
+  if (is_null_ptr(this->subset_scheme_sptr))
+    { warning("You need to specify a subset scheme"); return Succeeded::no; }
+
   // set projectors to be used for the calculations
 
   setup_distributable_computation(this->projector_pair_ptr,
@@ -633,6 +682,38 @@ set_up_before_sensitivity(shared_ptr<TargetT > const& target_sptr)
   return Succeeded::yes;
 }
 
+template<typename TargetT>
+std::string
+PoissonLogLikelihoodWithLinearModelForMeanAndProjData<TargetT>::
+get_sensitivity_cache_key_description() const
+{
+  std::ostringstream s;
+  // write the frame times with all digits of a double (i.e. max_digits10), such that
+  // different frames give different keys
+  s << std::setprecision(17)
+    << this->proj_data_sptr->get_proj_data_info_ptr()->parameter_info()
+    << "maximum absolute segment number to process := " << this->max_segment_num_to_process << '\n'
+    << "zero end planes of segment 0 := " << this->zero_seg0_end_planes << '\n'
+    << "time frame start := " << this->frame_defs.get_start_time(this->frame_num) << '\n'
+    << "time frame end := " << this->frame_defs.get_end_time(this->frame_num) << '\n'
+    << this->projector_pair_ptr->ParsingObject::parameter_info()
+    << this->normalisation_sptr->parameter_info()
+    << this->subset_scheme_sptr->parameter_info();
+  return s.str();
+}
+
+template<typename TargetT>
+std::string
+PoissonLogLikelihoodWithLinearModelForMeanAndProjData<TargetT>::
+get_approximate_Hessian_cache_key_description() const
+{
+  std::ostringstream s;
+  s << this->get_sensitivity_cache_key_description()
+    << "measured data hash := " << std::hex << std::setfill('0') << std::setw(16)
+    << hash_proj_data(*this->proj_data_sptr, this->max_segment_num_to_process) << '\n';
+  return s.str();
+}
+
 /***************************************************************
   functions that compute the value/gradient of the objective function etc
 ***************************************************************/
@@ -654,6 +735,7 @@ compute_sub_gradient_without_penalty_plus_sensitivity(TargetT& gradient,
                                  this->proj_data_sptr, 
                                  subset_num, 
                                  this->num_subsets, 
+                                 *this->subset_scheme_sptr,
                                  -this->max_segment_num_to_process,
                                  this->max_segment_num_to_process, 
                                  this->zero_seg0_end_planes!=0, 
@@ -680,6 +762,7 @@ actual_compute_objective_function_without_penalty(const TargetT& current_estimat
                                          current_estimate,
                                          this->proj_data_sptr,
                                          subset_num, this->get_num_subsets(),
+                                         *this->subset_scheme_sptr,
                                          -this->max_segment_num_to_process, 
                                          this->max_segment_num_to_process, 
                                          this->zero_seg0_end_planes != 0, &accum,
@@ -742,24 +825,16 @@ add_subset_sensitivity(TargetT& sensitivity, const int subset_num) const
   const int min_segment_num = -this->max_segment_num_to_process;
   const int max_segment_num = this->max_segment_num_to_process;
 
-  // warning: has to be same as subset scheme used as in distributable_computation
-  for (int segment_num = min_segment_num; segment_num <= max_segment_num; ++segment_num)
-  {
-        //CPUTimer timer;
-        //timer.start();
-        
-    for (int view = this->proj_data_sptr->get_min_view_num() + subset_num; 
-        view <= this->proj_data_sptr->get_max_view_num(); 
-        view += this->num_subsets)
-    {
-      const ViewSegmentNumbers view_segment_num(view, segment_num);
-        
-      if (!symmetries_sptr->is_basic(view_segment_num))
-        continue;
-      this->add_view_seg_to_sensitivity(sensitivity, view_segment_num);
-    }
-      //    cerr<<timer.value()<<endl;
-  }
+  // use the same subsets as distributable_computation
+  const std::vector<ViewSegmentNumbers> vs_nums_in_subset =
+    this->subset_scheme_sptr->
+    find_basic_vs_nums_in_subset(*this->proj_data_sptr->get_proj_data_info_ptr(), *this->symmetries_sptr,
+                                 min_segment_num, max_segment_num,
+                                 subset_num, this->num_subsets);
+  for (std::vector<ViewSegmentNumbers>::const_iterator iter = vs_nums_in_subset.begin();
+       iter != vs_nums_in_subset.end();
+       ++iter)
+    this->add_view_seg_to_sensitivity(sensitivity, *iter);
 }
 
 
@@ -816,58 +891,31 @@ actual_add_multiplication_with_approximate_sub_Hessian_without_penalty(TargetT&
       }
   }     
 
-  shared_ptr<DataSymmetriesForViewSegmentNumbers> symmetries_sptr(
-    this->get_projector_pair().get_symmetries_used()->clone());
-
   const double start_time =
     this->get_time_frame_definitions().get_start_time(this->get_time_frame_num());
   const double end_time =
     this->get_time_frame_definitions().get_end_time(this->get_time_frame_num());
 
-  for (int segment_num = -this->get_max_segment_num_to_process();
-       segment_num<= this->get_max_segment_num_to_process();
-       ++segment_num) 
-    {      
-      for (int view = this->get_proj_data().get_min_view_num() + subset_num; 
-           view <= this->get_proj_data().get_max_view_num(); 
-           view += this->num_subsets)
-        {
-          const ViewSegmentNumbers view_segment_num(view, segment_num);
-          
-          if (!symmetries_sptr->is_basic(view_segment_num))
-            continue;
-
-          // first compute data-term: y*norm^2
-          RelatedViewgrams<float> viewgrams =
-            this->get_proj_data().get_related_viewgrams(view_segment_num, symmetries_sptr);
-          // TODO add 1 for 1/(y+1) approximation
-
-          this->get_normalisation().apply(viewgrams, start_time, end_time);
-
-          // smooth TODO
-
-          this->get_normalisation().apply(viewgrams, start_time, end_time);
-
-          RelatedViewgrams<float> tmp_viewgrams;
-          // set tmp_viewgrams to geometric forward projection of input
-          {
-            tmp_viewgrams = this->get_proj_data().get_empty_related_viewgrams(view_segment_num, symmetries_sptr);
-            this->get_projector_pair().get_forward_projector_sptr()->
-              forward_project(tmp_viewgrams, input);
-          }
-          
-          // now divide by the data term
-          {
-            int tmp1=0, tmp2=0;// ignore counters returned by divide_and_truncate
-            divide_and_truncate(tmp_viewgrams, viewgrams, 0, tmp1, tmp2);
-          }
-
-          // back-project
-          this->get_projector_pair().get_back_projector_sptr()->
-            back_project(output, tmp_viewgrams);
-      }
-
-  } // end of loop over segments
+  // distributable_computation() overwrites its output, so use a temporary image
+  shared_ptr<TargetT> tmp_output_sptr(output.get_empty_copy());
+  distributable_computation(this->projector_pair_ptr->get_forward_projector_sptr(),
+                            this->projector_pair_ptr->get_back_projector_sptr(),
+                            this->symmetries_sptr,
+                            tmp_output_sptr.get(), &input,
+                            this->proj_data_sptr, true, //i.e. do read projection data
+                            subset_num, this->num_subsets,
+                            *this->subset_scheme_sptr,
+                            -this->max_segment_num_to_process,
+                            this->max_segment_num_to_process,
+                            /* zero_seg0_end_planes */ false,
+                            NULL,
+                            /* no additive data */ shared_ptr<ProjData>(),
+                            this->normalisation_sptr,
+                            start_time,
+                            end_time,
+                            &RPC_process_related_viewgrams_approximate_Hessian,
+                            this->caching_info_ptr);
+  output += *tmp_output_sptr;
 
   return Succeeded::yes;
 }
@@ -898,6 +946,7 @@ void distributable_compute_gradient(const shared_ptr<ForwardProjectorByBin>& for
                                     const DiscretisedDensity<3,float>& input_image,
                                     const shared_ptr<ProjData>& proj_dat,
                                     int subset_num, int num_subsets,
+                                    const SubsetScheme& subset_scheme,
                                     int min_segment, int max_segment,
                                     bool zero_seg0_end_planes,
                                     double* log_likelihood_ptr,
@@ -912,6 +961,7 @@ void distributable_compute_gradient(const shared_ptr<ForwardProjectorByBin>& for
                               &output_image, &input_image,
                               proj_dat, true, //i.e. do read projection data
                               subset_num, num_subsets,
+                              subset_scheme,
                               min_segment, max_segment,
                               zero_seg0_end_planes,
                               log_likelihood_ptr,
@@ -930,6 +980,7 @@ void distributable_accumulate_loglikelihood(
                                             const DiscretisedDensity<3,float>& input_image,
                                             const shared_ptr<ProjData>& proj_dat,
                                             int subset_num, int num_subsets,
+                                            const SubsetScheme& subset_scheme,
                                             int min_segment, int max_segment,
                                             bool zero_seg0_end_planes,
                                             double* log_likelihood_ptr,
@@ -947,6 +998,7 @@ void distributable_accumulate_loglikelihood(
                                     NULL, &input_image, 
                                     proj_dat, true, //i.e. do read projection data
                                     subset_num, num_subsets,
+                                    subset_scheme,
                                     min_segment, max_segment,
                                     zero_seg0_end_planes,
                                     log_likelihood_ptr,
@@ -1064,6 +1116,40 @@ void RPC_process_related_viewgrams_accumulate_loglikelihood(
 };      
 
 
+void RPC_process_related_viewgrams_approximate_Hessian(
+                                                       const shared_ptr<ForwardProjectorByBin>& forward_projector_sptr,
+                                                       const shared_ptr<BackProjectorByBin>& back_projector_sptr,
+                                                       DiscretisedDensity<3,float>* output_image_ptr,
+                                                       const DiscretisedDensity<3,float>* input_image_ptr,
+                                                       RelatedViewgrams<float>* measured_viewgrams_ptr,
+                                                       int& count, int& count2, double* log_likelihood_ptr,
+                                                       const RelatedViewgrams<float>* additive_binwise_correction_ptr,
+                                                       const RelatedViewgrams<float>* mult_viewgrams_ptr)
+{
+  assert(output_image_ptr != NULL);
+  assert(input_image_ptr != NULL);
+  assert(measured_viewgrams_ptr != NULL);
+  assert(log_likelihood_ptr == NULL);
+  assert(additive_binwise_correction_ptr == NULL);
+
+  // set tmp_viewgrams to geometric forward projection of input
+  RelatedViewgrams<float> tmp_viewgrams = measured_viewgrams_ptr->get_empty_copy();
+  forward_projector_sptr->forward_project(tmp_viewgrams, *input_image_ptr);
+
+  // now divide by the data term y*norm^2. We multiply with the efficiencies
+  // (i.e. 1/norm) instead of dividing the data by them, which is the same
+  // but avoids dividing by 0.
+  // TODO add 1 for 1/(y+1) approximation
+  if (mult_viewgrams_ptr != NULL)
+    {
+      tmp_viewgrams *= *mult_viewgrams_ptr;
+      tmp_viewgrams *= *mult_viewgrams_ptr;
+    }
+  divide_and_truncate(tmp_viewgrams, *measured_viewgrams_ptr, 0, count, count2);
+
+  back_projector_sptr->back_project(*output_image_ptr, tmp_viewgrams);
+}
+
 #  ifdef _MSC_VER
 // prevent warning message on instantiation of abstract class 
 #  pragma warning(disable:4661)
@@ -32,6 +32,10 @@
 
 #include "stir/recon_buildblock/ProjMatrixByBin.h"
 #include "stir/recon_buildblock/ProjMatrixElemsForOneBin.h"
+#include "stir/recon_buildblock/ProjMatrixByBinCompressedCache.h"
+#include "stir/recon_buildblock/ProjMatrixByBinConcurrentCache.h"
+#include "stir/is_null_ptr.h"
+#include "stir/warning.h"
 
 // define a local preprocessor symbol to keep code relatively clean
 #ifdef STIR_NO_MUTABLE
@@ -46,6 +50,7 @@ void ProjMatrixByBin::set_defaults()
 {
   cache_disabled=false;
   cache_stores_only_basic_bins=true;
+  set_cache_type(hash_map_cache);
 }
 
 void 
@@ -53,11 +58,24 @@ ProjMatrixByBin::initialise_keymap()
 {
   parser.add_key("disable caching", &cache_disabled);
   parser.add_key("store_only_basic_bins_in_cache", &cache_stores_only_basic_bins);
+  parser.add_key("cache type", &cache_type_name);
 }
 
 bool
 ProjMatrixByBin::post_processing()
 {
+  if (cache_type_name == "hash map")
+    cache_type = hash_map_cache;
+  else if (cache_type_name == "compressed")
+    cache_type = compressed_cache;
+  else if (cache_type_name == "concurrent")
+    cache_type = concurrent_cache;
+  else
+    {
+      warning("ProjMatrixByBin: cache type should be \"hash map\", \"compressed\" or \"concurrent\", but is \"%s\"",
+              cache_type_name.c_str());
+      return true;
+    }
   return false;
 }
 
@@ -86,6 +104,34 @@ ProjMatrixByBin::
 does_cache_store_only_basic_bins() const
 { return cache_stores_only_basic_bins; }
 
+void
+ProjMatrixByBin::
+set_cache_type(const CacheType v)
+{
+  cache_type = v;
+  switch (v)
+    {
+    case compressed_cache: cache_type_name = "compressed"; break;
+    case concurrent_cache: cache_type_name = "concurrent"; break;
+    default: cache_type_name = "hash map"; break;
+    }
+}
+
+ProjMatrixByBin::CacheType
+ProjMatrixByBin::
+get_cache_type() const
+{ return cache_type; }
+
+void
+ProjMatrixByBin::
+report_cache_statistics(std::ostream& s) const
+{
+  if (!is_null_ptr(this->concurrent_cache_sptr))
+    this->concurrent_cache_sptr->report_statistics(s);
+  else
+    s << "ProjMatrixByBin: no cache statistics available for this cache type\n";
+}
+
 void 
 ProjMatrixByBin::
 clear_cache() STIR_MUTABLE_CONST
@@ -104,6 +150,10 @@ clear_cache() STIR_MUTABLE_CONST
           this->cache_collection[i][j].clear();
         }
     }
+  if (!is_null_ptr(this->compressed_cache_sptr))
+    this->compressed_cache_sptr->clear();
+  if (!is_null_ptr(this->concurrent_cache_sptr))
+    this->concurrent_cache_sptr->clear();
 }
 
 /*
@@ -145,6 +195,15 @@ set_up(
         omp_init_lock(&this->cache_locks[view_num][seg_num]);
 #endif
     }
+
+  if (this->cache_type == compressed_cache)
+    this->compressed_cache_sptr.reset(new ProjMatrixByBinCompressedCache(*proj_data_info_sptr));
+  else
+    this->compressed_cache_sptr.reset();
+  if (this->cache_type == concurrent_cache)
+    this->concurrent_cache_sptr.reset(new ProjMatrixByBinConcurrentCache(*proj_data_info_sptr));
+  else
+    this->concurrent_cache_sptr.reset();
 }
 
 
@@ -175,6 +234,18 @@ cache_proj_matrix_elems_for_one_bin(
   
   //std::cerr << "cached lor size " << probabilities.size() << " capacity " << probabilities.capacity() << std::endl;    
   // insert probabilities into the collection	
+  if (cache_type == compressed_cache)
+    {
+      compressed_cache_sptr->insert(probabilities,
+                                    cache_stores_only_basic_bins ? symmetries_ptr.get() : 0);
+      return;
+    }
+  if (cache_type == concurrent_cache)
+    {
+      concurrent_cache_sptr->insert(probabilities);
+      return;
+    }
+
   const Bin bin = probabilities.get_bin();
 #ifdef STIR_OPENMP
   omp_set_lock(&this->cache_locks[bin.view_num()][bin.segment_num()]);
@@ -205,7 +276,12 @@ get_cached_proj_matrix_elems_for_one_bin(
     assert ( symmetries_ptr->find_basic_bin(bin_copy) == 0);     
   }
 #endif         
-  
+
+  if (cache_type == compressed_cache)
+    return compressed_cache_sptr->get(probabilities);
+  if (cache_type == concurrent_cache)
+    return concurrent_cache_sptr->get(probabilities);
+
   bool found=false;
 #ifdef STIR_OPENMP
   omp_set_lock(&this->cache_locks[bin.view_num()][bin.segment_num()]);
@@ -0,0 +1,453 @@
+/*!
+
+  \file
+  \ingroup projection
+
+  \brief  implementation of the stir::ProjMatrixByBinCompressedCache class
+*/
+/*
+    Copyright (C) 2016, University College London
+
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/recon_buildblock/ProjMatrixByBinCompressedCache.h"
+#include "stir/recon_buildblock/ProjMatrixElemsForOneBin.h"
+#include "stir/recon_buildblock/DataSymmetriesForBins.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/Coordinate3D.h"
+#include "stir/Succeeded.h"
+#include "stir/error.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+START_NAMESPACE_STIR
+
+const ProjMatrixByBinCompressedCache::row_index_type
+ProjMatrixByBinCompressedCache::not_cached = 0xFFFFFFFFU;
+
+/////////////////////// helper functions for encoding //////////////////
+
+// A run header with a run length of 0 in its top 4 bits is an escape word: the run
+// length is then in its lower 12 bits and the coordinates are stored in full.
+static const int max_delta_run_length = 0xF;
+static const int max_escape_run_length = 0xFFF;
+
+static inline boost::uint32_t float_bits(const float f)
+{
+  boost::uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  return x;
+}
+
+static inline float bits_to_float(const boost::uint32_t x)
+{
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+//! convert to IEEE half precision with round-to-nearest (no need for inf or NaN here)
+static inline boost::uint16_t float_to_half(const float f)
+{
+  const boost::uint32_t x = float_bits(f);
+  const boost::uint16_t sign = static_cast<boost::uint16_t>((x >> 16) & 0x8000U);
+  const int exponent = static_cast<int>((x >> 23) & 0xFF) - 127 + 15;
+  boost::uint32_t mantissa = x & 0x7FFFFFU;
+  if (exponent <= 0)
+    {
+      // denormalised half, or too small
+      if (exponent < -10)
+        return sign;
+      mantissa |= 0x800000U;
+      const int shift = 14 - exponent;
+      boost::uint32_t half_mantissa = mantissa >> shift;
+      if ((mantissa >> (shift-1)) & 1U)
+        ++half_mantissa;
+      return static_cast<boost::uint16_t>(sign | half_mantissa);
+    }
+  if (exponent >= 31)
+    return static_cast<boost::uint16_t>(sign | 0x7BFFU); // clamp to largest finite
+  boost::uint32_t half = (static_cast<boost::uint32_t>(exponent) << 10) | (mantissa >> 13);
+  // rounding can carry into the exponent, which is the correct result
+  if (mantissa & 0x1000U)
+    ++half;
+  return static_cast<boost::uint16_t>(sign | half);
+}
+
+static inline float half_to_float(const boost::uint16_t h)
+{
+  const boost::uint32_t sign = static_cast<boost::uint32_t>(h & 0x8000U) << 16;
+  const boost::uint32_t exponent = (h >> 10) & 0x1FU;
+  const boost::uint32_t mantissa = h & 0x3FFU;
+  if (exponent == 0)
+    {
+      const float value = std::ldexp(static_cast<float>(mantissa), -24);
+      return sign ? -value : value;
+    }
+  return bits_to_float(sign | ((exponent - 15 + 127) << 23) | (mantissa << 13));
+}
+
+// sign-extend the lowest num_bits of v
+static inline int sign_extend(const unsigned v, const int num_bits)
+{
+  const int shift = static_cast<int>(sizeof(int)*8) - num_bits;
+  return static_cast<int>(v << shift) >> shift;
+}
+
+static inline bool fits_in_bits(const int v, const int num_bits)
+{
+  return v >= -(1 << (num_bits-1)) && v < (1 << (num_bits-1));
+}
+
+static inline int count_bits(boost::uint32_t x)
+{
+  x = x - ((x >> 1) & 0x55555555U);
+  x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+  x = (x + (x >> 4)) & 0x0F0F0F0FU;
+  return static_cast<int>((x * 0x01010101U) >> 24);
+}
+
+/////////////////////// ProjMatrixByBinCompressedCache::Slab //////////////////
+
+ProjMatrixByBinCompressedCache::Slab::
+Slab()
+  : min_axial_pos_num(0), max_axial_pos_num(-1),
+    min_tangential_pos_num(0), max_tangential_pos_num(-1),
+    num_rows_stored(0), num_rows_expected(0),
+    is_complete(false)
+{}
+
+/////////////////////// ProjMatrixByBinCompressedCache //////////////////
+
+ProjMatrixByBinCompressedCache::
+ProjMatrixByBinCompressedCache(const ProjDataInfo& proj_data_info)
+{
+  const int min_view_num = proj_data_info.get_min_view_num();
+  const int max_view_num = proj_data_info.get_max_view_num();
+  const int min_segment_num = proj_data_info.get_min_segment_num();
+  const int max_segment_num = proj_data_info.get_max_segment_num();
+
+  this->slabs.resize(min_view_num, max_view_num);
+#ifdef STIR_OPENMP
+  this->locks.resize(min_view_num, max_view_num);
+#endif
+  for (int view_num=min_view_num; view_num<=max_view_num; ++view_num)
+    {
+      this->slabs[view_num].resize(min_segment_num, max_segment_num);
+#ifdef STIR_OPENMP
+      this->locks[view_num].resize(min_segment_num, max_segment_num);
+#endif
+      for (int segment_num=min_segment_num; segment_num<=max_segment_num; ++segment_num)
+        {
+          Slab& slab = this->slabs[view_num][segment_num];
+          slab.min_axial_pos_num = proj_data_info.get_min_axial_pos_num(segment_num);
+          slab.max_axial_pos_num = proj_data_info.get_max_axial_pos_num(segment_num);
+          slab.min_tangential_pos_num = proj_data_info.get_min_tangential_pos_num();
+          slab.max_tangential_pos_num = proj_data_info.get_max_tangential_pos_num();
+#ifdef STIR_OPENMP
+          omp_init_lock(&this->locks[view_num][segment_num]);
+#endif
+        }
+    }
+}
+
+ProjMatrixByBinCompressedCache::
+~ProjMatrixByBinCompressedCache()
+{
+#ifdef STIR_OPENMP
+  for (int view_num=this->locks.get_min_index(); view_num<=this->locks.get_max_index(); ++view_num)
+    for (int segment_num=this->locks[view_num].get_min_index();
+         segment_num<=this->locks[view_num].get_max_index();
+         ++segment_num)
+      omp_destroy_lock(&this->locks[view_num][segment_num]);
+#endif
+}
+
+void
+ProjMatrixByBinCompressedCache::
+clear()
+{
+  for (int view_num=this->slabs.get_min_index(); view_num<=this->slabs.get_max_index(); ++view_num)
+    for (int segment_num=this->slabs[view_num].get_min_index();
+         segment_num<=this->slabs[view_num].get_max_index();
+         ++segment_num)
+      {
+        Slab& slab = this->slabs[view_num][segment_num];
+        std::vector<boost::uint32_t>().swap(slab.mask);
+        std::vector<row_index_type>().swap(slab.mask_rank);
+        std::vector<row_index_type>().swap(slab.row_start);
+        std::vector<word_type>().swap(slab.data);
+        slab.num_rows_stored = 0;
+        slab.num_rows_expected = 0;
+        slab.is_complete = false;
+      }
+}
+
+std::size_t
+ProjMatrixByBinCompressedCache::
+get_memory_usage_in_bytes() const
+{
+  std::size_t num_bytes = 0;
+  for (int view_num=this->slabs.get_min_index(); view_num<=this->slabs.get_max_index(); ++view_num)
+    for (int segment_num=this->slabs[view_num].get_min_index();
+         segment_num<=this->slabs[view_num].get_max_index();
+         ++segment_num)
+      {
+        const Slab& slab = this->slabs[view_num][segment_num];
+        num_bytes +=
+          slab.mask.capacity()*sizeof(boost::uint32_t) +
+          slab.mask_rank.capacity()*sizeof(row_index_type) +
+          slab.row_start.capacity()*sizeof(row_index_type) +
+          slab.data.capacity()*sizeof(word_type);
+      }
+  return num_bytes;
+}
+
+void
+ProjMatrixByBinCompressedCache::
+encode(std::vector<word_type>& data, const ProjMatrixElemsForOneBin& probabilities)
+{
+  const boost::uint32_t num_elems = static_cast<boost::uint32_t>(probabilities.size());
+  data.push_back(static_cast<word_type>(num_elems & 0xFFFFU));
+  data.push_back(static_cast<word_type>(num_elems >> 16));
+  if (num_elems == 0)
+    return;
+
+  float scale = 0.F;
+  for (ProjMatrixElemsForOneBin::const_iterator iter = probabilities.begin();
+       iter != probabilities.end(); ++iter)
+    scale = std::max(scale, std::fabs(iter->get_value()));
+  if (scale == 0.F)
+    scale = 1.F;
+  const boost::uint32_t scale_bits = float_bits(scale);
+  data.push_back(static_cast<word_type>(scale_bits & 0xFFFFU));
+  data.push_back(static_cast<word_type>(scale_bits >> 16));
+
+  int prev_c1 = 0, prev_c2 = 0, prev_c3 = 0;
+  ProjMatrixElemsForOneBin::const_iterator iter = probabilities.begin();
+  while (iter != probabilities.end())
+    {
+      const int c1 = iter->coord1();
+      const int c2 = iter->coord2();
+      const int c3 = iter->coord3();
+      const int d1 = c1 - prev_c1;
+      const int d2 = c2 - prev_c2;
+      const int d3 = c3 - prev_c3;
+      const bool use_delta = fits_in_bits(d1, 2) && fits_in_bits(d2, 4) && fits_in_bits(d3, 6);
+      const int max_run_length = use_delta ? max_delta_run_length : max_escape_run_length;
+
+      // find the elements with consecutive x-coordinates
+      ProjMatrixElemsForOneBin::const_iterator run_end = iter + 1;
+      int run_length = 1;
+      while (run_end != probabilities.end() && run_length < max_run_length &&
+             run_end->coord1() == c1 && run_end->coord2() == c2 &&
+             run_end->coord3() == c3 + run_length)
+        {
+          ++run_end; ++run_length;
+        }
+
+      if (use_delta)
+        {
+          data.push_back(static_cast<word_type>((static_cast<unsigned>(run_length) << 12) |
+                                                ((static_cast<unsigned>(d1) & 0x3U) << 10) |
+                                                ((static_cast<unsigned>(d2) & 0xFU) << 6) |
+                                                (static_cast<unsigned>(d3) & 0x3FU)));
+        }
+      else
+        {
+          data.push_back(static_cast<word_type>(run_length));
+          data.push_back(static_cast<word_type>(static_cast<boost::int16_t>(c1)));
+          data.push_back(static_cast<word_type>(static_cast<boost::int16_t>(c2)));
+          data.push_back(static_cast<word_type>(static_cast<boost::int16_t>(c3)));
+        }
+      for (; iter != run_end; ++iter)
+        data.push_back(float_to_half(iter->get_value()/scale));
+      prev_c1 = c1; prev_c2 = c2; prev_c3 = c3 + run_length - 1;
+    }
+}
+
+void
+ProjMatrixByBinCompressedCache::
+decode(ProjMatrixElemsForOneBin& probabilities, const word_type * data_ptr)
+{
+  probabilities.erase();
+  const boost::uint32_t num_elems =
+    static_cast<boost::uint32_t>(data_ptr[0]) | (static_cast<boost::uint32_t>(data_ptr[1]) << 16);
+  data_ptr += 2;
+  if (num_elems == 0)
+    return;
+
+  const float scale =
+    bits_to_float(static_cast<boost::uint32_t>(data_ptr[0]) | (static_cast<boost::uint32_t>(data_ptr[1]) << 16));
+  data_ptr += 2;
+
+  probabilities.reserve(num_elems);
+  Coordinate3D<int> coords(0,0,0);
+  boost::uint32_t num_elems_decoded = 0;
+  while (num_elems_decoded < num_elems)
+    {
+      const word_type header = *data_ptr++;
+      int run_length = header >> 12;
+      if (run_length == 0)
+        {
+          run_length = header & max_escape_run_length;
+          coords[1] = static_cast<boost::int16_t>(*data_ptr++);
+          coords[2] = static_cast<boost::int16_t>(*data_ptr++);
+          coords[3] = static_cast<boost::int16_t>(*data_ptr++);
+        }
+      else
+        {
+          coords[1] += sign_extend((header >> 10) & 0x3U, 2);
+          coords[2] += sign_extend((header >> 6) & 0xFU, 4);
+          coords[3] += sign_extend(header & 0x3FU, 6);
+        }
+      for (int i=0; i<run_length; ++i)
+        {
+          if (i>0)
+            ++coords[3];
+          probabilities.push_back(ProjMatrixElemsForOneBin::value_type(coords, half_to_float(*data_ptr++)*scale));
+        }
+      num_elems_decoded += run_length;
+    }
+}
+
+ProjMatrixByBinCompressedCache::row_index_type
+ProjMatrixByBinCompressedCache::
+find_row_index(const Slab& slab, const int axial_pos_num, const int tangential_pos_num)
+{
+  if (slab.mask.empty() ||
+      axial_pos_num < slab.min_axial_pos_num || axial_pos_num > slab.max_axial_pos_num ||
+      tangential_pos_num < slab.min_tangential_pos_num || tangential_pos_num > slab.max_tangential_pos_num)
+    return not_cached;
+  const int num_tangential_poss = slab.max_tangential_pos_num - slab.min_tangential_pos_num + 1;
+  const int position =
+    (axial_pos_num - slab.min_axial_pos_num)*num_tangential_poss +
+    tangential_pos_num - slab.min_tangential_pos_num;
+  const boost::uint32_t word = slab.mask[position/32];
+  const boost::uint32_t bit = 1U << (position%32);
+  if ((word & bit) == 0)
+    return not_cached;
+  return slab.mask_rank[position/32] + count_bits(word & (bit - 1U));
+}
+
+Succeeded
+ProjMatrixByBinCompressedCache::
+get(ProjMatrixElemsForOneBin& probabilities) const
+{
+  const Bin bin = probabilities.get_bin();
+  const Slab& slab = this->slabs[bin.view_num()][bin.segment_num()];
+
+  bool found = false;
+#ifdef STIR_OPENMP
+  // Once a slab is complete, its data is never modified anymore, so we do not need the lock.
+  // The flushes make sure that we see all data written before is_complete was set.
+  bool complete;
+#pragma omp flush
+  complete = slab.is_complete;
+#pragma omp flush
+  if (!complete)
+    omp_set_lock(&this->locks[bin.view_num()][bin.segment_num()]);
+#endif
+  const row_index_type row_index = find_row_index(slab, bin.axial_pos_num(), bin.tangential_pos_num());
+  if (row_index != not_cached && slab.row_start[row_index] != not_cached)
+    {
+      decode(probabilities, &slab.data[slab.row_start[row_index]]);
+      found = true;
+    }
+#ifdef STIR_OPENMP
+  if (!complete)
+    omp_unset_lock(&this->locks[bin.view_num()][bin.segment_num()]);
+#endif
+  return found ? Succeeded::yes : Succeeded::no;
+}
+
+void
+ProjMatrixByBinCompressedCache::
+insert(const ProjMatrixElemsForOneBin& probabilities,
+       const DataSymmetriesForBins * symmetries_ptr)
+{
+  const Bin bin = probabilities.get_bin();
+  Slab& slab = this->slabs[bin.view_num()][bin.segment_num()];
+  if (bin.axial_pos_num() < slab.min_axial_pos_num || bin.axial_pos_num() > slab.max_axial_pos_num ||
+      bin.tangential_pos_num() < slab.min_tangential_pos_num || bin.tangential_pos_num() > slab.max_tangential_pos_num)
+    error("ProjMatrixByBinCompressedCache: bin (s=%d,v=%d,a=%d,t=%d) out of range",
+          bin.segment_num(), bin.view_num(), bin.axial_pos_num(), bin.tangential_pos_num());
+
+#ifdef STIR_OPENMP
+  omp_set_lock(&this->locks[bin.view_num()][bin.segment_num()]);
+#endif
+  if (slab.mask.empty())
+    {
+      // first time we use this slab: find which rows can be stored
+      const int num_axial_poss = slab.max_axial_pos_num - slab.min_axial_pos_num + 1;
+      const int num_tangential_poss = slab.max_tangential_pos_num - slab.min_tangential_pos_num + 1;
+      const int num_positions = num_axial_poss*num_tangential_poss;
+      slab.mask.resize((num_positions + 31)/32, 0U);
+      slab.mask_rank.resize(slab.mask.size());
+      int position = 0;
+      for (int a=slab.min_axial_pos_num; a<=slab.max_axial_pos_num; ++a)
+        for (int t=slab.min_tangential_pos_num; t<=slab.max_tangential_pos_num; ++t, ++position)
+          if (symmetries_ptr == 0 ||
+              symmetries_ptr->is_basic(Bin(bin.segment_num(), bin.view_num(), a, t)))
+            slab.mask[position/32] |= 1U << (position%32);
+      row_index_type rank = 0;
+      for (std::size_t i=0; i<slab.mask.size(); ++i)
+        {
+          slab.mask_rank[i] = rank;
+          rank += static_cast<row_index_type>(count_bits(slab.mask[i]));
+        }
+      slab.num_rows_expected = rank;
+      slab.row_start.resize(slab.num_rows_expected, not_cached);
+    }
+
+  const row_index_type row_index = find_row_index(slab, bin.axial_pos_num(), bin.tangential_pos_num());
+  // rows for bins that are not expected (e.g. non-basic bins) are not stored
+  if (row_index == not_cached)
+    {
+#ifdef STIR_OPENMP
+      omp_unset_lock(&this->locks[bin.view_num()][bin.segment_num()]);
+#endif
+      return;
+    }
+  row_index_type& row_start = slab.row_start[row_index];
+  if (row_start == not_cached)
+    {
+      if (slab.data.size() >= static_cast<std::size_t>(not_cached))
+        error("ProjMatrixByBinCompressedCache: too many elements for view %d, segment %d",
+              bin.view_num(), bin.segment_num());
+      row_start = static_cast<row_index_type>(slab.data.size());
+      encode(slab.data, probabilities);
+      ++slab.num_rows_stored;
+      if (slab.num_rows_stored == slab.num_rows_expected)
+        {
+          // release excess capacity, as nothing will be added anymore
+          std::vector<word_type>(slab.data).swap(slab.data);
+#ifdef STIR_OPENMP
+#pragma omp flush
+#endif
+          slab.is_complete = true;
+#ifdef STIR_OPENMP
+#pragma omp flush
+#endif
+        }
+    }
+#ifdef STIR_OPENMP
+  omp_unset_lock(&this->locks[bin.view_num()][bin.segment_num()]);
+#endif
+}
+
+END_NAMESPACE_STIR
@@ -0,0 +1,391 @@
+/*!
+
+  \file
+  \ingroup projection
+
+  \brief  implementation of the stir::ProjMatrixByBinConcurrentCache class
+*/
+/*
+    Copyright (C) 2016, University College London
+
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/recon_buildblock/ProjMatrixByBinConcurrentCache.h"
+#include "stir/recon_buildblock/ProjMatrixElemsForOneBin.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/Bin.h"
+#include "stir/Succeeded.h"
+#include "stir/error.h"
+#include <algorithm>
+#include <iostream>
+
+START_NAMESPACE_STIR
+
+/////////////////////// ProjMatrixByBinConcurrentCache::Statistics //////////////////
+
+ProjMatrixByBinConcurrentCache::Statistics::
+Statistics()
+  : num_hits(0), num_misses(0), num_inserts(0),
+    num_duplicate_inserts(0), num_lock_contentions(0)
+{}
+
+ProjMatrixByBinConcurrentCache::Statistics&
+ProjMatrixByBinConcurrentCache::Statistics::
+operator+=(const Statistics& s)
+{
+  num_hits += s.num_hits;
+  num_misses += s.num_misses;
+  num_inserts += s.num_inserts;
+  num_duplicate_inserts += s.num_duplicate_inserts;
+  num_lock_contentions += s.num_lock_contentions;
+  return *this;
+}
+
+/////////////////////// ProjMatrixByBinConcurrentCache::HitMissCounters //////////////////
+
+ProjMatrixByBinConcurrentCache::HitMissCounters::
+HitMissCounters()
+  : num_hits(0), num_misses(0)
+{}
+
+/////////////////////// ProjMatrixByBinConcurrentCache::Bucket //////////////////
+
+ProjMatrixByBinConcurrentCache::Bucket::
+Bucket()
+  : min_axial_pos_num(0), max_axial_pos_num(-1),
+    min_tangential_pos_num(0), max_tangential_pos_num(-1),
+    slots(0)
+{}
+
+/////////////////////// ProjMatrixByBinConcurrentCache //////////////////
+
+ProjMatrixByBinConcurrentCache::
+ProjMatrixByBinConcurrentCache(const ProjDataInfo& proj_data_info)
+{
+  const int min_view_num = proj_data_info.get_min_view_num();
+  const int max_view_num = proj_data_info.get_max_view_num();
+  const int min_segment_num = proj_data_info.get_min_segment_num();
+  const int max_segment_num = proj_data_info.get_max_segment_num();
+
+  this->buckets.resize(min_view_num, max_view_num);
+  this->statistics.resize(min_view_num, max_view_num);
+  const std::size_t num_buckets =
+    static_cast<std::size_t>((max_view_num - min_view_num + 1) * (max_segment_num - min_segment_num + 1));
+#ifdef STIR_OPENMP
+  this->locks.resize(min_view_num, max_view_num);
+  this->thread_counters.resize(omp_get_max_threads());
+#else
+  this->thread_counters.resize(1);
+#endif
+  for (std::size_t thread_num=0; thread_num<this->thread_counters.size(); ++thread_num)
+    this->thread_counters[thread_num].resize(num_buckets);
+  this->overflow_thread_counters.resize(num_buckets);
+  for (int view_num=min_view_num; view_num<=max_view_num; ++view_num)
+    {
+      this->buckets[view_num].resize(min_segment_num, max_segment_num);
+      this->statistics[view_num].resize(min_segment_num, max_segment_num);
+#ifdef STIR_OPENMP
+      this->locks[view_num].resize(min_segment_num, max_segment_num);
+#endif
+      for (int segment_num=min_segment_num; segment_num<=max_segment_num; ++segment_num)
+        {
+          Bucket& bucket = this->buckets[view_num][segment_num];
+          bucket.min_axial_pos_num = proj_data_info.get_min_axial_pos_num(segment_num);
+          bucket.max_axial_pos_num = proj_data_info.get_max_axial_pos_num(segment_num);
+          bucket.min_tangential_pos_num = proj_data_info.get_min_tangential_pos_num();
+          bucket.max_tangential_pos_num = proj_data_info.get_max_tangential_pos_num();
+#ifdef STIR_OPENMP
+          omp_init_lock(&this->locks[view_num][segment_num]);
+#endif
+        }
+    }
+}
+
+ProjMatrixByBinConcurrentCache::
+~ProjMatrixByBinConcurrentCache()
+{
+  this->clear();
+#ifdef STIR_OPENMP
+  for (int view_num=this->locks.get_min_index(); view_num<=this->locks.get_max_index(); ++view_num)
+    for (int segment_num=this->locks[view_num].get_min_index();
+         segment_num<=this->locks[view_num].get_max_index();
+         ++segment_num)
+      omp_destroy_lock(&this->locks[view_num][segment_num]);
+#endif
+}
+
+void
+ProjMatrixByBinConcurrentCache::
+clear()
+{
+  for (int view_num=this->buckets.get_min_index(); view_num<=this->buckets.get_max_index(); ++view_num)
+    for (int segment_num=this->buckets[view_num].get_min_index();
+         segment_num<=this->buckets[view_num].get_max_index();
+         ++segment_num)
+      {
+        Bucket& bucket = this->buckets[view_num][segment_num];
+        if (bucket.slots != 0)
+          {
+            const int num_slots =
+              (bucket.max_axial_pos_num - bucket.min_axial_pos_num + 1) *
+              (bucket.max_tangential_pos_num - bucket.min_tangential_pos_num + 1);
+            for (int i=0; i<num_slots; ++i)
+              delete bucket.slots[i];
+            delete[] bucket.slots;
+            bucket.slots = 0;
+          }
+        this->statistics[view_num][segment_num] = Statistics();
+      }
+  for (std::size_t thread_num=0; thread_num<this->thread_counters.size(); ++thread_num)
+    std::fill(this->thread_counters[thread_num].begin(), this->thread_counters[thread_num].end(),
+              HitMissCounters());
+  std::fill(this->overflow_thread_counters.begin(), this->overflow_thread_counters.end(),
+            HitMissCounters());
+}
+
+std::size_t
+ProjMatrixByBinConcurrentCache::
+get_bucket_index(const int view_num, const int segment_num) const
+{
+  const VectorWithOffset<Bucket>& buckets_for_view = this->buckets[view_num];
+  return
+    static_cast<std::size_t>((view_num - this->buckets.get_min_index()) * buckets_for_view.get_length() +
+                             segment_num - buckets_for_view.get_min_index());
+}
+
+void
+ProjMatrixByBinConcurrentCache::
+count_hit_or_miss(const bool hit, const std::size_t bucket_index) const
+{
+#ifdef STIR_OPENMP
+  const std::size_t thread_num = static_cast<std::size_t>(omp_get_thread_num());
+  if (thread_num >= this->thread_counters.size())
+    {
+      // more threads than when the cache was constructed
+      HitMissCounters& counters = this->overflow_thread_counters[bucket_index];
+      if (hit)
+        {
+#pragma omp atomic
+          ++counters.num_hits;
+        }
+      else
+        {
+#pragma omp atomic
+          ++counters.num_misses;
+        }
+      return;
+    }
+#else
+  const std::size_t thread_num = 0;
+#endif
+  // only this thread writes to this element, so no atomic operation is needed
+  HitMissCounters& counters = this->thread_counters[thread_num][bucket_index];
+  if (hit)
+    ++counters.num_hits;
+  else
+    ++counters.num_misses;
+}
+
+ProjMatrixByBinConcurrentCache::slot_type *
+ProjMatrixByBinConcurrentCache::
+find_slot(slot_type * slots, const Bucket& bucket, const Bin& bin)
+{
+  if (bin.axial_pos_num() < bucket.min_axial_pos_num || bin.axial_pos_num() > bucket.max_axial_pos_num ||
+      bin.tangential_pos_num() < bucket.min_tangential_pos_num || bin.tangential_pos_num() > bucket.max_tangential_pos_num)
+    return 0;
+  const int num_tangential_poss = bucket.max_tangential_pos_num - bucket.min_tangential_pos_num + 1;
+  return slots +
+    (bin.axial_pos_num() - bucket.min_axial_pos_num)*num_tangential_poss +
+    bin.tangential_pos_num() - bucket.min_tangential_pos_num;
+}
+
+Succeeded
+ProjMatrixByBinConcurrentCache::
+get(ProjMatrixElemsForOneBin& probabilities) const
+{
+  const Bin bin = probabilities.get_bin();
+  const Bucket& bucket = this->buckets[bin.view_num()][bin.segment_num()];
+
+  slot_type * slots;
+#ifdef STIR_OPENMP
+#pragma omp atomic read
+#endif
+  slots = bucket.slots;
+
+  slot_type row = 0;
+  if (slots != 0)
+    {
+      const slot_type * const slot_ptr = find_slot(slots, bucket, bin);
+      if (slot_ptr != 0)
+        {
+#ifdef STIR_OPENMP
+#pragma omp atomic read
+#endif
+          row = *slot_ptr;
+        }
+    }
+
+  if (row == 0)
+    {
+      this->count_hit_or_miss(false, this->get_bucket_index(bin.view_num(), bin.segment_num()));
+      return Succeeded::no;
+    }
+
+  // make sure we see the row as it was written before its pointer was published
+#ifdef STIR_OPENMP
+#pragma omp flush
+#endif
+  probabilities = *row;
+  this->count_hit_or_miss(true, this->get_bucket_index(bin.view_num(), bin.segment_num()));
+  return Succeeded::yes;
+}
+
+void
+ProjMatrixByBinConcurrentCache::
+insert(const ProjMatrixElemsForOneBin& probabilities)
+{
+  const Bin bin = probabilities.get_bin();
+  Bucket& bucket = this->buckets[bin.view_num()][bin.segment_num()];
+  Statistics& stats = this->statistics[bin.view_num()][bin.segment_num()];
+
+#ifdef STIR_OPENMP
+  omp_lock_t& lock = this->locks[bin.view_num()][bin.segment_num()];
+  if (!omp_test_lock(&lock))
+    {
+      omp_set_lock(&lock);
+      ++stats.num_lock_contentions;
+    }
+#endif
+  // note: inside the lock, we can read the pointers without atomic operations,
+  // as they are only written while holding the lock. Similarly, the statistics of
+  // the bucket are only modified while holding the lock.
+
+  if (bucket.slots == 0)
+    {
+      const int num_slots =
+        (bucket.max_axial_pos_num - bucket.min_axial_pos_num + 1) *
+        (bucket.max_tangential_pos_num - bucket.min_tangential_pos_num + 1);
+      slot_type * const new_slots = new slot_type[num_slots];
+      for (int i=0; i<num_slots; ++i)
+        new_slots[i] = 0;
+#ifdef STIR_OPENMP
+#pragma omp flush
+#pragma omp atomic write
+#endif
+      bucket.slots = new_slots;
+    }
+
+  slot_type * const slot_ptr = find_slot(bucket.slots, bucket, bin);
+  if (slot_ptr == 0)
+    {
+#ifdef STIR_OPENMP
+      omp_unset_lock(&lock);
+#endif
+      error("ProjMatrixByBinConcurrentCache: bin (s=%d,v=%d,a=%d,t=%d) out of range",
+            bin.segment_num(), bin.view_num(), bin.axial_pos_num(), bin.tangential_pos_num());
+    }
+
+  if (*slot_ptr != 0)
+    {
+      ++stats.num_duplicate_inserts;
+    }
+  else
+    {
+      slot_type const new_row = new ProjMatrixElemsForOneBin(probabilities);
+      // publish the row only once it has been completely written
+#ifdef STIR_OPENMP
+#pragma omp flush
+#pragma omp atomic write
+#endif
+      *slot_ptr = new_row;
+      ++stats.num_inserts;
+    }
+#ifdef STIR_OPENMP
+  omp_unset_lock(&lock);
+#endif
+}
+
+ProjMatrixByBinConcurrentCache::Statistics
+ProjMatrixByBinConcurrentCache::
+get_statistics(const int view_num, const int segment_num) const
+{
+  Statistics stats = this->statistics[view_num][segment_num];
+  const std::size_t bucket_index = this->get_bucket_index(view_num, segment_num);
+  for (std::size_t thread_num=0; thread_num<this->thread_counters.size(); ++thread_num)
+    {
+      stats.num_hits += this->thread_counters[thread_num][bucket_index].num_hits;
+      stats.num_misses += this->thread_counters[thread_num][bucket_index].num_misses;
+    }
+  stats.num_hits += this->overflow_thread_counters[bucket_index].num_hits;
+  stats.num_misses += this->overflow_thread_counters[bucket_index].num_misses;
+  return stats;
+}
+
+ProjMatrixByBinConcurrentCache::Statistics
+ProjMatrixByBinConcurrentCache::
+get_total_statistics() const
+{
+  Statistics total;
+  for (int view_num=this->statistics.get_min_index(); view_num<=this->statistics.get_max_index(); ++view_num)
+    for (int segment_num=this->statistics[view_num].get_min_index();
+         segment_num<=this->statistics[view_num].get_max_index();
+         ++segment_num)
+      total += this->get_statistics(view_num, segment_num);
+  return total;
+}
+
+void
+ProjMatrixByBinConcurrentCache::
+report_statistics(std::ostream& s) const
+{
+  const Statistics total = this->get_total_statistics();
+  s << "ProjMatrixByBin concurrent cache statistics:\n"
+    << "  hits: " << total.num_hits
+    << ", misses: " << total.num_misses
+    << ", inserts: " << total.num_inserts
+    << ", duplicate inserts: " << total.num_duplicate_inserts
+    << ", lock contentions: " << total.num_lock_contentions << '\n';
+
+  // find the bucket with the most contention
+  int worst_view_num = 0, worst_segment_num = 0;
+  unsigned long worst_contention = 0;
+  for (int view_num=this->statistics.get_min_index(); view_num<=this->statistics.get_max_index(); ++view_num)
+    for (int segment_num=this->statistics[view_num].get_min_index();
+         segment_num<=this->statistics[view_num].get_max_index();
+         ++segment_num)
+      {
+        const Statistics& stats = this->statistics[view_num][segment_num];
+        const unsigned long contention = stats.num_lock_contentions + stats.num_duplicate_inserts;
+        if (contention > worst_contention)
+          {
+            worst_contention = contention;
+            worst_view_num = view_num;
+            worst_segment_num = segment_num;
+          }
+      }
+  if (worst_contention > 0)
+    {
+      const Statistics stats = this->get_statistics(worst_view_num, worst_segment_num);
+      s << "  most contended bucket: view " << worst_view_num
+        << ", segment " << worst_segment_num
+        << " (hits: " << stats.num_hits
+        << ", misses: " << stats.num_misses
+        << ", lock contentions: " << stats.num_lock_contentions
+        << ", duplicate inserts: " << stats.num_duplicate_inserts << ")\n";
+    }
+}
+
+END_NAMESPACE_STIR
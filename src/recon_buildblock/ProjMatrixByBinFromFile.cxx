@@ -1,7 +1,7 @@
 /*
     Copyright (C) 2004 - 2008, Hammersmith Imanet Ltd
     Copyright (C) 2011 - 2012, Kris Thielemans
-    Copyright (C) 2014, University College London
+    Copyright (C) 2014, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -40,12 +40,18 @@
 #include "stir/Succeeded.h"
 #include "stir/is_null_ptr.h"
 #include "stir/Coordinate3D.h"
+#include "stir/stream.h"
 //#include "boost/format.hpp"
 //#include "stir/info.h"
 #include "boost/cstdint.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
 #include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <vector>
+#include <cstring>
 
 using std::string;
 
@@ -58,6 +64,7 @@ ProjMatrixByBinFromFile::registered_name =
 
 ProjMatrixByBinFromFile::
 ProjMatrixByBinFromFile()
+  : mapped_elements_ptr(0), mapped_index_ptr(0), num_mapped_rows(0)
 {
   set_defaults();
 }
@@ -72,6 +79,7 @@ initialise_keymap()
   parser.add_key("template_density_filename", &template_density_filename);
   parser.add_key("template_proj_data_filename", &template_proj_data_filename);
   parser.add_key("data_filename", &data_filename);
+  parser.add_key("use memory mapping", &use_memory_mapping);
 
   parser.add_key("Version", &this->parsed_version);
   parser.add_key("symmetries type", &this->symmetries_type) ;
@@ -96,6 +104,7 @@ ProjMatrixByBinFromFile::set_defaults()
   template_density_filename="";
   template_proj_data_filename="";
   data_filename="";
+  use_memory_mapping = true;
 
   do_symmetry_90degrees_min_phi = true;
   do_symmetry_180degrees_min_phi = true;
@@ -111,9 +120,9 @@ ProjMatrixByBinFromFile::post_processing()
   if (ProjMatrixByBin::post_processing() == true)
     return true;
 
-  if (this->parsed_version != "1.0")
+  if (this->parsed_version != "1.0" && this->parsed_version != "2.0")
     { 
-      warning("version has to be 1.0");
+      warning("version has to be 1.0 or 2.0");
       return true;
     }
   this->symmetries_type = standardise_interfile_keyword(this->symmetries_type);
@@ -237,7 +246,9 @@ set_up(
   // every LOR that's in the file in the cache
   ProjMatrixByBin::set_up(this->proj_data_info_ptr, density_info_ptr);
 
-  if (read_data() ==Succeeded::no)
+  const Succeeded success =
+    this->parsed_version == "2.0" ? read_data_version_2() : read_data();
+  if (success ==Succeeded::no)
     error("Something wrong reading the matrix from file. Exiting.");
 }
 
@@ -349,6 +360,149 @@ namespace {
       }  
     return readReturnType::ok;
   }
+
+  /* Version 2.0 of the binary file:
+     - FileHeaderVersion2
+     - elements of all rows, as ProjMatrixElemsForOneBin::value_type
+     - (aligned to 8 bytes) num_rows IndexEntryVersion2, sorted on bin
+     Everything is in native byte order.
+  */
+  const char magic_version_2[8] = {'S','T','I','R','P','M','v','2'};
+  const boost::uint32_t byte_order_marker = 0x01020304;
+
+  struct FileHeaderVersion2
+  {
+    char magic[8];
+    boost::uint32_t byte_order;
+    boost::uint32_t element_size;
+    boost::uint64_t geometry_hash;
+    boost::uint64_t num_rows;
+    boost::uint64_t index_offset;
+  };
+
+  struct IndexEntryVersion2
+  {
+    boost::int32_t segment_num;
+    boost::int32_t view_num;
+    boost::int32_t axial_pos_num;
+    boost::int32_t tangential_pos_num;
+    boost::uint32_t num_elements;
+    boost::uint32_t unused;
+    //! offset (in bytes) of the first element w.r.t. the start of the file
+    boost::uint64_t offset;
+  };
+
+  bool operator<(const IndexEntryVersion2& e1, const IndexEntryVersion2& e2)
+  {
+    if (e1.segment_num != e2.segment_num)
+      return e1.segment_num < e2.segment_num;
+    if (e1.view_num != e2.view_num)
+      return e1.view_num < e2.view_num;
+    if (e1.axial_pos_num != e2.axial_pos_num)
+      return e1.axial_pos_num < e2.axial_pos_num;
+    return e1.tangential_pos_num < e2.tangential_pos_num;
+  }
+
+  // 64-bit FNV-1a hash of the geometric info that the matrix depends on
+  boost::uint64_t
+  compute_geometry_hash(const ProjDataInfo& proj_data_info,
+                        const IndexRange<3>& densel_range,
+                        const CartesianCoordinate3D<float>& voxel_size,
+                        const CartesianCoordinate3D<float>& origin)
+  {
+    std::ostringstream s;
+    s << proj_data_info.parameter_info();
+    BasicCoordinate<3,int> min_indices, max_indices;
+    if (densel_range.get_regular_range(min_indices, max_indices))
+      s << "\nimage range: " << min_indices << max_indices;
+    else
+      s << "\nimage range: irregular with "
+        << densel_range.get_min_index() << ',' << densel_range.get_max_index();
+    s << "\nvoxel size: " << voxel_size
+      << "\norigin: " << origin << '\n';
+
+    const std::string str = s.str();
+    boost::uint64_t hash = 14695981039346656037ULL;
+    for (std::string::const_iterator iter = str.begin(); iter != str.end(); ++iter)
+      {
+        hash ^= static_cast<unsigned char>(*iter);
+        hash *= 1099511628211ULL;
+      }
+    return hash;
+  }
+
+  // finds all basic bins that we need to store (see write_to_file)
+  void
+  find_basic_bins(std::vector<Bin>& basic_bins,
+                  const ProjMatrixByBin& proj_matrix,
+                  const ProjDataInfo& proj_data_info)
+  {
+    // loop over bins
+    // the complication here is that we cannot just test if each bin in the range is 'basic'
+    // and write only those. The reason is that symmetry operations can construct a
+    // 'basic' bin outside of the input range (e.g. for tangential_pos_num ranging from -128 to 127).
+    // So, we can only loop over all bins, convert to basic bins, and write those.
+    // The complication is then that we need to keep track which one we wrote already.
+    // Originally, I did this via a std::list<Bin>. Checking if a bin was already written
+    // is terribly slow however. Instead, I currently use a vector of shared_ptrs.
+    // This wastes only a little bit of memory, but the bounds are difficult to 
+    // determine in general.
+    // A better approach (and simpler) would be to have access to the internal cache of the 
+    // projection matrix.
+    typedef VectorWithOffset<bool> tpos_t;
+    typedef VectorWithOffset<shared_ptr<tpos_t> > vpos_t;
+    typedef VectorWithOffset<shared_ptr<vpos_t> > apos_t;
+    typedef VectorWithOffset<shared_ptr<apos_t> > spos_t;
+
+    // vector that will contain (vectors of bools) to check if we wrote a bin already or not
+    // upper boundary takes into account that symmetries convert negative segment_num to positive
+    spos_t already_processed(proj_data_info.get_min_segment_num(), 
+                             std::max(proj_data_info.get_max_segment_num(),
+                                      -proj_data_info.get_min_segment_num())); 
+    for (int segment_num = proj_data_info.get_min_segment_num(); 
+         segment_num <= proj_data_info.get_max_segment_num();
+         ++segment_num)
+    for (int axial_pos_num = proj_data_info.get_min_axial_pos_num(segment_num);
+         axial_pos_num <= proj_data_info.get_max_axial_pos_num(segment_num);
+         ++axial_pos_num)
+      for (int view_num = proj_data_info.get_min_view_num();
+           view_num <= proj_data_info.get_max_view_num();
+           ++view_num)
+        for (int tang_pos_num = proj_data_info.get_min_tangential_pos_num();
+             tang_pos_num <= proj_data_info.get_max_tangential_pos_num();
+             ++tang_pos_num)
+          {
+            Bin  bin(segment_num,view_num, axial_pos_num, tang_pos_num);
+            proj_matrix.get_symmetries_ptr()->find_basic_bin(bin);
+            if (is_null_ptr(already_processed[bin.segment_num()]))
+              {
+                // range attempts to take into account that symmetries normally bring axial_pos_num back to 0 or 1
+                already_processed[bin.segment_num()].
+                  reset(new apos_t(std::min(0,proj_data_info.get_min_axial_pos_num(bin.segment_num())),
+                                   std::max(1,proj_data_info.get_max_axial_pos_num(bin.segment_num()))));
+              }
+            if (is_null_ptr((*already_processed[bin.segment_num()])[bin.axial_pos_num()]))
+              {
+                (*already_processed[bin.segment_num()])[bin.axial_pos_num()].
+                  reset(new vpos_t(proj_data_info.get_min_view_num(),
+                                   proj_data_info.get_max_view_num()));
+              }
+            if (is_null_ptr((*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()]))
+              {
+                // range takes into account that symmetries bring negative tangential_pos_num to positive
+                (*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()].
+                  reset(new tpos_t(proj_data_info.get_min_tangential_pos_num(),
+                                   std::max(proj_data_info.get_max_tangential_pos_num(),
+                                            -proj_data_info.get_min_tangential_pos_num())));
+                (*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()]->fill(false);
+              }
+            if ((*(*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()])[bin.tangential_pos_num()])
+              continue;
+
+            (*(*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()])[bin.tangential_pos_num()]=true;
+            basic_bins.push_back(bin);
+          }
+  }
 } // end of anonymous namespace
     
 Succeeded
@@ -356,8 +510,14 @@ ProjMatrixByBinFromFile::
 write_to_file(const std::string& output_filename_prefix, 
 	      const ProjMatrixByBin& proj_matrix,
 	      const shared_ptr<ProjDataInfo>& proj_data_info_sptr,
-	      const DiscretisedDensity<3,float>& template_density)
+	      const DiscretisedDensity<3,float>& template_density,
+	      const int format_version)
 {
+  if (format_version != 1 && format_version != 2)
+    {
+      warning("ProjMatrixByBinFromFile::write_to_file: format_version has to be 1 or 2");
+      return Succeeded::no;
+    }
 
   string template_density_filename =
     output_filename_prefix + "_template_density";
@@ -371,7 +531,7 @@ write_to_file(const std::string& output_filename_prefix,
       }
   }
   string template_proj_data_filename =
-    output_filename_prefix + "_template_proj_data";
+    output_filename_prefix + "_template_proj_data.hs";
   {
     // the following constructor will write an interfile header (and empty data) to disk
     shared_ptr<ExamInfo> exam_info_sptr(new ExamInfo);
@@ -380,6 +540,29 @@ write_to_file(const std::string& output_filename_prefix,
 					template_proj_data_filename);
   }
 
+  // the hash is computed from the template files as read back, as this is what
+  // the reader will compare with
+  boost::uint64_t geometry_hash = 0;
+  if (format_version == 2)
+    {
+      shared_ptr<ProjData> proj_data_sptr = 
+        ProjData::read_from_file(template_proj_data_filename);
+      shared_ptr<DiscretisedDensity<3,float> > 
+        density_sptr(read_from_file<DiscretisedDensity<3,float> >(template_density_filename));
+      const VoxelsOnCartesianGrid<float> * image_ptr =
+        dynamic_cast<const VoxelsOnCartesianGrid<float>*> (density_sptr.get());
+      if (image_ptr == NULL)
+        {
+          warning("ProjMatrixByBinFromFile::write_to_file only supports VoxelsOnCartesianGrid");
+          return Succeeded::no;
+        }
+      geometry_hash =
+        compute_geometry_hash(*proj_data_sptr->get_proj_data_info_ptr(),
+                              image_ptr->get_index_range(),
+                              image_ptr->get_voxel_size(),
+                              image_ptr->get_origin());
+    }
+
   string header_filename = output_filename_prefix;
   replace_extension(header_filename, ".hpm");
   string data_filename = output_filename_prefix;
@@ -395,7 +578,7 @@ write_to_file(const std::string& output_filename_prefix,
       }
 
     header << "Projection Matrix By Bin From File Parameters:=\n"
-	   << "Version := 1.0\n";
+	   << "Version := " << format_version << ".0\n";
     // TODO symmetries should not be hard-coded
     if (!is_null_ptr(dynamic_cast<const DataSymmetriesForBins_PET_CartesianGrid * const>(proj_matrix.get_symmetries_ptr())))
       {
@@ -433,94 +616,87 @@ write_to_file(const std::string& output_filename_prefix,
 
   std::ofstream fst;
   open_write_binary(fst, data_filename.c_str());
-  
-  // loop over bins
-  // the complication here is that we cannot just test if each bin in the range is 'basic'
-  // and write only those. The reason is that symmetry operations can construct a
-  // 'basic' bin outside of the input range (e.g. for tangential_pos_num ranging from -128 to 127).
-  // So, we can only loop over all bins, convert to basic bins, and write those.
-  // The complication is then that we need to keep track which one we wrote already.
-  // Originally, I did this via a std::list<Bin>. Checking if a bin was already written
-  // is terribly slow however. Instead, I currently use a vector of shared_ptrs.
-  // This wastes only a little bit of memory, but the bounds are difficult to 
-  // determine in general.
-  // A better approach (and simpler) would be to have access to the internal cache of the 
-  // projection matrix.
-  {
-    // defined here to avoid reallocation for every bin
-    ProjMatrixElemsForOneBin lor;
 
-#if 0
-    std::list<Bin> already_processed;
-#else
-    typedef VectorWithOffset<bool> tpos_t;
-    typedef VectorWithOffset<shared_ptr<tpos_t> > vpos_t;
-    typedef VectorWithOffset<shared_ptr<vpos_t> > apos_t;
-    typedef VectorWithOffset<shared_ptr<apos_t> > spos_t;
+  std::vector<Bin> basic_bins;
+  find_basic_bins(basic_bins, proj_matrix, *proj_data_info_sptr);
 
-    // vector that will contain (vectors of bools) to check if we wrote a bin already or not
-    // upper boundary takes into account that symmetries convert negative segment_num to positive
-    spos_t already_processed(proj_data_info_sptr->get_min_segment_num(), 
-			     std::max(proj_data_info_sptr->get_max_segment_num(),
-				      -proj_data_info_sptr->get_min_segment_num())); 
-#endif
-    for (int segment_num = proj_data_info_sptr->get_min_segment_num(); 
-	 segment_num <= proj_data_info_sptr->get_max_segment_num();
-	 ++segment_num)
-    for (int axial_pos_num = proj_data_info_sptr->get_min_axial_pos_num(segment_num);
-         axial_pos_num <= proj_data_info_sptr->get_max_axial_pos_num(segment_num);
-         ++axial_pos_num)
-      for (int view_num = proj_data_info_sptr->get_min_view_num();
-	   view_num <= proj_data_info_sptr->get_max_view_num();
-	   ++view_num)
-	for (int tang_pos_num = proj_data_info_sptr->get_min_tangential_pos_num();
-	     tang_pos_num <= proj_data_info_sptr->get_max_tangential_pos_num();
-	     ++tang_pos_num)
-	  {
-	    Bin  bin(segment_num,view_num, axial_pos_num, tang_pos_num);
-	    proj_matrix.get_symmetries_ptr()->find_basic_bin(bin);
-#if 0
-            if (std::find(already_processed.begin(), already_processed.end(), bin)
-		!= already_processed.end())
-	      continue;
-
-	    already_processed.push_back(bin);
-#else
-	    if (is_null_ptr(already_processed[bin.segment_num()]))
-	      {
-		// range attempts to take into account that symmetries normally bring axial_pos_num back to 0 or 1
-		already_processed[bin.segment_num()].
-		  reset(new apos_t(std::min(0,proj_data_info_sptr->get_min_axial_pos_num(bin.segment_num())),
-				   std::max(1,proj_data_info_sptr->get_max_axial_pos_num(bin.segment_num()))));
-	      }
-	    if (is_null_ptr((*already_processed[bin.segment_num()])[bin.axial_pos_num()]))
-	      {
-		(*already_processed[bin.segment_num()])[bin.axial_pos_num()].
-		  reset(new vpos_t(proj_data_info_sptr->get_min_view_num(),
-				   proj_data_info_sptr->get_max_view_num()));
-	      }
-	    if (is_null_ptr((*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()]))
-	      {
-		// range takes into account that symmetries bring negative tangential_pos_num to positive
-		(*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()].
-		  reset(new tpos_t(proj_data_info_sptr->get_min_tangential_pos_num(),
-				   std::max(proj_data_info_sptr->get_max_tangential_pos_num(),
-					    -proj_data_info_sptr->get_min_tangential_pos_num())));
-		(*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()]->fill(false);
-	      }
-	    if ((*(*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()])[bin.tangential_pos_num()])
-	      continue;
-
-	    (*(*(*already_processed[bin.segment_num()])[bin.axial_pos_num()])[bin.view_num()])[bin.tangential_pos_num()]=true;
+  // version 2.0: write a preliminary header (filled in at the end)
+  FileHeaderVersion2 file_header;
+  std::vector<IndexEntryVersion2> index;
+  if (format_version == 2)
+    {
+      std::memcpy(file_header.magic, magic_version_2, sizeof(file_header.magic));
+      file_header.byte_order = byte_order_marker;
+      file_header.element_size = sizeof(ProjMatrixElemsForOneBin::value_type);
+      file_header.geometry_hash = geometry_hash;
+      file_header.num_rows = 0;
+      file_header.index_offset = 0;
+      fst.write(reinterpret_cast<const char *>(&file_header), sizeof(file_header));
+      index.reserve(basic_bins.size());
+    }
+  boost::uint64_t current_offset = sizeof(file_header);
+
+  // compute rows in batches (in parallel if possible), and write them in order
+  const std::size_t batch_size = 1024;
+  std::vector<ProjMatrixElemsForOneBin> lors(std::min(batch_size, basic_bins.size()));
+  for (std::size_t batch_start = 0; batch_start < basic_bins.size(); batch_start += batch_size)
+    {
+      const int num_in_batch =
+        static_cast<int>(std::min(batch_size, basic_bins.size() - batch_start));
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(dynamic)
 #endif
-	    //if (!proj_matrix.get_symmetries_ptr()->is_basic(bin))
-	    //  continue;
-	    
-	    proj_matrix.get_proj_matrix_elems_for_one_bin(lor,bin);
-	    if (write_lor(fst, lor) == Succeeded::no)
-	      return Succeeded::no;
-	  }
-  }
+      for (int i=0; i<num_in_batch; ++i)
+        proj_matrix.get_proj_matrix_elems_for_one_bin(lors[i], basic_bins[batch_start+i]);
+
+      for (int i=0; i<num_in_batch; ++i)
+        {
+          const ProjMatrixElemsForOneBin& lor = lors[i];
+          if (format_version == 1)
+            {
+              if (write_lor(fst, lor) == Succeeded::no)
+                return Succeeded::no;
+              continue;
+            }
+          const Bin bin = lor.get_bin();
+          IndexEntryVersion2 entry;
+          entry.segment_num = bin.segment_num();
+          entry.view_num = bin.view_num();
+          entry.axial_pos_num = bin.axial_pos_num();
+          entry.tangential_pos_num = bin.tangential_pos_num();
+          entry.num_elements = static_cast<boost::uint32_t>(lor.size());
+          entry.unused = 0;
+          entry.offset = current_offset;
+          index.push_back(entry);
+          if (lor.size() > 0)
+            {
+              const std::size_t num_bytes = lor.size()*sizeof(ProjMatrixElemsForOneBin::value_type);
+              fst.write(reinterpret_cast<const char *>(&*lor.begin()), num_bytes);
+              current_offset += num_bytes;
+            }
+          if (!fst)
+            return Succeeded::no;
+        }
+    }
+
+  if (format_version == 2)
+    {
+      // pad to 8 bytes, such that the index is aligned
+      while (current_offset % 8 != 0)
+        {
+          fst.put(0);
+          ++current_offset;
+        }
+      std::sort(index.begin(), index.end());
+      if (index.size() > 0)
+        fst.write(reinterpret_cast<const char *>(&index[0]), index.size()*sizeof(IndexEntryVersion2));
+      file_header.num_rows = index.size();
+      file_header.index_offset = current_offset;
+      fst.seekp(0);
+      fst.write(reinterpret_cast<const char *>(&file_header), sizeof(file_header));
+      if (!fst)
+        return Succeeded::no;
+    }
   return Succeeded::yes;
 }
 
@@ -545,6 +721,109 @@ read_data()
   return Succeeded::yes;
 }
 
+Succeeded
+ProjMatrixByBinFromFile::
+read_data_version_2()
+{
+  using namespace boost::interprocess;
+  try
+    {
+      file_mapping mapping(data_filename.c_str(), read_only);
+      this->mapped_region_sptr.reset(new mapped_region(mapping, read_only));
+    }
+  catch (interprocess_exception& e)
+    {
+      warning("ProjMatrixByBinFromFile: error mapping %s into memory: %s",
+              data_filename.c_str(), e.what());
+      return Succeeded::no;
+    }
+  const char * const start_ptr = static_cast<const char *>(this->mapped_region_sptr->get_address());
+  const std::size_t file_size = this->mapped_region_sptr->get_size();
+
+  FileHeaderVersion2 file_header;
+  if (file_size < sizeof(file_header))
+    {
+      warning("ProjMatrixByBinFromFile: %s is too short", data_filename.c_str());
+      return Succeeded::no;
+    }
+  std::memcpy(&file_header, start_ptr, sizeof(file_header));
+  if (std::memcmp(file_header.magic, magic_version_2, sizeof(file_header.magic)) != 0)
+    {
+      warning("ProjMatrixByBinFromFile: %s is not a version 2.0 file", data_filename.c_str());
+      return Succeeded::no;
+    }
+  if (file_header.byte_order != byte_order_marker)
+    {
+      warning("ProjMatrixByBinFromFile: %s was written with a different byte order", data_filename.c_str());
+      return Succeeded::no;
+    }
+  if (file_header.element_size != sizeof(ProjMatrixElemsForOneBin::value_type))
+    {
+      warning("ProjMatrixByBinFromFile: %s has elements of size %u, but this version of STIR uses %u",
+              data_filename.c_str(), static_cast<unsigned>(file_header.element_size),
+              static_cast<unsigned>(sizeof(ProjMatrixElemsForOneBin::value_type)));
+      return Succeeded::no;
+    }
+  if (file_header.geometry_hash != 
+      compute_geometry_hash(*this->proj_data_info_ptr, densel_range, voxel_size, origin))
+    {
+      warning("ProjMatrixByBinFromFile: %s was computed for a different geometry than the template files",
+              data_filename.c_str());
+      return Succeeded::no;
+    }
+  if (file_header.index_offset % 8 != 0 ||
+      file_header.index_offset > file_size ||
+      file_header.num_rows > (file_size - file_header.index_offset)/sizeof(IndexEntryVersion2))
+    {
+      warning("ProjMatrixByBinFromFile: %s is corrupt (index out of range)", data_filename.c_str());
+      return Succeeded::no;
+    }
+  this->mapped_elements_ptr = start_ptr;
+  this->mapped_index_ptr = start_ptr + file_header.index_offset;
+  this->num_mapped_rows = file_header.num_rows;
+
+  // check that all rows are inside the file
+  {
+    const IndexEntryVersion2 * const index_begin =
+      static_cast<const IndexEntryVersion2 *>(this->mapped_index_ptr);
+    for (boost::uint64_t i=0; i<this->num_mapped_rows; ++i)
+      {
+        const IndexEntryVersion2& entry = index_begin[i];
+        if (entry.offset < sizeof(file_header) || entry.offset > file_header.index_offset ||
+            entry.num_elements > 
+              (file_header.index_offset - entry.offset)/sizeof(ProjMatrixElemsForOneBin::value_type))
+          {
+            warning("ProjMatrixByBinFromFile: %s is corrupt (row out of range)", data_filename.c_str());
+            this->mapped_region_sptr.reset();
+            return Succeeded::no;
+          }
+      }
+  }
+
+  if (this->use_memory_mapping)
+    {
+      // rows will be found in the mapped file, so no need to cache them
+      this->enable_cache(false);
+      return Succeeded::yes;
+    }
+
+  // copy all rows into the cache, and release the mapping
+  {
+    const IndexEntryVersion2 * const index_begin =
+      static_cast<const IndexEntryVersion2 *>(this->mapped_index_ptr);
+    // defined here to avoid reallocation for every bin
+    ProjMatrixElemsForOneBin lor;
+    for (boost::uint64_t i=0; i<this->num_mapped_rows; ++i)
+      {
+        const IndexEntryVersion2& entry = index_begin[i];
+        lor.set_bin(Bin(entry.segment_num, entry.view_num, entry.axial_pos_num, entry.tangential_pos_num, 0.F));
+        this->calculate_proj_matrix_elems_for_one_bin(lor);
+        this->cache_proj_matrix_elems_for_one_bin(lor);
+      }
+  }
+  this->mapped_region_sptr.reset();
+  return Succeeded::yes;
+}
 
 void 
 ProjMatrixByBinFromFile::
@@ -553,6 +832,29 @@ calculate_proj_matrix_elems_for_one_bin(ProjMatrixElemsForOneBin& lor
 {
   //error("ProjMatrixByBinFromFile element not found in cache (and hence file)");
   lor.erase();
+  if (is_null_ptr(this->mapped_region_sptr))
+    return;
+
+  const Bin bin = lor.get_bin();
+  IndexEntryVersion2 key;
+  key.segment_num = bin.segment_num();
+  key.view_num = bin.view_num();
+  key.axial_pos_num = bin.axial_pos_num();
+  key.tangential_pos_num = bin.tangential_pos_num();
+  const IndexEntryVersion2 * const index_begin =
+    static_cast<const IndexEntryVersion2 *>(this->mapped_index_ptr);
+  const IndexEntryVersion2 * const index_end = index_begin + this->num_mapped_rows;
+  const IndexEntryVersion2 * const entry_ptr =
+    std::lower_bound(index_begin, index_end, key);
+  if (entry_ptr == index_end || key < *entry_ptr)
+    return;
+
+  typedef ProjMatrixElemsForOneBin::value_type value_type;
+  const value_type * elem_ptr =
+    reinterpret_cast<const value_type *>(this->mapped_elements_ptr + entry_ptr->offset);
+  lor.reserve(entry_ptr->num_elements);
+  for (boost::uint32_t i=0; i<entry_ptr->num_elements; ++i, ++elem_ptr)
+    lor.push_back(*elem_ptr);
 }
 END_NAMESPACE_STIR
 
@@ -2,6 +2,7 @@
 //
 /*
     Copyright (C) 2000- 2011, Hammersmith Imanet Ltd
+    Copyright (C) 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -27,6 +28,8 @@
 */
 
 #include "stir/recon_buildblock/QuadraticPrior.h"
+#include "stir/recon_buildblock/NeighbourhoodStencil.h"
+#include "stir/recon_buildblock/NeighbourhoodPrior.h"
 #include "stir/Succeeded.h"
 #include "stir/DiscretisedDensityOnCartesianGrid.h"
 #include "stir/IndexRange3D.h"
@@ -38,11 +41,117 @@
 using std::min;
 using std::max;
 
-/* Pretty horrible code because we don't have an iterator of neigbhourhoods yet
- */
-
 START_NAMESPACE_STIR
 
+namespace
+{
+  /* Kernels for NeighbourhoodStencil.
+     They are written as simple loops over x (with the test for kappa outside the loop),
+     such that the compiler can vectorise them.
+  */
+
+  template <typename elemT>
+  class QuadraticValueKernel
+  {
+  public:
+    double operator()(elemT*, const elemT* centre, const elemT* neighbour,
+                      const elemT* kappa_centre, const elemT* kappa_neighbour,
+                      const int length, const float weight) const
+    {
+      double result = 0.;
+      if (kappa_centre == 0)
+        {
+          for (int i=0; i<length; ++i)
+            result += static_cast<double>(weight * square(centre[i] - neighbour[i])/4);
+        }
+      else
+        {
+          for (int i=0; i<length; ++i)
+            {
+              elemT current = weight * square(centre[i] - neighbour[i])/4;
+              current *= kappa_centre[i] * kappa_neighbour[i];
+              result += static_cast<double>(current);
+            }
+        }
+      return result;
+    }
+  };
+
+  template <typename elemT>
+  class QuadraticGradientKernel
+  {
+  public:
+    double operator()(elemT* output, const elemT* centre, const elemT* neighbour,
+                      const elemT* kappa_centre, const elemT* kappa_neighbour,
+                      const int length, const float weight) const
+    {
+      if (kappa_centre == 0)
+        {
+          for (int i=0; i<length; ++i)
+            output[i] += weight * (centre[i] - neighbour[i]);
+        }
+      else
+        {
+          for (int i=0; i<length; ++i)
+            {
+              elemT current = weight * (centre[i] - neighbour[i]);
+              current *= kappa_centre[i] * kappa_neighbour[i];
+              output[i] += current;
+            }
+        }
+      return 0.;
+    }
+  };
+
+  template <typename elemT>
+  class QuadraticCurvatureKernel
+  {
+  public:
+    double operator()(elemT* output, const elemT*, const elemT*,
+                      const elemT* kappa_centre, const elemT* kappa_neighbour,
+                      const int length, const float weight) const
+    {
+      if (kappa_centre == 0)
+        {
+          for (int i=0; i<length; ++i)
+            output[i] += weight;
+        }
+      else
+        {
+          for (int i=0; i<length; ++i)
+            output[i] += weight * (kappa_centre[i] * kappa_neighbour[i]);
+        }
+      return 0.;
+    }
+  };
+
+  template <typename elemT>
+  class QuadraticHessianMultiplicationKernel
+  {
+  public:
+    double operator()(elemT* output, const elemT*, const elemT* neighbour,
+                      const elemT* kappa_centre, const elemT* kappa_neighbour,
+                      const int length, const float weight) const
+    {
+      if (kappa_centre == 0)
+        {
+          for (int i=0; i<length; ++i)
+            output[i] += weight * neighbour[i];
+        }
+      else
+        {
+          for (int i=0; i<length; ++i)
+            {
+              elemT current = weight * neighbour[i];
+              current *= kappa_centre[i] * kappa_neighbour[i];
+              output[i] += current;
+            }
+        }
+      return 0.;
+    }
+  };
+}
+
 template <typename elemT>
 void 
 QuadraticPrior<elemT>::initialise_keymap()
@@ -65,47 +174,22 @@ QuadraticPrior<elemT>::post_processing()
   if (kappa_filename.size() != 0)
     this->kappa_ptr = read_from_file<DiscretisedDensity<3,elemT> >(kappa_filename);
 
-  bool warn_about_even_size = false;
-
   if (this->weights.size() ==0)
     {
-      // will call compute_weights() to fill it in
+      // will call compute_inverse_distance_weights() to fill it in
     }
   else
     {
-      if (!this->weights.is_regular())
+      bool has_even_size;
+      if (!centre_neighbourhood_weights(this->weights, has_even_size))
         {
           warning("Sorry. QuadraticPrior currently only supports regular arrays for the weights");
           return true;
         }
-
-      const unsigned int size_z = this->weights.size();
-      if (size_z%2==0)
-        warn_about_even_size = true;
-      const int min_index_z = -static_cast<int>(size_z/2);
-      this->weights.set_min_index(min_index_z);
-
-      for (int z = min_index_z; z<= this->weights.get_max_index(); ++z)
-        {
-          const unsigned int size_y = this->weights[z].size();
-          if (size_y%2==0)
-            warn_about_even_size = true;
-          const int min_index_y = -static_cast<int>(size_y/2);
-          this->weights[z].set_min_index(min_index_y);
-          for (int y = min_index_y; y<= this->weights[z].get_max_index(); ++y)
-            {
-              const unsigned int size_x = this->weights[z][y].size();
-              if (size_x%2==0)
-                warn_about_even_size = true;
-              const int min_index_x = -static_cast<int>(size_x/2);
-              this->weights[z][y].set_min_index(min_index_x);
-            }
-        }
+      if (has_even_size)
+        warning("Parsing QuadraticPrior: even number of weights occured in either x,y or z dimension.\n"
+                "I'll (effectively) make this odd by appending a 0 at the end.");
     }
-
-  if (warn_about_even_size)
-    warning("Parsing QuadraticPrior: even number of weights occured in either x,y or z dimension.\n"
-            "I'll (effectively) make this odd by appending a 0 at the end.");
   return false;
 
 }
@@ -173,39 +257,6 @@ set_kappa_sptr(const shared_ptr<DiscretisedDensity<3,elemT> >& k)
 { this->kappa_ptr = k; }
 
 
-// TODO move to set_up
-// initialise to 1/Euclidean distance
-static void 
-compute_weights(Array<3,float>& weights, const CartesianCoordinate3D<float>& grid_spacing, const bool only_2D)
-{
-  int min_dz, max_dz;
-  if (only_2D)
-    {
-      min_dz = max_dz = 0;
-    }
-  else
-    {
-      min_dz = -1;
-      max_dz = 1;
-    }
-  weights = Array<3,float>(IndexRange3D(min_dz,max_dz,-1,1,-1,1));
-  for (int z=min_dz;z<=max_dz;++z)
-    for (int y=-1;y<=1;++y)
-      for (int x=-1;x<=1;++x)
-        {
-          if (z==0 && y==0 && x==0)
-            weights[0][0][0] = 0;
-          else
-            {
-              weights[z][y][x] = 
-                grid_spacing.x()/
-                sqrt(square(x*grid_spacing.x())+
-                     square(y*grid_spacing.y())+
-                     square(z*grid_spacing.z()));
-            }
-        }
-}
-
 template <typename elemT>
 double
 QuadraticPrior<elemT>::
@@ -222,7 +273,7 @@ compute_value(const DiscretisedDensity<3,elemT> &current_image_estimate)
   
   if (this->weights.get_length() ==0)
   {
-    compute_weights(this->weights, current_image_cast.get_grid_spacing(), this->only_2D);
+    compute_inverse_distance_weights(this->weights, current_image_cast.get_grid_spacing(), this->only_2D);
   }
     
   const bool do_kappa = !is_null_ptr(kappa_ptr);
@@ -231,53 +282,16 @@ compute_value(const DiscretisedDensity<3,elemT> &current_image_estimate)
     error("QuadraticPrior: kappa image has not the same index range as the reconstructed image\n");
 
 
-  double result = 0.;
-  const int min_z = current_image_estimate.get_min_index(); 
-  const int max_z = current_image_estimate.get_max_index(); 
-  for (int z=min_z; z<=max_z; z++)
-    {
-      const int min_dz = max(weights.get_min_index(), min_z-z);
-      const int max_dz = min(weights.get_max_index(), max_z-z);
-        
-      const int min_y = current_image_estimate[z].get_min_index();
-      const int max_y = current_image_estimate[z].get_max_index();
-
-        for (int y=min_y;y<= max_y;y++)
-          {
-            const int min_dy = max(weights[0].get_min_index(), min_y-y);
-            const int max_dy = min(weights[0].get_max_index(), max_y-y);            
-
-            const int min_x = current_image_estimate[z][y].get_min_index(); 
-            const int max_x = current_image_estimate[z][y].get_max_index(); 
-
-            for (int x=min_x;x<= max_x;x++)       
-              {
-                const int min_dx = max(weights[0][0].get_min_index(), min_x-x);
-                const int max_dx = min(weights[0][0].get_max_index(), max_x-x);
-                
-                /* formula:
-                  sum_dx,dy,dz
-                   1/4 weights[dz][dy][dx] *
-                   (current_image_estimate[z][y][x] - current_image_estimate[z+dz][y+dy][x+dx])^2 *
-                   (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
-                */
-                for (int dz=min_dz;dz<=max_dz;++dz)
-                  for (int dy=min_dy;dy<=max_dy;++dy)
-                    for (int dx=min_dx;dx<=max_dx;++dx)
-                      {
-                        elemT current =
-                          weights[dz][dy][dx] *
-                          square(current_image_estimate[z][y][x] - current_image_estimate[z+dz][y+dy][x+dx])/4;
-
-                        if (do_kappa)
-                          current *= 
-                            (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
-
-                        result += static_cast<double>(current);
-                      }
-              }              
-          }
-    }
+  /* formula:
+    sum_dx,dy,dz
+     1/4 weights[dz][dy][dx] *
+     (current_image_estimate[z][y][x] - current_image_estimate[z+dz][y+dy][x+dx])^2 *
+     (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
+  */
+  const NeighbourhoodStencil<elemT> stencil(this->weights);
+  const double result =
+    stencil.apply(0, false, 1.F, current_image_estimate, kappa_ptr.get(),
+                  QuadraticValueKernel<elemT>());
   return result * this->penalisation_factor;
 }
 
@@ -300,7 +314,7 @@ compute_gradient(DiscretisedDensity<3,elemT>& prior_gradient,
   
   if (this->weights.get_length() ==0)
   {
-    compute_weights(this->weights, current_image_cast.get_grid_spacing(), this->only_2D);
+    compute_inverse_distance_weights(this->weights, current_image_cast.get_grid_spacing(), this->only_2D);
   }
  
  
@@ -309,101 +323,16 @@ compute_gradient(DiscretisedDensity<3,elemT>& prior_gradient,
   if (do_kappa && !kappa_ptr->has_same_characteristics(current_image_estimate))
     error("QuadraticPrior: kappa image has not the same index range as the reconstructed image\n");
 
-  const int min_z = current_image_estimate.get_min_index();  
-  const int max_z = current_image_estimate.get_max_index();  
-  for (int z=min_z; z<=max_z; z++) 
-    { 
-      const int min_dz = max(weights.get_min_index(), min_z-z); 
-      const int max_dz = min(weights.get_max_index(), max_z-z); 
-      
-      const int min_y = current_image_estimate[z].get_min_index(); 
-      const int max_y = current_image_estimate[z].get_max_index(); 
-      
-      for (int y=min_y;y<= max_y;y++) 
-        { 
-          const int min_dy = max(weights[0].get_min_index(), min_y-y); 
-          const int max_dy = min(weights[0].get_max_index(), max_y-y);             
-          
-          const int min_x = current_image_estimate[z][y].get_min_index();
-          const int max_x = current_image_estimate[z][y].get_max_index();  
-          
-          for (int x=min_x;x<= max_x;x++)
-            {
-              const int min_dx = max(weights[0][0].get_min_index(), min_x-x);
-              const int max_dx = min(weights[0][0].get_max_index(), max_x-x);
-                
-                /* formula:
-                  sum_dx,dy,dz
-                   weights[dz][dy][dx] *
-                   (current_image_estimate[z][y][x] - current_image_estimate[z+dz][y+dy][x+dx]) *
-                   (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
-                */
-#if 1
-                elemT gradient = 0;
-                for (int dz=min_dz;dz<=max_dz;++dz)
-                  for (int dy=min_dy;dy<=max_dy;++dy)
-                    for (int dx=min_dx;dx<=max_dx;++dx)
-                      {
-                        elemT current =
-                          weights[dz][dy][dx] *
-                          (current_image_estimate[z][y][x] - current_image_estimate[z+dz][y+dy][x+dx]);
-
-                        if (do_kappa)
-                          current *= 
-                            (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
-
-                        gradient += current;
-                      }
-#else
-                // attempt to speed up by precomputing the sum of weights.
-                // The current code gives identical results but is actually slower
-                // than the above, at least when kappas are present.
-
-
-                // precompute sum of weights
-                // TODO without kappas, this is just weights.sum() most of the time, 
-                // but not near edges
-                float sum_of_weights = 0;
-                {
-                  if (do_kappa)
-                    {                
-                      for (int dz=min_dz;dz<=max_dz;++dz)
-                        for (int dy=min_dy;dy<=max_dy;++dy)
-                          for (int dx=min_dx;dx<=max_dx;++dx)
-                            sum_of_weights +=  weights[dz][dy][dx]*(*kappa_ptr)[z+dz][y+dy][x+dx];
-                    }
-                  else
-                    {
-                      for (int dz=min_dz;dz<=max_dz;++dz)
-                        for (int dy=min_dy;dy<=max_dy;++dy)
-                          for (int dx=min_dx;dx<=max_dx;++dx)
-                            sum_of_weights +=  weights[dz][dy][dx];
-                    }
-                }
-                // now compute contribution of central term
-                elemT gradient = sum_of_weights * current_image_estimate[z][y][x] ;
-
-                // subtract the rest
-                for (int dz=min_dz;dz<=max_dz;++dz)
-                  for (int dy=min_dy;dy<=max_dy;++dy)
-                    for (int dx=min_dx;dx<=max_dx;++dx)
-                      {
-                        elemT current =
-                          weights[dz][dy][dx] * current_image_estimate[z+dz][y+dy][x+dx];
-
-                        if (do_kappa)
-                          current *= (*kappa_ptr)[z+dz][y+dy][x+dx];
-
-                        gradient -= current;
-                      }
-                // multiply with central kappa
-                if (do_kappa)
-                  gradient *= (*kappa_ptr)[z][y][x];
-#endif
-                prior_gradient[z][y][x]= gradient * this->penalisation_factor;
-              }              
-          }
-    }
+  /* formula:
+    sum_dx,dy,dz
+     weights[dz][dy][dx] *
+     (current_image_estimate[z][y][x] - current_image_estimate[z+dz][y+dy][x+dx]) *
+     (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
+  */
+  const NeighbourhoodStencil<elemT> stencil(this->weights);
+  stencil.apply(&prior_gradient, /*add_to_output=*/false, this->penalisation_factor,
+                current_image_estimate, kappa_ptr.get(),
+                QuadraticGradientKernel<elemT>());
 
   info(boost::format("Prior gradient max %1%, min %2%\n") % prior_gradient.find_max() % prior_gradient.find_min());
 
@@ -441,13 +370,13 @@ compute_Hessian(DiscretisedDensity<3,elemT>& prior_Hessian_for_single_densel,
 
   if (weights.get_length() ==0)
   {
-    compute_weights(weights, current_image_cast.get_grid_spacing(), this->only_2D);
+    compute_inverse_distance_weights(weights, current_image_cast.get_grid_spacing(), this->only_2D);
   }
  
    
   const bool do_kappa = !is_null_ptr(kappa_ptr);
   
-  if (do_kappa && kappa_ptr->has_same_characteristics(current_image_estimate))
+  if (do_kappa && !kappa_ptr->has_same_characteristics(current_image_estimate))
     error("QuadraticPrior: kappa image has not the same index range as the reconstructed image\n");
 
   const int z = coords[1];
@@ -501,7 +430,7 @@ QuadraticPrior<elemT>::parabolic_surrogate_curvature(DiscretisedDensity<3,elemT>
   
   if (weights.get_length() ==0)
   {
-    compute_weights(weights, current_image_cast.get_grid_spacing(), this->only_2D);
+    compute_inverse_distance_weights(weights, current_image_cast.get_grid_spacing(), this->only_2D);
   }  
    
   const bool do_kappa = !is_null_ptr(kappa_ptr);
@@ -509,48 +438,11 @@ QuadraticPrior<elemT>::parabolic_surrogate_curvature(DiscretisedDensity<3,elemT>
   if (do_kappa && !kappa_ptr->has_same_characteristics(current_image_estimate))
     error("QuadraticPrior: kappa image has not the same index range as the reconstructed image\n");
 
-  const int min_z = current_image_estimate.get_min_index();   
-  const int max_z = current_image_estimate.get_max_index();   
-  for (int z=min_z; z<=max_z; z++)  
-    {  
-      const int min_dz = max(weights.get_min_index(), min_z-z);  
-      const int max_dz = min(weights.get_max_index(), max_z-z);  
-       
-      const int min_y = current_image_estimate[z].get_min_index();  
-      const int max_y = current_image_estimate[z].get_max_index();  
-       
-      for (int y=min_y;y<= max_y;y++)  
-        {  
-          const int min_dy = max(weights[0].get_min_index(), min_y-y);  
-          const int max_dy = min(weights[0].get_max_index(), max_y-y);              
-           
-          const int min_x = current_image_estimate[z][y].get_min_index(); 
-          const int max_x = current_image_estimate[z][y].get_max_index();   
-          for (int x=min_x;x<= max_x;x++) 
-            { 
-              const int min_dx = max(weights[0][0].get_min_index(), min_x-x); 
-              const int max_dx = min(weights[0][0].get_max_index(), max_x-x); 
-                
-                elemT gradient = 0;
-                for (int dz=min_dz;dz<=max_dz;++dz)
-                  for (int dy=min_dy;dy<=max_dy;++dy)
-                    for (int dx=min_dx;dx<=max_dx;++dx)
-                      {
-                        // 1 comes from omega = psi'(t)/t = 2*t/2t =1                  
-                        elemT current =
-                          weights[dz][dy][dx] *1;
-
-                         if (do_kappa)
-                          current *= 
-                            (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
-
-                        gradient += current;
-                      }
-                
-                parabolic_surrogate_curvature[z][y][x]= gradient * this->penalisation_factor;
-              }              
-          }
-    }
+  // sum of weights (times kappas), as omega = psi'(t)/t = 2*t/2t =1
+  const NeighbourhoodStencil<elemT> stencil(this->weights);
+  stencil.apply(&parabolic_surrogate_curvature, /*add_to_output=*/false, this->penalisation_factor,
+                current_image_estimate, kappa_ptr.get(),
+                QuadraticCurvatureKernel<elemT>());
 
   info(boost::format("parabolic_surrogate_curvature max %1%, min %2%\n") % parabolic_surrogate_curvature.find_max() % parabolic_surrogate_curvature.find_min());
   /*{
@@ -582,7 +474,7 @@ add_multiplication_with_approximate_Hessian(DiscretisedDensity<3,elemT>& output,
 
   if (weights.get_length() ==0)
   {
-    compute_weights(weights, output_cast.get_grid_spacing(), this->only_2D);
+    compute_inverse_distance_weights(weights, output_cast.get_grid_spacing(), this->only_2D);
   }  
    
   const bool do_kappa = !is_null_ptr(kappa_ptr);
@@ -590,47 +482,10 @@ add_multiplication_with_approximate_Hessian(DiscretisedDensity<3,elemT>& output,
   if (do_kappa && !kappa_ptr->has_same_characteristics(input))
     error("QuadraticPrior: kappa image has not the same index range as the reconstructed image\n");
 
-  const int min_z = output.get_min_index();   
-  const int max_z = output.get_max_index();   
-  for (int z=min_z; z<=max_z; z++)  
-    {  
-      const int min_dz = max(weights.get_min_index(), min_z-z);  
-      const int max_dz = min(weights.get_max_index(), max_z-z);  
-      
-      const int min_y = output[z].get_min_index();  
-      const int max_y = output[z].get_max_index();  
-       
-      for (int y=min_y;y<= max_y;y++)  
-        {  
-          const int min_dy = max(weights[0].get_min_index(), min_y-y);  
-          const int max_dy = min(weights[0].get_max_index(), max_y-y);              
-           
-          const int min_x = output[z][y].get_min_index(); 
-          const int max_x = output[z][y].get_max_index();   
-
-          for (int x=min_x;x<= max_x;x++) 
-            { 
-              const int min_dx = max(weights[0][0].get_min_index(), min_x-x); 
-              const int max_dx = min(weights[0][0].get_max_index(), max_x-x); 
-                
-                elemT result = 0;
-                for (int dz=min_dz;dz<=max_dz;++dz)
-                  for (int dy=min_dy;dy<=max_dy;++dy)
-                    for (int dx=min_dx;dx<=max_dx;++dx)
-                      {
-                        elemT current =
-                          weights[dz][dy][dx] * input[z+dz][y+dy][x+dx];
-
-                         if (do_kappa)
-                          current *= 
-                            (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
-                         result += current;
-                      }
-                
-                output[z][y][x] += result * this->penalisation_factor;
-            }              
-        }
-    }
+  const NeighbourhoodStencil<elemT> stencil(this->weights);
+  stencil.apply(&output, /*add_to_output=*/true, this->penalisation_factor,
+                input, kappa_ptr.get(),
+                QuadraticHessianMultiplicationKernel<elemT>());
   return Succeeded::yes;
 }
 
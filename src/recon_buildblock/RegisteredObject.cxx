@@ -50,6 +50,9 @@
 #pragma message("instantiating RegisteredObject<BinNormalisation>")
 #include "stir/recon_buildblock/BinNormalisation.h"
 
+#pragma message("instantiating RegisteredObject<SubsetScheme>")
+#include "stir/recon_buildblock/SubsetScheme.h"
+
 // and others
 START_NAMESPACE_STIR
 
@@ -79,6 +82,8 @@ template RegisteredObject<ForwardProjectorByBin>;
 template RegisteredObject<BackProjectorByBin>;
 
 template RegisteredObject<BinNormalisation>;
+
+template RegisteredObject<SubsetScheme>;
 END_NAMESPACE_STIR
 
 #endif
@@ -0,0 +1,109 @@
+/*!
+
+  \file
+  \ingroup recon_buildblock
+
+  \brief  implementation of the stir::ThreadLocalImages class
+*/
+/*
+    Copyright (C) 2016, University College London
+
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/recon_buildblock/ThreadLocalImages.h"
+#include "stir/is_null_ptr.h"
+#include <utility>
+#include <cassert>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+
+START_NAMESPACE_STIR
+
+ThreadLocalImages::
+ThreadLocalImages(DiscretisedDensity<3,float>& target)
+  : target(target)
+{
+#ifdef STIR_OPENMP
+  this->local_image_sptrs.resize(omp_get_max_threads());
+#endif
+}
+
+DiscretisedDensity<3,float>&
+ThreadLocalImages::
+get_local_image()
+{
+#ifdef STIR_OPENMP
+  return this->get_local_image(omp_get_thread_num());
+#else
+  return this->target;
+#endif
+}
+
+DiscretisedDensity<3,float>&
+ThreadLocalImages::
+get_local_image(const int image_num)
+{
+#ifdef STIR_OPENMP
+  assert(image_num >= 0 && image_num < static_cast<int>(this->local_image_sptrs.size()));
+  if (image_num == 0)
+    return this->target;
+  // note: only one thread accesses this element at a time, so no locking is needed
+  shared_ptr<DiscretisedDensity<3,float> >& image_sptr = this->local_image_sptrs[image_num];
+  if (is_null_ptr(image_sptr))
+    image_sptr.reset(this->target.get_empty_copy());
+  return *image_sptr;
+#else
+  assert(image_num == 0);
+  return this->target;
+#endif
+}
+
+void
+ThreadLocalImages::
+reduce()
+{
+#ifdef STIR_OPENMP
+  std::vector<DiscretisedDensity<3,float>*> images;
+  for (std::size_t i=1; i<this->local_image_sptrs.size(); ++i)
+    if (!is_null_ptr(this->local_image_sptrs[i])) // only accumulate if a thread filled something in
+      images.push_back(this->local_image_sptrs[i].get());
+  if (images.empty())
+    return;
+
+  // use rows as tiles, such that there are enough of them even for 2D images
+  std::vector<std::pair<int,int> > rows;
+  for (int z=this->target.get_min_index(); z<=this->target.get_max_index(); ++z)
+    for (int y=this->target[z].get_min_index(); y<=this->target[z].get_max_index(); ++y)
+      rows.push_back(std::make_pair(z,y));
+
+  const int num_images = static_cast<int>(images.size());
+#pragma omp parallel for schedule(static)
+  for (int i=0; i<static_cast<int>(rows.size()); ++i)
+    {
+      const int z = rows[i].first;
+      const int y = rows[i].second;
+      Array<1,float>& target_row = this->target[z][y];
+      for (int image_num=0; image_num<num_images; ++image_num)
+        target_row += (*images[image_num])[z][y];
+    }
+
+  for (std::size_t i=1; i<this->local_image_sptrs.size(); ++i)
+    this->local_image_sptrs[i].reset();
+#endif
+}
+
+END_NAMESPACE_STIR
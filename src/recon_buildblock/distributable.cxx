@@ -1,7 +1,7 @@
 /*
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000 - 2011, Hammersmith Imanet Ltd
-    Copyright (C) 2013-2014, University College London
+    Copyright (C) 2013-2014, 2016, University College London
     This file is part of STIR.
 
     This file is free software; you can redistribute it and/or modify
@@ -53,11 +53,16 @@
 #include "stir/recon_buildblock/ForwardProjectorByBin.h"
 #include "stir/recon_buildblock/BackProjectorByBin.h"
 #include "stir/recon_buildblock/BinNormalisation.h"
-#include "stir/recon_buildblock/find_basic_vs_nums_in_subsets.h"
+#include "stir/recon_buildblock/SubsetScheme.h"
+#include "stir/recon_buildblock/ThreadLocalImages.h"
+#include "stir/recon_buildblock/DistributableScheduler.h"
 #include "stir/is_null_ptr.h"
 #include "stir/info.h"
 #include <boost/format.hpp>
 #include <algorithm>
+#include <numeric>
+#include <map>
+#include <sstream>
 //#include "stir/recon_buildblock/PoissonLogLikelihoodWithLinearModelForMeanAndProjData.h" // needed for RPC functions
 
 #ifdef STIR_MPI
@@ -75,6 +80,40 @@
 
 START_NAMESPACE_STIR
 
+/* The schedulers keep the measured times of the tasks between calls to
+   distributable_computation(). As these depend on the type of computation, there is
+   one scheduler for every RPC function. They are reset by setup_distributable_computation().
+   The map is only accessed in the critical section DISTRIBUTABLE_SCHEDULERS. Elements of a
+   std::map are not moved by insertions, so a scheduler can be used outside that section.
+*/
+typedef std::map<RPC_process_related_viewgrams_type *, DistributableScheduler> schedulers_type;
+static schedulers_type&
+get_schedulers()
+{
+  static schedulers_type schedulers;
+  return schedulers;
+}
+
+static DistributableScheduler&
+get_scheduler(RPC_process_related_viewgrams_type * RPC_process_related_viewgrams)
+{
+  DistributableScheduler * scheduler_ptr;
+#ifdef STIR_OPENMP
+#pragma omp critical(DISTRIBUTABLE_SCHEDULERS)
+#endif
+  scheduler_ptr = &get_schedulers()[RPC_process_related_viewgrams];
+  return *scheduler_ptr;
+}
+
+static void
+clear_schedulers()
+{
+#ifdef STIR_OPENMP
+#pragma omp critical(DISTRIBUTABLE_SCHEDULERS)
+#endif
+  get_schedulers().clear();
+}
+
 /* WARNING: the sequence of steps here has to match what is on the receiving end 
    in DistributedWorker */
 void setup_distributable_computation(
@@ -86,6 +125,7 @@ void setup_distributable_computation(
                                      const bool distributed_cache_enabled)
 {
   set_num_threads();
+  clear_schedulers();
 #ifdef STIR_OPENMP
   info(boost::format("Using distributable_computation with %d threads on %d processors.")
        % omp_get_max_threads() % omp_get_num_procs());
@@ -161,24 +201,25 @@ zero_end_sinograms(ViewgramsPtr viewgrams_ptr)
     }
 }
 
+/* Reads the measured data and the additive term (if any).
+   When using OpenMP (without MPI), this is either called by only one thread, or
+   (if all projection data involved support concurrent reads) from several tasks at the
+   same time, see distributable_computation(). The critical sections are therefore only needed
+   when using MPI and OpenMP together.
+*/
 static
-void get_viewgrams(shared_ptr<RelatedViewgrams<float> >& y,
-                   shared_ptr<RelatedViewgrams<float> >& additive_binwise_correction_viewgrams,
-                   shared_ptr<RelatedViewgrams<float> >& mult_viewgrams_sptr,
-                   const shared_ptr<ProjData>& proj_dat_ptr, 
-                   const bool read_from_proj_dat,
-                   const bool zero_seg0_end_planes,
-                   const shared_ptr<ProjData>& binwise_correction,
-                   const shared_ptr<BinNormalisation>& normalisation_sptr,
-                   const double start_time_of_frame,
-                   const double end_time_of_frame,
-                   const shared_ptr<DataSymmetriesForViewSegmentNumbers>& symmetries_ptr,
-                   const ViewSegmentNumbers& view_segment_num
-                   )
+void get_data_viewgrams(shared_ptr<RelatedViewgrams<float> >& y,
+                        shared_ptr<RelatedViewgrams<float> >& additive_binwise_correction_viewgrams,
+                        const shared_ptr<ProjData>& proj_dat_ptr, 
+                        const bool read_from_proj_dat,
+                        const shared_ptr<ProjData>& binwise_correction,
+                        const shared_ptr<DataSymmetriesForViewSegmentNumbers>& symmetries_ptr,
+                        const ViewSegmentNumbers& view_segment_num
+                        )
 {
   if (!is_null_ptr(binwise_correction))
     {
-#ifdef STIR_OPENMP
+#if defined(STIR_OPENMP) && defined(STIR_MPI)
 #pragma omp critical(ADDSINO)
 #endif
 #if !defined(_MSC_VER) || _MSC_VER>1300
@@ -194,7 +235,7 @@ void get_viewgrams(shared_ptr<RelatedViewgrams<float> >& y,
                         
   if (read_from_proj_dat)
     {
-#ifdef STIR_OPENMP
+#if defined(STIR_OPENMP) && defined(STIR_MPI)
 #pragma omp critical(VIEW)
 #endif
 #if !defined(_MSC_VER) || _MSC_VER>1300
@@ -212,18 +253,56 @@ void get_viewgrams(shared_ptr<RelatedViewgrams<float> >& y,
       y.reset(new RelatedViewgrams<float>
 	      (proj_dat_ptr->get_empty_related_viewgrams(view_segment_num, symmetries_ptr)));
     }
+}
 
-  // multiplicative correction
+/* Computes the multiplicative factors (if any).
+   When using OpenMP (without MPI), this is only called by one thread, see
+   distributable_computation().
+*/
+static
+void get_mult_viewgrams(shared_ptr<RelatedViewgrams<float> >& mult_viewgrams_sptr,
+                        const shared_ptr<ProjData>& proj_dat_ptr, 
+                        const shared_ptr<BinNormalisation>& normalisation_sptr,
+                        const double start_time_of_frame,
+                        const double end_time_of_frame,
+                        const shared_ptr<DataSymmetriesForViewSegmentNumbers>& symmetries_ptr,
+                        const ViewSegmentNumbers& view_segment_num
+                        )
+{
   if (!is_null_ptr(normalisation_sptr) && !normalisation_sptr->is_trivial())
     {
       mult_viewgrams_sptr.reset(
 				new RelatedViewgrams<float>(proj_dat_ptr->get_empty_related_viewgrams(view_segment_num, symmetries_ptr)));
       mult_viewgrams_sptr->fill(1.F);
-#ifdef STIR_OPENMP
+#if defined(STIR_OPENMP) && defined(STIR_MPI)
 #pragma omp critical(MULT)
 #endif
       normalisation_sptr->undo(*mult_viewgrams_sptr,start_time_of_frame,end_time_of_frame);
     }
+}
+
+/* Reads the viewgrams and computes the multiplicative factors. */
+static
+void get_viewgrams(shared_ptr<RelatedViewgrams<float> >& y,
+                   shared_ptr<RelatedViewgrams<float> >& additive_binwise_correction_viewgrams,
+                   shared_ptr<RelatedViewgrams<float> >& mult_viewgrams_sptr,
+                   const shared_ptr<ProjData>& proj_dat_ptr, 
+                   const bool read_from_proj_dat,
+                   const bool zero_seg0_end_planes,
+                   const shared_ptr<ProjData>& binwise_correction,
+                   const shared_ptr<BinNormalisation>& normalisation_sptr,
+                   const double start_time_of_frame,
+                   const double end_time_of_frame,
+                   const shared_ptr<DataSymmetriesForViewSegmentNumbers>& symmetries_ptr,
+                   const ViewSegmentNumbers& view_segment_num
+                   )
+{
+  get_data_viewgrams(y, additive_binwise_correction_viewgrams,
+                     proj_dat_ptr, read_from_proj_dat, binwise_correction,
+                     symmetries_ptr, view_segment_num);
+  get_mult_viewgrams(mult_viewgrams_sptr, proj_dat_ptr, normalisation_sptr,
+                     start_time_of_frame, end_time_of_frame,
+                     symmetries_ptr, view_segment_num);
                         
   if (view_segment_num.segment_num()==0 && zero_seg0_end_planes)
     {
@@ -286,6 +365,7 @@ void distributable_computation(
                                const shared_ptr<ProjData>& proj_dat_ptr, 
                                const bool read_from_proj_dat,
                                int subset_num, int num_subsets,
+                               const SubsetScheme& subset_scheme,
                                int min_segment_num, int max_segment_num,
                                bool zero_seg0_end_planes,
                                double* log_likelihood_ptr,
@@ -304,6 +384,8 @@ void distributable_computation(
     task_id=task_do_distributable_loglikelihood_computation;
   else if (RPC_process_related_viewgrams == &RPC_process_related_viewgrams_gradient)
     task_id=task_do_distributable_gradient_computation;
+  else if (RPC_process_related_viewgrams == &RPC_process_related_viewgrams_approximate_Hessian)
+    task_id=task_do_distributable_approximate_Hessian_computation;
       /* else if (RPC_process_related_viewgrams == &
 	case 
 	task_id=task_do_distributable_sensitivity_computation;break;
@@ -326,6 +408,7 @@ void distributable_computation(
                                               proj_dat_ptr,
                                               read_from_proj_dat,
                                               subset_num,  num_subsets,
+                                              subset_scheme,
                                               min_segment_num,  max_segment_num,
                                               zero_seg0_end_planes,
                                               log_likelihood_ptr,
@@ -390,10 +473,13 @@ void distributable_computation(
   if (zero_seg0_end_planes)
     info("End-planes of segment 0 will be zeroed");
 
-  const std::vector<ViewSegmentNumbers> vs_nums_to_process = 
-    detail::find_basic_vs_nums_in_subset(*proj_dat_ptr->get_proj_data_info_ptr(), *symmetries_ptr,
-                                         min_segment_num, max_segment_num,
-                                         subset_num, num_subsets);
+  std::vector<ViewSegmentNumbers> vs_nums_to_process = 
+    subset_scheme.find_basic_vs_nums_in_subset(*proj_dat_ptr->get_proj_data_info_ptr(), *symmetries_ptr,
+                                               min_segment_num, max_segment_num,
+                                               subset_num, num_subsets);
+  // hand out the largest tasks first
+  DistributableScheduler& scheduler = get_scheduler(RPC_process_related_viewgrams);
+  scheduler.sort_by_estimated_cost(vs_nums_to_process, *proj_dat_ptr->get_proj_data_info_ptr(), *symmetries_ptr);
         
   int count=0, count2=0;
   
@@ -405,10 +491,183 @@ void distributable_computation(
   //double total_seq_rpc_time=0.0; //sums up times used for RPC_process_related_viewgrams
 
 #ifdef STIR_OPENMP
-  std::vector< shared_ptr<DiscretisedDensity<3,float> > > local_output_image_sptrs;
+  shared_ptr<ThreadLocalImages> local_output_images_sptr;
+  if (output_image_ptr != NULL)
+    local_output_images_sptr.reset(new ThreadLocalImages(*output_image_ptr));
   std::vector<double> local_log_likelihoods;
   std::vector<int> local_counts, local_count2s;
-#pragma omp parallel shared(local_output_image_sptrs, local_log_likelihoods, local_counts, local_count2s)
+#endif
+#if defined(STIR_OPENMP) && !defined(STIR_MPI)
+  /* If all projection data can be read by several threads at the same time, every thread
+     gets a queue of tasks from the DistributableScheduler, and steals tasks from the other
+     threads when its own queue is empty. The data are read by the tasks themselves.
+     The multiplicative factors are computed in a critical section, as BinNormalisation
+     does not guarantee that this is thread-safe.
+
+     Otherwise, one thread reads the viewgrams (and computes the normalisation factors) in
+     order of decreasing cost, and creates a task for every set of related viewgrams. The
+     other threads process these tasks. Reading therefore overlaps with the computations.
+     To limit memory use, at most 2 sets of viewgrams per thread are read ahead. When that
+     many tasks are pending, the reading thread processes the viewgrams it has just read
+     itself, instead of waiting.
+
+     In both cases, the time needed for every set of related viewgrams is passed to the
+     scheduler to estimate the costs for the next call, and the idle time of every
+     thread is reported.
+  */
+  const bool read_in_tasks =
+    proj_dat_ptr->supports_concurrent_read() &&
+    (is_null_ptr(binwise_correction) || binwise_correction->supports_concurrent_read());
+  local_log_likelihoods.resize(omp_get_max_threads(), 0.);
+  local_counts.resize(omp_get_max_threads(), 0);
+  local_count2s.resize(omp_get_max_threads(), 0);
+  std::vector<double> busy_times(omp_get_max_threads(), 0.);
+  std::vector<double> task_times(vs_nums_to_process.size(), 0.);
+  int num_threads_used = 1;
+  const double start_of_loop_time = omp_get_wtime();
+  if (read_in_tasks)
+    {
+      const std::vector<double> estimated_costs =
+        scheduler.get_estimated_costs(vs_nums_to_process, *proj_dat_ptr->get_proj_data_info_ptr(), *symmetries_ptr);
+#pragma omp parallel shared(local_output_images_sptr, local_log_likelihoods, local_counts, local_count2s, busy_times, task_times, num_threads_used)
+      {
+#pragma omp single
+        {
+          num_threads_used = omp_get_num_threads();
+          std::cerr << "Starting loop with " << num_threads_used << " threads\n"; 
+          scheduler.start(estimated_costs, num_threads_used);
+        } // implicit barrier
+        const int thread_num=omp_get_thread_num();
+        int task_num;
+        while (scheduler.get_next_task(task_num, thread_num))
+          {
+            const double start_of_task_time = omp_get_wtime();
+            const ViewSegmentNumbers view_segment_num=vs_nums_to_process[task_num];
+
+            shared_ptr<RelatedViewgrams<float> > y;
+            shared_ptr<RelatedViewgrams<float> > additive_binwise_correction_viewgrams;
+            shared_ptr<RelatedViewgrams<float> > mult_viewgrams_sptr;
+
+#pragma omp critical(MULT)
+            get_mult_viewgrams(mult_viewgrams_sptr, proj_dat_ptr, normalisation_sptr,
+                               start_time_of_frame, end_time_of_frame,
+                               symmetries_ptr, view_segment_num);
+            get_data_viewgrams(y, additive_binwise_correction_viewgrams,
+                               proj_dat_ptr, read_from_proj_dat, binwise_correction,
+                               symmetries_ptr, view_segment_num);
+            if (view_segment_num.segment_num()==0 && zero_seg0_end_planes)
+              {
+                zero_end_sinograms(y);
+                zero_end_sinograms(additive_binwise_correction_viewgrams);
+                zero_end_sinograms(mult_viewgrams_sptr);
+              }
+
+            info(boost::format("Thread %d/%d calculating segment_num: %d, view_num: %d")
+                 % thread_num % omp_get_num_threads()
+                 % view_segment_num.segment_num() % view_segment_num.view_num());
+            RPC_process_related_viewgrams(forward_projector_ptr,
+                                          back_projector_ptr,
+                                          is_null_ptr(local_output_images_sptr)? NULL : &local_output_images_sptr->get_local_image(),
+                                          input_image_ptr, y.get(), 
+                                          local_counts[thread_num], local_count2s[thread_num], 
+                                          is_null_ptr(log_likelihood_ptr)? NULL : &local_log_likelihoods[thread_num], 
+                                          additive_binwise_correction_viewgrams.get(),
+                                          mult_viewgrams_sptr.get());
+            task_times[task_num] = omp_get_wtime() - start_of_task_time;
+            busy_times[thread_num] += task_times[task_num];
+          }
+      } // end of parallel section of openmp
+    }
+  else
+    {
+      const int max_num_pending_tasks = 2*omp_get_max_threads();
+      int num_pending_tasks = 0;
+#pragma omp parallel shared(local_output_images_sptr, local_log_likelihoods, local_counts, local_count2s, num_pending_tasks, busy_times, task_times, num_threads_used)
+      {
+#pragma omp single
+        {
+          num_threads_used = omp_get_num_threads();
+          std::cerr << "Starting loop with " << num_threads_used << " threads\n"; 
+          for (int i=0; i<static_cast<int>(vs_nums_to_process.size()); ++i)
+            {
+              const ViewSegmentNumbers view_segment_num=vs_nums_to_process[i];
+
+              const double start_of_read_time = omp_get_wtime();
+              shared_ptr<RelatedViewgrams<float> > y;
+              shared_ptr<RelatedViewgrams<float> > additive_binwise_correction_viewgrams;
+              shared_ptr<RelatedViewgrams<float> > mult_viewgrams_sptr;
+
+              get_viewgrams(y, additive_binwise_correction_viewgrams, mult_viewgrams_sptr,
+                            proj_dat_ptr, read_from_proj_dat,
+                            zero_seg0_end_planes,
+                            binwise_correction,
+                            normalisation_sptr, start_time_of_frame, end_time_of_frame,
+                            symmetries_ptr, view_segment_num);
+              const double read_time = omp_get_wtime() - start_of_read_time;
+              busy_times[omp_get_thread_num()] += read_time;
+
+              // If too many tasks are waiting, this thread executes the task itself
+              // (the task is undeferred) before reading the next viewgrams.
+              int current_num_pending_tasks;
+#pragma omp atomic read
+              current_num_pending_tasks = num_pending_tasks;
+              const bool defer_task = current_num_pending_tasks < max_num_pending_tasks;
+#pragma omp atomic
+              ++num_pending_tasks;
+#pragma omp task if(defer_task) firstprivate(y, additive_binwise_correction_viewgrams, mult_viewgrams_sptr, view_segment_num, i, read_time)
+              {
+                const double start_of_task_time = omp_get_wtime();
+                const int thread_num=omp_get_thread_num();
+                info(boost::format("Thread %d/%d calculating segment_num: %d, view_num: %d")
+                     % thread_num % omp_get_num_threads()
+                     % view_segment_num.segment_num() % view_segment_num.view_num());
+                RPC_process_related_viewgrams(forward_projector_ptr,
+                                              back_projector_ptr,
+                                              is_null_ptr(local_output_images_sptr)? NULL : &local_output_images_sptr->get_local_image(),
+                                              input_image_ptr, y.get(), 
+                                              local_counts[thread_num], local_count2s[thread_num], 
+                                              is_null_ptr(log_likelihood_ptr)? NULL : &local_log_likelihoods[thread_num], 
+                                              additive_binwise_correction_viewgrams.get(),
+                                              mult_viewgrams_sptr.get());
+                const double process_time = omp_get_wtime() - start_of_task_time;
+                task_times[i] = read_time + process_time;
+                busy_times[thread_num] += process_time;
+#pragma omp atomic
+                --num_pending_tasks;
+              } // end of task
+            } // end of for-loop 
+        } // end of single (all tasks are finished at the implicit barrier)
+      } // end of parallel section of openmp
+    }
+
+  // update the cost model and report idle times
+  {
+    const double loop_time = omp_get_wtime() - start_of_loop_time;
+    for (unsigned int i=0; i<vs_nums_to_process.size(); ++i)
+      scheduler.set_measured_time(vs_nums_to_process[i], task_times[i],
+                                  DistributableScheduler::get_num_bins(vs_nums_to_process[i],
+                                                                       *proj_dat_ptr->get_proj_data_info_ptr(),
+                                                                       *symmetries_ptr));
+    std::ostringstream idle_times;
+    double max_idle_time = 0.;
+    for (int thread_num=0; thread_num<num_threads_used; ++thread_num)
+      {
+        const double idle_time = std::max(loop_time - busy_times[thread_num], 0.);
+        max_idle_time = std::max(max_idle_time, idle_time);
+        idle_times << ' ' << idle_time;
+      }
+    // only written for higher verbosity, as this is called for every subiteration
+    info(boost::format("distributable_computation: loop time %1%s, idle time per thread (s):%2%\n"
+                       "Maximum idle time %3%s, number of stolen tasks %4%")
+         % loop_time % idle_times.str() % max_idle_time
+         % (read_in_tasks ? scheduler.get_num_stolen_tasks() : 0),
+         2);
+  }
+
+#else // STIR_OPENMP && !STIR_MPI
+
+#ifdef STIR_OPENMP
+#pragma omp parallel shared(local_output_images_sptr, local_log_likelihoods, local_counts, local_count2s)
 #endif
   // start of threaded section if openmp
   { 
@@ -416,7 +675,6 @@ void distributable_computation(
 #pragma omp single
     {
       std::cerr << "Starting loop with " << omp_get_num_threads() << " threads\n"; 
-      local_output_image_sptrs.resize(omp_get_max_threads(), shared_ptr<DiscretisedDensity<3,float> >());
       local_log_likelihoods.resize(omp_get_max_threads(), 0.);
       local_counts.resize(omp_get_max_threads(), 0);
       local_count2s.resize(omp_get_max_threads(), 0);
@@ -473,15 +731,10 @@ void distributable_computation(
                % view_segment_num.segment_num() % view_segment_num.view_num());
 #endif
 #ifdef STIR_OPENMP
-          if (output_image_ptr != NULL)
-            {
-              if(is_null_ptr(local_output_image_sptrs[thread_num]))
-                local_output_image_sptrs[thread_num].reset(output_image_ptr->get_empty_copy());
-            }
-            
           RPC_process_related_viewgrams(forward_projector_ptr,
                                         back_projector_ptr,
-                                        local_output_image_sptrs[thread_num].get(), input_image_ptr, y.get(), 
+                                        is_null_ptr(local_output_images_sptr)? NULL : &local_output_images_sptr->get_local_image(),
+                                        input_image_ptr, y.get(), 
                                         local_counts[thread_num], local_count2s[thread_num], 
                                         is_null_ptr(log_likelihood_ptr)? NULL : &local_log_likelihoods[thread_num], 
                                         additive_binwise_correction_viewgrams.get(),
@@ -497,21 +750,17 @@ void distributable_computation(
 #endif // MPI
       } // end of for-loop 
   } // end of parallel section of openmp
+#endif // STIR_OPENMP && !STIR_MPI
   
 #ifdef STIR_OPENMP
   // "reduce" data constructed by threads
   {
-    if (output_image_ptr != NULL)
-      {
-        for (int i=0; i<static_cast<int>(local_output_image_sptrs.size()); ++i)
-	  if(!is_null_ptr(local_output_image_sptrs[i])) // only accumulate if a thread filled something in
-	    *output_image_ptr += *(local_output_image_sptrs[i]);
-      }
+    if (!is_null_ptr(local_output_images_sptr))
+      local_output_images_sptr->reduce();
     if (log_likelihood_ptr != NULL)
       {
-        for (int i=0; i<static_cast<int>(local_log_likelihoods.size()); ++i)
-	  if(!is_null_ptr(local_output_image_sptrs[i])) // only accumulate if a thread filled something in
-	    *log_likelihood_ptr += local_log_likelihoods[i];
+        // threads that did not do anything have 0 here
+        *log_likelihood_ptr += std::accumulate(local_log_likelihoods.begin(), local_log_likelihoods.end(), 0.);
       }
     count += std::accumulate(local_counts.begin(), local_counts.end(), 0);
     count2 += std::accumulate(local_count2s.begin(), local_count2s.end(), 0);
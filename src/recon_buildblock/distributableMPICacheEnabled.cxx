@@ -50,7 +50,7 @@
 #include "stir/recon_buildblock/ForwardProjectorByBin.h"
 #include "stir/recon_buildblock/BackProjectorByBin.h"
 #include "stir/recon_buildblock/BinNormalisation.h"
-#include "stir/recon_buildblock/find_basic_vs_nums_in_subsets.h"
+#include "stir/recon_buildblock/SubsetScheme.h"
 #include "stir/info.h"
 #ifdef STIR_MPI
 #include "stir/recon_buildblock/distributed_functions.h"
@@ -194,6 +194,7 @@ void distributable_computation_cache_enabled(
                                              const shared_ptr<ProjData>& proj_dat_ptr, 
                                              const bool read_from_proj_dat,
                                              int subset_num, int num_subsets,
+                                             const SubsetScheme& subset_scheme,
                                              int min_segment_num, int max_segment_num,
                                              bool zero_seg0_end_planes,
                                              double* log_likelihood_ptr,
@@ -253,9 +254,9 @@ void distributable_computation_cache_enabled(
   int count=0, count2=0;
         
   const std::vector<ViewSegmentNumbers> vs_nums_to_process = 
-    detail::find_basic_vs_nums_in_subset(*proj_dat_ptr->get_proj_data_info_ptr(), *symmetries_ptr,
-                                         min_segment_num, max_segment_num,
-                                         subset_num, num_subsets);
+    subset_scheme.find_basic_vs_nums_in_subset(*proj_dat_ptr->get_proj_data_info_ptr(), *symmetries_ptr,
+                                               min_segment_num, max_segment_num,
+                                               subset_num, num_subsets);
   
   const std::size_t num_vs = vs_nums_to_process.size(); 
         
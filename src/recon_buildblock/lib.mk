@@ -22,9 +22,16 @@ $(dir)_LIB_SOURCES:= ForwardProjectorByBin.cxx \
 	SymmetryOperation.cxx \
 	SymmetryOperations_PET_CartesianGrid.cxx \
 	find_basic_vs_nums_in_subset.cxx \
+	SubsetScheme.cxx \
+	InterleavedSubsetScheme.cxx \
+	BalancedSubsetScheme.cxx \
 	ProjMatrixElemsForOneBin.cxx \
 	ProjMatrixElemsForOneDensel.cxx \
 	ProjMatrixByBin.cxx \
+	ProjMatrixByBinCompressedCache.cxx \
+	ProjMatrixByBinConcurrentCache.cxx \
+	ThreadLocalImages.cxx \
+	DistributableScheduler.cxx \
 	ProjMatrixByBinUsingRayTracing.cxx \
 	ProjMatrixByBinUsingInterpolation.cxx \
 	ProjMatrixByBinFromFile.cxx \
@@ -45,6 +52,7 @@ $(dir)_LIB_SOURCES:= ForwardProjectorByBin.cxx \
 	FourierRebinning.cxx \
 	GeneralisedPrior.cxx \
 	QuadraticPrior.cxx \
+	NeighbourhoodPrior.cxx \
 	FilterRootPrior.cxx \
 	GeneralisedObjectiveFunction.cxx \
 	PoissonLogLikelihoodWithLinearModelForMean.cxx \
@@ -3,6 +3,17 @@
 dir := recon_test
 
 $(dir)_TEST_SOURCES := test_DataSymmetriesForBins_PET_CartesianGrid.cxx \
+  test_ProjMatrixByBinCaches.cxx \
+  test_ProjMatrixByBinFromFile.cxx \
+  test_ThreadLocalImages.cxx \
+  test_QuadraticPrior.cxx \
+  test_NeighbourhoodPrior.cxx \
+  test_SubsetScheme.cxx \
+  test_DistributableScheduler.cxx \
+  test_FourierRebinning.cxx \
+  test_RampFilter.cxx \
+  test_ListModeData.cxx \
+  test_PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin.cxx \
   test_PoissonLogLikelihoodWithLinearModelForMeanAndProjData.cxx
 
 
@@ -0,0 +1,370 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for stir::DistributableScheduler
+
+  Tests
+  - the cost estimates with and without measured times
+  - that the tasks are distributed over the queues with balanced costs
+  - that every task is handed out exactly once, also when tasks are stolen
+    and when using several threads
+  - that distributable_computation processes all data exactly once, also with
+    projection data that cannot be read concurrently and a single thread
+*/
+
+#include "stir/recon_buildblock/DistributableScheduler.h"
+#include "stir/recon_buildblock/DataSymmetriesForBins_PET_CartesianGrid.h"
+#include "stir/recon_buildblock/distributable.h"
+#include "stir/recon_buildblock/InterleavedSubsetScheme.h"
+#include "stir/RelatedViewgrams.h"
+#include "stir/ProjDataInMemory.h"
+#include "stir/ExamInfo.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/VoxelsOnCartesianGrid.h"
+#include "stir/Scanner.h"
+#include "stir/RunTests.h"
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for DistributableScheduler
+*/
+class DistributableSchedulerTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  void test_costs(const ProjDataInfo& proj_data_info,
+                  const DataSymmetriesForViewSegmentNumbers& symmetries,
+                  const std::vector<ViewSegmentNumbers>& vs_nums);
+  void test_queues();
+  void test_distributable_computation(const shared_ptr<ProjDataInfo>& proj_data_info_sptr,
+                                      const shared_ptr<DiscretisedDensity<3,float> >& density_sptr);
+  //! check that every task in 0,1,...,num_tasks-1 occurs once in \a handed_out
+  void check_all_tasks_once(const std::vector<int>& handed_out, const int num_tasks);
+};
+
+void
+DistributableSchedulerTests::
+check_all_tasks_once(const std::vector<int>& handed_out, const int num_tasks)
+{
+  std::vector<int> count(num_tasks, 0);
+  for (unsigned int i=0; i<handed_out.size(); ++i)
+    {
+      check(handed_out[i]>=0 && handed_out[i]<num_tasks, "task number should be in range");
+      if (handed_out[i]>=0 && handed_out[i]<num_tasks)
+        ++count[handed_out[i]];
+    }
+  for (int task_num=0; task_num<num_tasks; ++task_num)
+    check_if_equal(count[task_num], 1, "every task should be handed out once");
+}
+
+void
+DistributableSchedulerTests::
+test_costs(const ProjDataInfo& proj_data_info,
+           const DataSymmetriesForViewSegmentNumbers& symmetries,
+           const std::vector<ViewSegmentNumbers>& vs_nums)
+{
+  DistributableScheduler scheduler;
+  {
+    const std::vector<double> costs = scheduler.get_estimated_costs(vs_nums, proj_data_info, symmetries);
+    for (unsigned int i=0; i<vs_nums.size(); ++i)
+      check_if_equal(costs[i],
+                     static_cast<double>(DistributableScheduler::get_num_bins(vs_nums[i], proj_data_info, symmetries)),
+                     "without measurements, the cost should be the number of bins");
+
+    std::vector<ViewSegmentNumbers> sorted_vs_nums(vs_nums);
+    scheduler.sort_by_estimated_cost(sorted_vs_nums, proj_data_info, symmetries);
+    const std::vector<double> sorted_costs =
+      scheduler.get_estimated_costs(sorted_vs_nums, proj_data_info, symmetries);
+    for (unsigned int i=1; i<sorted_vs_nums.size(); ++i)
+      {
+        check(sorted_costs[i-1] >= sorted_costs[i], "costs should be sorted in decreasing order");
+        if (sorted_costs[i-1] == sorted_costs[i])
+          check(std::find(vs_nums.begin(), vs_nums.end(), sorted_vs_nums[i-1]) <
+                std::find(vs_nums.begin(), vs_nums.end(), sorted_vs_nums[i]),
+                "order for equal costs should be preserved");
+      }
+  }
+  {
+    // measure the first half, with a time per bin of 2 microseconds, except for 1 task
+    // which is much slower
+    const unsigned int num_measured = static_cast<unsigned int>(vs_nums.size()/2);
+    for (unsigned int i=0; i<num_measured; ++i)
+      {
+        const long num_bins = DistributableScheduler::get_num_bins(vs_nums[i], proj_data_info, symmetries);
+        scheduler.set_measured_time(vs_nums[i], 2.E-6*num_bins, num_bins);
+      }
+    const long slow_num_bins = DistributableScheduler::get_num_bins(vs_nums[0], proj_data_info, symmetries);
+    scheduler.set_measured_time(vs_nums[0], 1000., slow_num_bins);
+    double total_measured_time = 1000.;
+    double total_num_bins = static_cast<double>(slow_num_bins);
+    for (unsigned int i=1; i<num_measured; ++i)
+      {
+        const long num_bins = DistributableScheduler::get_num_bins(vs_nums[i], proj_data_info, symmetries);
+        total_measured_time += 2.E-6*num_bins;
+        total_num_bins += num_bins;
+      }
+
+    const std::vector<double> costs = scheduler.get_estimated_costs(vs_nums, proj_data_info, symmetries);
+    check_if_equal(costs[0], 1000., "measured time should be used as cost");
+    for (unsigned int i=1; i<vs_nums.size(); ++i)
+      {
+        const long num_bins = DistributableScheduler::get_num_bins(vs_nums[i], proj_data_info, symmetries);
+        if (i<num_measured)
+          check_if_equal(costs[i], 2.E-6*num_bins, "measured time should be used as cost");
+        else
+          check_if_equal(costs[i], total_measured_time/total_num_bins*num_bins,
+                         "unmeasured cost should use the average time per bin");
+      }
+    std::vector<ViewSegmentNumbers> sorted_vs_nums(vs_nums);
+    scheduler.sort_by_estimated_cost(sorted_vs_nums, proj_data_info, symmetries);
+    check(sorted_vs_nums[0] == vs_nums[0], "slowest task should be first");
+
+    scheduler.clear();
+    check_if_equal(scheduler.get_estimated_costs(vs_nums, proj_data_info, symmetries)[0],
+                   static_cast<double>(slow_num_bins),
+                   "measurements should be forgotten after clear()");
+  }
+}
+
+void
+DistributableSchedulerTests::
+test_queues()
+{
+  DistributableScheduler scheduler;
+  std::vector<double> costs;
+  costs.push_back(5.); costs.push_back(4.); costs.push_back(3.);
+  costs.push_back(3.); costs.push_back(2.); costs.push_back(1.);
+  const int num_tasks = static_cast<int>(costs.size());
+  {
+    // greedy distribution gives queues {0,3,5} and {1,2,4}, each with cost 9
+    scheduler.start(costs, 2);
+    std::vector<int> handed_out;
+    int task_num;
+    check(scheduler.get_next_task(task_num, 0), "worker 0 should get a task");
+    check_if_equal(task_num, 0, "worker 0 should start with the largest task");
+    handed_out.push_back(task_num);
+    check(scheduler.get_next_task(task_num, 1), "worker 1 should get a task");
+    check_if_equal(task_num, 1, "worker 1 should start with its largest task");
+    handed_out.push_back(task_num);
+    check(scheduler.get_next_task(task_num, 0), "worker 0 should get a task");
+    check_if_equal(task_num, 3, "worker 0 should continue with its own queue");
+    handed_out.push_back(task_num);
+    check(scheduler.get_next_task(task_num, 0), "worker 0 should get a task");
+    check_if_equal(task_num, 5, "worker 0 should continue with its own queue");
+    handed_out.push_back(task_num);
+    check_if_equal(scheduler.get_num_stolen_tasks(), 0, "no tasks should have been stolen yet");
+    // worker 0 has finished its queue and steals the smallest remaining task of worker 1
+    check(scheduler.get_next_task(task_num, 0), "worker 0 should steal a task");
+    check_if_equal(task_num, 4, "worker 0 should steal the smallest task");
+    handed_out.push_back(task_num);
+    check_if_equal(scheduler.get_num_stolen_tasks(), 1, "1 task should have been stolen");
+    check(scheduler.get_next_task(task_num, 1), "worker 1 should get a task");
+    check_if_equal(task_num, 2, "worker 1 should get its remaining task");
+    handed_out.push_back(task_num);
+    check(!scheduler.get_next_task(task_num, 0), "no tasks should be left");
+    check(!scheduler.get_next_task(task_num, 1), "no tasks should be left");
+    check_all_tasks_once(handed_out, num_tasks);
+  }
+  {
+    // a single worker steals all tasks of the others
+    scheduler.start(costs, 3);
+    std::vector<int> handed_out;
+    int task_num;
+    while (scheduler.get_next_task(task_num, 2))
+      handed_out.push_back(task_num);
+    check_all_tasks_once(handed_out, num_tasks);
+    check_if_equal(scheduler.get_num_stolen_tasks(), 4, "worker 2 should have stolen the tasks of the other queues");
+  }
+#ifdef STIR_OPENMP
+  {
+    std::vector<double> many_costs(1000);
+    for (unsigned int i=0; i<many_costs.size(); ++i)
+      many_costs[i] = 1000. - i;
+    std::vector<std::vector<int> > handed_out_by_thread(omp_get_max_threads());
+#pragma omp parallel shared(handed_out_by_thread, many_costs)
+    {
+#pragma omp single
+      scheduler.start(many_costs, omp_get_num_threads());
+      const int thread_num = omp_get_thread_num();
+      int task_num;
+      while (scheduler.get_next_task(task_num, thread_num))
+        handed_out_by_thread[thread_num].push_back(task_num);
+    }
+    std::vector<int> handed_out;
+    for (unsigned int i=0; i<handed_out_by_thread.size(); ++i)
+      handed_out.insert(handed_out.end(), handed_out_by_thread[i].begin(), handed_out_by_thread[i].end());
+    check_all_tasks_once(handed_out, static_cast<int>(many_costs.size()));
+  }
+#endif
+}
+
+//! call-back for distributable_computation that sums all data in the viewgrams
+static void
+RPC_sum_viewgrams(const shared_ptr<ForwardProjectorByBin>&,
+                  const shared_ptr<BackProjectorByBin>&,
+                  DiscretisedDensity<3,float>*,
+                  const DiscretisedDensity<3,float>*,
+                  RelatedViewgrams<float>* measured_viewgrams_ptr,
+                  int& count, int&, double* sum_ptr,
+                  const RelatedViewgrams<float>*,
+                  const RelatedViewgrams<float>*)
+{
+  for (RelatedViewgrams<float>::const_iterator iter = measured_viewgrams_ptr->begin();
+       iter != measured_viewgrams_ptr->end();
+       ++iter)
+    *sum_ptr += iter->sum();
+  ++count;
+}
+
+void
+DistributableSchedulerTests::
+test_distributable_computation(const shared_ptr<ProjDataInfo>& proj_data_info_sptr,
+                               const shared_ptr<DiscretisedDensity<3,float> >& density_sptr)
+{
+  cerr << "\tTesting distributable_computation\n";
+  shared_ptr<ExamInfo> exam_info_sptr(new ExamInfo);
+  // ProjDataInMemory does not support concurrent reads, such that one thread reads
+  // the data and creates the tasks
+  shared_ptr<ProjData> proj_data_sptr(new ProjDataInMemory(exam_info_sptr, proj_data_info_sptr));
+  proj_data_sptr->fill(1.F);
+  check(!proj_data_sptr->supports_concurrent_read(), "ProjDataInMemory should not support concurrent reads");
+  double total_num_bins = 0.;
+  for (int segment_num = proj_data_info_sptr->get_min_segment_num();
+       segment_num <= proj_data_info_sptr->get_max_segment_num();
+       ++segment_num)
+    total_num_bins +=
+      static_cast<double>(proj_data_info_sptr->get_num_axial_poss(segment_num)) *
+      proj_data_info_sptr->get_num_views() * proj_data_info_sptr->get_num_tangential_poss();
+
+  shared_ptr<DataSymmetriesForViewSegmentNumbers>
+    symmetries_sptr(new DataSymmetriesForBins_PET_CartesianGrid(proj_data_info_sptr, density_sptr));
+  const InterleavedSubsetScheme subset_scheme;
+  setup_distributable_computation(shared_ptr<ProjectorByBinPair>(), exam_info_sptr,
+                                  proj_data_info_sptr.get(), density_sptr,
+                                  /*zero_seg0_end_planes=*/false, /*distributed_cache_enabled=*/false);
+#ifdef STIR_OPENMP
+  const int org_num_threads = omp_get_max_threads();
+  // with a single thread, the reading thread has to process all tasks itself
+  omp_set_num_threads(1);
+#endif
+  // call twice, as the second call uses the measured times
+  for (int i=0; i<2; ++i)
+    {
+      double sum = 0.;
+      distributable_computation(shared_ptr<ForwardProjectorByBin>(), shared_ptr<BackProjectorByBin>(),
+                                symmetries_sptr,
+                                NULL, NULL,
+                                proj_data_sptr, /*read_from_proj_data=*/true,
+                                /*subset_num=*/0, /*num_subsets=*/1, subset_scheme,
+                                proj_data_info_sptr->get_min_segment_num(),
+                                proj_data_info_sptr->get_max_segment_num(),
+                                /*zero_seg0_end_planes=*/false,
+                                &sum,
+                                shared_ptr<ProjData>(), shared_ptr<BinNormalisation>(),
+                                0., 0.,
+                                &RPC_sum_viewgrams,
+                                NULL);
+      check_if_equal(sum, total_num_bins, "sum of all data processed by distributable_computation");
+    }
+#ifdef STIR_OPENMP
+  omp_set_num_threads(org_num_threads);
+  {
+    double sum = 0.;
+    distributable_computation(shared_ptr<ForwardProjectorByBin>(), shared_ptr<BackProjectorByBin>(),
+                              symmetries_sptr,
+                              NULL, NULL,
+                              proj_data_sptr, /*read_from_proj_data=*/true,
+                              /*subset_num=*/0, /*num_subsets=*/1, subset_scheme,
+                              proj_data_info_sptr->get_min_segment_num(),
+                              proj_data_info_sptr->get_max_segment_num(),
+                              /*zero_seg0_end_planes=*/false,
+                              &sum,
+                              shared_ptr<ProjData>(), shared_ptr<BinNormalisation>(),
+                              0., 0.,
+                              &RPC_sum_viewgrams,
+                              NULL);
+    check_if_equal(sum, total_num_bins, "sum of all data processed by distributable_computation (several threads)");
+  }
+#endif
+  end_distributable_computation();
+}
+
+void
+DistributableSchedulerTests::
+run_tests()
+{
+  cerr << "Tests for DistributableScheduler\n";
+  shared_ptr<Scanner> scanner_sptr(new Scanner(Scanner::E953));
+  shared_ptr<ProjDataInfo> proj_data_info_sptr(
+    ProjDataInfo::ProjDataInfoCTI(scanner_sptr,
+                                  /*span=*/3,
+                                  /*max_delta=*/12,
+                                  /*num_views=*/48,
+                                  /*num_tang_poss=*/16));
+  shared_ptr<DiscretisedDensity<3,float> >
+    density_sptr(new VoxelsOnCartesianGrid<float>(*proj_data_info_sptr));
+  const DataSymmetriesForBins_PET_CartesianGrid symmetries_for_bins(proj_data_info_sptr, density_sptr);
+  const DataSymmetriesForViewSegmentNumbers& symmetries = symmetries_for_bins;
+
+  std::vector<ViewSegmentNumbers> vs_nums;
+  for (int view_num = proj_data_info_sptr->get_min_view_num();
+       view_num <= proj_data_info_sptr->get_max_view_num();
+       ++view_num)
+    for (int segment_num = proj_data_info_sptr->get_min_segment_num();
+         segment_num <= proj_data_info_sptr->get_max_segment_num();
+         ++segment_num)
+      {
+        const ViewSegmentNumbers vs_num(view_num, segment_num);
+        if (symmetries.is_basic(vs_num))
+          vs_nums.push_back(vs_num);
+      }
+
+  test_costs(*proj_data_info_sptr, symmetries, vs_nums);
+  test_queues();
+  test_distributable_computation(proj_data_info_sptr, density_sptr);
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  DistributableSchedulerTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
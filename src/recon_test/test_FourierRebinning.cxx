@@ -0,0 +1,132 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for stir::FourierRebinning
+
+  Checks the geometry of the rebinned data: only segment 0 with 2*num_rings-1 planes,
+  the same tangential positions as the input, and a number of views that is
+  half of the next power of 2 larger than or equal to twice the number of input views.
+*/
+
+#include "stir/recon_buildblock/FourierRebinning.h"
+#include "stir/ProjDataInMemory.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/ExamInfo.h"
+#include "stir/Scanner.h"
+#include "stir/SegmentBySinogram.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include <iostream>
+#include <string>
+#include <cstdio>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+using std::string;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for FourierRebinning
+*/
+class FourierRebinningTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  void test_geometry(const int num_views, const int expected_num_rebinned_views);
+};
+
+void
+FourierRebinningTests::
+test_geometry(const int num_views, const int expected_num_rebinned_views)
+{
+  cerr << "\tTesting FORE with " << num_views << " views\n";
+  shared_ptr<Scanner> scanner_sptr(new Scanner(Scanner::E953));
+  shared_ptr<ProjDataInfo> proj_data_info_sptr(
+    ProjDataInfo::ProjDataInfoCTI(scanner_sptr,
+                                  /*span=*/1,
+                                  /*max_delta=*/3,
+                                  num_views,
+                                  /*num_tang_poss=*/32));
+  shared_ptr<ProjData> proj_data_sptr(new ProjDataInMemory(shared_ptr<ExamInfo>(new ExamInfo),
+                                                           proj_data_info_sptr));
+  proj_data_sptr->fill(1.F);
+
+  const string prefix = "test_FourierRebinning_output";
+  {
+    FourierRebinning fore;
+    fore.set_kmin(2);
+    fore.set_wmin(2);
+    fore.set_deltamin(1);
+    fore.set_kc(4);
+    fore.set_input_proj_data_sptr(proj_data_sptr);
+    fore.set_output_filename_prefix(prefix);
+    fore.set_max_segment_num_to_process(proj_data_info_sptr->get_max_segment_num());
+    if (!check(fore.set_up() == Succeeded::yes, "set_up of FORE"))
+      return;
+    check(fore.rebin() == Succeeded::yes, "FORE rebinning");
+  }
+  {
+    shared_ptr<ProjData> rebinned_proj_data_sptr = ProjData::read_from_file(prefix + ".hs");
+    check_if_equal(rebinned_proj_data_sptr->get_min_segment_num(), 0, "min segment number of rebinned data");
+    check_if_equal(rebinned_proj_data_sptr->get_max_segment_num(), 0, "max segment number of rebinned data");
+    check_if_equal(rebinned_proj_data_sptr->get_num_views(), expected_num_rebinned_views,
+                   "number of views of rebinned data");
+    check_if_equal(rebinned_proj_data_sptr->get_num_axial_poss(0), 2*scanner_sptr->get_num_rings()-1,
+                   "number of planes of rebinned data");
+    check_if_equal(rebinned_proj_data_sptr->get_num_tangential_poss(), proj_data_sptr->get_num_tangential_poss(),
+                   "number of tangential positions of rebinned data");
+    const SegmentBySinogram<float> segment = rebinned_proj_data_sptr->get_segment_by_sinogram(0);
+    check(segment.find_max() > 0.F, "rebinned data should not be zero");
+  }
+  std::remove((prefix + ".hs").c_str());
+  std::remove((prefix + ".s").c_str());
+  std::remove((prefix + ".log").c_str());
+}
+
+void
+FourierRebinningTests::
+run_tests()
+{
+  cerr << "Tests for FourierRebinning\n";
+  // 2*12 views are interpolated to 32
+  test_geometry(12, 16);
+  test_geometry(16, 16);
+  // 2*20 views are interpolated to 64
+  test_geometry(20, 32);
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  FourierRebinningTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
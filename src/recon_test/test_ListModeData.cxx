@@ -0,0 +1,427 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for list mode data classes: stir::ListModeEventCache and
+  the time index of stir::CListModeData
+
+  Events are generated by a small list mode data class in this file (with
+  bins that have weights, some invalid events and several time records).
+
+  For ListModeEventCache, the test checks that the events read back from the cache are
+  the same as the ones that were put in, and that the time ranges are correct
+  (including at the start and end of the data).
+
+  For the time index, the test checks that CListModeData::set_get_position_for_time()
+  positions just after a time record at or before the requested time, that an index
+  written to file gives the same positions when read back, and that the file is
+  rejected once the list mode data have changed.
+*/
+
+#include "stir/listmode/ListModeEventCache.h"
+#include "stir/listmode/CListModeData.h"
+#include "stir/listmode/CListRecord.h"
+#include "stir/LORCoordinates.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/Scanner.h"
+#include "stir/Bin.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+using std::ofstream;
+using std::vector;
+using std::string;
+#endif
+
+START_NAMESPACE_STIR
+
+namespace {
+  //! event that returns a fixed bin
+  class TestEvent : public CListEvent
+  {
+  public:
+    Bin bin;
+    bool prompt;
+    virtual bool is_prompt() const { return this->prompt; }
+    virtual LORAs2Points<float> get_LOR() const { return LORAs2Points<float>(); }
+    virtual void get_bin(Bin& bin, const ProjDataInfo&) const { bin = this->bin; }
+  };
+
+  class TestTime : public CListTime
+  {
+  public:
+    unsigned long time_in_millisecs;
+    virtual unsigned long get_time_in_millisecs() const { return this->time_in_millisecs; }
+    virtual Succeeded set_time_in_millisecs(const unsigned long time_in_millisecs)
+    { this->time_in_millisecs = time_in_millisecs; return Succeeded::yes; }
+  };
+
+  class TestRecord : public CListRecord
+  {
+  public:
+    bool is_time_record;
+    TestEvent test_event;
+    TestTime test_time;
+    virtual bool is_time() const { return this->is_time_record; }
+    virtual bool is_event() const { return !this->is_time_record; }
+    virtual CListEvent& event() { return this->test_event; }
+    virtual const CListEvent& event() const { return this->test_event; }
+    virtual CListTime& time() { return this->test_time; }
+    virtual const CListTime& time() const { return this->test_time; }
+    virtual bool operator==(const CListRecord&) const { return false; }
+  };
+
+  //! list mode data in memory, as a sequence of TestRecord objects
+  class TestListModeData : public CListModeData
+  {
+  public:
+    TestListModeData() : name("test"), current_record_num(0) {}
+    vector<TestRecord> records;
+    //! file name used for the signature of the data (the records are not read from it)
+    string name;
+    virtual std::string get_name() const { return this->name; }
+    virtual shared_ptr<CListRecord> get_empty_record_sptr() const
+    { return shared_ptr<CListRecord>(new TestRecord); }
+    virtual Succeeded get_next_record(CListRecord& record) const
+    {
+      if (this->current_record_num >= this->records.size())
+        return Succeeded::no;
+      dynamic_cast<TestRecord&>(record) = this->records[this->current_record_num++];
+      return Succeeded::yes;
+    }
+    virtual Succeeded reset() { this->current_record_num = 0; return Succeeded::yes; }
+    virtual SavedPosition save_get_position()
+    { return static_cast<SavedPosition>(this->current_record_num); }
+    virtual Succeeded set_get_position(const SavedPosition& position)
+    { this->current_record_num = position; return Succeeded::yes; }
+    virtual bool has_delayeds() const { return true; }
+    //! number of the record that will be read next
+    std::size_t get_current_record_num() const { return this->current_record_num; }
+  protected:
+    //! the record number is used as stream position
+    virtual Succeeded
+      get_stream_positions(vector<std::streampos>& stream_positions,
+                           const vector<SavedPosition>& saved_positions) const
+    {
+      stream_positions.resize(saved_positions.size());
+      for (std::size_t i=0; i<saved_positions.size(); ++i)
+        stream_positions[i] = std::streampos(std::streamoff(saved_positions[i]));
+      return Succeeded::yes;
+    }
+    virtual Succeeded
+      save_stream_positions(vector<SavedPosition>& saved_positions,
+                            const vector<std::streampos>& stream_positions)
+    {
+      saved_positions.resize(stream_positions.size());
+      for (std::size_t i=0; i<stream_positions.size(); ++i)
+        saved_positions[i] = static_cast<SavedPosition>(std::streamoff(stream_positions[i]));
+      return Succeeded::yes;
+    }
+  private:
+    mutable std::size_t current_record_num;
+  };
+}
+
+/*!
+  \ingroup test
+  \brief Test class for ListModeEventCache and the time index of CListModeData
+*/
+class ListModeDataTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  //! fill the cache and check if all valid events in \a lm_data can be read back
+  void test_events(ListModeEventCache& cache, TestListModeData& lm_data);
+  //! build, write and read the time index of \a lm_data
+  void test_time_index(TestListModeData& lm_data);
+  //! check the positions found with the time index of \a lm_data
+  /*! \a record_nums is filled with the record number found for every time that is tested. */
+  void test_positions_for_time(TestListModeData& lm_data, vector<std::size_t>& record_nums);
+};
+
+void
+ListModeDataTests::
+test_events(ListModeEventCache& cache, TestListModeData& lm_data)
+{
+  check(cache.fill(lm_data) == Succeeded::yes, "fill");
+
+  // find the valid events and their times
+  vector<Bin> valid_bins;
+  vector<bool> valid_prompts;
+  vector<double> valid_times;
+  double time = 0;
+  for (std::size_t i=0; i<lm_data.records.size(); ++i)
+    {
+      const TestRecord& record = lm_data.records[i];
+      if (record.is_time())
+        time = record.time().get_time_in_secs();
+      else if (record.test_event.bin.get_bin_value() > 0)
+        {
+          valid_bins.push_back(record.test_event.bin);
+          valid_prompts.push_back(record.test_event.prompt);
+          valid_times.push_back(time);
+        }
+    }
+  if (!check_if_equal(cache.get_num_events(), valid_bins.size(), "number of events"))
+    return;
+
+  Bin bin;
+  for (std::size_t i=0; i<valid_bins.size(); ++i)
+    {
+      cache.get_bin(bin, i);
+      check(bin == valid_bins[i], "bin coordinates");
+      check_if_equal(bin.get_bin_value(), valid_bins[i].get_bin_value(), "bin value");
+      check(cache.is_prompt(i) == valid_prompts[i], "prompt");
+    }
+
+  // time intervals
+  const double intervals[][2] =
+    { {0., .5}, {0., 1.}, {.5, 2.}, {1., 3.}, {2.5, 100.}, {3., 100.}, {100., 200.}, {0., 100.} };
+  const int num_intervals = sizeof(intervals)/sizeof(intervals[0]);
+  for (int i=0; i<num_intervals; ++i)
+    {
+      const double start_time = intervals[i][0];
+      const double end_time = intervals[i][1];
+      std::size_t begin_index, end_index;
+      cache.get_event_range_for_time_interval(begin_index, end_index, start_time, end_time);
+      std::size_t expected_begin_index = 0;
+      while (expected_begin_index < valid_times.size() && valid_times[expected_begin_index] < start_time)
+        ++expected_begin_index;
+      std::size_t expected_end_index = expected_begin_index;
+      while (expected_end_index < valid_times.size() && valid_times[expected_end_index] < end_time)
+        ++expected_end_index;
+      check_if_equal(begin_index, expected_begin_index, "start of time interval");
+      check_if_equal(end_index, expected_end_index, "end of time interval");
+    }
+}
+
+void
+ListModeDataTests::
+run_tests()
+{
+  cerr << "Tests for ListModeEventCache\n";
+
+  shared_ptr<Scanner> scanner_sptr(new Scanner(Scanner::E953));
+  shared_ptr<ProjDataInfo>
+    proj_data_info_sptr(ProjDataInfo::ProjDataInfoCTI(scanner_sptr,
+                                                      /*span=*/1, /*max_delta=*/3,
+                                                      /*num_views=*/8, /*num_tangential_poss=*/16,
+                                                      /*arc_corrected=*/false));
+  const ProjDataInfo& proj_data_info = *proj_data_info_sptr;
+
+  TestListModeData lm_data;
+  {
+    // events in every segment, including the first and last bin of the data, with a
+    // time record every 10 events (but none at the start, and a few without events)
+    TestRecord record;
+    int event_num = 0;
+    for (int segment_num=proj_data_info.get_min_segment_num();
+         segment_num<=proj_data_info.get_max_segment_num();
+         ++segment_num)
+      for (int axial_pos_num=proj_data_info.get_min_axial_pos_num(segment_num);
+           axial_pos_num<=proj_data_info.get_max_axial_pos_num(segment_num);
+           axial_pos_num += 2)
+        for (int view_num=proj_data_info.get_min_view_num();
+             view_num<=proj_data_info.get_max_view_num();
+             view_num += 3)
+          {
+            const int tangential_pos_num =
+              view_num%2 == 0 ? proj_data_info.get_min_tangential_pos_num() : proj_data_info.get_max_tangential_pos_num();
+            record.is_time_record = false;
+            record.test_event.bin = Bin(segment_num, view_num, axial_pos_num, tangential_pos_num, 1.F);
+            record.test_event.prompt = event_num%4 != 0;
+            // some invalid events, which should be skipped
+            if (event_num%7 == 3)
+              record.test_event.bin.set_bin_value(event_num%2 == 0 ? 0.F : -1.F);
+            lm_data.records.push_back(record);
+            ++event_num;
+            if (event_num%10 == 0)
+              {
+                record.is_time_record = true;
+                record.test_time.set_time_in_millisecs(static_cast<unsigned long>(event_num/10)*500);
+                lm_data.records.push_back(record);
+                if (event_num%30 == 0)
+                  lm_data.records.push_back(record); // same time again
+              }
+          }
+    // last events: the one for the last bin, and a time record without events
+    record.is_time_record = false;
+    record.test_event.bin =
+      Bin(proj_data_info.get_max_segment_num(), proj_data_info.get_max_view_num(),
+          proj_data_info.get_max_axial_pos_num(proj_data_info.get_max_segment_num()),
+          proj_data_info.get_max_tangential_pos_num(), 1.F);
+    lm_data.records.push_back(record);
+    record.is_time_record = true;
+    record.test_time.set_time_in_millisecs(static_cast<unsigned long>(event_num/10+1)*500);
+    lm_data.records.push_back(record);
+  }
+
+  ListModeEventCache cache(proj_data_info_sptr);
+  cerr << "\tTesting events with weight 1\n";
+  test_events(cache, lm_data);
+  const std::size_t memory_usage_without_weights = cache.get_memory_usage_in_bytes();
+
+  cerr << "\tTesting events with weights\n";
+  // start with a few events with weight 1, such that values have to be filled in
+  for (std::size_t i=10; i<lm_data.records.size(); ++i)
+    {
+      Bin& bin = lm_data.records[i].test_event.bin;
+      if (bin.get_bin_value() > 0)
+        bin.set_bin_value(.5F + i%5);
+    }
+  test_events(cache, lm_data);
+  check(cache.get_memory_usage_in_bytes() > memory_usage_without_weights,
+        "memory usage with weights should be larger");
+
+  cerr << "\tTesting again with weight 1\n";
+  for (std::size_t i=0; i<lm_data.records.size(); ++i)
+    {
+      Bin& bin = lm_data.records[i].test_event.bin;
+      if (bin.get_bin_value() > 0)
+        bin.set_bin_value(1.F);
+    }
+  test_events(cache, lm_data);
+  check_if_equal(cache.get_memory_usage_in_bytes(), memory_usage_without_weights,
+                 "memory usage without weights after refilling");
+
+  cerr << "Tests for the time index of CListModeData\n";
+  test_time_index(lm_data);
+}
+
+void
+ListModeDataTests::
+test_positions_for_time(TestListModeData& lm_data, vector<std::size_t>& record_nums)
+{
+  // the index has an entry at most every second, while there is a time record every .5 secs
+  const double times[] = { 0., .2, .5, 1., 1.7, 3.2, 5., 1000. };
+  const int num_times = sizeof(times)/sizeof(times[0]);
+  record_nums.resize(num_times);
+  for (int i=0; i<num_times; ++i)
+    {
+      const double time = times[i];
+      double time_of_position = -1.;
+      if (!check(lm_data.set_get_position_for_time(time, time_of_position) == Succeeded::yes,
+                 "set_get_position_for_time"))
+        return;
+      check(time_of_position <= time, "time of position should not be after the requested time");
+      if (time <= 5.)
+        check(time_of_position > time - 1., "time of position should be close to the requested time");
+      const std::size_t record_num = lm_data.get_current_record_num();
+      record_nums[i] = record_num;
+      if (record_num == 0)
+        check_if_equal(time_of_position, 0., "time at the start of the data");
+      else
+        {
+          const TestRecord& previous_record = lm_data.records[record_num-1];
+          if (check(previous_record.is_time(), "position should be just after a time record"))
+            check_if_equal(previous_record.time().get_time_in_secs(), time_of_position,
+                           "time of the record before the position");
+        }
+    }
+}
+
+void
+ListModeDataTests::
+test_time_index(TestListModeData& lm_data)
+{
+  const string data_filename = "test_ListModeData_data.tmp";
+  const string index_filename = "test_ListModeData_time_index.tmp";
+  {
+    // the data file is only used for its signature
+    ofstream data_file(data_filename.c_str());
+    data_file << "list mode data\n";
+  }
+  lm_data.name = data_filename;
+
+  cerr << "\tTesting positions with a time index\n";
+  check(lm_data.build_time_index() == Succeeded::yes, "build_time_index");
+  check(lm_data.has_time_index(), "has_time_index after building");
+  vector<std::size_t> record_nums;
+  test_positions_for_time(lm_data, record_nums);
+
+  cerr << "\tTesting writing and reading the time index\n";
+  check(lm_data.write_time_index(index_filename) == Succeeded::yes, "write_time_index");
+  {
+    TestListModeData lm_data_read;
+    lm_data_read.records = lm_data.records;
+    lm_data_read.name = data_filename;
+    if (check(lm_data_read.read_time_index(index_filename) == Succeeded::yes, "read_time_index"))
+      {
+        vector<std::size_t> record_nums_read;
+        test_positions_for_time(lm_data_read, record_nums_read);
+        check(record_nums_read == record_nums, "positions after reading the time index");
+      }
+  }
+  {
+    TestListModeData lm_data_other_name;
+    lm_data_other_name.records = lm_data.records;
+    check(lm_data_other_name.read_time_index(index_filename) == Succeeded::no,
+          "time index for list mode data with another name should be rejected");
+  }
+
+  cerr << "\tTesting the time index after the data have changed\n";
+  {
+    ofstream data_file(data_filename.c_str(), std::ios::app);
+    data_file << "more list mode data\n";
+  }
+  {
+    TestListModeData lm_data_changed;
+    lm_data_changed.records = lm_data.records;
+    lm_data_changed.name = data_filename;
+    check(lm_data_changed.read_time_index(index_filename) == Succeeded::no,
+          "time index for changed list mode data should be rejected");
+    check(!lm_data_changed.has_time_index(), "has_time_index after rejecting the file");
+    // this rebuilds the index and writes it again
+    check(lm_data_changed.set_up_time_index(index_filename) == Succeeded::yes, "set_up_time_index");
+    check(lm_data_changed.has_time_index(), "has_time_index after set_up_time_index");
+  }
+  {
+    TestListModeData lm_data_read;
+    lm_data_read.records = lm_data.records;
+    lm_data_read.name = data_filename;
+    check(lm_data_read.read_time_index(index_filename) == Succeeded::yes,
+          "read_time_index after set_up_time_index");
+  }
+
+  std::remove(data_filename.c_str());
+  std::remove(index_filename.c_str());
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  ListModeDataTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
@@ -0,0 +1,262 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for stir::NeighbourhoodPrior and its potentials
+
+  Tests
+  - the derivatives of the potentials by comparing with numerical derivatives
+  - the gradient and Hessian of the priors by comparing with numerical derivatives
+    of the value and gradient
+  - that the Huber prior with a large \c delta gives the same results as stir::QuadraticPrior
+*/
+
+#include "stir/recon_buildblock/NeighbourhoodPrior.h"
+#include "stir/recon_buildblock/QuadraticPrior.h"
+#include "stir/VoxelsOnCartesianGrid.h"
+#include "stir/IndexRange3D.h"
+#include "stir/Coordinate3D.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <iostream>
+#include <string>
+#include <cmath>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+using std::string;
+#endif
+
+START_NAMESPACE_STIR
+
+namespace
+{
+  void
+  fill_randomly(DiscretisedDensity<3,float>& image, const float offset, const float scale)
+  {
+    boost::mt19937 generator;
+    boost::variate_generator<boost::mt19937&, boost::uniform_01<> > random01(generator, boost::uniform_01<>());
+    for (DiscretisedDensity<3,float>::full_iterator iter = image.begin_all(); iter != image.end_all(); ++iter)
+      *iter = offset + scale * static_cast<float>(random01());
+  }
+}
+
+/*!
+  \ingroup test
+  \brief Test class for NeighbourhoodPrior
+*/
+class NeighbourhoodPriorTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  //! compare the derivatives of the potential with numerical ones (computed in double precision)
+  /*! Also checks that the parabolic surrogate lies above the potential, and if
+      \a surrogate_uses_derivative_10 is \c true, that its curvature is derivative_10()/(centre-neighbour).
+  */
+  template <class PotentialT>
+    void test_potential(const PotentialT& potential, const string& name,
+                        const bool surrogate_uses_derivative_10 = true);
+  //! compare the gradient and Hessian with numerical derivatives
+  template <class PotentialT>
+    void test_prior(NeighbourhoodPrior<float,PotentialT>& prior, const string& name,
+                    const DiscretisedDensity<3,float>& image);
+  void test_Huber_vs_quadratic(const DiscretisedDensity<3,float>& image,
+                               const shared_ptr<DiscretisedDensity<3,float> >& kappa_sptr);
+};
+
+template <class PotentialT>
+void
+NeighbourhoodPriorTests::
+test_potential(const PotentialT& potential, const string& name,
+               const bool surrogate_uses_derivative_10)
+{
+  const double eps = 1.E-3;
+  const float values[] = { .3F, 1.F, 1.2F, 2.5F, 4.F };
+  const int num_values = sizeof(values)/sizeof(values[0]);
+  for (int i=0; i<num_values; ++i)
+    for (int j=0; j<num_values; ++j)
+      {
+        if (i==j)
+          continue;
+        const double c = values[i];
+        const double n = values[j];
+        const double d10 =
+          (potential.value(float(c+eps),float(n)) - potential.value(float(c-eps),float(n)))/(2*eps);
+        const double d20 =
+          (potential.derivative_10(float(c+eps),float(n)) - potential.derivative_10(float(c-eps),float(n)))/(2*eps);
+        const double d11 =
+          (potential.derivative_10(float(c),float(n+eps)) - potential.derivative_10(float(c),float(n-eps)))/(2*eps);
+        set_tolerance(.01);
+        check_if_equal(double(potential.derivative_10(float(c),float(n))), d10, name + ": derivative_10");
+        check_if_equal(double(potential.derivative_20(float(c),float(n))), d20, name + ": derivative_20");
+        check_if_equal(double(potential.derivative_11(float(c),float(n))), d11, name + ": derivative_11");
+        const double curvature = potential.surrogate_curvature(float(c),float(n));
+        if (surrogate_uses_derivative_10)
+          check_if_equal(curvature,
+                         double(potential.derivative_10(float(c),float(n)))/(c-n),
+                         name + ": surrogate_curvature");
+        // the parabolic surrogate at c has to lie above the potential for all non-negative values
+        {
+          const double value_c = potential.value(float(c),float(n));
+          const double derivative_c = potential.derivative_10(float(c),float(n));
+          bool surrogate_ok = true;
+          for (double r=0.; r<=10.; r+=.05)
+            {
+              const double surrogate = value_c + derivative_c*(r-c) + curvature*(r-c)*(r-c)/2;
+              const double value_r = potential.value(float(r),float(n));
+              if (surrogate < value_r - 1.E-4*(1 + std::fabs(value_r)))
+                surrogate_ok = false;
+            }
+          check(surrogate_ok, name + ": parabolic surrogate should lie above the potential");
+        }
+        check(potential.value(float(c),float(n)) == potential.value(float(n),float(c)),
+              name + ": potential should be symmetric");
+      }
+}
+
+template <class PotentialT>
+void
+NeighbourhoodPriorTests::
+test_prior(NeighbourhoodPrior<float,PotentialT>& prior, const string& name,
+           const DiscretisedDensity<3,float>& image)
+{
+  cerr << "\t" << name << "\n";
+  shared_ptr<DiscretisedDensity<3,float> > gradient_sptr(image.get_empty_copy());
+  prior.compute_gradient(*gradient_sptr, image);
+  shared_ptr<DiscretisedDensity<3,float> > Hessian_sptr(image.get_empty_copy());
+
+  // a voxel in the middle and one at the edge
+  const int num_voxels = 2;
+  const Coordinate3D<int> voxels[num_voxels] =
+    { Coordinate3D<int>((image.get_min_index()+image.get_max_index())/2,0,1),
+      Coordinate3D<int>(image.get_min_index(),image[0].get_min_index(),image[0][0].get_max_index()) };
+
+  const float eps = 1.E-2F;
+  shared_ptr<DiscretisedDensity<3,float> > image_plus_sptr(image.clone());
+  shared_ptr<DiscretisedDensity<3,float> > image_minus_sptr(image.clone());
+  shared_ptr<DiscretisedDensity<3,float> > gradient_plus_sptr(image.get_empty_copy());
+  shared_ptr<DiscretisedDensity<3,float> > gradient_minus_sptr(image.get_empty_copy());
+  for (int i=0; i<num_voxels; ++i)
+    {
+      const Coordinate3D<int>& c = voxels[i];
+      (*image_plus_sptr)[c] += eps;
+      (*image_minus_sptr)[c] -= eps;
+      const double numerical_gradient =
+        (prior.compute_value(*image_plus_sptr) - prior.compute_value(*image_minus_sptr))/(2*eps);
+      set_tolerance(.01);
+      check_if_equal(double((*gradient_sptr)[c]), numerical_gradient, name + ": gradient");
+
+      prior.compute_gradient(*gradient_plus_sptr, *image_plus_sptr);
+      prior.compute_gradient(*gradient_minus_sptr, *image_minus_sptr);
+      *gradient_plus_sptr -= *gradient_minus_sptr;
+      *gradient_plus_sptr /= 2*eps;
+      prior.compute_Hessian(*Hessian_sptr, c, image);
+      set_tolerance(.02);
+      check_if_equal(*Hessian_sptr, *gradient_plus_sptr, name + ": Hessian");
+
+      (*image_plus_sptr)[c] = image[c];
+      (*image_minus_sptr)[c] = image[c];
+    }
+}
+
+void
+NeighbourhoodPriorTests::
+test_Huber_vs_quadratic(const DiscretisedDensity<3,float>& image,
+                        const shared_ptr<DiscretisedDensity<3,float> >& kappa_sptr)
+{
+  cerr << "\tHuber prior with large delta vs QuadraticPrior\n";
+  HuberPrior Huber_prior(/*only_2D=*/false, 1.3F, HuberPotential<float>(1.E10F));
+  QuadraticPrior<float> quadratic_prior(/*only_2D=*/false, 1.3F);
+  Huber_prior.set_kappa_sptr(kappa_sptr);
+  quadratic_prior.set_kappa_sptr(kappa_sptr);
+
+  set_tolerance(.0001);
+  check_if_equal(Huber_prior.compute_value(image), quadratic_prior.compute_value(image), "value");
+  check_if_equal(Huber_prior.get_weights(), quadratic_prior.get_weights(), "weights");
+
+  shared_ptr<DiscretisedDensity<3,float> > output_sptr(image.get_empty_copy());
+  shared_ptr<DiscretisedDensity<3,float> > quadratic_output_sptr(image.get_empty_copy());
+  Huber_prior.compute_gradient(*output_sptr, image);
+  quadratic_prior.compute_gradient(*quadratic_output_sptr, image);
+  check_if_equal(*output_sptr, *quadratic_output_sptr, "gradient");
+  Huber_prior.parabolic_surrogate_curvature(*output_sptr, image);
+  quadratic_prior.parabolic_surrogate_curvature(*quadratic_output_sptr, image);
+  check_if_equal(*output_sptr, *quadratic_output_sptr, "parabolic surrogate curvature");
+  const BasicCoordinate<3,int> coords = make_coordinate(1,0,0);
+  Huber_prior.compute_Hessian(*output_sptr, coords, image);
+  quadratic_prior.compute_Hessian(*quadratic_output_sptr, coords, image);
+  check_if_equal(*output_sptr, *quadratic_output_sptr, "Hessian");
+}
+
+void
+NeighbourhoodPriorTests::
+run_tests()
+{
+  cerr << "Tests for NeighbourhoodPrior\n";
+
+  test_potential(HuberPotential<float>(.5F), "Huber");
+  test_potential(LogCoshPotential<float>(.7F), "Log-Cosh");
+  test_potential(RelativeDifferencePotential<float>(2.F, .1F), "Relative Difference",
+                 /*surrogate_uses_derivative_10=*/false);
+  test_potential(RelativeDifferencePotential<float>(0.F, 0.F), "Relative Difference without gamma",
+                 /*surrogate_uses_derivative_10=*/false);
+  test_potential(RelativeDifferencePotential<float>(.5F, 0.F), "Relative Difference with small gamma",
+                 /*surrogate_uses_derivative_10=*/false);
+
+  const CartesianCoordinate3D<float> origin(0,0,0);
+  const CartesianCoordinate3D<float> grid_spacing(2.F,3.F,3.F);
+  const IndexRange3D range(0,5,-4,4,-3,4);
+  VoxelsOnCartesianGrid<float> image(range, origin, grid_spacing);
+  fill_randomly(image, 1.F, 3.F);
+  shared_ptr<DiscretisedDensity<3,float> > kappa_sptr(image.get_empty_copy());
+  fill_randomly(*kappa_sptr, .5F, 1.F);
+
+  {
+    LogCoshPrior prior(/*only_2D=*/false, 1.1F, LogCoshPotential<float>(.5F));
+    test_prior(prior, "Log-Cosh prior", image);
+    prior.set_kappa_sptr(kappa_sptr);
+    test_prior(prior, "Log-Cosh prior with kappa", image);
+  }
+  {
+    RelativeDifferencePrior prior(/*only_2D=*/true, 2.F, RelativeDifferencePotential<float>(2.F, .01F));
+    test_prior(prior, "Relative Difference prior (2D)", image);
+    prior.set_kappa_sptr(kappa_sptr);
+    test_prior(prior, "Relative Difference prior (2D) with kappa", image);
+  }
+  test_Huber_vs_quadratic(image, kappa_sptr);
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  NeighbourhoodPriorTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
@@ -0,0 +1,285 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup recon_test
+
+  \brief Test program for stir::PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin
+
+  A small list mode file for the RATPET scanner (in ECAT8 32bit format) is written
+  to the current directory (and removed at the end). Tests
+  - that the gradient computed with several threads is equal (up to rounding errors)
+    to the gradient computed with 1 thread, when the events are read in several batches
+  - the same when the decoded events are cached
+  - if normalisation is taken into account in the sensitivity
+*/
+
+#include "stir/recon_buildblock/PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin.h"
+#include "stir/recon_buildblock/BinNormalisationFromProjData.h"
+#include "stir/ProjDataInMemory.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/ExamInfo.h"
+#include "stir/Scanner.h"
+#include "stir/DiscretisedDensity.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include "stir/is_null_ptr.h"
+#include "boost/cstdint.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+using std::string;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin
+*/
+class PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  typedef DiscretisedDensity<3,float> target_type;
+  typedef PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin<target_type> objective_type;
+
+  //! write a list mode file with \a num_events prompts for the RATPET scanner
+  void write_list_mode_data(const string& filename_prefix, const int num_events);
+  //! construct an objective function for the list mode file and set it up
+  /*! \a normalisation_sptr is only used if it is not null */
+  shared_ptr<objective_type>
+    construct_objective_function(shared_ptr<target_type>& target_sptr,
+                                 const string& list_mode_filename,
+                                 const bool cache_decoded_events,
+                                 const shared_ptr<BinNormalisation>& normalisation_sptr =
+                                   shared_ptr<BinNormalisation>());
+  void test_parallel_gradient(const string& list_mode_filename,
+                              const bool cache_decoded_events);
+  //! check that the sensitivity scales with the normalisation factors
+  void test_sensitivity_with_normalisation(const string& list_mode_filename);
+};
+
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests::
+write_list_mode_data(const string& filename_prefix, const int num_events)
+{
+  // RATPET scanner with uncompressed data
+  const int num_rings = 8;
+  const int num_views = 56;
+  const int num_tang_poss = 56;
+  const int max_ring_diff = 3;
+
+  std::ofstream data((filename_prefix + ".l").c_str(), std::ios::out | std::ios::binary);
+  // events are stored in segment order 0,-1,1,-2,2,... (with ring difference equal to the segment number)
+  // note: time is in ms, and events in the first second are used by the objective function
+  const int num_events_per_time_tick = 100;
+  boost::uint32_t seed = 42;
+  for (int event_num=0; event_num<num_events; ++event_num)
+    {
+      boost::uint32_t word;
+      if (event_num % num_events_per_time_tick == 0)
+        {
+          const boost::uint32_t time_in_ms =
+            static_cast<boost::uint32_t>((event_num/num_events_per_time_tick)*900/(num_events/num_events_per_time_tick+1));
+          word = (1U << 31) | time_in_ms;
+          for (int i=0; i<4; ++i)
+            data.put(static_cast<char>((word >> (8*i)) & 0xff));
+        }
+      // simple linear congruential generator such that the data are the same on every system
+      seed = seed*1664525U + 1013904223U;
+      const int segment_num = static_cast<int>((seed >> 8) % (2*max_ring_diff+1)) - max_ring_diff;
+      const int axial_pos_num = static_cast<int>((seed >> 12) % (num_rings - std::abs(segment_num)));
+      const int view_num = static_cast<int>((seed >> 16) % num_views);
+      const int tang_pos_num = static_cast<int>((seed >> 22) % num_tang_poss) - num_tang_poss/2;
+      int z = 0;
+      for (int s=0; s<std::abs(segment_num); ++s)
+        z += (s==0 ? num_rings : 2*(num_rings-s));
+      if (segment_num > 0)
+        z += num_rings - segment_num;
+      z += axial_pos_num;
+      const boost::uint32_t offset =
+        static_cast<boost::uint32_t>((z*num_views + view_num)*num_tang_poss + tang_pos_num + num_tang_poss/2);
+      word = (1U << 30) | offset;
+      for (int i=0; i<4; ++i)
+        data.put(static_cast<char>((word >> (8*i)) & 0xff));
+    }
+  data.close();
+
+  std::ofstream header((filename_prefix + ".l.hdr").c_str());
+  header << "!INTERFILE:=\n"
+         << "!originating system := RATPET\n"
+         << "name of data file := " << filename_prefix << ".l\n"
+         << "number format := unsigned integer\n"
+         << "number of bytes per pixel := 4\n"
+         << "number of dimensions := 1\n"
+         << "matrix size [1] := 1\n"
+         << "%axial_compression := 1\n"
+         << "%maximum_ring_difference := " << num_rings-1 << "\n"
+         << "%number_of_projections := " << num_tang_poss << "\n"
+         << "%number_of_views := " << num_views << "\n"
+         << "%number_of_segments := " << 2*num_rings-1 << "\n"
+         << "!END OF INTERFILE:=\n";
+}
+
+shared_ptr<PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests::objective_type>
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests::
+construct_objective_function(shared_ptr<target_type>& target_sptr,
+                             const string& list_mode_filename,
+                             const bool cache_decoded_events,
+                             const shared_ptr<BinNormalisation>& normalisation_sptr)
+{
+  std::stringstream parameters;
+  parameters << "PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin Parameters:=\n"
+             << "list mode filename := " << list_mode_filename << "\n"
+             << "zoom := .5\n"
+             << "XY output image size (in pixels) := 21\n"
+             << "max ring difference num to process := 3\n"
+             << "recompute sensitivity := 1\n"
+             << "Matrix type := Ray Tracing\n"
+             << "Ray Tracing Matrix Parameters:=\n"
+             << "End Ray Tracing Matrix Parameters:=\n"
+             << "number of events per batch := 300\n"
+             << "cache decoded events := " << (cache_decoded_events ? 1 : 0) << "\n"
+             << "End PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin Parameters:=\n";
+  shared_ptr<objective_type> objective_function_sptr(new objective_type);
+  if (!check(objective_function_sptr->parse(parameters), "parsing parameters of objective function"))
+    return shared_ptr<objective_type>();
+  if (!is_null_ptr(normalisation_sptr))
+    objective_function_sptr->set_normalisation_sptr(normalisation_sptr);
+  target_sptr.reset(objective_function_sptr->construct_target_ptr());
+  if (!check(objective_function_sptr->set_up(target_sptr) == Succeeded::yes, "set-up of objective function"))
+    return shared_ptr<objective_type>();
+  return objective_function_sptr;
+}
+
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests::
+test_parallel_gradient(const string& list_mode_filename,
+                       const bool cache_decoded_events)
+{
+  cerr << "\tTesting gradient with several threads" << (cache_decoded_events ? " (with cached events)\n" : "\n");
+  shared_ptr<target_type> target_sptr;
+  shared_ptr<objective_type> objective_function_sptr =
+    construct_objective_function(target_sptr, list_mode_filename, cache_decoded_events);
+  if (is_null_ptr(objective_function_sptr))
+    return;
+  target_sptr->fill(1.F);
+
+  shared_ptr<target_type> serial_gradient_sptr(target_sptr->get_empty_copy());
+  shared_ptr<target_type> parallel_gradient_sptr(target_sptr->get_empty_copy());
+#ifdef STIR_OPENMP
+  const int org_num_threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+#endif
+  objective_function_sptr->
+    compute_sub_gradient_without_penalty_plus_sensitivity(*serial_gradient_sptr, *target_sptr, 0);
+#ifdef STIR_OPENMP
+  // make sure that the events of a batch are divided in several parts
+  omp_set_num_threads(org_num_threads > 1 ? org_num_threads : 3);
+#endif
+  objective_function_sptr->
+    compute_sub_gradient_without_penalty_plus_sensitivity(*parallel_gradient_sptr, *target_sptr, 0);
+#ifdef STIR_OPENMP
+  omp_set_num_threads(org_num_threads);
+#endif
+
+  check(serial_gradient_sptr->find_max() > 0.F, "gradient should not be zero");
+  check_if_equal(static_cast<const Array<3,float>&>(*serial_gradient_sptr),
+                 static_cast<const Array<3,float>&>(*parallel_gradient_sptr),
+                 "gradient computed with several threads should be equal to the one with 1 thread");
+}
+
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests::
+test_sensitivity_with_normalisation(const string& list_mode_filename)
+{
+  cerr << "\tTesting sensitivity with normalisation\n";
+  shared_ptr<target_type> target_sptr;
+  shared_ptr<objective_type> objective_function_sptr =
+    construct_objective_function(target_sptr, list_mode_filename, /*cache_decoded_events=*/false);
+  if (is_null_ptr(objective_function_sptr))
+    return;
+  shared_ptr<target_type> sensitivity_sptr(objective_function_sptr->get_sensitivity().clone());
+
+  // normalisation factors of 2 for the projection data used by the objective function
+  // (RATPET, uncompressed, with max ring difference 3), i.e. all efficiencies are 1/2
+  shared_ptr<Scanner> scanner_sptr(Scanner::get_scanner_from_name("RATPET"));
+  shared_ptr<ProjDataInfo>
+    proj_data_info_sptr(ProjDataInfo::ProjDataInfoCTI(scanner_sptr, /*span=*/1, /*max_delta=*/3,
+                                                      scanner_sptr->get_num_detectors_per_ring()/2,
+                                                      scanner_sptr->get_default_num_arccorrected_bins(),
+                                                      /*arc_corrected=*/false));
+  shared_ptr<ProjData>
+    norm_proj_data_sptr(new ProjDataInMemory(shared_ptr<ExamInfo>(new ExamInfo), proj_data_info_sptr));
+  norm_proj_data_sptr->fill(2.F);
+  shared_ptr<BinNormalisation> normalisation_sptr(new BinNormalisationFromProjData(norm_proj_data_sptr));
+
+  shared_ptr<target_type> normalised_target_sptr;
+  shared_ptr<objective_type> normalised_objective_function_sptr =
+    construct_objective_function(normalised_target_sptr, list_mode_filename, /*cache_decoded_events=*/false,
+                                 normalisation_sptr);
+  if (is_null_ptr(normalised_objective_function_sptr))
+    return;
+
+  check(sensitivity_sptr->find_max() > 0.F, "sensitivity should not be zero");
+  *sensitivity_sptr *= .5F;
+  set_tolerance(1.E-4);
+  check_if_equal(static_cast<const Array<3,float>&>(*sensitivity_sptr),
+                 static_cast<const Array<3,float>&>(normalised_objective_function_sptr->get_sensitivity()),
+                 "sensitivity with normalisation factors 2 should be half the one without normalisation");
+}
+
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests::
+run_tests()
+{
+  cerr << "Tests for PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBin\n";
+  const string prefix = "test_PoissonLogLikelihoodWithLinearModelForMeanAndListModeData_lm";
+  // use more events than the batch size, such that several batches are read
+  write_list_mode_data(prefix, 2000);
+  test_parallel_gradient(prefix + ".l.hdr", /*cache_decoded_events=*/false);
+  test_parallel_gradient(prefix + ".l.hdr", /*cache_decoded_events=*/true);
+  test_sensitivity_with_normalisation(prefix + ".l.hdr");
+  std::remove((prefix + ".l").c_str());
+  std::remove((prefix + ".l.hdr").c_str());
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  PoissonLogLikelihoodWithLinearModelForMeanAndListModeDataWithProjMatrixByBinTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
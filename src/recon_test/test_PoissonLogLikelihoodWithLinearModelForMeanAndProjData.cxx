@@ -38,6 +38,8 @@
 #include "stir/ProjDataInfo.h"
 #include "stir/ProjDataInMemory.h"
 #include "stir/SegmentByView.h"
+#include "stir/RelatedViewgrams.h"
+#include "stir/recon_array_functions.h"
 #include "stir/Scanner.h"
 #include "stir/DataSymmetriesForViewSegmentNumbers.h"
 #include "stir/recon_buildblock/PoissonLogLikelihoodWithLinearModelForMeanAndProjData.h"
@@ -45,6 +47,7 @@
 #include "stir/recon_buildblock/ProjectorByBinPairUsingProjMatrixByBin.h"
 #include "stir/recon_buildblock/BinNormalisationFromProjData.h"
 #include "stir/recon_buildblock/TrivialBinNormalisation.h"
+#include "stir/OSSPS/OSSPSReconstruction.h"
 //#include "stir/OSMAPOSL/OSMAPOSLReconstruction.h"
 #include "stir/recon_buildblock/distributable_main.h"
 #include "stir/RunTests.h"
@@ -54,7 +57,17 @@
 #include "stir/Succeeded.h"
 #include "stir/num_threads.h"
 #include <iostream>
+#include <fstream>
 #include <memory>
+#include <vector>
+#include <string>
+#include <cstdio>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <boost/random/uniform_01.hpp>
 #include <boost/random/normal_distribution.hpp>
 #include <boost/random/mersenne_twister.hpp>
@@ -64,6 +77,70 @@
 #include "stir/recon_buildblock/distributable_main.h"
 START_NAMESPACE_STIR
 
+//! create a directory (returns \c false if this failed)
+static bool
+make_directory(const std::string& directory)
+{
+#ifdef _WIN32
+  return _mkdir(directory.c_str()) == 0;
+#else
+  return mkdir(directory.c_str(), 0755) == 0;
+#endif
+}
+
+//! remove an empty directory (returns \c false if this failed)
+static bool
+remove_directory(const std::string& directory)
+{
+#ifdef _WIN32
+  return _rmdir(directory.c_str()) == 0;
+#else
+  return rmdir(directory.c_str()) == 0;
+#endif
+}
+
+//! remove an Interfile image (given the name of its header)
+static void
+remove_interfile_image(const std::string& filename)
+{
+  std::remove(filename.c_str());
+  // remove the data file and the Analyze-style header as well
+  const std::string::size_type dot_pos = filename.rfind(".hv");
+  if (dot_pos != std::string::npos)
+    {
+      std::remove((filename.substr(0, dot_pos) + ".v").c_str());
+      std::remove((filename.substr(0, dot_pos) + ".ahv").c_str());
+    }
+}
+
+//! get the filenames of the images listed in the key file of a cache entry
+static std::vector<std::string>
+get_cache_entry_filenames(const std::string& key_filename)
+{
+  std::ifstream key_file(key_filename.c_str());
+  int num_files = 0;
+  key_file >> num_files;
+  key_file.ignore(1);
+  std::vector<std::string> filenames;
+  for (int i=0; i<num_files && key_file; ++i)
+    {
+      std::string filename;
+      std::getline(key_file, filename);
+      filenames.push_back(filename);
+    }
+  return filenames;
+}
+
+//! remove the key file of a cache entry and the (Interfile) images listed in it
+static void
+remove_cache_entry(const std::string& key_filename)
+{
+  const std::vector<std::string> filenames = get_cache_entry_filenames(key_filename);
+  for (std::size_t i=0; i<filenames.size(); ++i)
+    remove_interfile_image(filenames[i]);
+  std::remove(key_filename.c_str());
+}
+
 
 /*!
   \ingroup test
@@ -112,6 +189,16 @@ protected:
   /*! Note that this function is not specific to PoissonLogLikelihoodWithLinearModelForMeanAndProjData */
   void run_tests_for_objective_function(GeneralisedObjectiveFunction<target_type>& objective_function,
                                         target_type& target);
+
+  //! check that sensitivities read from the cache are the same as the computed ones
+  void test_sensitivity_cache(shared_ptr<target_type> const& density_sptr);
+
+  //! check that OSSPSReconstruction writes the precomputed denominator to its cache and reads it back
+  void test_OSSPS_denominator_cache(shared_ptr<target_type> const& density_sptr);
+
+  //! compare the multiplication with the approximate Hessian with a straightforward loop over the data
+  /*! Also checks that the cache key description depends on the measured data. */
+  void test_approximate_Hessian(target_type const& density);
 };
 
 PoissonLogLikelihoodWithLinearModelForMeanAndProjDataTests::
@@ -311,6 +398,167 @@ proj_data_sptr->get_proj_data_info_ptr()->create_shared_clone()));
     return;
 }
 
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndProjDataTests::
+test_sensitivity_cache(shared_ptr<target_type> const& density_sptr)
+{
+  PoissonLogLikelihoodWithLinearModelForMeanAndProjData<target_type>& objective_function =
+    reinterpret_cast<  PoissonLogLikelihoodWithLinearModelForMeanAndProjData<target_type>& >(*objective_function_sptr);
+  const int num_subsets = objective_function.get_num_subsets();
+  std::vector<shared_ptr<target_type> > org_subsensitivity_sptrs;
+  for (int subset_num=0; subset_num<num_subsets; ++subset_num)
+    org_subsensitivity_sptrs.push_back(shared_ptr<target_type>(objective_function.get_subset_sensitivity(subset_num).clone()));
+
+  const std::string cache_directory = "test_PoissonLogLikelihoodWithLinearModelForMeanAndProjData_cache";
+  make_directory(cache_directory);
+  objective_function.set_sensitivity_cache_directory(cache_directory);
+  std::string key_filename, description;
+  if (!check(objective_function.get_sensitivity_cache_key(key_filename, description, *density_sptr),
+             "cache key of sensitivity"))
+    return;
+
+  info("Writing sensitivity to cache");
+  objective_function.set_recompute_sensitivity(true);
+  if (check(objective_function.set_up(density_sptr)==Succeeded::yes, "set-up of objective function writing to cache"))
+    {
+      check(!objective_function.get_sensitivity_was_read_from_cache(),
+            "sensitivity should not be read from cache when recompute_sensitivity is set");
+      check(std::ifstream(key_filename.c_str()).good(), "key file of sensitivity cache should exist");
+
+      info("Reading sensitivity from cache");
+      objective_function.set_recompute_sensitivity(false);
+      // make sure set_up() does not try to use the current sensitivity
+      objective_function.set_subset_sensitivity_sptr(shared_ptr<target_type>(), 0);
+      if (check(objective_function.set_up(density_sptr)==Succeeded::yes, "set-up of objective function reading from cache"))
+        {
+          check(objective_function.get_sensitivity_was_read_from_cache(),
+                "sensitivity should be read from cache");
+          for (int subset_num=0; subset_num<num_subsets; ++subset_num)
+            check_if_equal(objective_function.get_subset_sensitivity(subset_num), *org_subsensitivity_sptrs[subset_num],
+                           "subset sensitivity read from cache");
+        }
+    }
+  objective_function.set_sensitivity_cache_directory("");
+  remove_cache_entry(key_filename);
+  check(remove_directory(cache_directory), "removing the cache directory (all files should have been removed)");
+}
+
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndProjDataTests::
+test_OSSPS_denominator_cache(shared_ptr<target_type> const& density_sptr)
+{
+  const std::string cache_directory = "test_PoissonLogLikelihoodWithLinearModelForMeanAndProjData_OSSPS_cache";
+  make_directory(cache_directory);
+  OSSPSReconstruction<target_type> reconstruction;
+  reconstruction.set_objective_function_sptr(objective_function_sptr);
+  reconstruction.set_num_subsets(objective_function_sptr->get_num_subsets());
+  const std::string output_filename_prefix = cache_directory + "/OSSPS";
+  reconstruction.set_output_filename_prefix(output_filename_prefix);
+  reconstruction.set_precomputed_denominator_cache_directory(cache_directory);
+  // set_up() is private in OSSPSReconstruction
+  Reconstruction<target_type>& reconstruction_base = reconstruction;
+
+  std::string key_filename, description;
+  if (!check(reconstruction.get_precomputed_denominator_cache_key(key_filename, description, *density_sptr),
+             "cache key of OSSPS precomputed denominator"))
+    return;
+
+  info("Writing OSSPS precomputed denominator to cache");
+  if (check(reconstruction_base.set_up(density_sptr) == Succeeded::yes, "set-up of OSSPS writing to cache"))
+    {
+      check(!reconstruction.get_precomputed_denominator_was_read_from_cache(),
+            "OSSPS precomputed denominator should not be read from an empty cache");
+      info("Reading OSSPS precomputed denominator from cache");
+      if (check(reconstruction_base.set_up(density_sptr) == Succeeded::yes, "set-up of OSSPS reading from cache"))
+        check(reconstruction.get_precomputed_denominator_was_read_from_cache(),
+              "OSSPS precomputed denominator should be read from cache");
+      // compare the cached image with the one written after computing it
+      const std::vector<std::string> filenames = get_cache_entry_filenames(key_filename);
+      if (check_if_equal(filenames.size(), std::size_t(1), "number of images in the OSSPS cache"))
+        {
+          shared_ptr<target_type> cached_denominator_sptr(read_from_file<target_type>(filenames[0]).release());
+          shared_ptr<target_type> computed_denominator_sptr(
+            read_from_file<target_type>(output_filename_prefix + "_precomputed_denominator.hv").release());
+          check_if_equal(*cached_denominator_sptr, *computed_denominator_sptr,
+                         "OSSPS precomputed denominator in cache");
+        }
+    }
+  remove_cache_entry(key_filename);
+  remove_interfile_image(output_filename_prefix + "_precomputed_denominator.hv");
+  check(remove_directory(cache_directory), "removing the OSSPS cache directory (all files should have been removed)");
+}
+
+void
+PoissonLogLikelihoodWithLinearModelForMeanAndProjDataTests::
+test_approximate_Hessian(target_type const& density)
+{
+  PoissonLogLikelihoodWithLinearModelForMeanAndProjData<target_type>& objective_function =
+    reinterpret_cast<  PoissonLogLikelihoodWithLinearModelForMeanAndProjData<target_type>& >(*objective_function_sptr);
+  const ProjData& proj_data = objective_function.get_proj_data();
+  const BinNormalisation& normalisation = objective_function.get_normalisation();
+  const ProjectorByBinPair& projectors = objective_function.get_projector_pair();
+  shared_ptr<DataSymmetriesForViewSegmentNumbers>
+    symmetries_sptr(projectors.get_symmetries_used()->clone());
+  const int num_subsets = objective_function.get_num_subsets();
+  const int max_segment_num = objective_function.get_max_segment_num_to_process();
+
+  info("Computing multiplication with approximate Hessian");
+  for (int subset_num=0; subset_num<num_subsets; subset_num += num_subsets-1)
+    {
+      shared_ptr<target_type> output_sptr(density.get_empty_copy());
+      // check that the result is added
+      output_sptr->fill(1.F);
+      objective_function.
+        add_multiplication_with_approximate_sub_Hessian_without_penalty(*output_sptr, density, subset_num);
+
+      // reference: data term y*norm^2, divide forward projection by it, back project
+      shared_ptr<target_type> org_output_sptr(density.get_empty_copy());
+      org_output_sptr->fill(1.F);
+      for (int segment_num = -max_segment_num; segment_num <= max_segment_num; ++segment_num)
+        for (int view = proj_data.get_min_view_num() + subset_num; 
+             view <= proj_data.get_max_view_num(); 
+             view += num_subsets)
+          {
+            const ViewSegmentNumbers view_segment_num(view, segment_num);
+            if (!symmetries_sptr->is_basic(view_segment_num))
+              continue;
+            RelatedViewgrams<float> viewgrams =
+              proj_data.get_related_viewgrams(view_segment_num, symmetries_sptr);
+            normalisation.apply(viewgrams, 0., 0.);
+            normalisation.apply(viewgrams, 0., 0.);
+            RelatedViewgrams<float> tmp_viewgrams =
+              proj_data.get_empty_related_viewgrams(view_segment_num, symmetries_sptr);
+            projectors.get_forward_projector_sptr()->forward_project(tmp_viewgrams, density);
+            int tmp1=0, tmp2=0;
+            divide_and_truncate(tmp_viewgrams, viewgrams, 0, tmp1, tmp2);
+            projectors.get_back_projector_sptr()->back_project(*org_output_sptr, tmp_viewgrams);
+          }
+      check_if_equal(*output_sptr, *org_output_sptr, "multiplication with approximate sub-Hessian");
+      if (num_subsets == 1)
+        break;
+    }
+
+  info("Checking cache description of the approximate Hessian");
+  const shared_ptr<ProjData> org_proj_data_sptr = objective_function.get_proj_data_sptr();
+  const std::string description = objective_function.get_approximate_Hessian_cache_key_description();
+  check(!description.empty(), "approximate Hessian cache description should not be empty");
+  check(description == objective_function.get_approximate_Hessian_cache_key_description(),
+        "approximate Hessian cache description should be reproducible");
+  shared_ptr<ProjData> proj_data_sptr(new ProjDataInMemory(proj_data.get_exam_info_sptr(),
+                                                           proj_data.get_proj_data_info_ptr()->create_shared_clone()));
+  for (int segment_num = proj_data.get_min_segment_num(); segment_num <= proj_data.get_max_segment_num(); ++segment_num)
+    proj_data_sptr->set_segment(proj_data.get_segment_by_view(segment_num));
+  {
+    SegmentByView<float> segment = proj_data_sptr->get_segment_by_view(0);
+    *segment.begin_all() += 1.F;
+    proj_data_sptr->set_segment(segment);
+  }
+  objective_function.set_proj_data_sptr(proj_data_sptr);
+  check(description != objective_function.get_approximate_Hessian_cache_key_description(),
+        "approximate Hessian cache description should depend on the data");
+  objective_function.set_proj_data_sptr(org_proj_data_sptr);
+}
+
 void
 PoissonLogLikelihoodWithLinearModelForMeanAndProjDataTests::
 run_tests()
@@ -321,6 +569,9 @@ run_tests()
   shared_ptr<target_type> density_sptr;
   construct_input_data(density_sptr);
   this->run_tests_for_objective_function(*this->objective_function_sptr, *density_sptr);
+  this->test_sensitivity_cache(density_sptr);
+  this->test_OSSPS_denominator_cache(density_sptr);
+  this->test_approximate_Hessian(*density_sptr);
 #else
   // alternative that gets the objective function from an OSMAPOSL .par file
   // currently disabled
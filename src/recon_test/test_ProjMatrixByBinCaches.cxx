@@ -0,0 +1,370 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for the different cache types of stir::ProjMatrixByBin
+
+  Uses stir::ProjMatrixByBinUsingRayTracing with and without a cache,
+  and checks that the rows are (nearly) identical. Tests
+  stir::ProjMatrixByBinCompressedCache and stir::ProjMatrixByBinConcurrentCache.
+  Also tests stir::ProjMatrixByBin::get_proj_matrix_elems_for_related_bins.
+*/
+
+#include "stir/VoxelsOnCartesianGrid.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/Scanner.h"
+#include "stir/recon_buildblock/ProjMatrixByBinUsingRayTracing.h"
+#include "stir/recon_buildblock/ProjMatrixByBinCompressedCache.h"
+#include "stir/recon_buildblock/ProjMatrixByBinConcurrentCache.h"
+#include "stir/recon_buildblock/ProjMatrixElemsForOneBin.h"
+#include "stir/recon_buildblock/DataSymmetriesForBins.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#ifndef STIR_NO_NAMESPACES
+using std::stringstream;
+using std::cerr;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for the caches of ProjMatrixByBin
+*/
+class ProjMatrixByBinCachesTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  //! compare 2 rows, allowing for the reduced precision of the compressed cache
+  bool check_equal_rows(const ProjMatrixElemsForOneBin& org,
+                        const ProjMatrixElemsForOneBin& compressed);
+  void set_up_matrix(ProjMatrixByBinUsingRayTracing& proj_matrix,
+                     const bool cache_enabled, const std::string& cache_type);
+  shared_ptr<ProjDataInfo> proj_data_info_sptr;
+  shared_ptr<DiscretisedDensity<3,float> > density_sptr;
+};
+
+bool
+ProjMatrixByBinCachesTests::
+check_equal_rows(const ProjMatrixElemsForOneBin& org,
+                 const ProjMatrixElemsForOneBin& compressed)
+{
+  if (!check_if_equal(org.size(), compressed.size(), "number of elements in row"))
+    return false;
+  float max_value = 0.F;
+  for (ProjMatrixElemsForOneBin::const_iterator iter = org.begin(); iter != org.end(); ++iter)
+    max_value = std::max(max_value, iter->get_value());
+  ProjMatrixElemsForOneBin::const_iterator compressed_iter = compressed.begin();
+  for (ProjMatrixElemsForOneBin::const_iterator iter = org.begin();
+       iter != org.end();
+       ++iter, ++compressed_iter)
+    {
+      if (!check(iter->get_coords() == compressed_iter->get_coords(), "coordinates of element"))
+        return false;
+      if (!check(fabs(iter->get_value() - compressed_iter->get_value()) <= 1.E-3F*max_value,
+                 "value of element"))
+        return false;
+    }
+  return true;
+}
+
+void
+ProjMatrixByBinCachesTests::
+set_up_matrix(ProjMatrixByBinUsingRayTracing& proj_matrix,
+              const bool cache_enabled, const std::string& cache_type)
+{
+  stringstream str;
+  str <<
+    "Ray Tracing Matrix Parameters :=\n"
+    "number of rays in tangential direction to trace for each bin := 3\n"
+    "disable caching := " << (cache_enabled ? 0 : 1) << "\n"
+    "cache type := " << cache_type << "\n"
+    "End Ray Tracing Matrix Parameters :=\n";
+  if (!check(proj_matrix.parse(str), "parsing projection matrix parameters"))
+    return;
+  proj_matrix.set_up(proj_data_info_sptr, density_sptr);
+}
+
+void
+ProjMatrixByBinCachesTests::run_tests()
+{
+  cerr << "Tests for caches of ProjMatrixByBin\n";
+
+  shared_ptr<Scanner> scanner_sptr(new Scanner(Scanner::E953));
+  proj_data_info_sptr.reset(
+    ProjDataInfo::ProjDataInfoCTI(scanner_sptr,
+                                  /*span=*/3,
+                                  /*max_delta=*/12,
+                                  /*num_views=*/8,
+                                  /*num_tang_poss=*/32));
+  const CartesianCoordinate3D<float> origin (0,0,0);
+  density_sptr.reset(new VoxelsOnCartesianGrid<float>(*proj_data_info_sptr, 1.F, origin));
+
+  {
+    cerr << "\tTesting get_proj_matrix_elems_for_related_bins\n";
+    ProjMatrixByBinUsingRayTracing proj_matrix_no_cache;
+    set_up_matrix(proj_matrix_no_cache, false, "hash map");
+    ProjMatrixByBinUsingRayTracing proj_matrix_basic_cache;
+    set_up_matrix(proj_matrix_basic_cache, true, "hash map");
+    const DataSymmetriesForBins& symmetries = *proj_matrix_no_cache.get_symmetries_ptr();
+
+    std::vector<ProjMatrixElemsForOneBin> related_rows;
+    ProjMatrixElemsForOneBin org_row;
+    bool all_equal = true;
+    std::size_t num_related_rows = 0;
+    const int min_axial_pos_num = 2;
+    const int max_axial_pos_num = 5;
+    const int min_tangential_pos_num = -7;
+    const int max_tangential_pos_num = 7;
+    for (int v=proj_data_info_sptr->get_min_view_num(); v <= proj_data_info_sptr->get_max_view_num(); ++v)
+      for (int a=proj_data_info_sptr->get_min_axial_pos_num(1); a <= proj_data_info_sptr->get_max_axial_pos_num(1); ++a)
+        for (int t=proj_data_info_sptr->get_min_tangential_pos_num(); t<=proj_data_info_sptr->get_max_tangential_pos_num(); ++t)
+          {
+            Bin basic_bin(1,v,a,t);
+            if (!symmetries.is_basic(basic_bin))
+              continue;
+            // pass 0: no cache, pass 1: fill the cache, pass 2: use the cache
+            for (int pass=0; pass<3; ++pass)
+              {
+                if (pass==0)
+                  proj_matrix_no_cache.get_proj_matrix_elems_for_related_bins(related_rows, basic_bin,
+                                                                              min_axial_pos_num, max_axial_pos_num,
+                                                                              min_tangential_pos_num, max_tangential_pos_num);
+                else
+                  proj_matrix_basic_cache.get_proj_matrix_elems_for_related_bins(related_rows, basic_bin,
+                                                                                 min_axial_pos_num, max_axial_pos_num,
+                                                                                 min_tangential_pos_num, max_tangential_pos_num);
+                std::vector<Bin> related_bins;
+                symmetries.get_related_bins(related_bins, basic_bin,
+                                            min_axial_pos_num, max_axial_pos_num,
+                                            min_tangential_pos_num, max_tangential_pos_num);
+                if (!check_if_equal(related_rows.size(), related_bins.size(), "number of related rows"))
+                  continue;
+                for (std::size_t i=0; i<related_rows.size(); ++i)
+                  {
+                    const Bin bin = related_rows[i].get_bin();
+                    if (!check(bin.segment_num() == related_bins[i].segment_num() &&
+                               bin.view_num() == related_bins[i].view_num() &&
+                               bin.axial_pos_num() == related_bins[i].axial_pos_num() &&
+                               bin.tangential_pos_num() == related_bins[i].tangential_pos_num(),
+                               "bin of related row"))
+                      continue;
+                    proj_matrix_no_cache.get_proj_matrix_elems_for_one_bin(org_row, bin);
+                    if (!(org_row == related_rows[i]))
+                      all_equal = false;
+                    ++num_related_rows;
+                  }
+              }
+          }
+    check(num_related_rows > 0, "at least one related row should have been found");
+    check(all_equal, "comparing related rows with rows obtained for every bin");
+  }
+
+  {
+    cerr << "\tTesting the compressed cache on its own\n";
+    ProjMatrixByBinUsingRayTracing proj_matrix_no_cache;
+    set_up_matrix(proj_matrix_no_cache, false, "hash map");
+    const DataSymmetriesForBins& symmetries = *proj_matrix_no_cache.get_symmetries_ptr();
+
+    ProjMatrixByBinCompressedCache cache(*proj_data_info_sptr);
+    std::size_t num_bytes_in_rows = 0;
+    ProjMatrixElemsForOneBin org_row, compressed_row;
+    for (int s=proj_data_info_sptr->get_min_segment_num(); s<=proj_data_info_sptr->get_max_segment_num(); ++s)
+      for (int v=proj_data_info_sptr->get_min_view_num(); v <= proj_data_info_sptr->get_max_view_num(); ++v)
+        for (int a=proj_data_info_sptr->get_min_axial_pos_num(s); a <= proj_data_info_sptr->get_max_axial_pos_num(s); ++a)
+          for (int t=proj_data_info_sptr->get_min_tangential_pos_num(); t<=proj_data_info_sptr->get_max_tangential_pos_num(); ++t)
+            {
+              const Bin bin(s,v,a,t);
+              if (!symmetries.is_basic(bin))
+                continue;
+              proj_matrix_no_cache.get_proj_matrix_elems_for_one_bin(org_row, bin);
+              num_bytes_in_rows += org_row.size()*sizeof(ProjMatrixElemsForOneBin::value_type);
+
+              compressed_row.set_bin(bin);
+              check(cache.get(compressed_row) == Succeeded::no, "row should not be in cache yet");
+              cache.insert(org_row, &symmetries);
+              compressed_row.set_bin(bin);
+              if (!check(cache.get(compressed_row) == Succeeded::yes, "row should be in cache"))
+                continue;
+              if (!check_equal_rows(org_row, compressed_row))
+                {
+                  cerr << "Current bin:  segment = " << s << ", axial pos " << a
+                       << ", view = " << v << ", tangential_pos_num = " << t << "\n";
+                  return;
+                }
+            }
+    cerr << "\t\tmemory used by rows: " << num_bytes_in_rows
+         << ", by compressed cache: " << cache.get_memory_usage_in_bytes() << '\n';
+    check(cache.get_memory_usage_in_bytes()*3 < num_bytes_in_rows, "memory usage of compressed cache");
+
+    cache.clear();
+    compressed_row.set_bin(Bin(0,0,0,0));
+    check(cache.get(compressed_row) == Succeeded::no, "cache should be empty after clear()");
+  }
+
+  {
+    cerr << "\tTesting ProjMatrixByBin with \"cache type := compressed\"\n";
+    ProjMatrixByBinUsingRayTracing proj_matrix_no_cache;
+    set_up_matrix(proj_matrix_no_cache, false, "hash map");
+    ProjMatrixByBinUsingRayTracing proj_matrix_compressed;
+    set_up_matrix(proj_matrix_compressed, true, "compressed");
+    check(proj_matrix_compressed.get_cache_type() == ProjMatrixByBin::compressed_cache, "cache type");
+
+    ProjMatrixElemsForOneBin org_row, compressed_row;
+    // run twice to test if elements retrieved from the cache are fine
+    for (int pass=0; pass<2; ++pass)
+      for (int s=proj_data_info_sptr->get_min_segment_num(); s<=proj_data_info_sptr->get_max_segment_num(); ++s)
+        for (int v=proj_data_info_sptr->get_min_view_num(); v <= proj_data_info_sptr->get_max_view_num(); ++v)
+          for (int a=proj_data_info_sptr->get_min_axial_pos_num(s); a <= proj_data_info_sptr->get_max_axial_pos_num(s); a+=3)
+            for (int t=-9; t<=9; t+=3)
+              {
+                const Bin bin(s,v,a,t);
+                proj_matrix_no_cache.get_proj_matrix_elems_for_one_bin(org_row, bin);
+                proj_matrix_compressed.get_proj_matrix_elems_for_one_bin(compressed_row, bin);
+                if (!check_equal_rows(org_row, compressed_row))
+                  {
+                    cerr << "Current bin:  segment = " << s << ", axial pos " << a
+                         << ", view = " << v << ", tangential_pos_num = " << t << "\n";
+                    return;
+                  }
+              }
+  }
+
+  {
+    cerr << "\tTesting the concurrent cache on its own\n";
+    ProjMatrixByBinUsingRayTracing proj_matrix_no_cache;
+    set_up_matrix(proj_matrix_no_cache, false, "hash map");
+    ProjMatrixByBinConcurrentCache cache(*proj_data_info_sptr);
+    ProjMatrixElemsForOneBin org_row, cached_row;
+    const Bin bin(1,2,3,4);
+    proj_matrix_no_cache.get_proj_matrix_elems_for_one_bin(org_row, bin);
+    cached_row.set_bin(bin);
+    check(cache.get(cached_row) == Succeeded::no, "row should not be in cache yet");
+    cache.insert(org_row);
+    cache.insert(org_row);
+    cached_row.set_bin(bin);
+    if (check(cache.get(cached_row) == Succeeded::yes, "row should be in cache"))
+      check(org_row == cached_row, "comparing cached row");
+    const ProjMatrixByBinConcurrentCache::Statistics stats =
+      cache.get_statistics(bin.view_num(), bin.segment_num());
+    check_if_equal(stats.num_inserts, 1UL, "number of inserts");
+    check_if_equal(stats.num_duplicate_inserts, 1UL, "number of duplicate inserts");
+    check_if_equal(stats.num_hits, 1UL, "number of hits");
+    check_if_equal(stats.num_misses, 1UL, "number of misses");
+    const ProjMatrixByBinConcurrentCache::Statistics total_stats = cache.get_total_statistics();
+    check_if_equal(total_stats.num_hits, 1UL, "total number of hits");
+    check_if_equal(total_stats.num_misses, 1UL, "total number of misses");
+    check_if_equal(total_stats.num_inserts, 1UL, "total number of inserts");
+  }
+
+  {
+    cerr << "\tTesting the statistics of the concurrent cache with several threads\n";
+    ProjMatrixByBinUsingRayTracing proj_matrix_no_cache;
+    set_up_matrix(proj_matrix_no_cache, false, "hash map");
+    ProjMatrixByBinConcurrentCache cache(*proj_data_info_sptr);
+    const int num_bins = 20;
+    const int num_passes = 10;
+    unsigned long num_gets = 0;
+#ifdef STIR_OPENMP
+#pragma omp parallel reduction(+:num_gets)
+#endif
+    {
+      ProjMatrixElemsForOneBin row;
+      for (int pass=0; pass<num_passes; ++pass)
+        for (int t=0; t<num_bins; ++t)
+          {
+            const Bin bin(0,1,2,t-num_bins/2);
+            row.set_bin(bin);
+            ++num_gets;
+            if (cache.get(row) == Succeeded::no)
+              {
+                proj_matrix_no_cache.get_proj_matrix_elems_for_one_bin(row, bin);
+                cache.insert(row);
+              }
+          }
+    }
+    const ProjMatrixByBinConcurrentCache::Statistics total_stats = cache.get_total_statistics();
+    check_if_equal(total_stats.num_hits + total_stats.num_misses, num_gets, "total number of hits and misses");
+    check_if_equal(total_stats.num_inserts, static_cast<unsigned long>(num_bins), "total number of inserts");
+    check_if_equal(total_stats.num_inserts + total_stats.num_duplicate_inserts, total_stats.num_misses,
+                   "every miss should lead to an insert");
+    // all bins are in the same bucket
+    const ProjMatrixByBinConcurrentCache::Statistics stats = cache.get_statistics(1, 0);
+    check_if_equal(stats.num_hits, total_stats.num_hits, "number of hits of the bucket");
+    check_if_equal(stats.num_misses, total_stats.num_misses, "number of misses of the bucket");
+  }
+
+  {
+    cerr << "\tTesting ProjMatrixByBin with \"cache type := concurrent\"\n";
+    ProjMatrixByBinUsingRayTracing proj_matrix_no_cache;
+    set_up_matrix(proj_matrix_no_cache, false, "hash map");
+    ProjMatrixByBinUsingRayTracing proj_matrix_concurrent;
+    set_up_matrix(proj_matrix_concurrent, true, "concurrent");
+    check(proj_matrix_concurrent.get_cache_type() == ProjMatrixByBin::concurrent_cache, "cache type");
+
+    const int min_segment_num = proj_data_info_sptr->get_min_segment_num();
+    const int max_segment_num = proj_data_info_sptr->get_max_segment_num();
+    bool all_equal = true;
+    // run twice to test if elements retrieved from the cache are fine
+    for (int pass=0; pass<2; ++pass)
+      {
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(&&:all_equal)
+#endif
+        for (int s=min_segment_num; s<=max_segment_num; ++s)
+          {
+            ProjMatrixElemsForOneBin org_row, cached_row;
+            for (int v=proj_data_info_sptr->get_min_view_num(); v <= proj_data_info_sptr->get_max_view_num(); ++v)
+              for (int a=proj_data_info_sptr->get_min_axial_pos_num(s); a <= proj_data_info_sptr->get_max_axial_pos_num(s); a+=3)
+                for (int t=-9; t<=9; t+=3)
+                  {
+                    const Bin bin(s,v,a,t);
+                    proj_matrix_no_cache.get_proj_matrix_elems_for_one_bin(org_row, bin);
+                    proj_matrix_concurrent.get_proj_matrix_elems_for_one_bin(cached_row, bin);
+                    if (!(org_row == cached_row))
+                      all_equal = false;
+                  }
+          }
+      }
+    check(all_equal, "comparing rows computed with concurrent cache");
+    proj_matrix_concurrent.report_cache_statistics(cerr);
+  }
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  ProjMatrixByBinCachesTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
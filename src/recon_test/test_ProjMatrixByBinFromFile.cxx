@@ -0,0 +1,183 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for stir::ProjMatrixByBinFromFile
+
+  Writes a stir::ProjMatrixByBinUsingRayTracing to file (in both file format versions),
+  reads it back (with and without memory mapping) and compares all rows.
+  Also checks that a file is rejected when the template image is changed.
+*/
+
+#include "stir/VoxelsOnCartesianGrid.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/Scanner.h"
+#include "stir/recon_buildblock/ProjMatrixByBinUsingRayTracing.h"
+#include "stir/recon_buildblock/ProjMatrixByBinFromFile.h"
+#include "stir/recon_buildblock/ProjMatrixElemsForOneBin.h"
+#include "stir/IO/OutputFileFormat.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#ifndef STIR_NO_NAMESPACES
+using std::stringstream;
+using std::cerr;
+using std::string;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for ProjMatrixByBinFromFile
+*/
+class ProjMatrixByBinFromFileTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  //! read the matrix back from file and compare with the original
+  void test_read(const string& prefix, const bool use_memory_mapping);
+  shared_ptr<ProjDataInfo> proj_data_info_sptr;
+  shared_ptr<DiscretisedDensity<3,float> > density_sptr;
+  shared_ptr<ProjMatrixByBinUsingRayTracing> proj_matrix_sptr;
+};
+
+void
+ProjMatrixByBinFromFileTests::
+test_read(const string& prefix, const bool use_memory_mapping)
+{
+  ProjMatrixByBinFromFile proj_matrix_from_file;
+  {
+    // use the header written by write_to_file, but add our own setting
+    stringstream str;
+    str << "Projection Matrix By Bin From File Parameters:=\n"
+        << "use memory mapping := " << (use_memory_mapping ? 1 : 0) << '\n';
+    std::ifstream header((prefix + ".hpm").c_str());
+    string line;
+    std::getline(header, line); // skip start key
+    while (std::getline(header, line))
+      str << line << '\n';
+    if (!check(proj_matrix_from_file.parse(str), "parsing header"))
+      return;
+  }
+  proj_matrix_from_file.set_up(proj_data_info_sptr, density_sptr);
+
+  bool all_equal = true;
+  ProjMatrixElemsForOneBin org_row, row_from_file;
+  for (int s=proj_data_info_sptr->get_min_segment_num(); s<=proj_data_info_sptr->get_max_segment_num(); ++s)
+    for (int v=proj_data_info_sptr->get_min_view_num(); v <= proj_data_info_sptr->get_max_view_num(); ++v)
+      for (int a=proj_data_info_sptr->get_min_axial_pos_num(s); a <= proj_data_info_sptr->get_max_axial_pos_num(s); ++a)
+        for (int t=proj_data_info_sptr->get_min_tangential_pos_num(); t<=proj_data_info_sptr->get_max_tangential_pos_num(); ++t)
+          {
+            const Bin bin(s,v,a,t);
+            proj_matrix_sptr->get_proj_matrix_elems_for_one_bin(org_row, bin);
+            proj_matrix_from_file.get_proj_matrix_elems_for_one_bin(row_from_file, bin);
+            if (!(org_row == row_from_file))
+              {
+                all_equal = false;
+                cerr << "Rows differ for bin (s=" << s << ",v=" << v << ",a=" << a << ",t=" << t << ")\n";
+              }
+          }
+  check(all_equal, "comparing rows read from file with original");
+}
+
+void
+ProjMatrixByBinFromFileTests::run_tests()
+{
+  cerr << "Tests for ProjMatrixByBinFromFile\n";
+
+  shared_ptr<Scanner> scanner_sptr(new Scanner(Scanner::E953));
+  proj_data_info_sptr.reset(
+    ProjDataInfo::ProjDataInfoCTI(scanner_sptr,
+                                  /*span=*/3,
+                                  /*max_delta=*/6,
+                                  /*num_views=*/8,
+                                  /*num_tang_poss=*/16));
+  const CartesianCoordinate3D<float> origin (0,0,0);
+  VoxelsOnCartesianGrid<float> * const image_ptr =
+    new VoxelsOnCartesianGrid<float>(*proj_data_info_sptr, .5F, origin,
+                                     CartesianCoordinate3D<int>(31,16,16));
+  // use a voxel size that is exactly preserved when writing the template image to Interfile,
+  // as ProjMatrixByBinFromFile checks that the geometry is identical
+  image_ptr->set_voxel_size(CartesianCoordinate3D<float>(image_ptr->get_voxel_size().z(), 6.F, 6.F));
+  density_sptr.reset(image_ptr);
+
+  proj_matrix_sptr.reset(new ProjMatrixByBinUsingRayTracing);
+  proj_matrix_sptr->set_up(proj_data_info_sptr, density_sptr);
+
+  for (int format_version=1; format_version<=2; ++format_version)
+    {
+      cerr << "\tTesting file format version " << format_version << '\n';
+      stringstream prefix;
+      prefix << "test_ProjMatrixByBinFromFile_v" << format_version;
+      if (!check(ProjMatrixByBinFromFile::write_to_file(prefix.str(), *proj_matrix_sptr,
+                                                        proj_data_info_sptr, *density_sptr,
+                                                        format_version) == Succeeded::yes,
+                 "writing matrix to file"))
+        continue;
+      test_read(prefix.str(), /*use_memory_mapping=*/false);
+      if (format_version == 2)
+        test_read(prefix.str(), /*use_memory_mapping=*/true);
+    }
+
+  {
+    cerr << "\tTesting that a version 2 file is rejected if the template image changed\n";
+    const string prefix = "test_ProjMatrixByBinFromFile_v2";
+    shared_ptr<DiscretisedDensity<3,float> > shifted_density_sptr(density_sptr->clone());
+    // shift by one plane, such that the symmetries remain valid
+    shifted_density_sptr->set_origin(CartesianCoordinate3D<float>(dynamic_cast<VoxelsOnCartesianGrid<float>&>(*shifted_density_sptr).get_voxel_size().z(),0,0));
+    string template_density_filename = prefix + "_template_density";
+    OutputFileFormat<DiscretisedDensity<3,float> >::default_sptr()->
+      write_to_file(template_density_filename, *shifted_density_sptr);
+
+    ProjMatrixByBinFromFile proj_matrix_from_file;
+    check(proj_matrix_from_file.parse((prefix + ".hpm").c_str()), "parsing header");
+    bool rejected = false;
+    try
+      {
+        cerr << "\nThe next test should give an error, but don't worry.\n";
+        proj_matrix_from_file.set_up(proj_data_info_sptr, shifted_density_sptr);
+      }
+    catch (const std::string&)
+      {
+        rejected = true;
+      }
+    check(rejected, "version 2 file with different geometry should be rejected");
+  }
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  ProjMatrixByBinFromFileTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
@@ -0,0 +1,300 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program (and benchmark) for stir::QuadraticPrior
+
+  The value, gradient, parabolic surrogate curvature and multiplication with the
+  Hessian are compared with a straightforward voxel-by-voxel implementation (which
+  was used by QuadraticPrior before it used stir::NeighbourhoodStencil), for
+  different weights and with and without \f$\kappa\f$ image.
+
+  The wall-clock times of both implementations are written to stderr.
+  Pass the number of planes and the size of a plane as arguments to time
+  a larger image, e.g.
+  \verbatim
+  test_QuadraticPrior 200 256
+  \endverbatim
+*/
+
+#include "stir/recon_buildblock/QuadraticPrior.h"
+#include "stir/VoxelsOnCartesianGrid.h"
+#include "stir/IndexRange3D.h"
+#include "stir/HighResWallClockTimer.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+using std::min;
+using std::max;
+#endif
+
+START_NAMESPACE_STIR
+
+namespace
+{
+  //! voxel-by-voxel implementation of the value, as used previously
+  double
+  reference_value(const Array<3,float>& weights, const DiscretisedDensity<3,float>& image,
+                  const DiscretisedDensity<3,float>* kappa_ptr)
+  {
+    double result = 0.;
+    const int min_z = image.get_min_index();
+    const int max_z = image.get_max_index();
+    for (int z=min_z; z<=max_z; z++)
+      {
+        const int min_dz = max(weights.get_min_index(), min_z-z);
+        const int max_dz = min(weights.get_max_index(), max_z-z);
+        const int min_y = image[z].get_min_index();
+        const int max_y = image[z].get_max_index();
+        for (int y=min_y;y<= max_y;y++)
+          {
+            const int min_dy = max(weights[0].get_min_index(), min_y-y);
+            const int max_dy = min(weights[0].get_max_index(), max_y-y);
+            const int min_x = image[z][y].get_min_index();
+            const int max_x = image[z][y].get_max_index();
+            for (int x=min_x;x<= max_x;x++)
+              {
+                const int min_dx = max(weights[0][0].get_min_index(), min_x-x);
+                const int max_dx = min(weights[0][0].get_max_index(), max_x-x);
+                for (int dz=min_dz;dz<=max_dz;++dz)
+                  for (int dy=min_dy;dy<=max_dy;++dy)
+                    for (int dx=min_dx;dx<=max_dx;++dx)
+                      {
+                        float current =
+                          weights[dz][dy][dx] * square(image[z][y][x] - image[z+dz][y+dy][x+dx])/4;
+                        if (kappa_ptr != 0)
+                          current *= (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
+                        result += static_cast<double>(current);
+                      }
+              }
+          }
+      }
+    return result;
+  }
+
+  //! voxel-by-voxel implementation of the gradient, curvature and Hessian multiplication
+  /*! \a type is 0 for the gradient, 1 for the curvature and 2 for the multiplication with
+      the Hessian (which is added to \a output). The result is not multiplied with the
+      penalisation factor.
+  */
+  void
+  reference_sum_over_neighbours(DiscretisedDensity<3,float>& output, const int type,
+                                const Array<3,float>& weights, const DiscretisedDensity<3,float>& image,
+                                const DiscretisedDensity<3,float>* kappa_ptr)
+  {
+    const int min_z = image.get_min_index();
+    const int max_z = image.get_max_index();
+    for (int z=min_z; z<=max_z; z++)
+      {
+        const int min_dz = max(weights.get_min_index(), min_z-z);
+        const int max_dz = min(weights.get_max_index(), max_z-z);
+        const int min_y = image[z].get_min_index();
+        const int max_y = image[z].get_max_index();
+        for (int y=min_y;y<= max_y;y++)
+          {
+            const int min_dy = max(weights[0].get_min_index(), min_y-y);
+            const int max_dy = min(weights[0].get_max_index(), max_y-y);
+            const int min_x = image[z][y].get_min_index();
+            const int max_x = image[z][y].get_max_index();
+            for (int x=min_x;x<= max_x;x++)
+              {
+                const int min_dx = max(weights[0][0].get_min_index(), min_x-x);
+                const int max_dx = min(weights[0][0].get_max_index(), max_x-x);
+                float result = 0;
+                for (int dz=min_dz;dz<=max_dz;++dz)
+                  for (int dy=min_dy;dy<=max_dy;++dy)
+                    for (int dx=min_dx;dx<=max_dx;++dx)
+                      {
+                        float current = weights[dz][dy][dx];
+                        if (type == 0)
+                          current *= image[z][y][x] - image[z+dz][y+dy][x+dx];
+                        else if (type == 2)
+                          current *= image[z+dz][y+dy][x+dx];
+                        if (kappa_ptr != 0)
+                          current *= (*kappa_ptr)[z][y][x] * (*kappa_ptr)[z+dz][y+dy][x+dx];
+                        result += current;
+                      }
+                if (type == 2)
+                  output[z][y][x] += result;
+                else
+                  output[z][y][x] = result;
+              }
+          }
+      }
+  }
+
+  void
+  fill_randomly(DiscretisedDensity<3,float>& image, const float offset)
+  {
+    boost::mt19937 generator;
+    boost::variate_generator<boost::mt19937&, boost::uniform_01<> > random01(generator, boost::uniform_01<>());
+    for (DiscretisedDensity<3,float>::full_iterator iter = image.begin_all(); iter != image.end_all(); ++iter)
+      *iter = offset + static_cast<float>(random01());
+  }
+}
+
+/*!
+  \ingroup test
+  \brief Test class for QuadraticPrior
+*/
+class QuadraticPriorTests : public RunTests
+{
+public:
+  QuadraticPriorTests(const int num_planes, const int plane_size)
+    : num_planes(num_planes), plane_size(plane_size)
+  {}
+  void run_tests();
+private:
+  int num_planes;
+  int plane_size;
+  //! compare with the reference implementation
+  void run_tests_for_prior(QuadraticPrior<float>& prior, const DiscretisedDensity<3,float>& image);
+};
+
+void
+QuadraticPriorTests::
+run_tests_for_prior(QuadraticPrior<float>& prior, const DiscretisedDensity<3,float>& image)
+{
+  const float penalisation_factor = prior.get_penalisation_factor();
+  const shared_ptr<DiscretisedDensity<3,float> > kappa_sptr = prior.get_kappa_sptr();
+  const DiscretisedDensity<3,float>* const kappa_ptr = kappa_sptr.get();
+  HighResWallClockTimer timer;
+
+  {
+    timer.reset(); timer.start();
+    const double value = prior.compute_value(image);
+    timer.stop();
+    const double time_new = timer.value();
+    // weights are computed by the first call if they were not set
+    const Array<3,float> weights = prior.get_weights();
+    timer.reset(); timer.start();
+    const double org_value = reference_value(weights, image, kappa_ptr) * penalisation_factor;
+    timer.stop();
+    cerr << "\t\tvalue: " << time_new << "s (voxel-by-voxel: " << timer.value() << "s)\n";
+    check_if_equal(value, org_value, "value");
+  }
+  const Array<3,float> weights = prior.get_weights();
+  shared_ptr<DiscretisedDensity<3,float> > output_sptr(image.get_empty_copy());
+  shared_ptr<DiscretisedDensity<3,float> > org_output_sptr(image.get_empty_copy());
+  for (int type=0; type<=2; ++type)
+    {
+      const char * const name =
+        type == 0 ? "gradient" : (type == 1 ? "parabolic surrogate curvature" : "multiplication with Hessian");
+      // start with something non-zero such that we test if the Hessian multiplication adds to it
+      output_sptr->fill(1.F);
+      org_output_sptr->fill(0.F);
+      timer.reset(); timer.start();
+      if (type == 0)
+        prior.compute_gradient(*output_sptr, image);
+      else if (type == 1)
+        prior.parabolic_surrogate_curvature(*output_sptr, image);
+      else
+        prior.add_multiplication_with_approximate_Hessian(*output_sptr, image);
+      timer.stop();
+      const double time_new = timer.value();
+      timer.reset(); timer.start();
+      reference_sum_over_neighbours(*org_output_sptr, type, weights, image, kappa_ptr);
+      timer.stop();
+      cerr << "\t\t" << name << ": " << time_new << "s (voxel-by-voxel: " << timer.value() << "s)\n";
+      *org_output_sptr *= penalisation_factor;
+      if (type == 2)
+        *org_output_sptr += 1.F;
+      // The sums are reordered when the kernels are vectorised (e.g. with -ffast-math), and
+      // entries close to 0 lose precision through cancellation. We therefore compare the
+      // largest difference with the largest absolute value.
+      const double max_abs_value = max(org_output_sptr->find_max(), -org_output_sptr->find_min());
+      *output_sptr -= *org_output_sptr;
+      const double max_abs_difference = max(output_sptr->find_max(), -output_sptr->find_min());
+      check_if_zero(max_abs_difference / max(max_abs_value, 1.E-20), name);
+    }
+}
+
+void
+QuadraticPriorTests::
+run_tests()
+{
+  cerr << "Tests for QuadraticPrior\n";
+
+  const CartesianCoordinate3D<float> origin(0,0,0);
+  const CartesianCoordinate3D<float> grid_spacing(2.F,3.F,3.F);
+  const IndexRange3D range(0, num_planes-1,
+                           -plane_size/2, (plane_size-1)/2,
+                           -plane_size/2 + 1, (plane_size-1)/2 + 1);
+  VoxelsOnCartesianGrid<float> image(range, origin, grid_spacing);
+  fill_randomly(image, 1.F);
+  shared_ptr<DiscretisedDensity<3,float> > kappa_sptr(image.get_empty_copy());
+  fill_randomly(*kappa_sptr, .5F);
+  // use different values for the kappas
+  *kappa_sptr *= 2.F;
+
+  {
+    cerr << "\t3D inverse Euclidean weights\n";
+    QuadraticPrior<float> prior(/*only_2D=*/false, 1.3F);
+    run_tests_for_prior(prior, image);
+    cerr << "\t3D inverse Euclidean weights with kappa\n";
+    prior.set_kappa_sptr(kappa_sptr);
+    run_tests_for_prior(prior, image);
+  }
+  {
+    cerr << "\t2D inverse Euclidean weights\n";
+    QuadraticPrior<float> prior(/*only_2D=*/true, 2.F);
+    run_tests_for_prior(prior, image);
+  }
+  {
+    cerr << "\tnon-square weights with kappa\n";
+    Array<3,float> weights(IndexRange3D(-1,1,-2,2,0,0));
+    for (int z=-1; z<=1; ++z)
+      for (int y=-2; y<=2; ++y)
+        weights[z][y][0] = (z==0 && y==0) ? 0.F : 1.F/(1 + std::abs(z) + 2*std::abs(y));
+    QuadraticPrior<float> prior(/*only_2D=*/false, 1.F);
+    prior.set_weights(weights);
+    prior.set_kappa_sptr(kappa_sptr);
+    run_tests_for_prior(prior, image);
+  }
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main(int argc, char **argv)
+{
+  if (argc > 3)
+    {
+      cerr << "Usage: " << argv[0] << " [num_planes [plane_size]]\n";
+      return EXIT_FAILURE;
+    }
+  const int num_planes = argc > 1 ? atoi(argv[1]) : 15;
+  const int plane_size = argc > 2 ? atoi(argv[2]) : 64;
+  QuadraticPriorTests tests(num_planes, plane_size);
+  tests.run_tests();
+  return tests.main_return_value();
+}
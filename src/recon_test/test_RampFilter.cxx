@@ -0,0 +1,141 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for stir::RampFilter
+
+  Checks that RampFilter::apply_to_rows() gives the same result as filtering
+  every row on its own (with RampFilter::operator()), for rows shorter than the
+  filter length (which are zero-padded) and for rows longer than the filter length.
+*/
+
+#include "stir/analytic/FBP2D/RampFilter.h"
+#include "stir/Array.h"
+#include "stir/IndexRange2D.h"
+#include "stir/IndexRange3D.h"
+#include "stir/RunTests.h"
+#include <iostream>
+#include <cmath>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for RampFilter
+*/
+class RampFilterTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  //! fill \a data with some values
+  void fill(Array<2,float>& data);
+  //! compare apply_to_rows with filtering every row
+  void test_rows(const RampFilter& filter, const Array<2,float>& data, const char * const description);
+};
+
+void
+RampFilterTests::
+fill(Array<2,float>& data)
+{
+  for (int r=data.get_min_index(); r<=data.get_max_index(); ++r)
+    for (int i=data[r].get_min_index(); i<=data[r].get_max_index(); ++i)
+      data[r][i] = static_cast<float>(std::sin(.3*i + r) + 1.5 + (i%3 == 0 ? 2 : 0));
+}
+
+void
+RampFilterTests::
+test_rows(const RampFilter& filter, const Array<2,float>& data, const char * const description)
+{
+  cerr << "\tTesting " << description << '\n';
+  Array<2,float> filtered_rows(data);
+  filter.apply_to_rows(filtered_rows);
+
+  Array<2,float> filtered_row_by_row(data);
+  for (int r=filtered_row_by_row.get_min_index(); r<=filtered_row_by_row.get_max_index(); ++r)
+    filter(filtered_row_by_row[r]);
+
+  check(filtered_row_by_row.find_max() > 0.F, "filtered data should not be zero");
+  // compare with a tolerance relative to the maximum, as the filter makes some values close to 0
+  const float max_abs_value =
+    std::max(filtered_row_by_row.find_max(), -filtered_row_by_row.find_min());
+  Array<2,float> diff(filtered_rows);
+  diff -= filtered_row_by_row;
+  const float max_abs_diff = std::max(diff.find_max(), -diff.find_min());
+  check(max_abs_diff <= max_abs_value*1.E-5F,
+        "apply_to_rows should give the same result as filtering every row");
+  if (!is_everything_ok())
+    cerr << "max abs diff " << max_abs_diff << " (max abs value " << max_abs_value << ")\n";
+
+  // check 3D version as well
+  Array<3,float> data_3d(IndexRange3D(-1, 1,
+                                      data.get_min_index(), data.get_max_index(),
+                                      data[data.get_min_index()].get_min_index(),
+                                      data[data.get_min_index()].get_max_index()));
+  for (int p=data_3d.get_min_index(); p<=data_3d.get_max_index(); ++p)
+    data_3d[p] = data;
+  filter.apply_to_rows(data_3d);
+  for (int p=data_3d.get_min_index(); p<=data_3d.get_max_index(); ++p)
+    {
+      Array<2,float> diff_3d(data_3d[p]);
+      diff_3d -= filtered_row_by_row;
+      check(std::max(diff_3d.find_max(), -diff_3d.find_min()) <= max_abs_value*1.E-5F,
+            "apply_to_rows for 3D array should give the same result as filtering every row");
+    }
+}
+
+void
+RampFilterTests::
+run_tests()
+{
+  cerr << "Tests for RampFilter\n";
+  const int filter_length = 64;
+  const RampFilter filter(/*sampledist=*/2.F, filter_length, /*alpha=*/.8F, /*fc=*/.4F);
+  {
+    // rows with negative indices, as for viewgrams
+    Array<2,float> data(IndexRange2D(0, 20, -23, 24));
+    fill(data);
+    test_rows(filter, data, "rows shorter than the filter length");
+  }
+  {
+    // these rows are not zero-padded, but handled by RampFilter::operator()
+    Array<2,float> data(IndexRange2D(-2, 10, -50, 49));
+    fill(data);
+    test_rows(filter, data, "rows longer than the filter length");
+  }
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  RampFilterTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
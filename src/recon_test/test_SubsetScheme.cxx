@@ -0,0 +1,270 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for stir::SubsetScheme and its derived classes
+
+  Tests
+  - that every basic view/segment number is in exactly one subset
+  - that the natural interleaved scheme gives the same subsets as
+    stir::detail::find_basic_vs_nums_in_subset
+  - that the golden angle and random orders use a permutation of the view offsets
+  - that the balanced scheme balances the number of viewgrams and sorts the
+    view/segment numbers by decreasing size
+*/
+
+#include "stir/recon_buildblock/InterleavedSubsetScheme.h"
+#include "stir/recon_buildblock/BalancedSubsetScheme.h"
+#include "stir/recon_buildblock/find_basic_vs_nums_in_subsets.h"
+#include "stir/recon_buildblock/DataSymmetriesForBins_PET_CartesianGrid.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/VoxelsOnCartesianGrid.h"
+#include "stir/Scanner.h"
+#include "stir/RunTests.h"
+#include <boost/format.hpp>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <iostream>
+#include <string>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+using std::string;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for SubsetScheme
+*/
+class SubsetSchemeTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  shared_ptr<ProjDataInfo> proj_data_info_sptr;
+  shared_ptr<DataSymmetriesForViewSegmentNumbers> symmetries_sptr;
+
+  //! check that every basic view/segment number is in exactly one subset
+  void test_partition(const SubsetScheme& scheme, const string& name, const int num_subsets);
+  void test_interleaved(const int num_subsets);
+  void test_balanced(const int num_subsets);
+  int num_viewgrams(const std::vector<ViewSegmentNumbers>&) const;
+};
+
+int
+SubsetSchemeTests::
+num_viewgrams(const std::vector<ViewSegmentNumbers>& vs_nums) const
+{
+  int num = 0;
+  for (std::vector<ViewSegmentNumbers>::const_iterator iter = vs_nums.begin();
+       iter != vs_nums.end(); ++iter)
+    num += symmetries_sptr->num_related_view_segment_numbers(*iter);
+  return num;
+}
+
+void
+SubsetSchemeTests::
+test_partition(const SubsetScheme& scheme, const string& name, const int num_subsets)
+{
+  const string prefix = boost::str(boost::format("%1% with %2% subsets: ") % name % num_subsets);
+  const int min_segment_num = proj_data_info_sptr->get_min_segment_num();
+  const int max_segment_num = proj_data_info_sptr->get_max_segment_num();
+
+  std::map<ViewSegmentNumbers, int> count;
+  for (int subset_num=0; subset_num<num_subsets; ++subset_num)
+    {
+      const std::vector<ViewSegmentNumbers> vs_nums =
+        scheme.find_basic_vs_nums_in_subset(*proj_data_info_sptr, *symmetries_sptr,
+                                            min_segment_num, max_segment_num,
+                                            subset_num, num_subsets);
+      for (std::vector<ViewSegmentNumbers>::const_iterator iter = vs_nums.begin();
+           iter != vs_nums.end(); ++iter)
+        {
+          check(symmetries_sptr->is_basic(*iter), prefix + "only basic view/segment numbers");
+          ++count[*iter];
+        }
+    }
+
+  int num_basic = 0;
+  for (int segment_num = min_segment_num; segment_num <= max_segment_num; ++segment_num)
+    for (int view_num = proj_data_info_sptr->get_min_view_num();
+         view_num <= proj_data_info_sptr->get_max_view_num();
+         ++view_num)
+      {
+        const ViewSegmentNumbers vs_num(view_num, segment_num);
+        if (!symmetries_sptr->is_basic(vs_num))
+          continue;
+        ++num_basic;
+        check_if_equal(count[vs_num], 1,
+                       prefix + boost::str(boost::format("view %1%, segment %2% should be in one subset")
+                                           % view_num % segment_num));
+      }
+  check_if_equal(static_cast<int>(count.size()), num_basic, prefix + "number of basic view/segment numbers");
+}
+
+void
+SubsetSchemeTests::
+test_interleaved(const int num_subsets)
+{
+  const int min_segment_num = proj_data_info_sptr->get_min_segment_num();
+  const int max_segment_num = proj_data_info_sptr->get_max_segment_num();
+
+  {
+    InterleavedSubsetScheme scheme;
+    test_partition(scheme, "natural interleaved", num_subsets);
+    for (int subset_num=0; subset_num<num_subsets; ++subset_num)
+      {
+        check_if_equal(scheme.get_view_offset(subset_num, num_subsets), subset_num,
+                       "natural interleaved: view offset");
+        const std::vector<ViewSegmentNumbers> vs_nums =
+          scheme.find_basic_vs_nums_in_subset(*proj_data_info_sptr, *symmetries_sptr,
+                                              min_segment_num, max_segment_num,
+                                              subset_num, num_subsets);
+        const std::vector<ViewSegmentNumbers> org_vs_nums =
+          detail::find_basic_vs_nums_in_subset(*proj_data_info_sptr, *symmetries_sptr,
+                                               min_segment_num, max_segment_num,
+                                               subset_num, num_subsets);
+        check(vs_nums == org_vs_nums, "natural interleaved should be the same as the original subsets");
+      }
+  }
+
+  const char * const orders[] = { "golden angle", "random" };
+  for (unsigned int i=0; i<sizeof(orders)/sizeof(orders[0]); ++i)
+    {
+      InterleavedSubsetScheme scheme;
+      scheme.set_subset_order(orders[i]);
+      scheme.set_random_seed(42);
+      test_partition(scheme, string(orders[i]) + " interleaved", num_subsets);
+
+      std::vector<int> offsets(num_subsets);
+      for (int subset_num=0; subset_num<num_subsets; ++subset_num)
+        offsets[subset_num] = scheme.get_view_offset(subset_num, num_subsets);
+      std::sort(offsets.begin(), offsets.end());
+      for (int subset_num=0; subset_num<num_subsets; ++subset_num)
+        check_if_equal(offsets[subset_num], subset_num,
+                       string(orders[i]) + " interleaved: offsets should be a permutation");
+    }
+}
+
+void
+SubsetSchemeTests::
+test_balanced(const int num_subsets)
+{
+  const int min_segment_num = proj_data_info_sptr->get_min_segment_num();
+  const int max_segment_num = proj_data_info_sptr->get_max_segment_num();
+
+  BalancedSubsetScheme scheme;
+  test_partition(scheme, "balanced", num_subsets);
+
+  int max_num_related = 0;
+  for (int segment_num = min_segment_num; segment_num <= max_segment_num; ++segment_num)
+    for (int view_num = proj_data_info_sptr->get_min_view_num();
+         view_num <= proj_data_info_sptr->get_max_view_num();
+         ++view_num)
+      max_num_related =
+        std::max(max_num_related,
+                 symmetries_sptr->num_related_view_segment_numbers(ViewSegmentNumbers(view_num, segment_num)));
+
+  int min_num_viewgrams = proj_data_info_sptr->get_num_views() * proj_data_info_sptr->get_num_segments();
+  int max_num_viewgrams = 0;
+  for (int subset_num=0; subset_num<num_subsets; ++subset_num)
+    {
+      const std::vector<ViewSegmentNumbers> vs_nums =
+        scheme.find_basic_vs_nums_in_subset(*proj_data_info_sptr, *symmetries_sptr,
+                                            min_segment_num, max_segment_num,
+                                            subset_num, num_subsets);
+      const int num = num_viewgrams(vs_nums);
+      min_num_viewgrams = std::min(min_num_viewgrams, num);
+      max_num_viewgrams = std::max(max_num_viewgrams, num);
+
+      bool sorted = true;
+      for (unsigned int i=1; i<vs_nums.size(); ++i)
+        {
+          const long prev_num_bins =
+            static_cast<long>(symmetries_sptr->num_related_view_segment_numbers(vs_nums[i-1])) *
+            proj_data_info_sptr->get_num_axial_poss(vs_nums[i-1].segment_num());
+          const long num_bins =
+            static_cast<long>(symmetries_sptr->num_related_view_segment_numbers(vs_nums[i])) *
+            proj_data_info_sptr->get_num_axial_poss(vs_nums[i].segment_num());
+          if (num_bins > prev_num_bins)
+            sorted = false;
+        }
+      check(sorted, "balanced: view/segment numbers should be sorted by decreasing size");
+    }
+  check(max_num_viewgrams - min_num_viewgrams <= max_num_related,
+        boost::str(boost::format("balanced with %1% subsets: number of viewgrams should be balanced (min %2%, max %3%)")
+                   % num_subsets % min_num_viewgrams % max_num_viewgrams));
+}
+
+void
+SubsetSchemeTests::
+run_tests()
+{
+  cerr << "Tests for SubsetScheme\n";
+  shared_ptr<Scanner> scanner_sptr(new Scanner(Scanner::E953));
+  proj_data_info_sptr.reset(
+    ProjDataInfo::ProjDataInfoCTI(scanner_sptr,
+                                  /*span=*/3,
+                                  /*max_delta=*/12,
+                                  /*num_views=*/48,
+                                  /*num_tang_poss=*/16));
+  shared_ptr<DiscretisedDensity<3,float> >
+    density_sptr(new VoxelsOnCartesianGrid<float>(*proj_data_info_sptr));
+  symmetries_sptr.reset(new DataSymmetriesForBins_PET_CartesianGrid(proj_data_info_sptr, density_sptr));
+
+  const int num_subsets_to_test[] = { 1, 3, 4, 7, 12 };
+  for (unsigned int i=0; i<sizeof(num_subsets_to_test)/sizeof(num_subsets_to_test[0]); ++i)
+    {
+      test_interleaved(num_subsets_to_test[i]);
+      test_balanced(num_subsets_to_test[i]);
+    }
+
+  {
+    InterleavedSubsetScheme scheme;
+    bool error_thrown = false;
+    try
+      {
+        cerr << "\nThe next test should give an error\n";
+        scheme.set_subset_order("some unknown order");
+      }
+    catch (...)
+      {
+        error_thrown = true;
+      }
+    check(error_thrown, "set_subset_order with an invalid order should throw");
+  }
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  SubsetSchemeTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
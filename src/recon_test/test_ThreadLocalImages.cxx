@@ -0,0 +1,113 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for stir::ThreadLocalImages
+
+  Every plane of an image is incremented many times from several threads (each
+  time in a different row and column), and the result after the reduction is
+  compared with the expected image.
+*/
+
+#include "stir/recon_buildblock/ThreadLocalImages.h"
+#include "stir/VoxelsOnCartesianGrid.h"
+#include "stir/IndexRange3D.h"
+#include "stir/RunTests.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for ThreadLocalImages
+*/
+class ThreadLocalImagesTests : public RunTests
+{
+public:
+  void run_tests();
+};
+
+void
+ThreadLocalImagesTests::run_tests()
+{
+  cerr << "Tests for ThreadLocalImages\n";
+
+  const CartesianCoordinate3D<float> origin(0,0,0);
+  const CartesianCoordinate3D<float> grid_spacing(2,3,3);
+  const IndexRange3D range(0,4, -6,6, -7,7);
+  VoxelsOnCartesianGrid<float> image(range, origin, grid_spacing);
+  // start with some values, as the result should be added to the target
+  image.fill(1.F);
+  VoxelsOnCartesianGrid<float> expected_image(image);
+
+  const int num_updates = 1000;
+  for (int i=0; i<num_updates; ++i)
+    {
+      const int z = i%5;
+      const int y = -6 + i%13;
+      const int x = -7 + i%15;
+      expected_image[z][y][x] += static_cast<float>(i%7);
+    }
+
+  for (int repeat=0; repeat<2; ++repeat)
+    {
+      VoxelsOnCartesianGrid<float> result_image(image);
+      ThreadLocalImages local_images(result_image);
+      // RunTests::check() is not thread-safe, so record the results and check them afterwards
+      std::vector<int> index_range_ok(num_updates, 0);
+#ifdef STIR_OPENMP
+#pragma omp parallel for shared(local_images, index_range_ok) schedule(dynamic)
+#endif
+      for (int i=0; i<num_updates; ++i)
+        {
+          DiscretisedDensity<3,float>& local_image = local_images.get_local_image();
+          index_range_ok[i] = local_image.get_index_range() == range ? 1 : 0;
+          const int z = i%5;
+          const int y = -6 + i%13;
+          const int x = -7 + i%15;
+          local_image[z][y][x] += static_cast<float>(i%7);
+        }
+      local_images.reduce();
+      check(std::count(index_range_ok.begin(), index_range_ok.end(), 0) == 0,
+            "index range of thread-local images");
+      // values are small integers, so there is no rounding error
+      check_if_equal(result_image, expected_image, "image after reduction");
+    }
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  ThreadLocalImagesTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
@@ -0,0 +1,193 @@
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup test
+  \ingroup Array
+
+  \brief Timing program for the element-wise operations on stir::Array
+
+  For every operation, this times the previous implementation (a loop over all
+  rows) and the element-wise operation (see stir/elementwise_kernels.h) for every
+  instruction set supported by the processor, and prints the speed-up.
+
+  \par Usage
+  \verbatim
+  elementwise_kernels_timing [num_planes [num_rows [num_columns [num_repetitions]]]]
+  \endverbatim
+  The defaults correspond to an image of 128x128x64 voxels.
+  Use the \c OMP_NUM_THREADS environment variable to change the number of threads.
+*/
+
+#include "stir/elementwise_kernels.h"
+#include "stir/Array.h"
+#include "stir/ArrayFunction.h"
+#include "stir/IndexRange3D.h"
+#include "stir/HighResWallClockTimer.h"
+#include "stir/thresholding.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#ifndef STIR_NO_NAMESPACES
+using std::cout;
+using std::cerr;
+using std::setw;
+using std::string;
+#endif
+
+USING_NAMESPACE_STIR
+
+namespace
+{
+  typedef Array<3,float> ArrayType;
+
+  //! the operations that are timed
+  enum Operation { op_add, op_multiply, op_divide, op_multiply_scalar, op_log, op_exp, op_threshold, op_divide_unless_small };
+  const char * const operation_names[] =
+    { "a += b", "a *= b", "a /= b", "a *= value", "log(a)", "exp(a)",
+      "threshold(a)", "a/b unless small" };
+  const int num_operations = sizeof(operation_names)/sizeof(operation_names[0]);
+
+  //! the previous implementation, looping over all rows
+  void
+  apply_using_rows(const Operation operation, ArrayType& a, const ArrayType& b)
+  {
+    for (int z=a.get_min_index(); z<=a.get_max_index(); ++z)
+      for (int y=a[z].get_min_index(); y<=a[z].get_max_index(); ++y)
+        {
+          Array<1,float>& row = a[z][y];
+          const Array<1,float>& b_row = b[z][y];
+          for (int x=row.get_min_index(); x<=row.get_max_index(); ++x)
+            switch (operation)
+              {
+              case op_add: row[x] += b_row[x]; break;
+              case op_multiply: row[x] *= b_row[x]; break;
+              case op_divide: row[x] /= b_row[x]; break;
+              case op_multiply_scalar: row[x] *= 1.0001F; break;
+              case op_log: row[x] = std::log(row[x]); break;
+              case op_exp: row[x] = std::exp(row[x]); break;
+              case op_threshold:
+                if (row[x] > 5.F) row[x] = 5.F; else if (.5F > row[x]) row[x] = .5F;
+                break;
+              case op_divide_unless_small:
+                row[x] = std::fabs(b_row[x])<=1.E-6F && std::fabs(row[x])<=1.E-6F ? 0.F : row[x]/b_row[x];
+                break;
+              }
+        }
+  }
+
+  //! the new implementation
+  void
+  apply_using_elementwise_kernels(const Operation operation, ArrayType& a, const ArrayType& b)
+  {
+    float * const a_ptr = a.get_full_data_ptr();
+    const float * const b_ptr = b.get_const_full_data_ptr();
+    const std::size_t n = a.size_all();
+    switch (operation)
+      {
+      case op_add: a += b; break;
+      case op_multiply: a *= b; break;
+      case op_divide: a /= b; break;
+      case op_multiply_scalar: a *= 1.0001F; break;
+      case op_log: in_place_log(a); break;
+      case op_exp: in_place_exp(a); break;
+      case op_threshold: threshold_upper_lower(a_ptr, a_ptr + n, .5F, 5.F); break;
+      case op_divide_unless_small: elementwise_divide_unless_small(a_ptr, b_ptr, n, 1.E-6F); break;
+      }
+  }
+
+  //! fill with values for which all operations are well-defined
+  void
+  fill_with_positive_values(ArrayType& a)
+  {
+    for (ArrayType::full_iterator iter = a.begin_all(); iter != a.end_all(); ++iter)
+      *iter = 1.F + static_cast<float>(std::rand() % 1000) / 1000.F;
+  }
+
+  //! time \a num_repetitions calls, returns the time per call in seconds
+  double
+  time_operation(const Operation operation, ArrayType& a, const ArrayType& b,
+                 const int num_repetitions, const bool use_elementwise_kernels)
+  {
+    HighResWallClockTimer timer;
+    double total_time = 0.;
+    for (int i=0; i<num_repetitions; ++i)
+      {
+        // restart from the same values to avoid overflow etc
+        fill_with_positive_values(a);
+        timer.reset();
+        timer.start();
+        if (use_elementwise_kernels)
+          apply_using_elementwise_kernels(operation, a, b);
+        else
+          apply_using_rows(operation, a, b);
+        timer.stop();
+        total_time += timer.value();
+      }
+    return total_time / num_repetitions;
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  if (argc > 5)
+    {
+      cerr << "Usage: " << argv[0] << " [num_planes [num_rows [num_columns [num_repetitions]]]]\n";
+      return EXIT_FAILURE;
+    }
+  const int num_planes = argc>1 ? std::atoi(argv[1]) : 64;
+  const int num_rows = argc>2 ? std::atoi(argv[2]) : 128;
+  const int num_columns = argc>3 ? std::atoi(argv[3]) : 128;
+  const int num_repetitions = argc>4 ? std::atoi(argv[4]) : 20;
+
+  const IndexRange3D range(0, num_planes-1, -(num_rows/2), num_rows-1-(num_rows/2),
+                           -(num_columns/2), num_columns-1-(num_columns/2));
+  ArrayType a(range);
+  ArrayType b(range);
+  fill_with_positive_values(b);
+
+  const std::vector<string> instruction_sets = get_supported_elementwise_instruction_sets();
+  cout << "Image size " << num_planes << "x" << num_rows << "x" << num_columns
+       << ", time per call in ms (speed-up w.r.t. the loop over rows)\n";
+  cout << setw(18) << "operation" << setw(18) << "loop over rows";
+  for (unsigned int i=0; i<instruction_sets.size(); ++i)
+    cout << setw(18) << instruction_sets[i];
+  cout << '\n';
+
+  for (int operation_num=0; operation_num<num_operations; ++operation_num)
+    {
+      const Operation operation = static_cast<Operation>(operation_num);
+      const double reference_time =
+        time_operation(operation, a, b, num_repetitions, /*use_elementwise_kernels=*/false);
+      cout << setw(18) << operation_names[operation_num]
+           << setw(18) << std::fixed << std::setprecision(3) << reference_time*1000;
+      for (unsigned int i=0; i<instruction_sets.size(); ++i)
+        {
+          set_elementwise_instruction_set(instruction_sets[i]);
+          const double time =
+            time_operation(operation, a, b, num_repetitions, /*use_elementwise_kernels=*/true);
+          cout << setw(10) << time*1000 << " (" << std::setprecision(1) << setw(4)
+               << reference_time/time << ")" << std::setprecision(3);
+        }
+      cout << '\n';
+    }
+  return EXIT_SUCCESS;
+}
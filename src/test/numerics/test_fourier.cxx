@@ -0,0 +1,364 @@
+//
+//
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup numerics_test
+  \brief tests the functions in stir/numerics/fourier.h and the classes in stir/numerics/FFTPlan.h
+
+  The transforms are compared with a direct evaluation of the DFT for lengths
+  with factors 2, 3, 5 and other primes, and the inverse transforms are checked
+  to give back the original data.
+*/
+
+#include "stir/RunTests.h"
+#include "stir/numerics/fourier.h"
+#include "stir/numerics/FFTPlan.h"
+#include "stir/IndexRange2D.h"
+#include "stir/IndexRange3D.h"
+#include "stir/array_index_functions.h"
+#include <boost/format.hpp>
+#include <complex>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#ifdef STIR_OPENMP
+#include <omp.h>
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup numerics_test
+  \brief A class to test the DFT functions.
+*/
+class FourierTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  typedef std::complex<float> complex_t;
+
+  //! checks that the largest difference is small compared to the largest element of \a expected
+  template <class IterT1, class IterT2>
+  void check_if_almost_equal(IterT1 begin, IterT1 end, IterT2 expected_begin, IterT2 expected_end,
+                             const std::string& str);
+
+  void test_complex_transforms();
+  void test_real_transforms();
+  void test_transforms_of_rows();
+  void test_multi_dimensional_transforms();
+  void test_plans();
+};
+
+namespace
+{
+  //! direct (slow) evaluation of the DFT
+  std::vector<std::complex<double> >
+  direct_DFT(const std::vector<std::complex<float> >& data, const int sign)
+  {
+    const int n = static_cast<int>(data.size());
+    std::vector<std::complex<double> > result(n);
+    for (int s=0; s<n; ++s)
+      for (int r=0; r<n; ++r)
+        {
+          const double angle = sign*2*_PI*((static_cast<long>(r)*s) % n)/n;
+          result[s] += std::complex<double>(data[r])*std::complex<double>(std::cos(angle), std::sin(angle));
+        }
+    return result;
+  }
+
+  float random_value()
+  {
+    return static_cast<float>(std::rand()%2000)/1000.F - 1.F;
+  }
+}
+
+template <class IterT1, class IterT2>
+void
+FourierTests::
+check_if_almost_equal(IterT1 begin, IterT1 end, IterT2 expected_begin, IterT2 expected_end,
+                      const std::string& str)
+{
+  double max_diff = 0.;
+  double max_value = 1.;
+  IterT2 expected_iter = expected_begin;
+  for (IterT1 iter = begin; iter != end && expected_iter != expected_end; ++iter, ++expected_iter)
+    {
+      const std::complex<double> value(*iter);
+      const std::complex<double> expected(*expected_iter);
+      max_diff = std::max(max_diff, std::abs(value - expected));
+      max_value = std::max(max_value, std::abs(expected));
+    }
+  check(std::distance(begin, end) == std::distance(expected_begin, expected_end), str + ": sizes differ");
+  check(max_diff <= 1.E-5*max_value, str);
+  if (max_diff > 1.E-5*max_value)
+    std::cerr << "Maximum difference " << max_diff << " for maximum value " << max_value << "\n";
+}
+
+void
+FourierTests::
+test_complex_transforms()
+{
+  std::cerr << "Testing complex DFTs\n";
+  const int lengths[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 12, 15, 16, 25, 27, 30, 49, 60, 64, 77, 90, 97, 100, 120, 125, 243, 256, 1000 };
+  for (unsigned int l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l)
+    for (int sign=-1; sign<=1; sign+=2)
+      {
+        const int length = lengths[l];
+        const std::string prefix = boost::str(boost::format("length %1%, sign %2%: ") % length % sign);
+        std::vector<complex_t> data(length);
+        for (int i=0; i<length; ++i)
+          data[i] = complex_t(random_value(), random_value());
+        const std::vector<std::complex<double> > expected = direct_DFT(data, sign);
+
+        // FFTPlan, using a stride
+        {
+          std::vector<complex_t> strided_data(2*length);
+          for (int i=0; i<length; ++i)
+            strided_data[2*i] = data[i];
+          std::vector<complex_t> result(length);
+          FFTPlan<float>::get_plan(length, sign)->transform(&result[0], &strided_data[0], 2);
+          check_if_almost_equal(result.begin(), result.end(), expected.begin(), expected.end(),
+                                prefix + "FFTPlan::transform with stride");
+        }
+        // fourier_1d and inverse
+        {
+          Array<1,complex_t> array(length);
+          std::copy(data.begin(), data.end(), array.begin());
+          fourier_1d(array, sign);
+          check_if_almost_equal(array.begin(), array.end(), expected.begin(), expected.end(),
+                                prefix + "fourier_1d");
+          inverse_fourier_1d(array, sign);
+          check_if_almost_equal(array.begin(), array.end(), data.begin(), data.end(),
+                                prefix + "inverse_fourier_1d");
+        }
+      }
+}
+
+void
+FourierTests::
+test_real_transforms()
+{
+  std::cerr << "Testing DFTs of real data\n";
+  const int lengths[] = { 2, 4, 6, 10, 12, 18, 30, 64, 90, 100, 126, 1000 };
+  for (unsigned int l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l)
+    for (int sign=-1; sign<=1; sign+=2)
+      {
+        const int length = lengths[l];
+        const std::string prefix = boost::str(boost::format("real data, length %1%, sign %2%: ") % length % sign);
+        Array<1,float> data(length);
+        std::vector<complex_t> complex_data(length);
+        for (int i=0; i<length; ++i)
+          {
+            data[i] = random_value();
+            complex_data[i] = data[i];
+          }
+        const std::vector<std::complex<double> > expected = direct_DFT(complex_data, sign);
+        Array<1,complex_t> result = fourier_1d_for_real_data(data, sign);
+        check_if_equal(result.get_min_index(), 0, prefix + "min index of fourier_1d_for_real_data");
+        check_if_equal(result.get_max_index(), length/2, prefix + "max index of fourier_1d_for_real_data");
+        check_if_almost_equal(result.begin(), result.end(), expected.begin(), expected.begin()+length/2+1,
+                              prefix + "fourier_1d_for_real_data");
+        const Array<1,float> inverse = inverse_fourier_1d_for_real_data_corrupting_input(result, sign);
+        check_if_almost_equal(inverse.begin(), inverse.end(), data.begin(), data.end(),
+                              prefix + "inverse_fourier_1d_for_real_data");
+      }
+}
+
+void
+FourierTests::
+test_transforms_of_rows()
+{
+  std::cerr << "Testing DFTs of all rows\n";
+  // use index ranges as in a Viewgram (i.e. rows not starting from 0)
+  const int num_rows = 11;
+  const int length = 90;
+  Array<2,float> rows(IndexRange2D(-3, num_rows-4, -length/2, length/2-1));
+  for (Array<2,float>::full_iterator iter = rows.begin_all(); iter != rows.end_all(); ++iter)
+    *iter = random_value();
+
+  Array<2,complex_t> result;
+  fourier_1d_for_real_data_of_rows(result, rows);
+  check_if_equal(result.get_index_range(), IndexRange<2>(IndexRange2D(-3, num_rows-4, 0, length/2)),
+                 "index range of fourier_1d_for_real_data_of_rows");
+  for (int r=rows.get_min_index(); r<=rows.get_max_index(); ++r)
+    {
+      Array<1,float> row(length);
+      std::copy(rows[r].begin(), rows[r].end(), row.begin());
+      const Array<1,complex_t> expected = fourier_1d_for_real_data(row);
+      check_if_almost_equal(result[r].begin(), result[r].end(), expected.begin(), expected.end(),
+                            "fourier_1d_for_real_data_of_rows");
+    }
+
+  // inverse into array with the same index range
+  Array<2,float> inverse(rows.get_index_range());
+  inverse_fourier_1d_for_real_data_of_rows(inverse, result);
+  check_if_equal(inverse.get_index_range(), rows.get_index_range(),
+                 "inverse_fourier_1d_for_real_data_of_rows should keep index range");
+  check_if_almost_equal(inverse.begin_all_const(), inverse.end_all_const(),
+                        rows.begin_all_const(), rows.end_all_const(),
+                        "inverse_fourier_1d_for_real_data_of_rows");
+  // inverse into array with different index range
+  Array<2,float> inverse_from_0;
+  inverse_fourier_1d_for_real_data_of_rows(inverse_from_0, result);
+  check_if_equal(inverse_from_0.get_index_range(), IndexRange<2>(IndexRange2D(-3, num_rows-4, 0, length-1)),
+                 "inverse_fourier_1d_for_real_data_of_rows should resize to rows starting from 0");
+  check_if_almost_equal(inverse_from_0.begin_all_const(), inverse_from_0.end_all_const(),
+                        rows.begin_all_const(), rows.end_all_const(),
+                        "inverse_fourier_1d_for_real_data_of_rows (resized)");
+}
+
+void
+FourierTests::
+test_multi_dimensional_transforms()
+{
+  std::cerr << "Testing multi-dimensional DFTs\n";
+  {
+    const int sizes[][2] = { {6,10}, {9,12}, {16,16}, {15,30} };
+    for (unsigned int i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i)
+      {
+        const std::string prefix = boost::str(boost::format("2D %1%x%2%: ") % sizes[i][0] % sizes[i][1]);
+        Array<2,float> data(IndexRange2D(sizes[i][0], sizes[i][1]));
+        Array<2,complex_t> complex_data(data.get_index_range());
+        Array<2,complex_t>::full_iterator complex_iter = complex_data.begin_all();
+        for (Array<2,float>::full_iterator iter = data.begin_all(); iter != data.end_all(); ++iter, ++complex_iter)
+          *complex_iter = *iter = random_value();
+
+        fourier(complex_data);
+        const Array<2,complex_t> result = fourier_for_real_data(data);
+        Array<2,complex_t> all_frequencies = pos_frequencies_to_all(result);
+        check_if_almost_equal(all_frequencies.begin_all_const(), all_frequencies.end_all_const(),
+                              complex_data.begin_all_const(), complex_data.end_all_const(),
+                              prefix + "fourier_for_real_data");
+        const Array<2,float> inverse = inverse_fourier_for_real_data(result);
+        check_if_almost_equal(inverse.begin_all_const(), inverse.end_all_const(),
+                              data.begin_all_const(), data.end_all_const(),
+                              prefix + "inverse_fourier_for_real_data");
+      }
+  }
+  {
+    Array<3,float> data(IndexRange3D(3,5,8));
+    Array<3,complex_t> complex_data(data.get_index_range());
+    Array<3,complex_t>::full_iterator complex_iter = complex_data.begin_all();
+    for (Array<3,float>::full_iterator iter = data.begin_all(); iter != data.end_all(); ++iter, ++complex_iter)
+      *complex_iter = *iter = random_value();
+
+    Array<3,complex_t> inverse_complex_data(complex_data);
+    fourier(complex_data);
+    const Array<3,complex_t> result = fourier_for_real_data(data);
+    Array<3,complex_t> all_frequencies = pos_frequencies_to_all(result);
+    check_if_almost_equal(all_frequencies.begin_all_const(), all_frequencies.end_all_const(),
+                          complex_data.begin_all_const(), complex_data.end_all_const(),
+                          "3D: fourier_for_real_data");
+    inverse_fourier(complex_data);
+    check_if_almost_equal(complex_data.begin_all_const(), complex_data.end_all_const(),
+                          inverse_complex_data.begin_all_const(), inverse_complex_data.end_all_const(),
+                          "3D: inverse_fourier");
+    const Array<3,float> inverse = inverse_fourier_for_real_data(result);
+    check_if_almost_equal(inverse.begin_all_const(), inverse.end_all_const(),
+                          data.begin_all_const(), data.end_all_const(),
+                          "3D: inverse_fourier_for_real_data");
+  }
+}
+
+void
+FourierTests::
+test_plans()
+{
+  std::cerr << "Testing plans\n";
+  check(FFTPlan<float>::get_plan(120, 1) == FFTPlan<float>::get_plan(120, 1),
+        "get_plan should return the same plan for the same length");
+  check(FFTPlan<float>::get_plan(120, 1) != FFTPlan<float>::get_plan(120, -1),
+        "get_plan should return different plans for different signs");
+  {
+    const std::vector<int> radices = FFTPlan<float>::get_plan(120, 1)->get_radices();
+    int product = 1;
+    for (unsigned int i=0; i<radices.size(); ++i)
+      {
+        check(radices[i]==2 || radices[i]==3 || radices[i]==4 || radices[i]==5,
+              "120 should be split in radices 2, 3, 4 and 5");
+        product *= radices[i];
+      }
+    check_if_equal(product, 120, "product of radices should be the length");
+  }
+
+  check_if_equal(get_efficient_fourier_length(0), 2, "get_efficient_fourier_length(0)");
+  check_if_equal(get_efficient_fourier_length(7), 8, "get_efficient_fourier_length(7)");
+  check_if_equal(get_efficient_fourier_length(11), 12, "get_efficient_fourier_length(11)");
+  check_if_equal(get_efficient_fourier_length(13), 16, "get_efficient_fourier_length(13)");
+  check_if_equal(get_efficient_fourier_length(97), 100, "get_efficient_fourier_length(97)");
+  check_if_equal(get_efficient_fourier_length(129), 144, "get_efficient_fourier_length(129)");
+  check_if_equal(get_efficient_fourier_length(384), 384, "get_efficient_fourier_length(384)");
+
+#ifdef STIR_OPENMP
+  {
+    // get and use plans from multiple threads at the same time
+    const int num_lengths = 40;
+    std::vector<shared_ptr<const RealFFTPlan<float> > > plans(num_lengths);
+    std::vector<int> num_failures(num_lengths, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int i=0; i<num_lengths; ++i)
+      {
+        const int length = 2*(200 + i%10);
+        plans[i] = RealFFTPlan<float>::get_plan(length, 1);
+        std::vector<float> data(length, 1.F);
+        std::vector<complex_t> result(length/2+1);
+        std::vector<complex_t> scratch(length/2);
+        plans[i]->transform(&result[0], &data[0], &scratch[0]);
+        // the DFT of a constant is only non-zero at frequency 0
+        if (std::abs(result[0] - complex_t(static_cast<float>(length))) > 1.E-3F*length)
+          ++num_failures[i];
+        for (int k=1; k<=length/2; ++k)
+          if (std::abs(result[k]) > 1.E-3F*length)
+            ++num_failures[i];
+      }
+    for (int i=0; i<num_lengths; ++i)
+      {
+        check_if_equal(num_failures[i], 0, "transforms computed in multiple threads");
+        check(plans[i] == plans[i%10], "plans obtained in multiple threads should be the same");
+      }
+  }
+#endif
+}
+
+void
+FourierTests::
+run_tests()
+{
+  std::cerr << "Testing DFT functions..." << std::endl;
+  test_complex_transforms();
+  test_real_transforms();
+  test_transforms_of_rows();
+  test_multi_dimensional_transforms();
+  test_plans();
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+int main()
+{
+  FourierTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
@@ -14,6 +14,7 @@ $(dir)_TEST_SOURCES := test_Array.cxx test_NestedIterator.cxx \
 	test_VoxelsOnCartesianGrid.cxx \
 	test_zoom_image.cxx \
 	test_proj_data_info.cxx \
+	test_ProjDataFromStream.cxx \
 	test_stir_math.cxx \
 	test_OutputFileFormat.cxx \
 	test_ByteOrder.cxx \
@@ -22,11 +23,13 @@ $(dir)_TEST_SOURCES := test_Array.cxx test_NestedIterator.cxx \
 	test_ArcCorrection.cxx \
 	test_DynamicDiscretisedDensity.cxx   \
 	test_find_fwhm_in_image.cxx \
-        test_warp_image.cxx
+        test_warp_image.cxx \
+	test_elementwise_kernels.cxx
 
 (dir)_INTERACTIVE_TEST_SOURCES := \
 	test_display.cxx \
-	test_interpolate.cxx 
+	test_interpolate.cxx \
+	elementwise_kernels_timing.cxx
 
 
 # note: do not use $(dir) in the command lines as that variable
@@ -101,7 +104,8 @@ ${DEST}$(dir)/test_ArrayFilter: ${DEST}$(dir)/test_ArrayFilter${O_SUFFIX} \
    $(DEST)buildblock/ArrayFilter3DUsingConvolution${O_SUFFIX} \
    $(DEST)buildblock/ArrayFilter1DUsingConvolutionSymmetricKernel${O_SUFFIX} \
    $(DEST)buildblock/ArrayFilterUsingRealDFTWithPadding${O_SUFFIX}  \
-   $(DEST)numerics_buildblock/fourier${O_SUFFIX}
+   $(DEST)numerics_buildblock/fourier${O_SUFFIX} \
+   $(DEST)numerics_buildblock/FFTPlan${O_SUFFIX}
 	$(LINK) $(EXE_OUTFLAG)$(@)$(EXE_SUFFIX) $< \
 	${DEST}buildblock/error${O_SUFFIX}  $(DEST)buildblock/IndexRange${O_SUFFIX} \
 	${DEST}buildblock/warning${O_SUFFIX}\
@@ -112,6 +116,7 @@ ${DEST}$(dir)/test_ArrayFilter: ${DEST}$(dir)/test_ArrayFilter${O_SUFFIX} \
         $(DEST)buildblock/ArrayFilter1DUsingConvolutionSymmetricKernel${O_SUFFIX} \
         $(DEST)buildblock/ArrayFilterUsingRealDFTWithPadding${O_SUFFIX} \
         $(DEST)numerics_buildblock/fourier${O_SUFFIX} \
+        $(DEST)numerics_buildblock/FFTPlan${O_SUFFIX} \
 	$(LINKFLAGS) $(SYS_LIBS)
 
 ${DEST}$(dir)/test_NestedIterator: ${DEST}$(dir)/test_NestedIterator${O_SUFFIX} ${DEST}buildblock/error${O_SUFFIX}  $(DEST)buildblock/IndexRange${O_SUFFIX}
@@ -2,7 +2,7 @@
     Copyright (C) 2000 PARAPET partners
     Copyright (C) 2000-2011, Hammersmith Imanet Ltd
     Copyright (C) 2013 Kris Thielemans
-    Copyright (C) 2013 University College London
+    Copyright (C) 2013, 2016 University College London
 
     This file is part of STIR.
 
@@ -623,6 +623,72 @@ ArrayTests::run_tests()
         Array<3,float>::const_full_iterator ctiter= titer; // this should compile
       }
     }
+    // contiguous storage
+    {
+      const IndexRange<3> range(Coordinate3D<int>(-1,1,4),Coordinate3D<int>(1,2,6));
+      Array<3,float> test(range);
+      check(test.is_contiguous(), "test is_contiguous() after construction");
+      {
+        const float* const data_ptr = test.get_const_full_data_ptr();
+        check(reinterpret_cast<size_t>(data_ptr) % 64 == 0, "test alignment of contiguous data");
+        float value = 1.2F;
+        for (Array<3,float>::full_iterator iter = test.begin_all();
+             iter != test.end_all(); 
+             )
+          *iter++ = value++;
+        Array<3,float>::const_full_iterator iter = test.begin_all_const();
+        for (size_t i=0; i<test.size_all(); ++i, ++iter)
+          check_if_equal(data_ptr[i], *iter, "test order of get_full_data_ptr() vs. full iterator");
+      }
+      Array<3,float> test_copy(test);
+      check(test_copy.is_contiguous(), "test is_contiguous() after copy");
+      check_if_equal(test_copy, test, "test copy of contiguous array");
+      check(test_copy.get_const_full_data_ptr() != test.get_const_full_data_ptr(),
+            "test copy of contiguous array uses new memory");
+      {
+        Array<3,float> test_assigned(IndexRange<3>(Coordinate3D<int>(0,0,0),Coordinate3D<int>(1,1,1)));
+        test_assigned = test;
+        check(test_assigned.is_contiguous(), "test is_contiguous() after assignment with different range");
+        check_if_equal(test_assigned, test, "test assignment with different range");
+        const float* const data_ptr = test_assigned.get_const_full_data_ptr();
+        test_assigned = test_copy;
+        check(data_ptr == test_assigned.get_const_full_data_ptr(),
+              "test assignment with same range uses the same memory");
+      }
+      test_copy.resize(IndexRange<3>(Coordinate3D<int>(0,0,3),Coordinate3D<int>(2,2,5)));
+      check(test_copy.is_contiguous(), "test is_contiguous() after resize");
+      check_if_equal(test_copy[1][2][5], test[1][2][5], "test resize keeps elements in overlap");
+      check_if_equal(test_copy[2][0][3], 0.F, "test resize sets new elements to 0");
+
+      // non-contiguous case
+      test_copy = test;
+      test_copy[0][1].resize(3,7);
+      check(!test_copy.is_contiguous(), "test is_contiguous() after resizing a row");
+      test_copy[0][1][7] = 5.F;
+      check_if_equal(test_copy.sum(), test.sum() + 5.F, "test sum() of non-contiguous array");
+      check_if_equal(test_copy.find_max(), test.find_max(), "test find_max() of non-contiguous array");
+      test_copy.fill(2.F);
+      check_if_equal(test_copy.sum(), 2.F*test_copy.size_all(), "test fill() of non-contiguous array");
+      test_copy[0][1].resize(4,6);
+      check(!test_copy.is_contiguous(), "test is_contiguous() after resizing a row back to its range");
+      test_copy += test;
+      check_if_equal(test_copy[1][2][5], test[1][2][5] + 2.F, "test operator+= of non-contiguous array");
+      test_copy.resize(range);
+      check(test_copy.is_contiguous(), "test is_contiguous() after resizing the whole array");
+      check_if_equal(test_copy[1][2][5], test[1][2][5] + 2.F, "test resize of non-contiguous array keeps elements");
+      bool error_thrown = false;
+      try
+        {
+          test_copy[1][1].resize(0,3);
+          cerr << "\nThe next test should give an error\n";
+          test_copy.get_full_data_ptr();
+        }
+      catch (...)
+        {
+          error_thrown = true;
+        }
+      check(error_thrown, "test get_full_data_ptr() of non-contiguous array should throw");
+    }
   }
 
 
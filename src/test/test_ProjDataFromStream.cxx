@@ -0,0 +1,206 @@
+//
+//
+/*!
+
+  \file
+  \ingroup test
+
+  \brief Test program for reading data with stir::ProjDataFromStream
+
+  Writes projection data as (byte-swapped) shorts with a scale factor, and checks
+  that it is read back correctly via the stream and via the memory mapping
+  (see stir::ProjDataFromStream::set_up_concurrent_read), and (when using OpenMP)
+  when reading from several threads at the same time.
+*/
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+
+#include "stir/ProjDataFromStream.h"
+#include "stir/ExamInfo.h"
+#include "stir/ProjDataInfo.h"
+#include "stir/SegmentByView.h"
+#include "stir/SegmentBySinogram.h"
+#include "stir/Sinogram.h"
+#include "stir/Viewgram.h"
+#include "stir/Scanner.h"
+#include "stir/NumericInfo.h"
+#include "stir/IO/write_data.h"
+#include "stir/Succeeded.h"
+#include "stir/RunTests.h"
+#include <fstream>
+#include <cstdio>
+#include <vector>
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for reading with ProjDataFromStream
+*/
+class ProjDataFromStreamTests: public RunTests
+{
+public:
+  void run_tests();
+private:
+  void run_tests_for_storage_order(const ProjDataFromStream::StorageOrder storage_order);
+
+  shared_ptr<ExamInfo> exam_info_sptr;
+  shared_ptr<ProjDataInfo> proj_data_info_sptr;
+  //! data as written to file
+  std::vector<SegmentByView<float> > segments;
+};
+
+void
+ProjDataFromStreamTests::
+run_tests_for_storage_order(const ProjDataFromStream::StorageOrder storage_order)
+{
+  const char * const filename = "test_ProjDataFromStream.s";
+  const std::streamoff offset = 16;
+  const float scale_factor = 2.F;
+  {
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    // some bytes to check the offset
+    const std::vector<char> header(static_cast<std::size_t>(offset), 'x');
+    out.write(&header[0], offset);
+    for (std::size_t i=0; i<segments.size(); ++i)
+      {
+        bool ok;
+        if (storage_order == ProjDataFromStream::Segment_View_AxialPos_TangPos)
+          ok = write_data_with_fixed_scale_factor(out, segments[i], NumericInfo<short>(),
+                                                  scale_factor, ByteOrder::swapped) == Succeeded::yes;
+        else
+          ok = write_data_with_fixed_scale_factor(out, SegmentBySinogram<float>(segments[i]), NumericInfo<short>(),
+                                                  scale_factor, ByteOrder::swapped) == Succeeded::yes;
+        if (!check(ok, "writing data"))
+          return;
+      }
+  }
+
+  shared_ptr<std::iostream> stream_sptr(new std::fstream(filename, std::ios::in | std::ios::binary));
+  ProjDataFromStream proj_data(exam_info_sptr, proj_data_info_sptr, stream_sptr, offset,
+                               storage_order, NumericType::SHORT, ByteOrder::swapped, scale_factor);
+  shared_ptr<std::iostream> stream2_sptr(new std::fstream(filename, std::ios::in | std::ios::binary));
+  ProjDataFromStream mapped_proj_data(exam_info_sptr, proj_data_info_sptr, stream2_sptr, offset,
+                                      storage_order, NumericType::SHORT, ByteOrder::swapped, scale_factor);
+  check(!proj_data.supports_concurrent_read(), "concurrent reading should be off by default");
+  check(mapped_proj_data.set_up_concurrent_read(filename) == Succeeded::yes, "set_up_concurrent_read");
+  check(mapped_proj_data.supports_concurrent_read(), "concurrent reading after set_up_concurrent_read");
+  {
+    // the file is too short if the data start later, so it should not be mapped
+    ProjDataFromStream shifted_proj_data(exam_info_sptr, proj_data_info_sptr, stream_sptr, offset+2,
+                                         storage_order, NumericType::SHORT, ByteOrder::swapped, scale_factor);
+    check(shifted_proj_data.set_up_concurrent_read(filename) == Succeeded::no,
+          "set_up_concurrent_read for a file that is too short");
+    check(!shifted_proj_data.supports_concurrent_read(), "concurrent reading for a file that is too short");
+  }
+
+  for (std::size_t i=0; i<segments.size(); ++i)
+    {
+      const SegmentByView<float>& segment = segments[i];
+      const int segment_num = segment.get_segment_num();
+      check_if_equal(proj_data.get_segment_by_view(segment_num), segment, "get_segment_by_view via stream");
+      check_if_equal(mapped_proj_data.get_segment_by_view(segment_num), segment, "get_segment_by_view via mapping");
+      const SegmentBySinogram<float> segment_by_sino(segment);
+      check_if_equal(mapped_proj_data.get_segment_by_sinogram(segment_num), segment_by_sino,
+                     "get_segment_by_sinogram via mapping");
+      const int view_num = segment.get_max_view_num();
+      check_if_equal(mapped_proj_data.get_viewgram(view_num, segment_num), segment[view_num],
+                     "get_viewgram via mapping");
+      const int ax_pos_num = segment.get_max_axial_pos_num();
+      check_if_equal(mapped_proj_data.get_sinogram(ax_pos_num, segment_num), segment_by_sino[ax_pos_num],
+                     "get_sinogram via mapping");
+    }
+
+  // read all viewgrams from several threads at the same time
+  // and compare with the same reads done serially
+  // (conversion of the data is not necessarily exact, so we do not compare with the segments)
+  {
+    const int min_view_num = proj_data_info_sptr->get_min_view_num();
+    const int num_views = proj_data_info_sptr->get_num_views();
+    const int num_segments = static_cast<int>(segments.size());
+    std::vector<Array<2,float> > serial_viewgrams;
+    std::vector<Array<2,float> > serial_sinograms;
+    for (int i=0; i<num_segments*num_views; ++i)
+      {
+        const SegmentByView<float>& segment = segments[i/num_views];
+        const int view_num = min_view_num + i%num_views;
+        serial_viewgrams.push_back(mapped_proj_data.get_viewgram(view_num, segment.get_segment_num()));
+        serial_sinograms.push_back(mapped_proj_data.get_sinogram(segment.get_min_axial_pos_num(),
+                                                                 segment.get_segment_num()));
+      }
+    int num_different = 0;
+#ifdef STIR_OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:num_different)
+#endif
+    for (int i=0; i<num_segments*num_views; ++i)
+      {
+        const SegmentByView<float>& segment = segments[i/num_views];
+        const int view_num = min_view_num + i%num_views;
+        const Viewgram<float> viewgram = mapped_proj_data.get_viewgram(view_num, segment.get_segment_num());
+        const Sinogram<float> sinogram =
+          mapped_proj_data.get_sinogram(segment.get_min_axial_pos_num(), segment.get_segment_num());
+        if (!(static_cast<const Array<2,float>&>(viewgram) == serial_viewgrams[i]) ||
+            !(static_cast<const Array<2,float>&>(sinogram) == serial_sinograms[i]))
+          ++num_different;
+      }
+    check_if_equal(num_different, 0, "reading viewgrams and sinograms from several threads");
+  }
+  std::remove(filename);
+}
+
+void
+ProjDataFromStreamTests::
+run_tests()
+{
+  std::cerr << "-------- Testing ProjDataFromStream --------\n";
+  shared_ptr<Scanner> scanner_sptr(new Scanner(Scanner::E953));
+  proj_data_info_sptr.reset(
+    ProjDataInfo::ProjDataInfoCTI(scanner_sptr,
+                                  /*span*/3, 6,/*views*/ 16, /*tang_pos*/32, /*arc_corrected*/ true));
+  exam_info_sptr.reset(new ExamInfo);
+
+  // fill with values that can be represented exactly as short after dividing by the scale factor
+  segments.clear();
+  for (int segment_num=proj_data_info_sptr->get_min_segment_num();
+       segment_num<=proj_data_info_sptr->get_max_segment_num();
+       ++segment_num)
+    {
+      SegmentByView<float> segment = proj_data_info_sptr->get_empty_segment_by_view(segment_num);
+      for (int v=segment.get_min_view_num(); v<=segment.get_max_view_num(); ++v)
+        for (int a=segment.get_min_axial_pos_num(); a<=segment.get_max_axial_pos_num(); ++a)
+          for (int t=segment.get_min_tangential_pos_num(); t<=segment.get_max_tangential_pos_num(); ++t)
+            segment[v][a][t] = 2.F*(1000*segment_num + 100*v + 10*a + t);
+      segments.push_back(segment);
+    }
+
+  std::cerr << "\tTesting storage order Segment_View_AxialPos_TangPos\n";
+  run_tests_for_storage_order(ProjDataFromStream::Segment_View_AxialPos_TangPos);
+  std::cerr << "\tTesting storage order Segment_AxialPos_View_TangPos\n";
+  run_tests_for_storage_order(ProjDataFromStream::Segment_AxialPos_View_TangPos);
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+int main()
+{
+  ProjDataFromStreamTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
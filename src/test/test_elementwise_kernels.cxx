@@ -0,0 +1,212 @@
+/*
+    Copyright (C) 2016, University College London
+    This file is part of STIR.
+
+    This file is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This file is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    See STIR/LICENSE.txt for details
+*/
+/*!
+  \file
+  \ingroup test
+  \ingroup Array
+
+  \brief Test program for the functions in stir/elementwise_kernels.h
+
+  For every instruction set supported by the processor, the float versions are
+  compared with the template versions, for sizes that do not fill a whole
+  vector register, for data that is not aligned, and for a size that is large
+  enough to be split over threads.
+*/
+
+#include "stir/elementwise_kernels.h"
+#include "stir/Array.h"
+#include "stir/IndexRange3D.h"
+#include "stir/RunTests.h"
+#include <boost/format.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#ifndef STIR_NO_NAMESPACES
+using std::cerr;
+using std::string;
+#endif
+
+START_NAMESPACE_STIR
+
+/*!
+  \ingroup test
+  \brief Test class for the element-wise operations
+*/
+class ElementwiseKernelsTests : public RunTests
+{
+public:
+  void run_tests();
+private:
+  //! test all operations on \a n elements starting at \a offset in the vectors
+  void test_operations(const std::size_t n, const std::size_t offset, const string& prefix);
+  //! compare with the expected values
+  void check_all(const std::vector<float>& data, const std::vector<float>& expected, const string& message);
+};
+
+void
+ElementwiseKernelsTests::
+check_all(const std::vector<float>& data, const std::vector<float>& expected, const string& message)
+{
+  bool equal = true;
+  for (unsigned int i=0; i<data.size() && equal; ++i)
+    equal = check_if_equal(data[i], expected[i], message);
+}
+
+void
+ElementwiseKernelsTests::
+test_operations(const std::size_t n, const std::size_t offset, const string& prefix)
+{
+  // allocate 1 more such that &a[offset] is valid when n is 0
+  const std::size_t size = n + offset + 1;
+  std::vector<float> a(size), b(size);
+  for (std::size_t i=0; i<size; ++i)
+    {
+      a[i] = static_cast<float>(i%17) - 8.3F;
+      b[i] = static_cast<float>(i%13) - 6.F;
+    }
+  // make sure some elements are small for the division tests
+  for (std::size_t i=0; i<size; i+=7)
+    a[i] = 0.F;
+
+  // note: these call the non-template and the template versions respectively
+  std::vector<float> result(a), expected(a);
+#define STIR_TEST_BINARY(NAME)                                          \
+  result = a; expected = a;                                             \
+  NAME(&result[offset], &b[offset], n);                                 \
+  NAME<float>(&expected[offset], &b[offset], n);                        \
+  check_all(result, expected, prefix + #NAME)
+
+  STIR_TEST_BINARY(elementwise_add);
+  STIR_TEST_BINARY(elementwise_subtract);
+  STIR_TEST_BINARY(elementwise_multiply);
+  STIR_TEST_BINARY(elementwise_divide_or_zero);
+#undef STIR_TEST_BINARY
+
+#define STIR_TEST_SCALAR(NAME, VALUE)                                   \
+  result = a; expected = a;                                             \
+  NAME(&result[offset], VALUE, n);                                      \
+  NAME<float>(&expected[offset], VALUE, n);                             \
+  check_all(result, expected, prefix + #NAME)
+
+  STIR_TEST_SCALAR(elementwise_add_scalar, 2.5F);
+  STIR_TEST_SCALAR(elementwise_subtract_scalar, 2.5F);
+  STIR_TEST_SCALAR(elementwise_multiply_scalar, 2.5F);
+  STIR_TEST_SCALAR(elementwise_divide_scalar, 2.5F);
+#undef STIR_TEST_SCALAR
+
+  // avoid 0 in the denominator
+  {
+    std::vector<float> positive_b(b);
+    for (std::size_t i=0; i<size; ++i)
+      positive_b[i] = std::fabs(b[i]) + 1.F;
+    result = a; expected = a;
+    elementwise_divide(&result[offset], &positive_b[offset], n);
+    elementwise_divide<float>(&expected[offset], &positive_b[offset], n);
+    check_all(result, expected, prefix + "elementwise_divide");
+  }
+  result = a; expected = a;
+  elementwise_divide_unless_small(&result[offset], &b[offset], n, 1.5F);
+  elementwise_divide_unless_small<float>(&expected[offset], &b[offset], n, 1.5F);
+  check_all(result, expected, prefix + "elementwise_divide_unless_small");
+
+  result = a; expected = a;
+  elementwise_threshold_upper_lower(&result[offset], n, -2.F, 3.F);
+  elementwise_threshold_upper_lower<float>(&expected[offset], n, -2.F, 3.F);
+  check_all(result, expected, prefix + "elementwise_threshold_upper_lower");
+
+  // log and exp might use a different implementation when vectorised (check_if_equal uses a tolerance)
+  {
+    std::vector<float> positive_a(a);
+    for (std::size_t i=0; i<size; ++i)
+      positive_a[i] = std::fabs(a[i]) + .5F;
+    result = positive_a; expected = positive_a;
+    elementwise_log(&result[offset], n);
+    elementwise_log<float>(&expected[offset], n);
+    check_all(result, expected, prefix + "elementwise_log");
+    result = positive_a; expected = positive_a;
+    elementwise_exp(&result[offset], n);
+    elementwise_exp<float>(&expected[offset], n);
+    check_all(result, expected, prefix + "elementwise_exp");
+  }
+}
+
+void
+ElementwiseKernelsTests::
+run_tests()
+{
+  cerr << "Tests for elementwise_kernels\n";
+
+  const std::vector<string> instruction_sets = get_supported_elementwise_instruction_sets();
+  check(instruction_sets[0] == "generic", "first instruction set should be generic");
+  check(get_elementwise_instruction_set() == instruction_sets.back(),
+        "last supported instruction set should be the default");
+
+  for (unsigned int i=0; i<instruction_sets.size(); ++i)
+    {
+      cerr << "Testing instruction set " << instruction_sets[i] << '\n';
+      check(set_elementwise_instruction_set(instruction_sets[i]) == Succeeded::yes,
+            "set_elementwise_instruction_set with supported instruction set");
+      check(get_elementwise_instruction_set() == instruction_sets[i],
+            "get_elementwise_instruction_set");
+      const std::size_t sizes[] = { 0, 1, 7, 33, 1000, 300001 };
+      for (unsigned int s=0; s<sizeof(sizes)/sizeof(sizes[0]); ++s)
+        for (std::size_t offset=0; offset<3; ++offset)
+          test_operations(sizes[s], offset,
+                          boost::str(boost::format("%1%, size %2%, offset %3%: ")
+                                     % instruction_sets[i] % sizes[s] % offset));
+    }
+  check(set_elementwise_instruction_set("some unknown instruction set") == Succeeded::no,
+        "set_elementwise_instruction_set with unknown instruction set");
+  set_elementwise_instruction_set(instruction_sets.back());
+
+  // test the Array operators that use the element-wise operations
+  {
+    Array<3,float> array(IndexRange3D(-1,30,0,40,-3,60));
+    Array<3,float> array2(array.get_index_range());
+    for (Array<3,float>::full_iterator iter = array.begin_all(), iter2 = array2.begin_all();
+         iter != array.end_all();
+         ++iter, ++iter2)
+      {
+        *iter = static_cast<float>(std::rand()%1000)/100.F;
+        *iter2 = static_cast<float>(std::rand()%1000)/100.F + 1;
+      }
+    Array<3,float> expected(array);
+    for (Array<3,float>::full_iterator iter = expected.begin_all(), iter2 = array2.begin_all();
+         iter != expected.end_all();
+         ++iter, ++iter2)
+      *iter = (*iter + *iter2)*2.F/ *iter2 - 1.F;
+    array += array2;
+    array *= 2.F;
+    array /= array2;
+    array -= 1.F;
+    check_if_equal(array, expected, "Array operations using element-wise operations");
+  }
+}
+
+END_NAMESPACE_STIR
+
+
+USING_NAMESPACE_STIR
+
+
+int main()
+{
+  ElementwiseKernelsTests tests;
+  tests.run_tests();
+  return tests.main_return_value();
+}
@@ -38,6 +38,8 @@
 #include "stir/is_null_ptr.h"
 #include "stir/Coordinate3D.h"
 #include "stir/IO/read_from_file.h"
+#include <cstring>
+#include <cstdlib>
 
 #ifndef STIR_NO_NAMESPACES
 using std::endl;
@@ -50,10 +52,18 @@ int
 main(int argc, char **argv)
 {  
   USING_NAMESPACE_STIR
-  if (argc==1 || argc>5)
+  const char * const program_name = argv[0];
+  int format_version = 2;
+  if (argc>2 && strcmp(argv[1], "--format-version")==0)
+    {
+      format_version = atoi(argv[2]);
+      argc -= 2; argv += 2;
+    }
+  if (argc==1 || argc>5 || (format_version != 1 && format_version != 2))
   {
-    cerr <<"Usage: " << argv[0] << " \\\n"
-	 << "\toutput-filename [proj_data_file [projmatrixbybin-parfile [template-image]]]\n";
+    cerr <<"Usage: " << program_name << " \\\n"
+	 << "\t[--format-version 1|2] output-filename [proj_data_file [projmatrixbybin-parfile [template-image]]]\n"
+	 << "Version 2 (the default) can be memory mapped by ProjMatrixByBinFromFile.\n";
     exit(EXIT_FAILURE);
   }
   const std::string output_filename_prefix=
@@ -122,7 +132,8 @@ main(int argc, char **argv)
     write_to_file(output_filename_prefix, 
 		  *proj_matrix_sptr, 
 		  proj_data_info_sptr,
-		  *image_sptr) == Succeeded::yes ?
+		  *image_sptr,
+		  format_version) == Succeeded::yes ?
     EXIT_SUCCESS : EXIT_FAILURE;
 }
 